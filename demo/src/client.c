@@ -5,34 +5,107 @@
  * 1. 展示 TCP 客户端的创建流程: socket() -> connect()
  * 2. 展示如何发送请求和接收响应
  * 3. 展示命令行参数解析和交互式操作
+ * 4. 展示请求流水线: 不等待响应连续发送，测量吞吐
+ * 5. 基准测试: 多连接、多线程、命令组合、闭环/开环负载和延迟分布
+ * 6. 协议 v2 (-2): 版本协商、请求 ID、大负载上传/下载和乱序响应
  *
  * 用法:
  *   ./client -h <host> -p <port> -c <command> [args]
  *   ./client -i                  # 交互模式
+ *   ./client -P 100000 -d 64 -c ping   # 流水线压测
+ *   ./client -B -n 64 -t 4 -D 10       # 基准测试
+ *   ./client -2 -c "mux 67108864 100"  # v2: 下载期间的小请求
  */
 
+#define _GNU_SOURCE     /* epoll_pwait2 */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
 
 /* Socket 相关头文件 */
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/tcp.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 
 #include "protocol.h"
 
+/* 当前连接使用的协议版本 (-2 时由 HELLO 协商) */
+static int g_version = PROTO_V1;
+
+/* v2 的下一个请求 ID */
+static uint32_t g_next_id = 1;
+
 /* ============================================
  * 消息收发函数
  * ============================================ */
 
 /*
- * 发送消息到服务器
+ * 阻塞地发送/接收全部 len 字节
+ */
+static int send_all(int sock_fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = send(sock_fd, p, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int recv_all(int sock_fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = recv(sock_fd, p, len, MSG_WAITALL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/*
+ * 填写 v2 消息头
+ */
+static void set_header_v2(MessageHeaderV2 *h, uint8_t cmd, uint32_t id, uint32_t len) {
+    h->cmd = cmd;
+    h->flags = 0;
+    h->reserved = 0;
+    h->request_id = htonl(id);
+    h->length = htonl(len);
+}
+
+/*
+ * 发送消息到服务器 (按当前协议版本组帧)
  */
 int send_message(int sock_fd, uint8_t cmd, const void *payload, uint16_t len) {
+    if (g_version == PROTO_V2) {
+        char buf[HEADER_V2_SIZE + MAX_PAYLOAD_SIZE];
+        set_header_v2((MessageHeaderV2 *)buf, cmd, g_next_id++, len);
+        if (len > 0 && payload != NULL) {
+            memcpy(buf + HEADER_V2_SIZE, payload, len);
+        }
+        return send_all(sock_fd, buf, HEADER_V2_SIZE + len);
+    }
+
     Message msg;
     msg.header.cmd = cmd;
     msg.header.length = htons(len);
@@ -49,22 +122,38 @@ int send_message(int sock_fd, uint8_t cmd, const void *payload, uint16_t len) {
 
 /*
  * 从服务器接收消息
+ * v2 的响应转换成 v1 的 Message (一问一答时按顺序到达，不检查 ID)
  */
 int recv_message(int sock_fd, Message *msg) {
-    /* 接收消息头 */
-    ssize_t n = recv(sock_fd, &msg->header, HEADER_SIZE, MSG_WAITALL);
-    if (n <= 0) {
-        return -1;
+    if (g_version == PROTO_V2) {
+        MessageHeaderV2 h;
+        if (recv_all(sock_fd, &h, HEADER_V2_SIZE) < 0) {
+            return -1;
+        }
+        uint32_t len = ntohl(h.length);
+        if (len > MAX_PAYLOAD_SIZE) {
+            return -1;
+        }
+        msg->header.cmd = h.cmd;
+        msg->header.length = htons(len);
+    } else {
+        /* 接收消息头 */
+        ssize_t n = recv(sock_fd, &msg->header, HEADER_SIZE, MSG_WAITALL);
+        if (n <= 0) {
+            return -1;
+        }
     }
 
     /* 接收负载 */
     uint16_t payload_len = ntohs(msg->header.length);
     if (payload_len > 0) {
-        n = recv(sock_fd, msg->payload, payload_len, MSG_WAITALL);
+        ssize_t n = recv(sock_fd, msg->payload, payload_len, MSG_WAITALL);
         if (n != payload_len) {
             return -1;
         }
-        msg->payload[payload_len] = '\0';  /* 确保字符串结尾 */
+        if (payload_len < MAX_PAYLOAD_SIZE) {
+            msg->payload[payload_len] = '\0';  /* 确保字符串结尾 */
+        }
     }
 
     return 0;
@@ -198,6 +287,46 @@ int do_calc(int sock_fd, uint8_t cmd, int a, int b) {
     return 0;
 }
 
+/*
+ * 执行任意命令 (例如服务器插件提供的命令)，负载为文本
+ */
+int do_raw(int sock_fd, uint8_t cmd, const char *text) {
+    size_t len = strlen(text) > MAX_PAYLOAD_SIZE ? MAX_PAYLOAD_SIZE : strlen(text);
+    printf("Sending [0x%02X]: \"%.*s\"\n", cmd, (int)len, text);
+
+    if (send_message(sock_fd, cmd, text, len) < 0) {
+        perror("Failed to send");
+        return -1;
+    }
+
+    Message resp;
+    if (recv_message(sock_fd, &resp) < 0) {
+        perror("Failed to receive");
+        return -1;
+    }
+
+    printf("Response [%s]: %.*s\n", cmd_to_string(resp.header.cmd),
+           ntohs(resp.header.length), resp.payload);
+    return 0;
+}
+
+/*
+ * 解析 "raw <cmd> [text]" 的命令字节和文本
+ * 返回: 0=成功, -1=格式错误
+ */
+int parse_raw(const char *command, uint8_t *cmd, const char **text) {
+    char *end;
+    const char *p = command + 3;
+    long value = strtol(p, &end, 0);
+    if (end == p || value < 0 || value > 0xFF) {
+        return -1;
+    }
+    while (*end == ' ') end++;
+    *cmd = (uint8_t)value;
+    *text = end;
+    return 0;
+}
+
 /*
  * 执行 QUIT 命令
  */
@@ -207,10 +336,422 @@ int do_quit(int sock_fd) {
     return 0;
 }
 
+/* ============================================
+ * 协议 v2
+ * ============================================
+ *
+ * -2 时连接建立后先用 v1 格式发送 HELLO，服务器同意后双方都改用 v2 帧
+ * (32 位长度 + 请求 ID)。下面的命令只能在 v2 连接上使用，数据内容是
+ * 按偏移生成的固定序列，接收时逐字节校验。
+ */
+
+#define V2_IO_CHUNK     (1024 * 1024)   /* 生成/校验数据时每次处理的大小 */
+
+/*
+ * 协商协议版本
+ * 返回: 协商出的版本, -1=连接出错
+ */
+int negotiate_version(int sock_fd, int version) {
+    uint8_t want = version;
+    if (send_message(sock_fd, CMD_HELLO, &want, 1) < 0) {
+        return -1;
+    }
+    Message resp;
+    if (recv_message(sock_fd, &resp) < 0) {
+        return -1;
+    }
+
+    /* 不认识 HELLO 的服务器回复 ERROR，继续使用 v1 */
+    g_version = PROTO_V1;
+    if (resp.header.cmd == RESP_OK && ntohs(resp.header.length) >= 1 &&
+        (uint8_t)resp.payload[0] == PROTO_V2) {
+        g_version = PROTO_V2;
+
+        /* 大负载的消息头和数据分两次写出，不能让 Nagle 等待对端的 ACK */
+        int on = 1;
+        setsockopt(sock_fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    printf("Protocol: v%d%s\n", g_version,
+           g_version < version ? " (server does not support a newer version)" : "");
+    return g_version;
+}
+
+static int require_v2(void) {
+    if (g_version != PROTO_V2) {
+        printf("This command needs a protocol v2 connection (-2, not available with -u servers)\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* 偏移 off 处的数据: 251 是质数，块边界错位时也能发现 */
+static void fill_pattern(char *buf, size_t off, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (char)((off + i) % 251);
+    }
+}
+
+static int check_pattern(const char *buf, size_t off, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (buf[i] != (char)((off + i) % 251)) {
+            printf("Data mismatch at offset %zu\n", off + i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * 接收并校验 len 字节的负载 (从数据的第 off 字节开始)
+ */
+static int recv_pattern(int sock_fd, char *scratch, size_t off, size_t len) {
+    while (len > 0) {
+        size_t n = len < V2_IO_CHUNK ? len : V2_IO_CHUNK;
+        if (recv_all(sock_fd, scratch, n) < 0 || check_pattern(scratch, off, n) < 0) {
+            return -1;
+        }
+        off += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/*
+ * 接收并打印一个错误响应的负载
+ */
+static void print_error_v2(int sock_fd, uint32_t len) {
+    char err[MAX_PAYLOAD_SIZE + 1];
+    if (len > MAX_PAYLOAD_SIZE || recv_all(sock_fd, err, len) < 0) {
+        printf("Error\n");
+        return;
+    }
+    printf("Error: %.*s\n", (int)len, err);
+}
+
+static void print_rate(const char *what, size_t bytes, double secs) {
+    printf("%s %zu bytes in %.3f ms (%.1f MB/s)\n", what, bytes, secs * 1e3,
+           secs > 0 ? bytes / secs / 1e6 : 0.0);
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * 上传 size 字节
+ * 返回: 0=成功, -1=失败
+ */
+static int blob_put(int sock_fd, char *scratch, size_t size) {
+    MessageHeaderV2 h;
+    uint32_t id = g_next_id++;
+    set_header_v2(&h, CMD_BLOB_PUT, id, size);
+    if (send_all(sock_fd, &h, HEADER_V2_SIZE) < 0) {
+        return -1;
+    }
+    for (size_t off = 0; off < size; ) {
+        size_t n = size - off < V2_IO_CHUNK ? size - off : V2_IO_CHUNK;
+        fill_pattern(scratch, off, n);
+        if (send_all(sock_fd, scratch, n) < 0) {
+            return -1;
+        }
+        off += n;
+    }
+
+    if (recv_all(sock_fd, &h, HEADER_V2_SIZE) < 0) {
+        return -1;
+    }
+    uint32_t len = ntohl(h.length);
+    if (h.cmd != RESP_OK || len != sizeof(uint32_t)) {
+        print_error_v2(sock_fd, len);
+        return -1;
+    }
+    uint32_t stored;
+    if (recv_all(sock_fd, &stored, sizeof(stored)) < 0 || ntohl(stored) != size) {
+        printf("Server stored a different size\n");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * 执行 put 命令 - 上传 size 字节的 blob
+ */
+int do_put(int sock_fd, size_t size) {
+    if (require_v2() < 0) {
+        return -1;
+    }
+    char *scratch = malloc(V2_IO_CHUNK);
+    if (!scratch) {
+        return -1;
+    }
+    double start = now_sec();
+    int ret = blob_put(sock_fd, scratch, size);
+    if (ret == 0) {
+        print_rate("Uploaded", size, now_sec() - start);
+    }
+    free(scratch);
+    return ret;
+}
+
+/*
+ * 执行 get 命令 - 下载 blob 的前 size 字节 (0=全部)，逐块校验
+ */
+int do_get(int sock_fd, size_t size) {
+    if (require_v2() < 0) {
+        return -1;
+    }
+    char *scratch = malloc(V2_IO_CHUNK);
+    if (!scratch) {
+        return -1;
+    }
+
+    double start = now_sec();
+    MessageHeaderV2 h;
+    uint32_t want = htonl(size);
+    set_header_v2(&h, CMD_BLOB_GET, g_next_id++, sizeof(want));
+    char req[HEADER_V2_SIZE + sizeof(want)];
+    memcpy(req, &h, HEADER_V2_SIZE);
+    memcpy(req + HEADER_V2_SIZE, &want, sizeof(want));
+    int ret = send_all(sock_fd, req, sizeof(req));
+
+    size_t total = 0;
+    int frames = 0;
+    while (ret == 0) {
+        if (recv_all(sock_fd, &h, HEADER_V2_SIZE) < 0) {
+            ret = -1;
+            break;
+        }
+        uint32_t len = ntohl(h.length);
+        if (h.cmd != RESP_OK) {
+            print_error_v2(sock_fd, len);
+            ret = -1;
+            break;
+        }
+        if (recv_pattern(sock_fd, scratch, total, len) < 0) {
+            ret = -1;
+            break;
+        }
+        total += len;
+        frames++;
+        if (!(h.flags & V2_FLAG_MORE)) {
+            break;
+        }
+    }
+    if (ret == 0) {
+        print_rate("Downloaded", total, now_sec() - start);
+        printf("  -> %d frame(s), data verified\n", frames);
+    }
+    free(scratch);
+    return ret;
+}
+
+/*
+ * 执行 bigecho 命令 - 回显超过 MAX_PAYLOAD_SIZE 的负载
+ * 服务器边收边发，所以发送和接收必须同时进行 (非阻塞 + poll)，
+ * 否则双方的 socket 缓冲区都满了以后会互相等待
+ */
+int do_bigecho(int sock_fd, size_t size) {
+    if (require_v2() < 0) {
+        return -1;
+    }
+    char *out = malloc(HEADER_V2_SIZE + size);
+    char *in = malloc(V2_IO_CHUNK);
+    if (!out || !in) {
+        free(out);
+        free(in);
+        return -1;
+    }
+    set_header_v2((MessageHeaderV2 *)out, CMD_ECHO, g_next_id++, size);
+    fill_pattern(out + HEADER_V2_SIZE, 0, size);
+
+    int flags = fcntl(sock_fd, F_GETFL);
+    fcntl(sock_fd, F_SETFL, flags | O_NONBLOCK);
+
+    double start = now_sec();
+    size_t to_send = HEADER_V2_SIZE + size, sent = 0;
+    MessageHeaderV2 h;
+    size_t hdr_got = 0, got = 0, resp_len = 0;
+    int ret = 0;
+
+    while (ret == 0 && (hdr_got < HEADER_V2_SIZE || got < resp_len)) {
+        struct pollfd pfd = { sock_fd, POLLIN | (sent < to_send ? POLLOUT : 0), 0 };
+        if (poll(&pfd, 1, 5000) <= 0) {
+            printf("Timed out\n");
+            ret = -1;
+            break;
+        }
+
+        if ((pfd.revents & POLLOUT) && sent < to_send) {
+            ssize_t n = send(sock_fd, out + sent, to_send - sent, 0);
+            if (n > 0) {
+                sent += n;
+            } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                ret = -1;
+            }
+        }
+        if (!(pfd.revents & (POLLIN | POLLHUP | POLLERR))) {
+            continue;
+        }
+
+        /* 先收齐响应头，再边收边校验负载 */
+        ssize_t n;
+        if (hdr_got < HEADER_V2_SIZE) {
+            n = recv(sock_fd, (char *)&h + hdr_got, HEADER_V2_SIZE - hdr_got, 0);
+            if (n > 0) {
+                hdr_got += n;
+                if (hdr_got == HEADER_V2_SIZE) {
+                    resp_len = ntohl(h.length);
+                    if (h.cmd != RESP_OK || resp_len != size) {
+                        printf("Unexpected response [%s], len=%zu\n", cmd_to_string(h.cmd),
+                               resp_len);
+                        ret = -1;
+                    }
+                }
+            }
+        } else {
+            size_t want = resp_len - got < V2_IO_CHUNK ? resp_len - got : V2_IO_CHUNK;
+            n = recv(sock_fd, in, want, 0);
+            if (n > 0) {
+                if (check_pattern(in, got, n) < 0) {
+                    ret = -1;
+                }
+                got += n;
+            }
+        }
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            ret = -1;
+        }
+    }
+
+    fcntl(sock_fd, F_SETFL, flags);
+    if (ret == 0) {
+        print_rate("Echoed", size, now_sec() - start);
+        printf("  -> data verified\n");
+    }
+    free(out);
+    free(in);
+    return ret;
+}
+
+/*
+ * 执行 mux 命令 - 上传 size 字节，然后在一个连接上同时下载它并发送 pings 个 PING
+ * 所有请求一次发出，响应按 ID 匹配: 下载分块进行，PING 的响应插在块之间
+ */
+int do_mux(int sock_fd, size_t size, int pings) {
+    if (require_v2() < 0) {
+        return -1;
+    }
+    char *scratch = malloc(V2_IO_CHUNK);
+    if (!scratch || blob_put(sock_fd, scratch, size) < 0) {
+        free(scratch);
+        return -1;
+    }
+
+    /* GET 在前，PING 在后: 按顺序处理的服务器会先发完整个下载 */
+    size_t reqs_len = (size_t)(pings + 1) * HEADER_V2_SIZE + sizeof(uint32_t);
+    char *reqs = malloc(reqs_len);
+    if (!reqs) {
+        free(scratch);
+        return -1;
+    }
+    uint32_t get_id = g_next_id++;
+    uint32_t first_ping = g_next_id;
+    uint32_t want = 0;
+    set_header_v2((MessageHeaderV2 *)reqs, CMD_BLOB_GET, get_id, sizeof(want));
+    memcpy(reqs + HEADER_V2_SIZE, &want, sizeof(want));
+    char *p = reqs + HEADER_V2_SIZE + sizeof(want);
+    for (int i = 0; i < pings; i++, p += HEADER_V2_SIZE) {
+        set_header_v2((MessageHeaderV2 *)p, CMD_PING, g_next_id++, 0);
+    }
+
+    double start = now_sec();
+    int ret = send_all(sock_fd, reqs, reqs_len);
+    int pongs = 0, early = 0, frames = 0, get_done = 0;
+    size_t total = 0;
+    double get_time = 0, last_pong = 0;
+
+    while (ret == 0 && (!get_done || pongs < pings)) {
+        MessageHeaderV2 h;
+        if (recv_all(sock_fd, &h, HEADER_V2_SIZE) < 0) {
+            ret = -1;
+            break;
+        }
+        uint32_t id = ntohl(h.request_id);
+        uint32_t len = ntohl(h.length);
+
+        if (id == get_id) {
+            if (h.cmd != RESP_OK) {
+                print_error_v2(sock_fd, len);
+                ret = -1;
+                break;
+            }
+            if (recv_pattern(sock_fd, scratch, total, len) < 0) {
+                ret = -1;
+                break;
+            }
+            total += len;
+            frames++;
+            if (!(h.flags & V2_FLAG_MORE)) {
+                get_done = 1;
+                get_time = now_sec() - start;
+            }
+        } else if (id >= first_ping && id < first_ping + (uint32_t)pings && len <= MAX_PAYLOAD_SIZE) {
+            if (recv_all(sock_fd, scratch, len) < 0) {
+                ret = -1;
+                break;
+            }
+            pongs++;
+            early += !get_done;
+            last_pong = now_sec() - start;
+        } else {
+            printf("Unexpected response id=%u\n", id);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        if (total != size) {
+            printf("Downloaded %zu bytes, expected %zu\n", total, size);
+            ret = -1;
+        } else {
+            print_rate("Downloaded", total, get_time);
+            printf("  -> %d frame(s), data verified\n", frames);
+            printf("  -> %d/%d PING(s) answered before the download finished "
+                   "(last PONG at %.3f ms)\n", early, pings, last_pong * 1e3);
+        }
+    }
+    free(reqs);
+    free(scratch);
+    return ret;
+}
+
 /* ============================================
  * 连接管理
  * ============================================ */
 
+/*
+ * 解析服务器地址
+ */
+int resolve_host(const char *host, int port, struct sockaddr_in *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+
+    /* 尝试直接解析 IP 地址 */
+    if (inet_pton(AF_INET, host, &addr->sin_addr) <= 0) {
+        /* 如果失败，尝试 DNS 解析 */
+        struct hostent *he = gethostbyname(host);
+        if (he == NULL) {
+            fprintf(stderr, "Cannot resolve host: %s\n", host);
+            return -1;
+        }
+        memcpy(&addr->sin_addr, he->h_addr_list[0], he->h_length);
+    }
+    return 0;
+}
+
 /*
  * 连接到服务器
  */
@@ -240,20 +781,9 @@ int connect_to_server(const char *host, int port) {
     printf("Step 2: Resolving host '%s'...\n", host);
 
     struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
-
-    /* 尝试直接解析 IP 地址 */
-    if (inet_pton(AF_INET, host, &server_addr.sin_addr) <= 0) {
-        /* 如果失败，尝试 DNS 解析 */
-        struct hostent *he = gethostbyname(host);
-        if (he == NULL) {
-            fprintf(stderr, "Cannot resolve host: %s\n", host);
-            close(sock_fd);
-            return -1;
-        }
-        memcpy(&server_addr.sin_addr, he->h_addr_list[0], he->h_length);
+    if (resolve_host(host, port, &server_addr) < 0) {
+        close(sock_fd);
+        return -1;
     }
 
     char ip_str[INET_ADDRSTRLEN];
@@ -281,10 +811,122 @@ int connect_to_server(const char *host, int port) {
     return sock_fd;
 }
 
+/*
+ * 连接隔离测试: 连接 A 发一条 ECHO，紧跟一条非法帧 (服务器会关闭 A)；
+ * 随后新连接 B 发 PING，B 收到的第一条响应必须是它自己的 PONG，
+ * 不能是 A 没来得及发出的回显。事件模式的新连接按四元组哈希分给
+ * reactor，重复多轮才能让 B 落到 A 所在的 reactor。
+ * 返回: 0=通过, -1=失败
+ */
+int do_isolation(const char *host, int port, int rounds) {
+    static const char secret[] = "SECRET-OF-A";
+    struct sockaddr_in addr;
+    if (resolve_host(host, port, &addr) < 0) {
+        return -1;
+    }
+
+    printf("Checking response isolation over %d rounds...\n", rounds);
+    for (int i = 0; i < rounds; i++) {
+        int a = socket(AF_INET, SOCK_STREAM, 0);
+        int b = socket(AF_INET, SOCK_STREAM, 0);
+        struct timeval tv = { .tv_sec = 2 };
+        setsockopt(a, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(b, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        if (a < 0 || b < 0 || connect(a, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            perror("connect() failed");
+            goto fail;
+        }
+
+        /* 两个帧在同一个段中到达: 回显进入响应批之后才遇到非法帧 */
+        char frames[2 * HEADER_SIZE + sizeof(secret) - 1];
+        MessageHeader *h = (MessageHeader *)frames;
+        h->cmd = CMD_ECHO;
+        h->length = htons(sizeof(secret) - 1);
+        memcpy(frames + HEADER_SIZE, secret, sizeof(secret) - 1);
+        h = (MessageHeader *)(frames + HEADER_SIZE + sizeof(secret) - 1);
+        h->cmd = CMD_PING;
+        h->length = htons(0xFFFF);
+        if (send_all(a, frames, sizeof(frames)) < 0) {
+            perror("Failed to send");
+            goto fail;
+        }
+
+        /* 等服务器关闭 A (A 可能收到也可能收不到自己的回显) */
+        char drain[256];
+        while (recv(a, drain, sizeof(drain), 0) > 0) {
+        }
+
+        Message resp;
+        if (connect(b, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+            send_message(b, CMD_PING, NULL, 0) < 0 || recv_message(b, &resp) < 0) {
+            perror("Failed to ping on the second connection");
+            goto fail;
+        }
+        if (resp.header.cmd != RESP_OK || ntohs(resp.header.length) != 4 ||
+            memcmp(resp.payload, "PONG", 4) != 0) {
+            printf("FAIL: round %d: second connection received \"%.*s\" instead of PONG\n",
+                   i, (int)ntohs(resp.header.length), resp.payload);
+            goto fail;
+        }
+        close(a);
+        close(b);
+        continue;
+
+fail:
+        if (a >= 0) close(a);
+        if (b >= 0) close(b);
+        return -1;
+    }
+    printf("OK: no response crossed connections\n");
+    return 0;
+}
+
 /* ============================================
  * 交互模式
  * ============================================ */
 
+/*
+ * 执行 v2 的大数据命令 (与 -c 相同的格式)
+ * 返回: 0=成功, -1=失败, 1=不是 v2 命令
+ */
+int do_v2_command(int sock_fd, const char *command) {
+    char cmd[32] = "";
+    unsigned long long size = 0;
+    int pings = 10;
+
+    int n = sscanf(command, "%31s %llu %d", cmd, &size, &pings);
+    if (size > MAX_PAYLOAD_V2_SIZE) {
+        printf("Size must be at most %u bytes\n", MAX_PAYLOAD_V2_SIZE);
+        return -1;
+    }
+
+    if (strcmp(cmd, "put") == 0) {
+        if (n < 2) {
+            printf("Usage: put <bytes>\n");
+            return -1;
+        }
+        return do_put(sock_fd, size);
+    }
+    if (strcmp(cmd, "get") == 0) {
+        return do_get(sock_fd, size);
+    }
+    if (strcmp(cmd, "bigecho") == 0) {
+        if (n < 2) {
+            printf("Usage: bigecho <bytes>\n");
+            return -1;
+        }
+        return do_bigecho(sock_fd, size);
+    }
+    if (strcmp(cmd, "mux") == 0) {
+        if (n < 2 || size == 0 || pings < 0) {
+            printf("Usage: mux <bytes> [pings]\n");
+            return -1;
+        }
+        return do_mux(sock_fd, size, pings);
+    }
+    return 1;
+}
+
 void print_interactive_help(void) {
     printf("\nAvailable commands:\n");
     printf("  echo <text>       - Echo text back from server\n");
@@ -295,6 +937,11 @@ void print_interactive_help(void) {
     printf("  sub <a> <b>       - Calculate a - b\n");
     printf("  mul <a> <b>       - Calculate a * b\n");
     printf("  div <a> <b>       - Calculate a / b\n");
+    printf("  put <bytes>       - Upload a blob (v2)\n");
+    printf("  get [bytes]       - Download the blob (v2)\n");
+    printf("  bigecho <bytes>   - Echo a large payload (v2)\n");
+    printf("  mux <bytes> [n]   - Download while sending n PINGs (v2)\n");
+    printf("  raw <cmd> [text]  - Send any command byte, e.g. a plugin command\n");
     printf("  quit              - Disconnect and exit\n");
     printf("  help              - Show this help\n");
     printf("\n");
@@ -374,6 +1021,19 @@ void interactive_mode(int sock_fd) {
                 printf("Usage: div <a> <b>\n");
             }
         }
+        else if (strcmp(cmd, "put") == 0 || strcmp(cmd, "get") == 0 ||
+                 strcmp(cmd, "bigecho") == 0 || strcmp(cmd, "mux") == 0) {
+            do_v2_command(sock_fd, line);
+        }
+        else if (strcmp(cmd, "raw") == 0) {
+            uint8_t raw_cmd;
+            const char *text;
+            if (parse_raw(line, &raw_cmd, &text) == 0) {
+                do_raw(sock_fd, raw_cmd, text);
+            } else {
+                printf("Usage: raw <cmd> [text]\n");
+            }
+        }
         else if (strcmp(cmd, "quit") == 0 || strcmp(cmd, "exit") == 0) {
             do_quit(sock_fd);
             break;
@@ -389,6 +1049,766 @@ void interactive_mode(int sock_fd) {
     }
 }
 
+/* ============================================
+ * 流水线压测模式
+ * ============================================
+ *
+ * 连续发送同一条请求，最多 depth 条在途 (已发送、未收到响应)，
+ * 不等待每条响应。socket 设为非阻塞，用 poll 同时等待可读和可写:
+ * 阻塞的 send 在服务器因背压暂停读取时会和服务器互相等待。
+ */
+
+#define PIPE_RECV_BUF   65536
+
+/*
+ * 把命令字符串 (与 -c 相同的格式) 转换成请求消息
+ * 返回: 消息总长度, -1=无法识别的命令
+ */
+int build_request(const char *command, Message *msg) {
+    char cmd[32] = "";
+    int a = 0, b = 0;
+    uint16_t len = 0;
+
+    sscanf(command, "%31s", cmd);
+
+    if (strcmp(cmd, "echo") == 0) {
+        const char *text = command + 4;
+        while (*text == ' ') text++;
+        len = strlen(text) > MAX_PAYLOAD_SIZE ? MAX_PAYLOAD_SIZE : strlen(text);
+        msg->header.cmd = CMD_ECHO;
+        memcpy(msg->payload, text, len);
+    }
+    else if (strcmp(cmd, "time") == 0) {
+        msg->header.cmd = CMD_TIME;
+    }
+    else if (strcmp(cmd, "info") == 0) {
+        msg->header.cmd = CMD_INFO;
+    }
+    else if (strcmp(cmd, "ping") == 0) {
+        msg->header.cmd = CMD_PING;
+    }
+    else if (strcmp(cmd, "add") == 0 || strcmp(cmd, "sub") == 0 ||
+             strcmp(cmd, "mul") == 0 || strcmp(cmd, "div") == 0) {
+        sscanf(command, "%*s %d %d", &a, &b);
+        msg->header.cmd = cmd[0] == 'a' ? CMD_CALC_ADD :
+                          cmd[0] == 's' ? CMD_CALC_SUB :
+                          cmd[0] == 'm' ? CMD_CALC_MUL : CMD_CALC_DIV;
+        CalcPayload calc;
+        calc.a = htonl(a);
+        calc.b = htonl(b);
+        len = sizeof(calc);
+        memcpy(msg->payload, &calc, len);
+    }
+    else if (strcmp(cmd, "raw") == 0) {
+        const char *text;
+        if (parse_raw(command, &msg->header.cmd, &text) < 0) {
+            return -1;
+        }
+        len = strlen(text) > MAX_PAYLOAD_SIZE ? MAX_PAYLOAD_SIZE : strlen(text);
+        memcpy(msg->payload, text, len);
+    }
+    else {
+        return -1;
+    }
+
+    msg->header.length = htons(len);
+    return HEADER_SIZE + len;
+}
+
+int pipeline_mode(int sock_fd, const char *command, long count, int depth) {
+    Message req;
+    int req_size = build_request(command, &req);
+    if (req_size < 0) {
+        fprintf(stderr, "Unknown command: %s\n", command);
+        return -1;
+    }
+
+    /* depth 份请求首尾相接: 从任意位置开始发送都是完整的请求序列 */
+    size_t window = (size_t)req_size * depth;
+    char *sendbuf = malloc(window);
+    char *recvbuf = malloc(PIPE_RECV_BUF);
+    if (!sendbuf || !recvbuf) {
+        perror("malloc() failed");
+        free(sendbuf);
+        free(recvbuf);
+        return -1;
+    }
+    for (int i = 0; i < depth; i++) {
+        memcpy(sendbuf + (size_t)i * req_size, &req, req_size);
+    }
+
+    fcntl(sock_fd, F_SETFL, fcntl(sock_fd, F_GETFL, 0) | O_NONBLOCK);
+
+    printf("Pipelining %ld x \"%s\" (depth %d)...\n", count, command, depth);
+
+    size_t sent_bytes = 0;
+    size_t recv_len = 0;
+    long received = 0, errors = 0;
+    unsigned long send_calls = 0, recv_calls = 0;
+    int ret = 0;
+    double start = now_sec();
+
+    while (received < count) {
+        /* 在途请求不超过 depth 条 */
+        long limit = received + depth < count ? received + depth : count;
+        size_t allowed = (size_t)req_size * limit;
+
+        struct pollfd pfd = { .fd = sock_fd, .events = POLLIN };
+        if (sent_bytes < allowed) {
+            pfd.events |= POLLOUT;
+        }
+        if (poll(&pfd, 1, 5000) <= 0) {
+            fprintf(stderr, "Timed out waiting for the server\n");
+            ret = -1;
+            break;
+        }
+
+        if ((pfd.revents & POLLOUT) && sent_bytes < allowed) {
+            size_t pos = sent_bytes % req_size;
+            size_t len = allowed - sent_bytes;
+            if (len > window - pos) {
+                len = window - pos;
+            }
+            ssize_t n = send(sock_fd, sendbuf + pos, len, MSG_NOSIGNAL);
+            send_calls++;
+            if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                perror("send() failed");
+                ret = -1;
+                break;
+            }
+            if (n > 0) {
+                sent_bytes += n;
+            }
+        }
+
+        if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = recv(sock_fd, recvbuf + recv_len, PIPE_RECV_BUF - recv_len, 0);
+            recv_calls++;
+            if (n == 0) {
+                fprintf(stderr, "Server closed the connection\n");
+                ret = -1;
+                break;
+            }
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EINTR) continue;
+                perror("recv() failed");
+                ret = -1;
+                break;
+            }
+            recv_len += n;
+
+            /* 数出缓冲区中所有完整的响应 */
+            size_t off = 0;
+            while (recv_len - off >= HEADER_SIZE) {
+                const MessageHeader *h = (const MessageHeader *)(recvbuf + off);
+                size_t size = HEADER_SIZE + ntohs(h->length);
+                if (recv_len - off < size) {
+                    break;
+                }
+                if (h->cmd != RESP_OK) {
+                    errors++;
+                }
+                received++;
+                off += size;
+            }
+            memmove(recvbuf, recvbuf + off, recv_len - off);
+            recv_len -= off;
+        }
+    }
+
+    double elapsed = now_sec() - start;
+    printf("Completed: %ld/%ld responses (%ld errors) in %.3f s\n", received, count, errors, elapsed);
+    if (elapsed > 0) {
+        printf("Throughput: %.0f req/s\n", received / elapsed);
+    }
+    printf("Syscalls:   %lu send, %lu recv (%.1f responses per recv)\n",
+           send_calls, recv_calls, recv_calls ? (double)received / recv_calls : 0.0);
+
+    /* 恢复阻塞模式，之后发送 QUIT */
+    fcntl(sock_fd, F_SETFL, fcntl(sock_fd, F_GETFL, 0) & ~O_NONBLOCK);
+
+    free(sendbuf);
+    free(recvbuf);
+    return ret;
+}
+
+/* ============================================
+ * 基准测试模式
+ * ============================================
+ *
+ *   ./client -B -n 64 -t 4 -D 10 -m "ping:40,add:30,echo64:20,echo1024:10"
+ *
+ * M 个线程，每个线程用 epoll 驱动自己的一组非阻塞连接 (共 N 个)。
+ *
+ *   闭环 (默认): 每个连接保持 depth 个请求在途，收到一个响应就再发一个。
+ *               测量的是服务器能跑多快，延迟包含排队。
+ *   开环 (-R):   按目标速率发送，发送时刻由时间表决定，与响应无关。
+ *               延迟从 "计划发送时刻" 开始计算: 服务器 (或者客户端自己)
+ *               卡住时，本该发出的请求的等待时间也算进去，不会因为少发
+ *               请求而掩盖停顿 (coordinated omission 修正)。
+ *
+ * 延迟记录在 HDR 直方图中 (3 位有效数字)，结束时合并各线程的直方图。
+ */
+
+/* ---------- HDR 直方图 ----------
+ *
+ * 值按 2 的幂分成若干区间，每个区间内再线性分成 2048 个子桶 (前一半与
+ * 上一个区间重叠)，相对误差不超过 1/1024。记录是 O(1) 的，内存与最大值
+ * 的对数成正比。值的单位是纳秒。
+ */
+
+#define HDR_SUB_BUCKET_BITS     11                              /* 2048 个子桶: 3 位有效数字 */
+#define HDR_SUB_BUCKET_COUNT    (1 << HDR_SUB_BUCKET_BITS)
+#define HDR_SUB_BUCKET_HALF     (HDR_SUB_BUCKET_COUNT / 2)
+#define HDR_BUCKETS             (64 - HDR_SUB_BUCKET_BITS + 1)  /* 覆盖全部 64 位值 */
+#define HDR_COUNTS              ((HDR_BUCKETS + 1) * HDR_SUB_BUCKET_HALF)
+
+typedef struct {
+    uint64_t counts[HDR_COUNTS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+} HdrHistogram;
+
+static void hdr_init(HdrHistogram *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+static int hdr_index(uint64_t value) {
+    /* 最高位决定区间，区间内按 value >> bucket 线性定位 */
+    int bucket = 63 - __builtin_clzll(value | (HDR_SUB_BUCKET_COUNT - 1)) - (HDR_SUB_BUCKET_BITS - 1);
+    int sub = (int)(value >> bucket);
+    return ((bucket + 1) << (HDR_SUB_BUCKET_BITS - 1)) + (sub - HDR_SUB_BUCKET_HALF);
+}
+
+/* 索引对应区间的最大值 (报告百分位时偏向保守) */
+static uint64_t hdr_value_at_index(int index) {
+    int bucket = (index >> (HDR_SUB_BUCKET_BITS - 1)) - 1;
+    int sub = (index & (HDR_SUB_BUCKET_HALF - 1)) + HDR_SUB_BUCKET_HALF;
+    if (bucket < 0) {
+        sub -= HDR_SUB_BUCKET_HALF;
+        bucket = 0;
+    }
+    uint64_t low = (uint64_t)sub << bucket;
+    return low + ((1ULL << bucket) - 1);
+}
+
+static void hdr_record(HdrHistogram *h, uint64_t value) {
+    h->counts[hdr_index(value)]++;
+    h->total++;
+    h->sum += value;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+}
+
+static void hdr_merge(HdrHistogram *dst, const HdrHistogram *src) {
+    for (int i = 0; i < HDR_COUNTS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+static uint64_t hdr_percentile(const HdrHistogram *h, double percentile) {
+    if (h->total == 0) {
+        return 0;
+    }
+    uint64_t target = (uint64_t)(percentile / 100.0 * h->total + 0.5);
+    if (target < 1) target = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HDR_COUNTS; i++) {
+        seen += h->counts[i];
+        if (seen >= target) {
+            uint64_t v = hdr_value_at_index(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+/* ---------- 命令组合 ---------- */
+
+#define BENCH_MAX_MIX       16
+#define BENCH_DEFAULT_MIX   "ping:40,add:30,echo64:20,echo1024:10"
+
+typedef struct {
+    char name[16];
+    int weight;
+    Message req;                /* 预先构造好的请求 */
+    int size;                   /* 请求总字节数 */
+} MixEntry;
+
+typedef struct {
+    MixEntry entries[BENCH_MAX_MIX];
+    int count;
+    int total_weight;
+} CommandMix;
+
+/*
+ * 解析 "name:weight,..."，name 为 ping/time/info/add/sub/mul/div/echo<字节数>
+ * 返回: 0=成功, -1=格式错误
+ */
+static int parse_mix(const char *spec, CommandMix *mix) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", spec);
+    mix->count = 0;
+    mix->total_weight = 0;
+
+    for (char *save = NULL, *tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (mix->count == BENCH_MAX_MIX) {
+            return -1;
+        }
+        MixEntry *e = &mix->entries[mix->count];
+        char *colon = strchr(tok, ':');
+        e->weight = colon ? atoi(colon + 1) : 1;
+        if (colon) *colon = '\0';
+        snprintf(e->name, sizeof(e->name), "%s", tok);
+        if (e->weight <= 0) {
+            return -1;
+        }
+
+        char command[MAX_PAYLOAD_SIZE + 8];
+        if (strncmp(tok, "echo", 4) == 0) {
+            int n = atoi(tok + 4);
+            if (n <= 0 || n > MAX_PAYLOAD_SIZE) {
+                return -1;
+            }
+            memcpy(command, "echo ", 5);
+            memset(command + 5, 'x', n);
+            command[5 + n] = '\0';
+        } else if (strcmp(tok, "add") == 0 || strcmp(tok, "sub") == 0 ||
+                   strcmp(tok, "mul") == 0 || strcmp(tok, "div") == 0) {
+            snprintf(command, sizeof(command), "%s 1234 56", tok);
+        } else {
+            snprintf(command, sizeof(command), "%s", tok);
+        }
+
+        e->size = build_request(command, &e->req);
+        if (e->size < 0) {
+            return -1;
+        }
+        mix->total_weight += e->weight;
+        mix->count++;
+    }
+    return mix->count > 0 ? 0 : -1;
+}
+
+/* ---------- 连接和线程 ---------- */
+
+#define BENCH_RECV_BUF      65536
+#define BENCH_OPEN_INFLIGHT 4096        /* 开环时每个连接最多记录的在途请求 */
+
+typedef struct {
+    int fd;
+
+    /* 待发送的请求 */
+    char *out;
+    size_t out_len, out_off, out_cap;
+
+    /* 已收到的不完整响应 */
+    char in[BENCH_RECV_BUF];
+    size_t in_len;
+
+    /* 在途请求的开始时间 (响应按顺序返回，环形队列) */
+    uint64_t *starts;
+    int cap, head, inflight;
+
+    uint64_t next_send;                 /* 开环: 下一个请求的计划发送时刻 */
+    int want_write;                     /* 已经注册 EPOLLOUT */
+} BenchConn;
+
+typedef struct {
+    const char *host;
+    struct sockaddr_in addr;
+    int conns;
+    int threads;
+    int depth;
+    double duration;
+    double rate;                        /* 0=闭环 */
+    int json;
+    CommandMix mix;
+} BenchConfig;
+
+typedef struct {
+    int id;
+    pthread_t thread;
+    const BenchConfig *cfg;
+    pthread_barrier_t *barrier;
+    uint64_t *start_time;               /* 由 0 号线程设置，所有线程共用 */
+    int first_conn, nconns;
+    HdrHistogram hist;
+    uint64_t requests;                  /* 收到的响应数 */
+    uint64_t sent;
+    uint64_t errors;
+    uint64_t io_errors;
+    uint32_t rng;
+} BenchThread;
+
+static inline uint64_t bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline uint32_t bench_rand(uint32_t *state) {
+    /* xorshift32 */
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static int bench_connect(const BenchConfig *cfg) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (const struct sockaddr *)&cfg->addr, sizeof(cfg->addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+/*
+ * 排入一个请求 (按权重随机选择命令)
+ */
+static int bench_queue(BenchThread *t, BenchConn *c, uint64_t start) {
+    const CommandMix *mix = &t->cfg->mix;
+    int pick = bench_rand(&t->rng) % mix->total_weight;
+    const MixEntry *e = mix->entries;
+    while (pick >= e->weight) {
+        pick -= e->weight;
+        e++;
+    }
+
+    if (c->out_len + e->size > c->out_cap) {
+        /* 已发出的部分不再需要 */
+        memmove(c->out, c->out + c->out_off, c->out_len - c->out_off);
+        c->out_len -= c->out_off;
+        c->out_off = 0;
+        if (c->out_len + e->size > c->out_cap) {
+            size_t cap = c->out_cap ? c->out_cap * 2 : 4096;
+            while (cap < c->out_len + e->size) cap *= 2;
+            char *out = realloc(c->out, cap);
+            if (!out) return -1;
+            c->out = out;
+            c->out_cap = cap;
+        }
+    }
+    memcpy(c->out + c->out_len, &e->req, e->size);
+    c->out_len += e->size;
+
+    c->starts[(c->head + c->inflight) % c->cap] = start;
+    c->inflight++;
+    t->sent++;
+    return 0;
+}
+
+static int bench_flush(int epfd, BenchConn *c) {
+    while (c->out_off < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return -1;
+            break;
+        }
+        c->out_off += n;
+    }
+    if (c->out_off == c->out_len) {
+        c->out_off = c->out_len = 0;
+    }
+
+    /* 只在发不出去时关注可写事件 */
+    int want = c->out_len > 0;
+    if (want != c->want_write) {
+        struct epoll_event ev = { .events = EPOLLIN | (want ? EPOLLOUT : 0), .data.ptr = c };
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->want_write = want;
+    }
+    return 0;
+}
+
+/*
+ * 读取并统计所有完整的响应
+ * 返回: 0=正常, -1=连接出错
+ */
+static int bench_read(BenchThread *t, BenchConn *c, uint64_t end) {
+    for (;;) {
+        ssize_t n = recv(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len, 0);
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        c->in_len += n;
+
+        uint64_t now = bench_now();
+        size_t off = 0;
+        while (c->in_len - off >= HEADER_SIZE) {
+            const MessageHeader *h = (const MessageHeader *)(c->in + off);
+            size_t size = HEADER_SIZE + ntohs(h->length);
+            if (c->in_len - off < size) {
+                break;
+            }
+            if (c->inflight == 0) {
+                return -1;      /* 多出来的响应 */
+            }
+            uint64_t start = c->starts[c->head];
+            c->head = (c->head + 1) % c->cap;
+            c->inflight--;
+            off += size;
+
+            /* 结束之后到达的响应不计入 (测量窗口之外) */
+            if (now <= end) {
+                hdr_record(&t->hist, now > start ? now - start : 0);
+                t->requests++;
+                if (h->cmd != RESP_OK) {
+                    t->errors++;
+                }
+            }
+        }
+        memmove(c->in, c->in + off, c->in_len - off);
+        c->in_len -= off;
+    }
+}
+
+static void *bench_thread_main(void *arg) {
+    BenchThread *t = arg;
+    const BenchConfig *cfg = t->cfg;
+    int open_loop = cfg->rate > 0;
+
+    int epfd = epoll_create1(0);
+    BenchConn *conns = calloc(t->nconns, sizeof(BenchConn));
+    int ok = epfd >= 0 && conns != NULL;
+
+    for (int i = 0; ok && i < t->nconns; i++) {
+        BenchConn *c = &conns[i];
+        c->cap = open_loop ? BENCH_OPEN_INFLIGHT : cfg->depth;
+        c->starts = malloc(sizeof(uint64_t) * c->cap);
+        c->fd = bench_connect(cfg);
+        if (c->fd < 0 || !c->starts) {
+            fprintf(stderr, "connect() failed: %s\n", strerror(errno));
+            ok = 0;
+            break;
+        }
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+    }
+
+    /* 所有线程都连接好之后同时开始 */
+    if (!ok) {
+        t->io_errors++;
+    }
+    pthread_barrier_wait(t->barrier);
+    if (t->id == 0) {
+        *t->start_time = bench_now();
+    }
+    pthread_barrier_wait(t->barrier);
+
+    uint64_t start = *t->start_time;
+    uint64_t end = start + (uint64_t)(cfg->duration * 1e9);
+    uint64_t interval = open_loop ? (uint64_t)(1e9 * cfg->conns / cfg->rate) : 0;
+
+    if (ok && open_loop) {
+        /* 各连接的时间表错开，避免所有连接同时发送 */
+        for (int i = 0; i < t->nconns; i++) {
+            conns[i].next_send = start + interval * (t->first_conn + i) / cfg->conns;
+        }
+    }
+
+    struct epoll_event events[256];
+    while (ok) {
+        uint64_t now = bench_now();
+        if (now >= end) {
+            break;
+        }
+
+        /* 安排发送 */
+        uint64_t next_due = end;
+        for (int i = 0; i < t->nconns; i++) {
+            BenchConn *c = &conns[i];
+            if (c->fd < 0) continue;
+            if (open_loop) {
+                while (c->next_send <= now && c->inflight < c->cap) {
+                    if (bench_queue(t, c, c->next_send) < 0) break;
+                    c->next_send += interval;
+                }
+                if (c->next_send < next_due) next_due = c->next_send;
+            } else {
+                while (c->inflight < c->cap) {
+                    if (bench_queue(t, c, now) < 0) break;
+                }
+            }
+            if (c->out_len > c->out_off && !c->want_write && bench_flush(epfd, c) < 0) {
+                t->io_errors++;
+                close(c->fd);
+                c->fd = -1;
+            }
+        }
+
+        /* 等待响应，开环时最多等到下一个计划发送时刻 */
+        uint64_t wait_ns = next_due > now ? next_due - now : 0;
+        if (wait_ns > 100000000ULL) wait_ns = 100000000ULL;
+        struct timespec ts = { wait_ns / 1000000000ULL, wait_ns % 1000000000ULL };
+        int n = epoll_pwait2(epfd, events, 256, &ts, NULL);
+        if (n < 0 && errno == ENOSYS) {
+            n = epoll_wait(epfd, events, 256, (int)(wait_ns / 1000000));  /* Linux 5.11 之前 */
+        }
+        for (int i = 0; i < n; i++) {
+            BenchConn *c = events[i].data.ptr;
+            if (c->fd < 0) continue;
+            int bad = 0;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                bad = bench_read(t, c, end) < 0;
+            }
+            if (!bad && (events[i].events & EPOLLOUT)) {
+                bad = bench_flush(epfd, c) < 0;
+            }
+            if (bad) {
+                t->io_errors++;
+                close(c->fd);
+                c->fd = -1;
+            }
+        }
+    }
+
+    for (int i = 0; conns && i < t->nconns; i++) {
+        if (conns[i].fd >= 0) close(conns[i].fd);
+        free(conns[i].out);
+        free(conns[i].starts);
+    }
+    free(conns);
+    if (epfd >= 0) close(epfd);
+    return NULL;
+}
+
+int bench_mode(BenchConfig *cfg) {
+    if (cfg->threads > cfg->conns) {
+        cfg->threads = cfg->conns;
+    }
+
+    /* 连接数多时需要更多 fd */
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    if (!cfg->json) {
+        printf("Benchmark: %d connection(s), %d thread(s), %.1f s, ", cfg->conns, cfg->threads,
+               cfg->duration);
+        if (cfg->rate > 0) {
+            printf("open loop at %.0f req/s\n", cfg->rate);
+        } else {
+            printf("closed loop, depth %d\n", cfg->depth);
+        }
+        printf("Mix:");
+        for (int i = 0; i < cfg->mix.count; i++) {
+            printf(" %s %.0f%%", cfg->mix.entries[i].name,
+                   100.0 * cfg->mix.entries[i].weight / cfg->mix.total_weight);
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    BenchThread *threads = calloc(cfg->threads, sizeof(BenchThread));
+    if (!threads) {
+        perror("calloc() failed");
+        return -1;
+    }
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, cfg->threads);
+    uint64_t start_time = 0;
+
+    for (int i = 0, first = 0; i < cfg->threads; i++) {
+        BenchThread *t = &threads[i];
+        t->id = i;
+        t->cfg = cfg;
+        t->barrier = &barrier;
+        t->start_time = &start_time;
+        t->nconns = cfg->conns / cfg->threads + (i < cfg->conns % cfg->threads);
+        t->first_conn = first;
+        t->rng = 0x9E3779B9u * (i + 1);
+        first += t->nconns;
+        hdr_init(&t->hist);
+    }
+    int started = 0;
+    for (; started < cfg->threads; started++) {
+        if (pthread_create(&threads[started].thread, NULL, bench_thread_main, &threads[started]) != 0) {
+            perror("pthread_create() failed");
+            break;
+        }
+    }
+    if (started < cfg->threads) {
+        /* 屏障需要全部线程: 无法继续 */
+        exit(1);
+    }
+
+    HdrHistogram *hist = malloc(sizeof(HdrHistogram));
+    if (!hist) {
+        perror("malloc() failed");
+        return -1;
+    }
+    hdr_init(hist);
+    uint64_t requests = 0, sent = 0, errors = 0, io_errors = 0;
+    for (int i = 0; i < cfg->threads; i++) {
+        pthread_join(threads[i].thread, NULL);
+        hdr_merge(hist, &threads[i].hist);
+        requests += threads[i].requests;
+        sent += threads[i].sent;
+        errors += threads[i].errors;
+        io_errors += threads[i].io_errors;
+    }
+    pthread_barrier_destroy(&barrier);
+    free(threads);
+
+    double throughput = requests / cfg->duration;
+    double us = 1000.0;
+    double p50 = hdr_percentile(hist, 50) / us;
+    double p90 = hdr_percentile(hist, 90) / us;
+    double p99 = hdr_percentile(hist, 99) / us;
+    double p999 = hdr_percentile(hist, 99.9) / us;
+    double max = hist->total ? hist->max / us : 0;
+    double mean = hist->total ? hist->sum / hist->total / us : 0;
+
+    if (cfg->json) {
+        printf("{\"mode\":\"%s\",\"connections\":%d,\"threads\":%d,\"duration_s\":%.3f,"
+               "\"target_rps\":%.0f,\"depth\":%d,\"requests\":%llu,\"sent\":%llu,"
+               "\"errors\":%llu,\"io_errors\":%llu,\"throughput_rps\":%.1f,"
+               "\"p50_us\":%.2f,\"p90_us\":%.2f,\"p99_us\":%.2f,\"p999_us\":%.2f,"
+               "\"max_us\":%.2f,\"mean_us\":%.2f}\n",
+               cfg->rate > 0 ? "open" : "closed", cfg->conns, cfg->threads, cfg->duration,
+               cfg->rate, cfg->depth, (unsigned long long)requests, (unsigned long long)sent,
+               (unsigned long long)errors, (unsigned long long)io_errors, throughput,
+               p50, p90, p99, p999, max, mean);
+    } else {
+        printf("\nRequests:   %llu completed, %llu sent, %llu error response(s), %llu I/O error(s)\n",
+               (unsigned long long)requests, (unsigned long long)sent,
+               (unsigned long long)errors, (unsigned long long)io_errors);
+        printf("Throughput: %.0f req/s", throughput);
+        if (cfg->rate > 0) {
+            printf(" (target %.0f)", cfg->rate);
+        }
+        printf("\nLatency (us)%s:\n", cfg->rate > 0 ? ", from intended send time" : "");
+        printf("  p50  %10.2f\n  p90  %10.2f\n  p99  %10.2f\n  p999 %10.2f\n"
+               "  max  %10.2f\n  mean %10.2f\n", p50, p90, p99, p999, max, mean);
+    }
+
+    free(hist);
+    return io_errors > 0 ? -1 : 0;
+}
+
 /* ============================================
  * 主函数
  * ============================================ */
@@ -400,6 +1820,18 @@ void print_usage(const char *prog) {
     printf("  -p port   Server port (default: %d)\n", DEFAULT_PORT);
     printf("\nMode options:\n");
     printf("  -i        Interactive mode\n");
+    printf("  -P count  Pipelined load: send <count> copies of -c (default: ping)\n");
+    printf("  -d depth  Requests in flight per connection (default: 64 with -P, 1 with -B)\n");
+    printf("  -B        Benchmark: N connections over M threads, latency percentiles\n");
+    printf("  -2        Negotiate protocol v2 (with -i or -c)\n");
+    printf("\nBenchmark options (-B):\n");
+    printf("  -n conns  Connections (default: 64)\n");
+    printf("  -t num    Threads (default: 4)\n");
+    printf("  -D secs   Duration in seconds (default: 10)\n");
+    printf("  -R rate   Open loop at <rate> req/s in total (default: closed loop)\n");
+    printf("  -m mix    Command mix name:weight,... (default: %s)\n", BENCH_DEFAULT_MIX);
+    printf("            names: ping time info add sub mul div echo<bytes>\n");
+    printf("  -j        Print the result as one JSON line\n");
     printf("\nCommand options (non-interactive):\n");
     printf("  -c cmd    Command to execute:\n");
     printf("            echo <text>  - Echo text\n");
@@ -410,12 +1842,22 @@ void print_usage(const char *prog) {
     printf("            sub <a> <b>  - Calculate a - b\n");
     printf("            mul <a> <b>  - Calculate a * b\n");
     printf("            div <a> <b>  - Calculate a / b\n");
+    printf("            put <bytes>  - Upload a blob (v2)\n");
+    printf("            get [bytes]  - Download the blob (v2)\n");
+    printf("            bigecho <bytes>    - Echo a large payload (v2)\n");
+    printf("            mux <bytes> [n]    - Upload, then download while sending n PINGs (v2)\n");
+    printf("            raw <cmd> [text]   - Send any command byte (e.g. plugin commands)\n");
+    printf("            isolation [rounds] - Check a bad frame's connection does not leak replies\n");
     printf("\nExamples:\n");
     printf("  %s -i                           # Interactive mode\n", prog);
     printf("  %s -c ping                      # Single ping\n", prog);
     printf("  %s -c \"echo Hello World\"        # Echo message\n", prog);
     printf("  %s -c \"add 10 20\"               # Calculate 10 + 20\n", prog);
     printf("  %s -h 192.168.1.100 -p 9999 -i  # Connect to remote\n", prog);
+    printf("  %s -P 100000 -d 64 -c \"add 1 2\" # Pipelined load\n", prog);
+    printf("  %s -B -n 256 -t 4 -R 200000       # Open-loop benchmark\n", prog);
+    printf("  %s -2 -c \"bigecho 10000000\"   # Large payload over v2\n", prog);
+    printf("  %s -c \"raw 0x40 hello\"        # Plugin command (server -L text.so)\n", prog);
 }
 
 int main(int argc, char *argv[]) {
@@ -423,10 +1865,16 @@ int main(int argc, char *argv[]) {
     int port = DEFAULT_PORT;
     int interactive = 0;
     const char *command = NULL;
+    long pipeline = 0;
+    int depth = 0;
+    int bench = 0;
+    int version = PROTO_V1;
+    BenchConfig cfg = { .conns = 64, .threads = 4, .duration = 10 };
+    const char *mix = BENCH_DEFAULT_MIX;
     int opt;
 
     /* 解析命令行参数 */
-    while ((opt = getopt(argc, argv, "h:p:ic:?")) != -1) {
+    while ((opt = getopt(argc, argv, "h:p:ic:P:d:Bn:t:D:R:m:j2?")) != -1) {
         switch (opt) {
             case 'h':
                 host = optarg;
@@ -440,6 +1888,36 @@ int main(int argc, char *argv[]) {
             case 'c':
                 command = optarg;
                 break;
+            case 'P':
+                pipeline = atol(optarg);
+                break;
+            case 'd':
+                depth = atoi(optarg);
+                break;
+            case 'B':
+                bench = 1;
+                break;
+            case 'n':
+                cfg.conns = atoi(optarg);
+                break;
+            case 't':
+                cfg.threads = atoi(optarg);
+                break;
+            case 'D':
+                cfg.duration = atof(optarg);
+                break;
+            case 'R':
+                cfg.rate = atof(optarg);
+                break;
+            case 'm':
+                mix = optarg;
+                break;
+            case 'j':
+                cfg.json = 1;
+                break;
+            case '2':
+                version = PROTO_V2;
+                break;
             case '?':
             default:
                 print_usage(argv[0]);
@@ -447,21 +1925,73 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    /* 流水线和基准测试直接构造 v1 帧 */
+    if (version == PROTO_V2 && (bench || pipeline > 0)) {
+        fprintf(stderr, "-2 cannot be combined with -P or -B\n");
+        return 1;
+    }
+
+    if (bench) {
+        /* 基准测试模式不使用下面的单连接流程 */
+        if (parse_mix(mix, &cfg.mix) < 0) {
+            fprintf(stderr, "Invalid command mix: %s\n", mix);
+            return 1;
+        }
+        if (cfg.conns < 1 || cfg.threads < 1 || cfg.duration <= 0) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        cfg.depth = depth > 0 ? depth : 1;
+        if (resolve_host(host, port, &cfg.addr) < 0) {
+            return 1;
+        }
+        return bench_mode(&cfg) < 0 ? 1 : 0;
+    }
+
+    if (pipeline > 0 && command == NULL) {
+        command = "ping";
+    }
+    if (depth < 1) {
+        depth = 64;
+    }
+
     /* 必须指定交互模式或命令 */
     if (!interactive && command == NULL) {
         print_usage(argv[0]);
         return 1;
     }
 
+    if (command != NULL && strncmp(command, "isolation", 9) == 0 &&
+        (command[9] == '\0' || command[9] == ' ')) {
+        /* 自己建立连接 (阻塞模式的服务器同一时刻只服务一个连接) */
+        int rounds = 32;
+        sscanf(command, "%*s %d", &rounds);
+        return do_isolation(host, port, rounds > 0 ? rounds : 1) < 0 ? 1 : 0;
+    }
+
     /* 连接服务器 */
     int sock_fd = connect_to_server(host, port);
     if (sock_fd < 0) {
         return 1;
     }
 
+    int status = 0;
+
+    if (version == PROTO_V2 && negotiate_version(sock_fd, version) < 0) {
+        perror("Failed to negotiate protocol version");
+        close(sock_fd);
+        return 1;
+    }
+
     if (interactive) {
         /* 交互模式 */
         interactive_mode(sock_fd);
+    } else if (pipeline > 0) {
+        /* 流水线压测模式 */
+        if (pipeline_mode(sock_fd, command, pipeline, depth) < 0) {
+            status = 1;
+        }
+        do_quit(sock_fd);
     } else {
         /* 单命令模式 */
         char cmd[32];
@@ -500,7 +2030,21 @@ int main(int argc, char *argv[]) {
             sscanf(command, "%*s %d %d", &a, &b);
             do_calc(sock_fd, CMD_CALC_DIV, a, b);
         }
+        else if (strcmp(cmd, "raw") == 0) {
+            uint8_t raw_cmd;
+            const char *text;
+            if (parse_raw(command, &raw_cmd, &text) == 0) {
+                status = do_raw(sock_fd, raw_cmd, text) < 0 ? 1 : 0;
+            } else {
+                printf("Usage: raw <cmd> [text]\n");
+                status = 1;
+            }
+        }
+        else if ((status = do_v2_command(sock_fd, command)) != 1) {
+            status = status < 0 ? 1 : 0;
+        }
         else {
+            status = 0;
             printf("Unknown command: %s\n", cmd);
         }
 
@@ -510,5 +2054,5 @@ int main(int argc, char *argv[]) {
     close(sock_fd);
     printf("Disconnected.\n");
 
-    return 0;
+    return status;
 }
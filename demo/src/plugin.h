@@ -0,0 +1,60 @@
+/*
+ * plugin.h - 命令处理插件接口
+ *
+ * 插件是普通的共享库，服务器启动时 (-L path) 通过 mini linker (../linux)
+ * 的 mini_dlopen 加载，收到 SIGHUP 时用 mini_dlreload 重新加载 (热替换)。
+ *
+ * 插件导出一个以 { 0, NULL, NULL } 结尾的命令表 plugin_commands，每一项
+ * 给出命令字节 (CMD_PLUGIN_FIRST ~ CMD_PLUGIN_LAST) 和处理函数的符号名:
+ *
+ *   static int do_upper(const Message *req, Message *resp) { ... }
+ *   const PluginCommand plugin_commands[] = {
+ *       { 0x40, "UPPER", "do_upper" },
+ *       { 0, NULL, NULL },
+ *   };
+ *
+ * 处理函数必须是导出符号 (不能是 static)。服务器为每个处理函数取一个稳定槽
+ * (mini_dlsym_stable)，按命令字节放入分发表；处理请求时只读一次槽，不再按名字查找。
+ * 重新加载时槽原子地切换到新版本；新版本可以增加命令，但不能删除已有的处理函数。
+ *
+ * 插件不能调用服务器中的函数，只能使用 libc 和这里的内联函数。
+ */
+
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "protocol.h"
+
+/* 与 process_message 相同: 填写 resp，返回 0=发送 resp, 1=关闭连接 (不回复) */
+typedef int (*CommandHandler)(const Message *req, Message *resp);
+
+/* 命令表的一项 */
+typedef struct {
+    uint8_t cmd;            /* 命令字节 */
+    const char *name;       /* 命令名 (用于日志) */
+    const char *symbol;     /* 处理函数的符号名 */
+} PluginCommand;
+
+/* 命令表的符号名 */
+#define PLUGIN_COMMANDS_SYMBOL "plugin_commands"
+
+/*
+ * 填写响应消息 (len 超过 MAX_PAYLOAD_SIZE 时截断)
+ * payload 可以就是 resp->payload (命令原地改写了内容)，此时不复制
+ */
+static inline void plugin_reply(Message *resp, uint8_t cmd, const void *payload, size_t len) {
+    if (len > MAX_PAYLOAD_SIZE) {
+        len = MAX_PAYLOAD_SIZE;
+    }
+    resp->header.cmd = cmd;
+    resp->header.length = htons((uint16_t)len);
+    if (len > 0 && payload != resp->payload) {
+        memcpy(resp->payload, payload, len);
+    }
+}
+
+#endif /* PLUGIN_H */
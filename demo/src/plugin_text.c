@@ -0,0 +1,83 @@
+/*
+ * plugin_text.c - 命令插件示例: 文本处理命令
+ *
+ * 服务器用 -L out/plugins/text.so 加载。重新编译出不同的版本后
+ * kill -HUP <server pid> 即可热替换，不需要重启，连接也不会断开:
+ *
+ *   make plugins PLUGIN_VERSION=2 && kill -HUP $(pidof server)
+ *
+ * 版本 2 增加了 ROT13 命令，演示热替换时新增命令。
+ */
+
+#include <stdio.h>
+
+#include "plugin.h"
+
+#ifndef PLUGIN_VERSION
+#define PLUGIN_VERSION 1
+#endif
+
+/* 处理函数必须导出，服务器按符号名取稳定槽 */
+
+/*
+ * UPPER - 返回转换成大写的文本
+ */
+int text_upper(const Message *req, Message *resp) {
+    uint16_t len = ntohs(req->header.length);
+    for (uint16_t i = 0; i < len; i++) {
+        char c = req->payload[i];
+        resp->payload[i] = (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+    }
+    plugin_reply(resp, RESP_OK, resp->payload, len);
+    return 0;
+}
+
+/*
+ * REVERSE - 返回倒序的文本 (按字节)
+ */
+int text_reverse(const Message *req, Message *resp) {
+    uint16_t len = ntohs(req->header.length);
+    for (uint16_t i = 0; i < len; i++) {
+        resp->payload[i] = req->payload[len - 1 - i];
+    }
+    plugin_reply(resp, RESP_OK, resp->payload, len);
+    return 0;
+}
+
+/*
+ * VERSION - 返回插件版本 (热替换后立即变化)
+ */
+int text_version(const Message *req, Message *resp) {
+    (void)req;
+    char buf[64];
+    int n = snprintf(buf, sizeof(buf), "text plugin v%d", PLUGIN_VERSION);
+    plugin_reply(resp, RESP_OK, buf, n);
+    return 0;
+}
+
+#if PLUGIN_VERSION >= 2
+/*
+ * ROT13 - 字母循环移动 13 位 (版本 2 新增)
+ */
+int text_rot13(const Message *req, Message *resp) {
+    uint16_t len = ntohs(req->header.length);
+    for (uint16_t i = 0; i < len; i++) {
+        char c = req->payload[i];
+        if (c >= 'a' && c <= 'z') c = 'a' + (c - 'a' + 13) % 26;
+        else if (c >= 'A' && c <= 'Z') c = 'A' + (c - 'A' + 13) % 26;
+        resp->payload[i] = c;
+    }
+    plugin_reply(resp, RESP_OK, resp->payload, len);
+    return 0;
+}
+#endif
+
+const PluginCommand plugin_commands[] = {
+    { 0x40, "UPPER",   "text_upper" },
+    { 0x41, "REVERSE", "text_reverse" },
+    { 0x4F, "VERSION", "text_version" },
+#if PLUGIN_VERSION >= 2
+    { 0x42, "ROT13",   "text_rot13" },
+#endif
+    { 0, NULL, NULL },
+};
@@ -22,6 +22,25 @@
  * CMD: 命令类型 (1 字节)
  * LEN: 负载长度 (2 字节, 网络字节序)
  * PAYLOAD: 数据负载 (0-1024 字节)
+ *
+ * v2 帧格式 (连接建立后用 CMD_HELLO 协商，之后双方都使用 v2):
+ * +--------+----------+---------+----------+--------+------------------+
+ * | CMD(1) | FLAGS(1) | RSV(2)  | ID(4)    | LEN(4) | PAYLOAD(变长)    |
+ * +--------+----------+---------+----------+--------+------------------+
+ *
+ * ID:    请求编号，服务器在响应中原样返回。响应可以不按请求顺序到达，
+ *        客户端按 ID 匹配 (同一连接上的多个请求可以交错进行)
+ * LEN:   负载长度 (4 字节, 网络字节序, 最大 MAX_PAYLOAD_V2_SIZE)
+ * FLAGS: V2_FLAG_MORE 表示同一 ID 还有后续的帧 (大响应分块发送，
+ *        块之间可以插入其他请求的响应)
+ *
+ * 负载不超过 MAX_PAYLOAD_SIZE 的请求与 v1 的命令相同；更大的负载
+ * (ECHO, BLOB_PUT) 由服务器直接在 socket 和文件/管道之间搬运，
+ * 不进入用户态缓冲区 (splice / sendfile)。
+ *
+ * 协商: 客户端用 v1 格式发送 CMD_HELLO，负载为 1 字节的期望版本。
+ * 服务器回复 RESP_OK，负载为 1 字节的实际版本；不认识 HELLO 的旧服务器
+ * 回复 RESP_ERROR，客户端继续使用 v1。
  */
 
 /* 默认端口 */
@@ -33,6 +52,17 @@
 /* 消息头大小 */
 #define HEADER_SIZE 3
 
+/* v2 消息头大小和最大负载 */
+#define HEADER_V2_SIZE 12
+#define MAX_PAYLOAD_V2_SIZE (1u << 30)
+
+/* 协议版本 */
+#define PROTO_V1 1
+#define PROTO_V2 2
+
+/* v2 帧标志 */
+#define V2_FLAG_MORE 0x01       /* 同一 ID 还有后续的帧 */
+
 /* ============ 命令类型定义 ============ */
 
 typedef enum {
@@ -47,8 +77,17 @@ typedef enum {
     CMD_CALC_MUL  = 0x12,   /* 乘法: a * b */
     CMD_CALC_DIV  = 0x13,   /* 除法: a / b */
 
+    /* 大数据命令 (仅 v2) */
+    CMD_BLOB_PUT  = 0x30,   /* 上传: 负载存为本连接的 blob，响应为 4 字节的大小 */
+    CMD_BLOB_GET  = 0x31,   /* 下载: 负载为 4 字节的长度，分块返回 blob 的内容 */
+
+    /* 插件命令: 由服务器加载的插件定义 (见 plugin.h) */
+    CMD_PLUGIN_FIRST = 0x40,
+    CMD_PLUGIN_LAST  = 0x7F,
+
     /* 控制命令 */
     CMD_PING      = 0x20,   /* 心跳检测 */
+    CMD_HELLO     = 0x21,   /* 协商协议版本 (总是使用 v1 格式) */
     CMD_QUIT      = 0xFF,   /* 断开连接 */
 
     /* 响应状态 */
@@ -70,6 +109,15 @@ typedef struct {
     char payload[MAX_PAYLOAD_SIZE];
 } Message;
 
+/* v2 消息头 */
+typedef struct {
+    uint8_t  cmd;           /* 命令类型 */
+    uint8_t  flags;         /* V2_FLAG_* */
+    uint16_t reserved;      /* 保留, 为 0 */
+    uint32_t request_id;    /* 请求编号 (网络字节序) */
+    uint32_t length;        /* 负载长度 (网络字节序) */
+} __attribute__((packed)) MessageHeaderV2;
+
 /* 计算请求的负载格式 */
 typedef struct {
     int32_t a;
@@ -96,6 +144,9 @@ static inline const char* cmd_to_string(uint8_t cmd) {
         case CMD_CALC_MUL: return "CALC_MUL";
         case CMD_CALC_DIV: return "CALC_DIV";
         case CMD_PING:     return "PING";
+        case CMD_HELLO:    return "HELLO";
+        case CMD_BLOB_PUT: return "BLOB_PUT";
+        case CMD_BLOB_GET: return "BLOB_GET";
         case CMD_QUIT:     return "QUIT";
         case RESP_OK:      return "OK";
         case RESP_ERROR:   return "ERROR";
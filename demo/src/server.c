@@ -5,10 +5,26 @@
  * 1. 展示 TCP 服务器的创建流程: socket() -> bind() -> listen() -> accept()
  * 2. 展示如何处理客户端连接和消息
  * 3. 展示基于协议的消息解析和响应
+ * 4. 展示事件驱动模式 (-e): 边缘触发的 epoll + 非阻塞 socket + 多 reactor
+ * 5. 展示 io_uring 模式 (-u): 多发 accept/recv、提供缓冲区环、固定缓冲区
+ * 6. 展示协议 v2: 32 位长度、按 ID 匹配的乱序响应、splice/sendfile 搬运大负载
+ * 7. 展示命令插件: 用 mini_dlopen 加载处理函数，按命令字节查表分发，SIGHUP 热替换
  *
- * 用法: ./server [-p port]
+ * 两种运行模式:
+ *   默认      阻塞模式，accept() 之后在主线程中处理，一次只服务一个客户端
+ *   -e        事件驱动模式，每个 CPU 一个 reactor 线程，每个线程有自己的
+ *             epoll 和监听 socket (SO_REUSEPORT，由内核分配新连接)，
+ *             可以同时保持成千上万个连接
+ *             (升级到 v2 的连接各占一个阻塞线程，最多 V2_MAX_SESSIONS 个，超出时回复 v1)
+ *   -u        io_uring 模式，结构与 -e 相同，I/O 请求直接提交给内核
+ *
+ * 命令插件 (-L path，可以重复): 通过 ../linux 的 mini linker 加载，
+ * kill -HUP 热替换 (见 plugin.h)
+ *
+ * 用法: ./server [-p port] [-e | -u] [-t threads] [-q] [-L plugin.so]...
  */
 
+#define _GNU_SOURCE     /* accept4, splice, memfd_create */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -17,18 +33,37 @@
 #include <time.h>
 #include <errno.h>
 #include <signal.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <poll.h>
 
 /* Socket 相关头文件 */
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 
 #include "protocol.h"
+#include "plugin.h"
+#include "uring.h"
+
+/* mini linker (../linux): 加载命令插件 */
+#include "mini_dlfcn.h"
+#include "linker.h"
+#include "log.h"
 
 /* 全局变量: 服务器 socket (用于信号处理) */
 static int g_server_fd = -1;
 static volatile int g_running = 1;
 
+/* 是否打印每个连接/每条请求的日志 (-q 关闭，连接很多时日志本身就是瓶颈) */
+static int g_verbose = 1;
+
 /* ============================================
  * 辅助函数
  * ============================================ */
@@ -38,10 +73,12 @@ static volatile int g_running = 1;
  */
 void log_msg(const char *fmt, ...) {
     time_t now = time(NULL);
-    struct tm *tm_info = localtime(&now);
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);    /* 多个 reactor 线程同时打印，不能用 localtime */
     char time_buf[20];
-    strftime(time_buf, sizeof(time_buf), "%H:%M:%S", tm_info);
+    strftime(time_buf, sizeof(time_buf), "%H:%M:%S", &tm_info);
 
+    flockfile(stdout);
     printf("[%s] ", time_buf);
 
     va_list args;
@@ -51,8 +88,12 @@ void log_msg(const char *fmt, ...) {
 
     printf("\n");
     fflush(stdout);
+    funlockfile(stdout);
 }
 
+/* 每个连接/每条请求的日志 */
+#define log_verbose(...) do { if (g_verbose) log_msg(__VA_ARGS__); } while (0)
+
 /*
  * 信号处理函数 - 优雅退出
  */
@@ -69,82 +110,155 @@ void signal_handler(int sig) {
  * ============================================ */
 
 /*
- * 接收完整消息
- * 返回: 0=成功, -1=错误, 1=连接关闭
+ * 请求流水线 (pipelining)
+ *
+ * 客户端可以连续发送多条请求而不等待响应。服务器每次用一个大缓冲区
+ * recv，从中解析出所有完整的消息 (直接在缓冲区中处理，不再逐条 recv
+ * 消息头和负载)；这一批请求的所有响应用一次 sendmsg (writev) 发出。
+ * 小请求 (PING/CALC) 的吞吐不再受每条消息 3 次系统调用的限制。
  */
-int recv_message(int client_fd, Message *msg) {
-    /* 步骤 1: 先接收消息头 (3字节) */
-    ssize_t n = recv(client_fd, &msg->header, HEADER_SIZE, MSG_WAITALL);
-    if (n == 0) {
-        return 1;  /* 连接关闭 */
-    }
-    if (n != HEADER_SIZE) {
-        return -1; /* 错误 */
+
+#define RECV_BUF_SIZE   65536   /* 一次 recv 的缓冲区大小 */
+#define RESP_BATCH      64      /* 一次 sendmsg 最多合并的响应数 */
+
+/* 一批待发送的响应 */
+typedef struct {
+    Message msgs[RESP_BATCH];
+    int count;
+} RespBatch;
+
+/*
+ * 检查缓冲区开头是否是一条完整的消息
+ * 返回: 消息总长度, 0=还不完整, -1=长度非法
+ */
+static ssize_t frame_length(const char *buf, size_t len) {
+    if (len < HEADER_SIZE) {
+        return 0;
     }
 
-    /* 步骤 2: 转换字节序并验证长度 */
-    uint16_t payload_len = ntohs(msg->header.length);
+    const MessageHeader *header = (const MessageHeader *)buf;
+    uint16_t payload_len = ntohs(header->length);
     if (payload_len > MAX_PAYLOAD_SIZE) {
         return -1;
     }
 
-    /* 步骤 3: 接收负载数据 */
-    if (payload_len > 0) {
-        n = recv(client_fd, msg->payload, payload_len, MSG_WAITALL);
-        if (n != payload_len) {
-            return -1;
-        }
+    size_t total = HEADER_SIZE + payload_len;
+    return len >= total ? (ssize_t)total : 0;
+}
+
+/*
+ * 填写响应消息
+ */
+void set_response(Message *resp, uint8_t cmd, const void *payload, uint16_t len) {
+    resp->header.cmd = cmd;
+    resp->header.length = htons(len);
+
+    if (len > 0 && payload != NULL) {
+        memcpy(resp->payload, payload, len);
     }
+}
 
-    return 0;
+/*
+ * 消息的总字节数 (消息头 + 负载)
+ */
+static inline size_t message_size(const Message *msg) {
+    return HEADER_SIZE + ntohs(msg->header.length);
 }
 
 /*
- * 发送完整消息
+ * sendmsg 相当于带 flags 的 writev (MSG_NOSIGNAL: 对端关闭时返回 EPIPE 而不是收到 SIGPIPE)
  */
-int send_message(int client_fd, uint8_t cmd, const void *payload, uint16_t len) {
-    Message msg;
-    msg.header.cmd = cmd;
-    msg.header.length = htons(len);
+static ssize_t send_iov(int fd, struct iovec *iov, int count) {
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    mh.msg_iovlen = count;
+
+    ssize_t n;
+    do {
+        n = sendmsg(fd, &mh, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
 
-    if (len > 0 && payload != NULL) {
-        memcpy(msg.payload, payload, len);
+/*
+ * 阻塞地发送 iov 中的全部数据 (会修改 iov)
+ */
+static int send_iov_all(int fd, struct iovec *iov, int count) {
+    struct iovec *cur = iov;
+    while (count > 0) {
+        ssize_t n = send_iov(fd, cur, count);
+        if (n < 0) {
+            return -1;
+        }
+        /* 跳过已经完整发出的部分 */
+        while (count > 0 && (size_t)n >= cur->iov_len) {
+            n -= cur->iov_len;
+            cur++;
+            count--;
+        }
+        if (count > 0) {
+            cur->iov_base = (char *)cur->iov_base + n;
+            cur->iov_len -= n;
+        }
     }
+    return 0;
+}
 
-    ssize_t total = HEADER_SIZE + len;
-    ssize_t sent = send(client_fd, &msg, total, 0);
+/*
+ * 阻塞地发送一批响应 (一次 sendmsg，只有大响应填满 socket 缓冲区时才需要多次)
+ */
+int send_batch(int client_fd, RespBatch *batch) {
+    struct iovec iov[RESP_BATCH];
+    int count = batch->count;
 
-    return (sent == total) ? 0 : -1;
+    for (int i = 0; i < count; i++) {
+        iov[i].iov_base = &batch->msgs[i];
+        iov[i].iov_len = message_size(&batch->msgs[i]);
+    }
+    batch->count = 0;
+    return send_iov_all(client_fd, iov, count);
 }
 
 /* ============================================
  * 命令处理函数
- * ============================================ */
+ * ============================================
+ *
+ * 处理函数只负责填写响应，不直接操作 socket：
+ * 阻塞模式和事件驱动模式用各自的方式把响应发出去。
+ * 所有处理函数的原型相同 (CommandHandler)，按命令字节放在分发表中。
+ */
 
 /*
  * 处理 ECHO 命令 - 原样返回数据
  */
-void handle_echo(int client_fd, const char *data, uint16_t len) {
-    log_msg("  -> ECHO: \"%.*s\"", len, data);
-    send_message(client_fd, RESP_OK, data, len);
+int handle_echo(const Message *req, Message *resp) {
+    uint16_t len = ntohs(req->header.length);
+    log_verbose("  -> ECHO: \"%.*s\"", len, req->payload);
+    set_response(resp, RESP_OK, req->payload, len);
+    return 0;
 }
 
 /*
  * 处理 TIME 命令 - 返回服务器时间
  */
-void handle_time(int client_fd) {
+int handle_time(const Message *req, Message *resp) {
+    (void)req;
     time_t now = time(NULL);
-    char *time_str = ctime(&now);
+    char time_str[32];
+    ctime_r(&now, time_str);
     time_str[strlen(time_str) - 1] = '\0';  /* 移除换行符 */
 
-    log_msg("  -> TIME: %s", time_str);
-    send_message(client_fd, RESP_OK, time_str, strlen(time_str));
+    log_verbose("  -> TIME: %s", time_str);
+    set_response(resp, RESP_OK, time_str, strlen(time_str));
+    return 0;
 }
 
 /*
  * 处理 INFO 命令 - 返回服务器信息
  */
-void handle_info(int client_fd) {
+int handle_info(const Message *req, Message *resp) {
+    (void)req;
     char info[256];
     snprintf(info, sizeof(info),
              "Server: Mini Socket Server v1.0\n"
@@ -153,36 +267,71 @@ void handle_info(int client_fd) {
              "PID: %d",
              MAX_PAYLOAD_SIZE, getpid());
 
-    log_msg("  -> INFO requested");
-    send_message(client_fd, RESP_OK, info, strlen(info));
+    log_verbose("  -> INFO requested");
+    set_response(resp, RESP_OK, info, strlen(info));
+    return 0;
 }
 
 /*
  * 处理 PING 命令 - 返回 PONG
  */
-void handle_ping(int client_fd) {
+int handle_ping(const Message *req, Message *resp) {
+    (void)req;
     const char *pong = "PONG";
-    log_msg("  -> PING -> PONG");
-    send_message(client_fd, RESP_OK, pong, strlen(pong));
+    log_verbose("  -> PING -> PONG");
+    set_response(resp, RESP_OK, pong, strlen(pong));
+    return 0;
+}
+
+/*
+ * 处理 HELLO 命令 - 协商协议版本 (取客户端期望的版本和服务器支持的版本中较小的)
+ * 返回: 2=协商出 v2, 0=继续使用 v1
+ */
+int handle_hello(const Message *req, Message *resp) {
+    uint16_t len = ntohs(req->header.length);
+    uint8_t version = (len >= 1 && (uint8_t)req->payload[0] >= PROTO_V2) ? PROTO_V2 : PROTO_V1;
+    log_verbose("  -> HELLO: protocol v%d", version);
+    set_response(resp, RESP_OK, &version, 1);
+    return version == PROTO_V2 ? 2 : 0;
+}
+
+/*
+ * BLOB_PUT/BLOB_GET: v2 连接上由 serve_v2() 直接处理，走到这里说明还是 v1
+ */
+int handle_v2_only(const Message *req, Message *resp) {
+    (void)req;
+    const char *err = "Command requires protocol v2";
+    set_response(resp, RESP_ERROR, err, strlen(err));
+    return 0;
+}
+
+/*
+ * 处理 QUIT 命令 - 不回复，关闭连接
+ */
+int handle_quit(const Message *req, Message *resp) {
+    (void)req;
+    (void)resp;
+    log_verbose("  -> Client requested disconnect");
+    return 1;
 }
 
 /*
  * 处理计算命令
  */
-void handle_calc(int client_fd, uint8_t cmd, const char *data, uint16_t len) {
-    if (len < sizeof(CalcPayload)) {
+int handle_calc(const Message *req, Message *resp) {
+    if (ntohs(req->header.length) < sizeof(CalcPayload)) {
         const char *err = "Invalid calc payload";
-        send_message(client_fd, RESP_ERROR, err, strlen(err));
-        return;
+        set_response(resp, RESP_ERROR, err, strlen(err));
+        return 0;
     }
 
-    CalcPayload *calc = (CalcPayload *)data;
+    const CalcPayload *calc = (const CalcPayload *)req->payload;
     int32_t a = ntohl(calc->a);
     int32_t b = ntohl(calc->b);
     int32_t result = 0;
     const char *op = "";
 
-    switch (cmd) {
+    switch (req->header.cmd) {
         case CMD_CALC_ADD:
             result = a + b;
             op = "+";
@@ -198,134 +347,2301 @@ void handle_calc(int client_fd, uint8_t cmd, const char *data, uint16_t len) {
         case CMD_CALC_DIV:
             if (b == 0) {
                 const char *err = "Division by zero";
-                log_msg("  -> CALC: %d / 0 = ERROR", a);
-                send_message(client_fd, RESP_ERROR, err, strlen(err));
-                return;
+                log_verbose("  -> CALC: %d / 0 = ERROR", a);
+                set_response(resp, RESP_ERROR, err, strlen(err));
+                return 0;
             }
             result = a / b;
             op = "/";
             break;
     }
 
-    log_msg("  -> CALC: %d %s %d = %d", a, op, b, result);
+    log_verbose("  -> CALC: %d %s %d = %d", a, op, b, result);
 
-    CalcResult resp;
-    resp.result = htonl(result);
-    send_message(client_fd, RESP_OK, &resp, sizeof(resp));
+    CalcResult res;
+    res.result = htonl(result);
+    set_response(resp, RESP_OK, &res, sizeof(res));
+    return 0;
 }
 
 /* ============================================
- * 客户端处理
- * ============================================ */
+ * 命令分发
+ * ============================================
+ *
+ * 命令字节直接作为下标查表，没有 switch 和字符串比较:
+ *   g_builtin       内置命令，编译期确定
+ *   g_plugin_slots  插件命令 (CMD_PLUGIN_FIRST ~ CMD_PLUGIN_LAST)，指向
+ *                   mini_dlsym_stable 的槽。槽中的地址在热替换时原子地切换，
+ *                   读槽和调用放在 mini_dlslot_enter/exit 之间，旧版本要等
+ *                   这样的区间全部结束才会被卸载
+ */
+
+static const CommandHandler g_builtin[256] = {
+    [CMD_ECHO]     = handle_echo,
+    [CMD_TIME]     = handle_time,
+    [CMD_INFO]     = handle_info,
+    [CMD_PING]     = handle_ping,
+    [CMD_CALC_ADD] = handle_calc,
+    [CMD_CALC_SUB] = handle_calc,
+    [CMD_CALC_MUL] = handle_calc,
+    [CMD_CALC_DIV] = handle_calc,
+    [CMD_HELLO]    = handle_hello,
+    [CMD_BLOB_PUT] = handle_v2_only,
+    [CMD_BLOB_GET] = handle_v2_only,
+    [CMD_QUIT]     = handle_quit,
+};
+
+/* 插件命令的槽和名字: 只在加载/重新加载时写入 (先写名字，再发布槽) */
+static void **g_plugin_slots[256];
+static const char *g_plugin_names[256];
 
 /*
- * 处理单个客户端连接
+ * 命令名 (用于日志)
  */
-void handle_client(int client_fd, struct sockaddr_in *client_addr) {
-    char client_ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &client_addr->sin_addr, client_ip, sizeof(client_ip));
-    int client_port = ntohs(client_addr->sin_port);
+static const char *command_name(uint8_t cmd) {
+    if (__atomic_load_n(&g_plugin_slots[cmd], __ATOMIC_ACQUIRE)) {
+        return g_plugin_names[cmd];
+    }
+    return cmd_to_string(cmd);
+}
 
-    log_msg("Client connected: %s:%d (fd=%d)", client_ip, client_port, client_fd);
+/*
+ * 处理一条请求，填写响应
+ * 返回: 0=发送 resp, 1=客户端请求断开 (不回复),
+ *       2=发送 resp (仍是 v1 格式)，之后的数据按 v2 处理 (serve_v2)
+ */
+int process_message(const Message *req, Message *resp) {
+    uint8_t cmd = req->header.cmd;
 
-    Message msg;
-    int running = 1;
+    CommandHandler handler = g_builtin[cmd];
+    if (handler) {
+        return handler(req, resp);
+    }
 
-    while (running && g_running) {
-        /* 接收消息 */
-        int ret = recv_message(client_fd, &msg);
-        if (ret == 1) {
-            log_msg("Client disconnected: %s:%d", client_ip, client_port);
-            break;
+    void **slot = __atomic_load_n(&g_plugin_slots[cmd], __ATOMIC_ACQUIRE);
+    if (slot) {
+        mini_dlslot_enter();
+        handler = (CommandHandler)mini_dlslot_get(slot);
+        int ret = handler(req, resp);
+        mini_dlslot_exit();
+        /* 插件不能切换协议 */
+        return ret == 1 ? 1 : 0;
+    }
+
+    log_verbose("  -> Unknown command: 0x%02X", cmd);
+    const char *err = "Unknown command";
+    set_response(resp, RESP_ERROR, err, strlen(err));
+    return 0;
+}
+
+/* ============================================
+ * 命令插件
+ * ============================================
+ *
+ * -L path 指定的插件在启动时由 mini_dlopen 加载 (立即绑定)，命令表中的每个
+ * 处理函数取一个稳定槽放入分发表。SIGHUP 时由一个专门的线程用 mini_dlreload
+ * 重新加载每个插件 (文件已被替换): 已有命令的槽原子地切换到新版本，新增的
+ * 命令加入分发表；新版本缺少已有的处理函数时替换失败，继续使用旧版本。
+ * 正在处理的请求不受影响，旧版本在它们全部结束之后才被卸载。
+ */
+
+#define MAX_PLUGINS     16
+
+typedef struct {
+    const char *path;
+    void *handle;
+} Plugin;
+
+static Plugin g_plugins[MAX_PLUGINS];
+static int g_nplugins = 0;
+
+/*
+ * 把插件命令表中的命令加入分发表 (已经由本插件注册的命令跳过)
+ * 返回: 新注册的命令数, -1=没有命令表
+ */
+static int plugin_register(int index) {
+    Plugin *pl = &g_plugins[index];
+    const PluginCommand *cmds = mini_dlsym(pl->handle, PLUGIN_COMMANDS_SYMBOL);
+    if (!cmds) {
+        log_msg("Plugin %s: no %s table", pl->path, PLUGIN_COMMANDS_SYMBOL);
+        return -1;
+    }
+
+    int added = 0;
+    for (; cmds->symbol != NULL; cmds++) {
+        uint8_t cmd = cmds->cmd;
+        const char *name = cmds->name ? cmds->name : cmds->symbol;
+
+        if (cmd < CMD_PLUGIN_FIRST || cmd > CMD_PLUGIN_LAST) {
+            log_msg("Plugin %s: command 0x%02X (%s) outside 0x%02X-0x%02X, skipped",
+                    pl->path, cmd, name, CMD_PLUGIN_FIRST, CMD_PLUGIN_LAST);
+            continue;
         }
-        if (ret < 0) {
-            log_msg("Error receiving from %s:%d", client_ip, client_port);
-            break;
+
+        /* 槽按 (库, 符号) 唯一: 重新加载后同一个命令得到同一个槽 */
+        void **slot = mini_dlsym_stable(pl->handle, cmds->symbol);
+        if (!slot) {
+            log_msg("Plugin %s: %s", pl->path, mini_dlerror());
+            continue;
+        }
+        void **cur = g_plugin_slots[cmd];
+        if (cur == slot) {
+            continue;
+        }
+        if (cur != NULL) {
+            log_msg("Plugin %s: command 0x%02X (%s) already registered as %s, skipped",
+                    pl->path, cmd, name, g_plugin_names[cmd]);
+            continue;
         }
 
-        uint16_t payload_len = ntohs(msg.header.length);
-        log_msg("Received [%s] from %s:%d, len=%d",
-                cmd_to_string(msg.header.cmd), client_ip, client_port, payload_len);
+        /* 名字在插件卸载后仍然要用，复制一份 (不再释放) */
+        g_plugin_names[cmd] = strdup(name);
+        __atomic_store_n(&g_plugin_slots[cmd], slot, __ATOMIC_RELEASE);
+        log_msg("  -> [0x%02X] %s -> %s", cmd, name, cmds->symbol);
+        added++;
+    }
+    return added;
+}
 
-        /* 根据命令类型分发处理 */
-        switch (msg.header.cmd) {
-            case CMD_ECHO:
-                handle_echo(client_fd, msg.payload, payload_len);
-                break;
+/*
+ * 启动时加载插件 (在创建任何服务线程之前)
+ */
+static int plugin_load(const char *path) {
+    if (g_nplugins == MAX_PLUGINS) {
+        log_msg("Too many plugins (max %d)", MAX_PLUGINS);
+        return -1;
+    }
 
-            case CMD_TIME:
-                handle_time(client_fd);
-                break;
+    void *handle = mini_dlopen(path, MINI_RTLD_NOW);
+    if (!handle) {
+        log_msg("Cannot load plugin %s: %s", path, mini_dlerror());
+        return -1;
+    }
+    log_msg("Plugin loaded: %s", path);
 
-            case CMD_INFO:
-                handle_info(client_fd);
-                break;
+    g_plugins[g_nplugins].path = path;
+    g_plugins[g_nplugins].handle = handle;
+    if (plugin_register(g_nplugins) < 0) {
+        mini_dlclose(handle);
+        return -1;
+    }
+    g_nplugins++;
+    return 0;
+}
 
-            case CMD_PING:
-                handle_ping(client_fd);
-                break;
+/*
+ * 重新加载所有插件
+ */
+static void plugin_reload_all(void) {
+    for (int i = 0; i < g_nplugins; i++) {
+        Plugin *pl = &g_plugins[i];
+        void *handle = mini_dlreload(pl->handle, NULL, MINI_RTLD_NOW);
+        if (!handle) {
+            log_msg("Reload of %s failed, keeping the old version: %s", pl->path, mini_dlerror());
+            continue;
+        }
+        pl->handle = handle;
+        int added = plugin_register(i);
+        log_msg("Plugin reloaded: %s (%d new command(s))", pl->path, added > 0 ? added : 0);
+    }
+}
 
-            case CMD_CALC_ADD:
-            case CMD_CALC_SUB:
-            case CMD_CALC_MUL:
-            case CMD_CALC_DIV:
-                handle_calc(client_fd, msg.header.cmd, msg.payload, payload_len);
-                break;
+/*
+ * 等待 SIGHUP 的线程: 热替换需要等待宽限期，不能放在信号处理函数中
+ */
+static void *plugin_reload_main(void *arg) {
+    sigset_t *set = arg;
+    while (g_running) {
+        int sig;
+        if (sigwait(set, &sig) == 0 && sig == SIGHUP) {
+            log_msg("Received SIGHUP, reloading %d plugin(s)...", g_nplugins);
+            plugin_reload_all();
+        }
+    }
+    return NULL;
+}
 
-            case CMD_QUIT:
-                log_msg("  -> Client requested disconnect");
-                running = 0;
-                break;
+/*
+ * 屏蔽 SIGHUP 并启动重新加载线程
+ * 必须在创建其他线程之前调用: 新线程继承信号屏蔽字，SIGHUP 只会交给 sigwait
+ */
+static int plugin_start_reloader(void) {
+    static sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, plugin_reload_main, &set) != 0) {
+        perror("pthread_create() failed");
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
 
-            default:
-                log_msg("  -> Unknown command: 0x%02X", msg.header.cmd);
-                const char *err = "Unknown command";
-                send_message(client_fd, RESP_ERROR, err, strlen(err));
-                break;
+/* ============================================
+ * 协议 v2
+ * ============================================
+ *
+ * HELLO 协商成功后，连接交给 serve_v2() 在阻塞的 socket 上处理 (阻塞模式
+ * 在主线程中直接调用；事件驱动模式把 fd 移出 epoll，交给一个单独的线程，
+ * 线程数有上限，名额用完时 HELLO 回复版本 1):
+ *
+ *   - 小请求 (负载不超过 MAX_PAYLOAD_SIZE) 复制成 Message 交给
+ *     process_message()，响应带上请求的 ID
+ *   - 大 ECHO: socket -> 管道 -> socket (splice)，负载不经过用户态
+ *   - BLOB_PUT: socket -> 管道 -> memfd (splice)，代替真实服务中的文件
+ *   - BLOB_GET: 按块 sendfile(memfd -> socket)。每发一块之前先处理已经
+ *     到达的请求，多个下载轮流发送，所以下载期间的小请求先得到响应 (乱序)
+ */
+
+#define V2_RECV_BUF     (2 * RECV_BUF_SIZE)
+#define V2_CHUNK        (256 * 1024)        /* BLOB_GET 每一帧的大小 */
+#define V2_MAX_STREAMS  16                  /* 同时进行的 BLOB_GET 数 */
+#define V2_PIPE_SIZE    (1024 * 1024)       /* splice 中转管道的容量 */
+
+/* 一个进行中的 BLOB_GET */
+typedef struct {
+    uint32_t id;
+    int fd;                     /* blob 的副本: 之后的 PUT 不影响进行中的下载 */
+    off_t off;
+    size_t remaining;
+} V2Stream;
+
+typedef struct {
+    int fd;
+    const char *peer;
+    int pipe[2];
+    int blob_fd;                /* 最近一次 BLOB_PUT 的内容, -1=没有 */
+    size_t blob_size;
+    V2Stream streams[V2_MAX_STREAMS];
+    int nstreams;
+    int next_stream;            /* 下一个发送的下载 (轮转) */
+} V2Conn;
+
+/*
+ * 发送一个 v2 帧
+ * payload 为 NULL 时只发送消息头，负载由调用者接着发送 (splice/sendfile)
+ */
+static int v2_send_frame(int fd, uint8_t cmd, uint8_t flags, uint32_t id,
+                         const void *payload, size_t len) {
+    MessageHeaderV2 h = { cmd, flags, 0, htonl(id), htonl(len) };
+    struct iovec iov[2] = {
+        { &h, HEADER_V2_SIZE },
+        { (void *)payload, len },
+    };
+    return send_iov_all(fd, iov, payload != NULL && len > 0 ? 2 : 1);
+}
+
+static int v2_send_error(V2Conn *v, uint32_t id, const char *err) {
+    return v2_send_frame(v->fd, RESP_ERROR, 0, id, err, strlen(err));
+}
+
+/*
+ * 把 socket 中接下来的 len 字节经过管道搬运到 out (socket 或文件)
+ * 数据只在内核的页面之间移动，不复制到用户态
+ * 返回: 0=成功, -1=失败
+ */
+static int v2_splice(V2Conn *v, int out, size_t len) {
+    while (len > 0) {
+        size_t want = len < V2_PIPE_SIZE ? len : V2_PIPE_SIZE;
+        ssize_t n = splice(v->fd, NULL, v->pipe[1], NULL, want, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            return -1;
+        }
+        len -= n;
+
+        while (n > 0) {
+            ssize_t m = splice(v->pipe[0], NULL, out, NULL, n, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (m < 0 && errno == EINTR) continue;
+            if (m <= 0) {
+                return -1;
+            }
+            n -= m;
         }
     }
+    return 0;
+}
 
-    close(client_fd);
-    log_msg("Connection closed: %s:%d", client_ip, client_port);
+/*
+ * 大 ECHO: 响应头和缓冲区中已有的负载先发出，其余的负载直接从 socket 转发
+ */
+static int v2_echo_large(V2Conn *v, uint32_t id, const char *data, size_t nbuf, size_t len) {
+    log_verbose("  -> ECHO: %zu bytes (spliced)", len);
+    MessageHeaderV2 h = { RESP_OK, 0, 0, htonl(id), htonl(len) };
+    struct iovec iov[2] = {
+        { &h, HEADER_V2_SIZE },
+        { (void *)data, nbuf },
+    };
+    if (send_iov_all(v->fd, iov, nbuf > 0 ? 2 : 1) < 0) {
+        return -1;
+    }
+    return v2_splice(v, v->fd, len - nbuf);
 }
 
-/* ============================================
- * 主函数
- * ============================================ */
+/*
+ * BLOB_PUT: 负载存入新的 memfd，响应为 4 字节的大小
+ */
+static int v2_blob_put(V2Conn *v, uint32_t id, const char *data, size_t nbuf, size_t len) {
+    int fd = memfd_create("blob", MFD_CLOEXEC);
+    if (fd < 0) {
+        log_msg("memfd_create() failed: %s", strerror(errno));
+        return -1;     /* 负载还在 socket 中，无法继续解析 */
+    }
 
-void print_usage(const char *prog) {
-    printf("Usage: %s [-p port]\n", prog);
-    printf("Options:\n");
-    printf("  -p port   Server port (default: %d)\n", DEFAULT_PORT);
-    printf("  -h        Show this help\n");
+    size_t off = 0;
+    while (off < nbuf) {
+        ssize_t n = write(fd, data + off, nbuf - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            close(fd);
+            return -1;
+        }
+        off += n;
+    }
+    if (v2_splice(v, fd, len - nbuf) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (v->blob_fd >= 0) {
+        close(v->blob_fd);
+    }
+    v->blob_fd = fd;
+    v->blob_size = len;
+    log_verbose("  -> BLOB_PUT: %zu bytes", len);
+
+    uint32_t size = htonl(len);
+    return v2_send_frame(v->fd, RESP_OK, 0, id, &size, sizeof(size));
 }
 
-int main(int argc, char *argv[]) {
-    int port = DEFAULT_PORT;
-    int opt;
+/*
+ * BLOB_GET: 负载为 4 字节的长度 (0 或超过 blob 大小时取整个 blob)，
+ * 登记一个下载，由 v2_stream_step() 分块发送
+ */
+static int v2_blob_get(V2Conn *v, uint32_t id, const char *data, size_t len) {
+    if (v->blob_fd < 0) {
+        return v2_send_error(v, id, "No blob stored");
+    }
+    if (v->nstreams == V2_MAX_STREAMS) {
+        return v2_send_error(v, id, "Too many concurrent downloads");
+    }
 
-    /* 解析命令行参数 */
-    while ((opt = getopt(argc, argv, "p:h")) != -1) {
-        switch (opt) {
-            case 'p':
-                port = atoi(optarg);
-                break;
-            case 'h':
-                print_usage(argv[0]);
-                return 0;
-            default:
-                print_usage(argv[0]);
-                return 1;
+    size_t want = v->blob_size;
+    if (len >= sizeof(uint32_t)) {
+        uint32_t n;
+        memcpy(&n, data, sizeof(n));
+        n = ntohl(n);
+        if (n > 0 && n < want) {
+            want = n;
         }
     }
+    log_verbose("  -> BLOB_GET: %zu bytes", want);
+    if (want == 0) {
+        return v2_send_frame(v->fd, RESP_OK, 0, id, NULL, 0);
+    }
 
-    /* 设置信号处理 */
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    int fd = dup(v->blob_fd);
+    if (fd < 0) {
+        return v2_send_error(v, id, "Out of file descriptors");
+    }
+    V2Stream *s = &v->streams[v->nstreams++];
+    s->id = id;
+    s->fd = fd;
+    s->off = 0;
+    s->remaining = want;
+    return 0;
+}
 
-    printf("==========================================\n");
-    printf("     Mini Socket Server - 教学示例\n");
-    printf("==========================================\n\n");
+/*
+ * 发送一个下载的下一块 (除最后一块外都带 V2_FLAG_MORE)
+ */
+static int v2_stream_step(V2Conn *v) {
+    if (v->next_stream >= v->nstreams) {
+        v->next_stream = 0;
+    }
+    V2Stream *s = &v->streams[v->next_stream];
+    size_t chunk = s->remaining < V2_CHUNK ? s->remaining : V2_CHUNK;
+    uint8_t flags = chunk < s->remaining ? V2_FLAG_MORE : 0;
+
+    if (v2_send_frame(v->fd, RESP_OK, flags, s->id, NULL, chunk) < 0) {
+        return -1;
+    }
+    size_t left = chunk;
+    while (left > 0) {
+        ssize_t n = sendfile(v->fd, s->fd, &s->off, left);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            return -1;
+        }
+        left -= n;
+    }
+
+    s->remaining -= chunk;
+    if (s->remaining == 0) {
+        /* 用最后一个下载填补空位，next_stream 不变即轮到它 */
+        close(s->fd);
+        *s = v->streams[--v->nstreams];
+    } else {
+        v->next_stream++;
+    }
+    return 0;
+}
+
+/*
+ * 处理缓冲区中所有完整的请求
+ * 大负载 (BLOB_PUT, 超过 MAX_PAYLOAD_SIZE 的 ECHO) 不需要整条在缓冲区中:
+ * 已经读到的部分直接使用，其余的当场从 socket 搬运
+ * 返回: 消耗的字节数, -1=需要关闭连接；*quit=1 表示收到 QUIT
+ */
+static ssize_t v2_parse(V2Conn *v, const char *buf, size_t len, int *quit) {
+    size_t off = 0;
+
+    while (len - off >= HEADER_V2_SIZE) {
+        const MessageHeaderV2 *h = (const MessageHeaderV2 *)(buf + off);
+        uint8_t cmd = h->cmd;
+        uint32_t id = ntohl(h->request_id);
+        uint32_t plen = ntohl(h->length);
+        const char *payload = buf + off + HEADER_V2_SIZE;
+        size_t avail = len - off - HEADER_V2_SIZE;
+
+        int large = cmd == CMD_BLOB_PUT || plen > MAX_PAYLOAD_SIZE;
+        if (plen > MAX_PAYLOAD_V2_SIZE || (large && cmd != CMD_ECHO && cmd != CMD_BLOB_PUT)) {
+            log_msg("Invalid v2 message from %s: cmd=0x%02X, len=%u", v->peer, cmd, plen);
+            return -1;
+        }
+        if (!large && avail < plen) {
+            break;
+        }
+        log_verbose("Received [%s] from %s, id=%u, len=%u", command_name(cmd), v->peer,
+                    id, plen);
+
+        if (large) {
+            size_t nbuf = avail < plen ? avail : plen;
+            int ret = cmd == CMD_ECHO ? v2_echo_large(v, id, payload, nbuf, plen)
+                                      : v2_blob_put(v, id, payload, nbuf, plen);
+            if (ret < 0) {
+                return -1;
+            }
+            off += HEADER_V2_SIZE + nbuf;
+            continue;
+        }
+
+        off += HEADER_V2_SIZE + plen;
+        if (cmd == CMD_BLOB_GET) {
+            if (v2_blob_get(v, id, payload, plen) < 0) {
+                return -1;
+            }
+            continue;
+        }
+
+        Message req, resp;
+        req.header.cmd = cmd;
+        req.header.length = htons(plen);
+        memcpy(req.payload, payload, plen);
+        if (process_message(&req, &resp) == 1) {
+            *quit = 1;
+            break;
+        }
+        if (v2_send_frame(v->fd, resp.header.cmd, 0, id, resp.payload,
+                          ntohs(resp.header.length)) < 0) {
+            return -1;
+        }
+    }
+    return off;
+}
+
+/*
+ * 以 v2 协议处理一个连接，直到对端关闭或者 QUIT (不关闭 fd)
+ * rest: HELLO 之后已经读到的数据
+ */
+void serve_v2(int fd, const char *peer, const char *rest, size_t rest_len) {
+    log_verbose("Protocol v2: %s", peer);
+
+    V2Conn v;
+    memset(&v, 0, sizeof(v));
+    v.fd = fd;
+    v.peer = peer;
+    v.blob_fd = -1;
+
+    char *buf = malloc(V2_RECV_BUF);
+    if (!buf || rest_len > V2_RECV_BUF || pipe2(v.pipe, O_CLOEXEC) < 0) {
+        log_msg("Cannot start v2 session for %s", peer);
+        free(buf);
+        return;
+    }
+    /* 默认 64 KB 的管道一次 splice 只能搬运 16 页，调大可以减少系统调用 */
+    fcntl(v.pipe[1], F_SETPIPE_SZ, V2_PIPE_SIZE);
+
+    /* 大负载的消息头和数据分两次写出，不能让 Nagle 等待对端的 ACK */
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    memcpy(buf, rest, rest_len);
+    size_t len = rest_len;
+    int quit = 0;
+
+    while (g_running) {
+        ssize_t used = v2_parse(&v, buf, len, &quit);
+        if (used < 0 || quit) {
+            break;
+        }
+        memmove(buf, buf + used, len - used);
+        len -= used;
+
+        /* 有下载在进行时只检查一下是否有新请求，否则等待 (超时用于检查 g_running) */
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, v.nstreams > 0 ? 0 : 500);
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+        if (ready > 0) {
+            ssize_t n = recv(fd, buf + len, V2_RECV_BUF - len, 0);
+            if (n == 0) {
+                break;
+            }
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            len += n;
+        }
+
+        /* 每一轮最多发一块，之后先处理新到达的请求 */
+        if (v.nstreams > 0 && v2_stream_step(&v) < 0) {
+            break;
+        }
+    }
+
+    for (int i = 0; i < v.nstreams; i++) {
+        close(v.streams[i].fd);
+    }
+    if (v.blob_fd >= 0) {
+        close(v.blob_fd);
+    }
+    close(v.pipe[0]);
+    close(v.pipe[1]);
+    free(buf);
+}
+
+/* ============================================
+ * 客户端处理
+ * ============================================ */
+
+/*
+ * 处理单个客户端连接
+ */
+void handle_client(int client_fd, struct sockaddr_in *client_addr) {
+    char client_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &client_addr->sin_addr, client_ip, sizeof(client_ip));
+    int client_port = ntohs(client_addr->sin_port);
+
+    log_verbose("Client connected: %s:%d (fd=%d)", client_ip, client_port, client_fd);
+
+    /* 缓冲区较大，放在静态区 (阻塞模式只有一个线程在处理连接) */
+    static char buf[RECV_BUF_SIZE];
+    static RespBatch batch;
+    size_t len = 0;
+    size_t off = 0;
+    int done = 0;
+    int upgrade = 0;
+
+    while (g_running && !done) {
+        /* 一次 recv 可能带来多条请求，也可能只有半条 */
+        ssize_t n = recv(client_fd, buf + len, sizeof(buf) - len, 0);
+        if (n == 0) {
+            log_verbose("Client disconnected: %s:%d", client_ip, client_port);
+            break;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            log_msg("Error receiving from %s:%d", client_ip, client_port);
+            break;
+        }
+        len += n;
+
+        /* 处理缓冲区中所有完整的消息 */
+        off = 0;
+        while (!done) {
+            ssize_t frame = frame_length(buf + off, len - off);
+            if (frame == 0) {
+                break;
+            }
+            if (frame < 0) {
+                log_msg("Invalid message length from %s:%d", client_ip, client_port);
+                done = 1;
+                break;
+            }
+
+            const Message *req = (const Message *)(buf + off);
+            off += frame;
+            log_verbose("Received [%s] from %s:%d, len=%d", command_name(req->header.cmd),
+                        client_ip, client_port, ntohs(req->header.length));
+
+            int ret = process_message(req, &batch.msgs[batch.count]);
+            if (ret == 1) {
+                done = 1;
+                break;
+            }
+            if (++batch.count == RESP_BATCH && send_batch(client_fd, &batch) < 0) {
+                log_msg("Error sending to %s:%d", client_ip, client_port);
+                done = 1;
+            }
+            if (ret == 2) {
+                /* HELLO 之后的数据都是 v2 帧 */
+                upgrade = !done;
+                done = 1;
+            }
+        }
+
+        /* 这一批的响应一次发出 (QUIT 之前的请求也要回复) */
+        if (batch.count > 0 && send_batch(client_fd, &batch) < 0) {
+            log_msg("Error sending to %s:%d", client_ip, client_port);
+            break;
+        }
+        if (upgrade) {
+            char peer[INET_ADDRSTRLEN + 8];
+            snprintf(peer, sizeof(peer), "%s:%d", client_ip, client_port);
+            serve_v2(client_fd, peer, buf + off, len - off);
+            break;
+        }
+
+        /* 不完整的消息移到缓冲区开头，等待后续数据 */
+        memmove(buf, buf + off, len - off);
+        len -= off;
+    }
+
+    close(client_fd);
+    log_verbose("Connection closed: %s:%d", client_ip, client_port);
+}
+
+/* ============================================
+ * 事件驱动模式 (epoll)
+ * ============================================
+ *
+ * 结构:
+ *   - N 个 reactor 线程，每个线程一个 epoll 实例和一个监听 socket。
+ *     所有监听 socket 绑定同一端口 (SO_REUSEPORT)，内核按四元组哈希
+ *     把新连接分给其中一个，线程之间没有共享的 accept 队列和锁。
+ *   - 连接只属于接受它的线程，整个生命周期内不跨线程。
+ *   - 所有 fd 都是非阻塞的，以边缘触发 (EPOLLET) 注册：每次通知后
+ *     必须一直读/写到 EAGAIN，否则剩下的数据不会再有通知。
+ *   - 每个连接有一个增量解析器: 消息可能被拆成任意多段到达，
+ *     一次 recv 也可能包含多条消息。
+ */
+
+#define EVENT_BATCH     256             /* 每次 epoll_wait 最多取回的事件数 */
+#define OUT_BUF_LIMIT   (256 * 1024)    /* 待发送数据超过此值时暂停读取 (背压) */
+#define V2_MAX_SESSIONS 64              /* 同时进行的 v2 会话数 (每个会话一个线程) */
+
+typedef struct Conn {
+    int fd;
+    char peer[INET_ADDRSTRLEN + 8];     /* "ip:port"，用于日志 */
+
+    /* 上一次 recv 末尾不完整的消息 (一定小于一条最大消息) */
+    char partial[sizeof(Message)];
+    size_t partial_len;
+
+    /* 一次 sendmsg 没有发完的响应 */
+    char *out;
+    size_t out_len;                     /* 缓冲区中的数据总量 */
+    size_t out_off;                     /* 已经发送的部分 */
+    size_t out_cap;
+
+    int read_paused;                    /* 因背压暂停读取，EPOLLOUT 时恢复 */
+    int closing;                        /* 收到 QUIT: 响应发完后关闭 */
+    int upgrading;                      /* 收到 HELLO v2 (已预留会话名额): 响应发完后交给 v2 线程 */
+    char *v2_rest;                      /* HELLO 之后已经读到的 v2 数据 */
+    size_t v2_rest_len;
+
+    struct Conn *prev, *next;           /* reactor 的连接链表 (退出时释放) */
+} Conn;
+
+typedef struct {
+    int id;
+    int listen_fd;
+    int epoll_fd;
+    pthread_t thread;
+    Conn *conns;
+    long nconns;                        /* 当前连接数 */
+    unsigned long accepted;             /* 累计接受的连接数 */
+    unsigned long requests;             /* 累计处理的请求数 */
+    unsigned long writes;               /* 累计 sendmsg 次数 */
+
+    /* 所有连接共用: 同一时刻一个 reactor 只处理一个连接 */
+    char rbuf[sizeof(Message) + RECV_BUF_SIZE];     /* 上次剩下的半条消息 + 新数据 */
+    RespBatch batch;
+} Reactor;
+
+/*
+ * 把打开文件数上限提高到硬上限 (成千上万个连接需要同样多的 fd)
+ */
+static void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) == 0) {
+            log_msg("  -> RLIMIT_NOFILE raised to %lu", (unsigned long)rl.rlim_cur);
+        }
+    }
+}
+
+/*
+ * 创建非阻塞监听 socket，允许多个 socket 绑定同一端口
+ */
+static int create_reuseport_listener(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket() failed");
+        return -1;
+    }
+
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+        perror("setsockopt(SO_REUSEPORT) failed");
+        close(fd);
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind() failed");
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, SOMAXCONN) < 0) {
+        perror("listen() failed");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* 交给 v2 线程的连接 */
+typedef struct V2Session {
+    int fd;
+    char peer[INET_ADDRSTRLEN + 8];
+    char *rest;
+    size_t rest_len;
+    pthread_t thread;
+    int done;                           /* 线程已经结束，等待 join (g_v2.lock 保护) */
+    struct V2Session *next;
+} V2Session;
+
+/* 所有 reactor 共用: 运行中和已经结束但还没有 join 的 v2 会话 */
+static struct {
+    pthread_mutex_t lock;
+    V2Session *list;
+    int count;                          /* 占用的名额，包括已预留但还没有创建线程的 */
+} g_v2 = { PTHREAD_MUTEX_INITIALIZER, NULL, 0 };
+
+/* join 已经结束的会话 (调用者持有 g_v2.lock) */
+static void v2_reap_locked(void) {
+    V2Session **p = &g_v2.list;
+    while (*p) {
+        V2Session *s = *p;
+        if (!s->done) {
+            p = &s->next;
+            continue;
+        }
+        *p = s->next;
+        pthread_join(s->thread, NULL);
+        free(s);
+        g_v2.count--;
+    }
+}
+
+/*
+ * 收到 HELLO v2 时预留一个会话名额
+ * 返回: 1=成功, 0=名额已满 (连接继续使用 v1)
+ */
+static int v2_reserve(void) {
+    pthread_mutex_lock(&g_v2.lock);
+    v2_reap_locked();
+    int ok = g_v2.count < V2_MAX_SESSIONS;
+    if (ok) {
+        g_v2.count++;
+    }
+    pthread_mutex_unlock(&g_v2.lock);
+    return ok;
+}
+
+static void v2_unreserve(void) {
+    pthread_mutex_lock(&g_v2.lock);
+    g_v2.count--;
+    pthread_mutex_unlock(&g_v2.lock);
+}
+
+static void *v2_session_main(void *arg) {
+    V2Session *s = arg;
+    serve_v2(s->fd, s->peer, s->rest, s->rest_len);
+    log_verbose("Connection closed: %s", s->peer);
+    free(s->rest);
+    s->rest = NULL;
+
+    /* 持锁关闭: v2_sessions_stop() 只对还没有关闭的 fd 调用 shutdown() */
+    pthread_mutex_lock(&g_v2.lock);
+    close(s->fd);
+    s->done = 1;
+    pthread_mutex_unlock(&g_v2.lock);
+    return NULL;
+}
+
+/*
+ * 服务器退出 (所有 reactor 已经结束): 唤醒阻塞在 socket 上的 v2 会话，等待它们结束
+ */
+static void v2_sessions_stop(void) {
+    pthread_mutex_lock(&g_v2.lock);
+    for (V2Session *s = g_v2.list; s; s = s->next) {
+        if (!s->done) {
+            shutdown(s->fd, SHUT_RDWR);
+        }
+    }
+    V2Session *list = g_v2.list;
+    g_v2.list = NULL;
+    g_v2.count = 0;
+    pthread_mutex_unlock(&g_v2.lock);
+
+    while (list) {
+        V2Session *next = list->next;
+        pthread_join(list->thread, NULL);
+        free(list);
+        list = next;
+    }
+}
+
+/*
+ * 从 reactor 中摘除连接并释放 (不关闭 fd)
+ */
+static void conn_release(Reactor *r, Conn *c) {
+    if (c->prev) c->prev->next = c->next;
+    else r->conns = c->next;
+    if (c->next) c->next->prev = c->prev;
+    r->nconns--;
+
+    /* 没有交给 v2 线程就释放了: 归还预留的会话名额 */
+    if (c->upgrading) {
+        v2_unreserve();
+    }
+
+    /* 响应批中只可能是这个连接还没发出的响应 (解析出错、对端关闭或 recv 失败
+     * 时直接关闭)，必须丢掉，否则会在下一个连接的响应之前发给下一个连接 */
+    r->batch.count = 0;
+
+    free(c->out);
+    free(c->v2_rest);
+    free(c);
+}
+
+static void conn_close(Reactor *r, Conn *c) {
+    log_verbose("[reactor %d] Connection closed: %s", r->id, c->peer);
+
+    /* close() 会自动把 fd 从 epoll 中移除 */
+    close(c->fd);
+    conn_release(r, c);
+}
+
+/*
+ * HELLO 的响应已经发完: 把连接移出 epoll，改回阻塞模式，交给一个单独的线程
+ * v2 的 splice/sendfile 是阻塞的长操作，不能在 reactor 线程中进行。
+ * 线程数受 V2_MAX_SESSIONS 限制 (HELLO 时预留名额)，退出时全部 join
+ */
+static void conn_upgrade(Reactor *r, Conn *c) {
+    epoll_ctl(r->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    int flags = fcntl(c->fd, F_GETFL);
+    fcntl(c->fd, F_SETFL, flags & ~O_NONBLOCK);
+
+    V2Session *s = calloc(1, sizeof(V2Session));
+    if (!s) {
+        conn_close(r, c);
+        return;
+    }
+    s->fd = c->fd;
+    memcpy(s->peer, c->peer, sizeof(s->peer));
+    s->rest = c->v2_rest;
+    s->rest_len = c->v2_rest_len;
+    c->v2_rest = NULL;
+
+    int ret = pthread_create(&s->thread, NULL, v2_session_main, s);
+    if (ret != 0) {
+        log_msg("[reactor %d] pthread_create() failed: %s", r->id, strerror(ret));
+        close(c->fd);
+        free(s->rest);
+        free(s);
+    } else {
+        /* 名额转交给会话，退出时由 v2_sessions_stop() join */
+        pthread_mutex_lock(&g_v2.lock);
+        s->next = g_v2.list;
+        g_v2.list = s;
+        pthread_mutex_unlock(&g_v2.lock);
+        c->upgrading = 0;
+    }
+    conn_release(r, c);
+}
+
+static inline size_t conn_pending(const Conn *c) {
+    return c->out_len - c->out_off;
+}
+
+/*
+ * 把 sendmsg 没有发完的数据追加到输出缓冲区
+ */
+static int conn_queue(Conn *c, const void *data, size_t size) {
+    /* 已经发送的部分不再需要，先把剩余数据移到开头 */
+    if (c->out_off > 0) {
+        memmove(c->out, c->out + c->out_off, c->out_len - c->out_off);
+        c->out_len -= c->out_off;
+        c->out_off = 0;
+    }
+
+    if (c->out_len + size > c->out_cap) {
+        size_t cap = c->out_cap ? c->out_cap : 4096;
+        while (cap < c->out_len + size) {
+            cap *= 2;
+        }
+        char *out = realloc(c->out, cap);
+        if (!out) {
+            return -1;
+        }
+        c->out = out;
+        c->out_cap = cap;
+    }
+
+    memcpy(c->out + c->out_len, data, size);
+    c->out_len += size;
+    return 0;
+}
+
+/*
+ * 尽量发送输出缓冲区中的数据，直到发完或者 EAGAIN
+ * 返回: 0=正常 (可能还有剩余), -1=连接出错
+ */
+static int conn_flush(Conn *c) {
+    while (c->out_off < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        c->out_off += n;
+    }
+    c->out_off = c->out_len = 0;
+    return 0;
+}
+
+/*
+ * 用一次 sendmsg 发送输出缓冲区中的剩余数据和这一批响应
+ * 没发完的部分复制到输出缓冲区，等 EPOLLOUT 再发
+ * 返回: 0=正常, -1=连接出错
+ */
+static int conn_send_batch(Reactor *r, Conn *c) {
+    RespBatch *batch = &r->batch;
+    struct iovec iov[RESP_BATCH + 1];
+    int count = 0;
+
+    size_t pending = conn_pending(c);
+    if (pending > 0) {
+        iov[count].iov_base = c->out + c->out_off;
+        iov[count].iov_len = pending;
+        count++;
+    }
+    for (int i = 0; i < batch->count; i++) {
+        iov[count].iov_base = &batch->msgs[i];
+        iov[count].iov_len = message_size(&batch->msgs[i]);
+        count++;
+    }
+    batch->count = 0;
+    if (count == 0) {
+        return 0;
+    }
+
+    ssize_t n = send_iov(c->fd, iov, count);
+    r->writes++;
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return -1;
+        }
+        n = 0;
+    }
+
+    /* 跳过已经发出的部分，剩下的进入输出缓冲区 */
+    int i = 0;
+    if (pending > 0) {
+        if ((size_t)n < pending) {
+            c->out_off += n;
+            n = 0;
+        } else {
+            c->out_off = c->out_len = 0;
+            n -= pending;
+        }
+        i = 1;
+    }
+    for (; i < count; i++) {
+        if ((size_t)n >= iov[i].iov_len) {
+            n -= iov[i].iov_len;
+            continue;
+        }
+        if (conn_queue(c, (char *)iov[i].iov_base + n, iov[i].iov_len - n) < 0) {
+            return -1;
+        }
+        n = 0;
+    }
+
+    /* 部分发送不一定意味着 socket 缓冲区已满，继续发送直到 EAGAIN，
+     * 否则边缘触发的 EPOLLOUT 可能不会再来 */
+    return conn_pending(c) > 0 ? conn_flush(c) : 0;
+}
+
+/*
+ * 处理缓冲区中所有完整的消息，响应放入 reactor 的响应批
+ * 返回: 0=正常, -1=需要关闭连接
+ */
+static int conn_parse(Reactor *r, Conn *c, const char *buf, size_t len) {
+    size_t off = 0;
+
+    while (!c->closing && !c->upgrading) {
+        ssize_t frame = frame_length(buf + off, len - off);
+        if (frame == 0) {
+            break;
+        }
+        if (frame < 0) {
+            log_verbose("[reactor %d] Invalid message length from %s", r->id, c->peer);
+            return -1;
+        }
+
+        const Message *req = (const Message *)(buf + off);
+        off += frame;
+        log_verbose("[reactor %d] Received [%s] from %s, len=%d", r->id,
+                    command_name(req->header.cmd), c->peer, ntohs(req->header.length));
+        r->requests++;
+
+        int ret = process_message(req, &r->batch.msgs[r->batch.count]);
+        if (ret == 1) {
+            c->closing = 1;
+            break;
+        }
+        if (ret == 2) {
+            if (v2_reserve()) {
+                c->upgrading = 1;
+            } else {
+                /* 每个 v2 会话占一个线程，名额用完时回复版本 1，客户端继续使用 v1 */
+                uint8_t version = PROTO_V1;
+                set_response(&r->batch.msgs[r->batch.count], RESP_OK, &version, 1);
+            }
+        }
+        if (++r->batch.count == RESP_BATCH && conn_send_batch(r, c) < 0) {
+            return -1;
+        }
+    }
+
+    if (c->upgrading) {
+        /* HELLO 之后的数据属于 v2，连同 socket 一起交给 v2 线程 */
+        c->partial_len = 0;
+        c->v2_rest_len = len - off;
+        c->v2_rest = malloc(c->v2_rest_len + 1);
+        if (!c->v2_rest) {
+            return -1;
+        }
+        memcpy(c->v2_rest, buf + off, c->v2_rest_len);
+        return 0;
+    }
+
+    /* 剩下的半条消息留到下一次 recv */
+    c->partial_len = c->closing ? 0 : len - off;
+    memcpy(c->partial, buf + off, c->partial_len);
+    return 0;
+}
+
+/*
+ * 响应发完之后: QUIT 时关闭，HELLO v2 时交给 v2 线程
+ * 返回: 0=连接继续由 reactor 处理, -1=连接已经不属于 reactor (c 已释放)
+ */
+static int conn_check_done(Reactor *r, Conn *c) {
+    if (conn_pending(c) > 0) {
+        return 0;
+    }
+    if (c->closing) {
+        conn_close(r, c);
+        return -1;
+    }
+    if (c->upgrading) {
+        conn_upgrade(r, c);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * 可读: 读完 socket 缓冲区 (边缘触发)，这一次事件的所有响应一起发出
+ * hup: 对端已经关闭写方向，需要一直读到 recv 返回 0
+ * 返回: 0=正常, -1=连接已关闭 (c 已释放)
+ */
+static int conn_on_readable(Reactor *r, Conn *c, int hup) {
+    while (!c->closing && !c->upgrading) {
+        /* 背压: 对端不读响应时不再读新请求，让 TCP 窗口把对端压住 */
+        if (conn_pending(c) > OUT_BUF_LIMIT) {
+            c->read_paused = 1;
+            break;
+        }
+
+        /* 上次剩下的半条消息放在新数据前面，解析时不需要特殊处理 */
+        memcpy(r->rbuf, c->partial, c->partial_len);
+        ssize_t n = recv(c->fd, r->rbuf + c->partial_len, RECV_BUF_SIZE, 0);
+        if (n > 0) {
+            if (conn_parse(r, c, r->rbuf, c->partial_len + n) < 0) {
+                conn_close(r, c);
+                return -1;
+            }
+            /* 没有读满说明接收缓冲区已经空了，省掉一次返回 EAGAIN 的 recv；
+             * 之后到达的数据会产生新的边缘事件 */
+            if (n < RECV_BUF_SIZE && !hup) {
+                break;
+            }
+            continue;
+        }
+        if (n == 0) {
+            conn_close(r, c);   /* 对端关闭 */
+            return -1;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        conn_close(r, c);
+        return -1;
+    }
+
+    if (conn_send_batch(r, c) < 0) {
+        conn_close(r, c);
+        return -1;
+    }
+    return conn_check_done(r, c);
+}
+
+/*
+ * 可写: 发送剩余的响应，发完后恢复因背压暂停的读取
+ */
+static int conn_on_writable(Reactor *r, Conn *c) {
+    if (conn_flush(c) < 0) {
+        conn_close(r, c);
+        return -1;
+    }
+    if (conn_check_done(r, c) < 0) {
+        return -1;
+    }
+    if (c->read_paused && conn_pending(c) <= OUT_BUF_LIMIT) {
+        /* 暂停期间到达的数据不会再有 EPOLLIN 通知 (边缘触发)，主动去读 */
+        c->read_paused = 0;
+        return conn_on_readable(r, c, 1);
+    }
+    return 0;
+}
+
+/*
+ * 接受所有排队的新连接 (边缘触发: 一直 accept 到 EAGAIN)
+ */
+static void reactor_accept(Reactor *r) {
+    for (;;) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        int fd = accept4(r->listen_fd, (struct sockaddr *)&addr, &addr_len,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            /* EMFILE 等: 连接留在队列中，下一次有新连接时再试 */
+            log_msg("[reactor %d] accept() failed: %s", r->id, strerror(errno));
+            return;
+        }
+
+        /* 请求/响应式协议: 关闭 Nagle，小响应立即发出 */
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        Conn *c = calloc(1, sizeof(Conn));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+        snprintf(c->peer, sizeof(c->peer), "%s:%d", ip, ntohs(addr.sin_port));
+
+        /* 一次注册读写两个方向，之后不再需要 epoll_ctl(MOD) */
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = c;
+        if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            log_msg("[reactor %d] epoll_ctl() failed: %s", r->id, strerror(errno));
+            close(fd);
+            free(c);
+            continue;
+        }
+
+        c->next = r->conns;
+        if (r->conns) r->conns->prev = c;
+        r->conns = c;
+        r->nconns++;
+        r->accepted++;
+
+        log_verbose("[reactor %d] Client connected: %s (fd=%d)", r->id, c->peer, fd);
+    }
+}
+
+static void *reactor_main(void *arg) {
+    Reactor *r = arg;
+    struct epoll_event events[EVENT_BATCH];
+
+    while (g_running) {
+        /* 超时用于定期检查 g_running */
+        int n = epoll_wait(r->epoll_fd, events, EVENT_BATCH, 500);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            log_msg("[reactor %d] epoll_wait() failed: %s", r->id, strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            /* 监听 socket 注册时 data.ptr 为 NULL */
+            if (events[i].data.ptr == NULL) {
+                reactor_accept(r);
+                continue;
+            }
+
+            Conn *c = events[i].data.ptr;
+            uint32_t ev = events[i].events;
+
+            if (ev & EPOLLERR) {
+                conn_close(r, c);
+                continue;
+            }
+            /* EPOLLHUP/EPOLLRDHUP 时缓冲区中可能还有数据，交给 recv 读到 0 再关闭 */
+            if (ev & (EPOLLIN | EPOLLHUP | EPOLLRDHUP)) {
+                if (conn_on_readable(r, c, (ev & (EPOLLHUP | EPOLLRDHUP)) != 0) < 0) {
+                    continue;
+                }
+            }
+            if (ev & EPOLLOUT) {
+                conn_on_writable(r, c);
+            }
+        }
+    }
+
+    while (r->conns) {
+        conn_close(r, r->conns);
+    }
+    return NULL;
+}
+
+/*
+ * 运行事件驱动模式的服务器
+ */
+int run_event_server(int port, int threads) {
+    log_msg("Event mode: %d reactor(s), edge-triggered epoll, SO_REUSEPORT", threads);
+    raise_fd_limit();
+
+    Reactor *reactors = calloc(threads, sizeof(Reactor));
+    if (!reactors) {
+        perror("calloc() failed");
+        return 1;
+    }
+
+    /* 先在主线程中创建所有监听 socket，端口被占用时可以直接报错退出 */
+    for (int i = 0; i < threads; i++) {
+        reactors[i].id = i;
+        reactors[i].listen_fd = -1;
+        reactors[i].epoll_fd = -1;
+    }
+
+    int ok = 1;
+    for (int i = 0; i < threads && ok; i++) {
+        Reactor *r = &reactors[i];
+        r->listen_fd = create_reuseport_listener(port);
+        if (r->listen_fd < 0) {
+            ok = 0;
+            break;
+        }
+        r->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (r->epoll_fd < 0) {
+            perror("epoll_create1() failed");
+            ok = 0;
+            break;
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.ptr = NULL;
+        if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->listen_fd, &ev) < 0) {
+            perror("epoll_ctl() failed");
+            ok = 0;
+        }
+    }
+
+    int started = 0;
+    if (ok) {
+        printf("Server is running on port %d (event mode, %d reactors)\n", port, threads);
+        printf("Press Ctrl+C to stop\n");
+        printf("------------------------------------------\n\n");
+        fflush(stdout);
+
+        for (; started < threads; started++) {
+            if (pthread_create(&reactors[started].thread, NULL, reactor_main,
+                               &reactors[started]) != 0) {
+                perror("pthread_create() failed");
+                g_running = 0;
+                ok = 0;
+                break;
+            }
+        }
+    }
+
+    unsigned long accepted = 0, requests = 0, writes = 0;
+    for (int i = 0; i < started; i++) {
+        pthread_join(reactors[i].thread, NULL);
+        accepted += reactors[i].accepted;
+        requests += reactors[i].requests;
+        writes += reactors[i].writes;
+    }
+    v2_sessions_stop();
+    for (int i = 0; i < threads; i++) {
+        if (reactors[i].epoll_fd >= 0) close(reactors[i].epoll_fd);
+        if (reactors[i].listen_fd >= 0) close(reactors[i].listen_fd);
+    }
+    free(reactors);
+
+    if (started > 0) {
+        log_msg("Served %lu connection(s), %lu request(s) in %lu write(s)",
+                accepted, requests, writes);
+    }
+    log_msg("Server stopped.");
+    return ok ? 0 : 1;
+}
+
+/* ============================================
+ * io_uring 模式
+ * ============================================
+ *
+ * 与事件驱动模式相同的多 reactor 结构 (每个线程一个 ring 和一个 SO_REUSEPORT
+ * 监听 socket)，但不再是 "等待就绪 -> 调用 recv/send"，而是把 I/O 请求本身
+ * 交给内核，一次 io_uring_enter 提交所有新请求并取回所有完成:
+ *
+ *   - 多发 accept: 提交一次，每个新连接产生一个 CQE
+ *   - 多发 recv + 提供缓冲区环: 每个连接只提交一次 recv，数据到达时内核
+ *     从环中取一个缓冲区填入，CQE 中带缓冲区编号；处理完再放回环中
+ *   - 响应直接由 process_message() 写入注册的固定缓冲区 (每个槽放若干条
+ *     完整的 Message)，不再额外复制；槽中的数据足够多时用零拷贝发送
+ *     (SEND_ZC + 固定缓冲区，内核直接引用已经固定的页面)
+ *   - ECHO 零拷贝: 响应就是请求本身，只把接收缓冲区中的命令字节改成
+ *     RESP_OK，整段直接交给 send，发送完成后才把接收缓冲区放回环中
+ *
+ * 同一连接同时只有一个发送请求在途，保证响应顺序；在途期间产生的响应
+ * 排队，下一次用一个 sendmsg 合并发出。
+ */
+
+#define URING_ENTRIES       4096            /* SQ 大小 */
+#define URING_CQ_ENTRIES    16384           /* CQ 大小 (多发请求会产生大量 CQE) */
+#define URING_BUFS          2048            /* 提供缓冲区个数 (2 的幂) */
+#define URING_BUF_SIZE      4096            /* 每个接收缓冲区的大小 */
+#define URING_BGID          0               /* 提供缓冲区组号 */
+#define URING_SLOTS         256             /* 注册的响应槽个数 */
+#define URING_SLOT_MSGS     4               /* 每个响应槽能放的最大消息数 */
+#define URING_SLOT_SIZE     (URING_SLOT_MSGS * sizeof(Message))
+#define URING_IOV           16              /* 一次 sendmsg 最多合并的发送项 */
+#define URING_ZC_MIN        2048            /* 响应槽中的数据达到这么多才用零拷贝发送 */
+
+/* user_data = 连接指针 | 请求类型 (malloc 返回的地址低 3 位为 0) */
+enum {
+    UD_ACCEPT = 1,
+    UD_RECV,
+    UD_SEND,
+    UD_SEND_ZC,                 /* 零拷贝发送: user_data 是发送项而不是连接 */
+    UD_CANCEL,
+};
+#define UD_TYPE_MASK    7ULL
+
+/* 一段待发送的数据 */
+typedef struct SendItem {
+    char *base;
+    size_t len;
+    int slot;                   /* 注册的响应槽编号, -1=不是 */
+    int bid;                    /* 引用的接收缓冲区 (零拷贝回显), -1=不是 */
+    int heap;                   /* 响应槽用完时的后备内存，发送完释放 */
+    int busy;                   /* 包含在在途发送请求中，不能再追加 */
+    int zc_refs;                /* 还没收到通知的零拷贝发送数: 为 0 之前内核可能还在读 */
+    int sent;                   /* 已经发完，等待零拷贝通知后释放 */
+    struct UConn *conn;
+    struct SendItem *next;
+} SendItem;
+
+typedef struct UConn {
+    int fd;
+    char peer[INET_ADDRSTRLEN + 8];
+
+    /* 跨接收缓冲区的不完整消息 */
+    char partial[sizeof(Message)];
+    size_t partial_len;
+
+    SendItem *fill;             /* 正在填写的响应槽 */
+    SendItem *sendq;            /* 发送队列 (有序) */
+    SendItem *sendq_tail;
+    size_t queued;              /* 发送队列中的字节数 */
+    int inflight;               /* 在途发送请求包含的项数, 0=没有在途发送 */
+    int zc_pending;             /* 还没收到通知的零拷贝发送数 */
+    struct iovec iov[URING_IOV];    /* 在途 sendmsg 的参数，完成前不能修改 */
+    struct msghdr mh;
+
+    int recv_armed;             /* 多发 recv 还在生效 */
+    int paused;                 /* 背压: 已取消 recv，发送队列变短后重新提交 */
+    int starved;                /* 提供缓冲区用完: 有缓冲区放回后重新提交 */
+    int closing;                /* 收到 QUIT: 发完后关闭 */
+    int dead;                   /* 已经出错/关闭: 等待在途请求完成后释放 */
+
+    struct UConn *prev, *next;
+} UConn;
+
+typedef struct {
+    int id;
+    int listen_fd;
+    pthread_t thread;
+    uring_t ring;
+
+    /* 提供缓冲区环 */
+    struct io_uring_buf_ring *br;
+    char *bufs;
+    int buf_refs[URING_BUFS];   /* 引用该缓冲区的待发送项数 */
+    int br_pending;             /* 已放回但还没有发布的缓冲区数 */
+
+    /* 注册的响应槽 */
+    char *slots;
+    int slot_free[URING_SLOTS];
+    int nslot_free;
+    int fixed_send;             /* 使用固定缓冲区发送 (内核不支持时关闭) */
+    int ring_disabled;          /* ring 以禁用状态创建，需要在 reactor 线程中启用 */
+
+    SendItem *item_pool;        /* 空闲的 SendItem */
+    UConn *conns;
+    int nstarved;
+
+    unsigned long accepted;
+    unsigned long requests;
+    unsigned long sends;
+    unsigned long zc_echoes;
+} UReactor;
+
+static struct io_uring_sqe *ureactor_sqe(UReactor *r) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&r->ring);
+    while (sqe == NULL) {
+        /* SQ 满: 先把已有的请求交给内核 */
+        uring_submit_and_wait(&r->ring, 0, -1);
+        sqe = uring_get_sqe(&r->ring);
+    }
+    return sqe;
+}
+
+static void ureactor_arm_accept(UReactor *r) {
+    struct io_uring_sqe *sqe = ureactor_sqe(r);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = r->listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = UD_ACCEPT;
+}
+
+static void uconn_arm_recv(UReactor *r, UConn *c) {
+    struct io_uring_sqe *sqe = ureactor_sqe(r);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+    sqe->user_data = (uint64_t)(uintptr_t)c | UD_RECV;
+    c->recv_armed = 1;
+}
+
+static void uconn_cancel_recv(UReactor *r, UConn *c) {
+    struct io_uring_sqe *sqe = ureactor_sqe(r);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = (uint64_t)(uintptr_t)c | UD_RECV;
+    sqe->user_data = UD_CANCEL;
+}
+
+/*
+ * 把接收缓冲区放回环中 (本轮 CQE 处理完后统一发布)
+ */
+static void ureactor_recycle_buf(UReactor *r, int bid) {
+    uring_buf_ring_add(r->br, URING_BUFS - 1, r->br_pending,
+                       r->bufs + (size_t)bid * URING_BUF_SIZE, URING_BUF_SIZE, bid);
+    r->br_pending++;
+}
+
+static SendItem *ureactor_item(UReactor *r) {
+    SendItem *it = r->item_pool;
+    if (it) {
+        r->item_pool = it->next;
+    } else {
+        it = malloc(sizeof(SendItem));
+        if (!it) {
+            return NULL;
+        }
+    }
+    memset(it, 0, sizeof(*it));
+    it->slot = -1;
+    it->bid = -1;
+    return it;
+}
+
+/*
+ * 发送项用完: 归还响应槽或者接收缓冲区
+ */
+static void ureactor_release_item(UReactor *r, SendItem *it) {
+    if (it->slot >= 0) {
+        r->slot_free[r->nslot_free++] = it->slot;
+    } else if (it->heap) {
+        free(it->base);
+    }
+    if (it->bid >= 0 && --r->buf_refs[it->bid] == 0) {
+        ureactor_recycle_buf(r, it->bid);
+    }
+    it->next = r->item_pool;
+    r->item_pool = it;
+}
+
+static void uconn_enqueue(UConn *c, SendItem *it) {
+    it->next = NULL;
+    if (c->sendq_tail) c->sendq_tail->next = it;
+    else c->sendq = it;
+    c->sendq_tail = it;
+    c->queued += it->len;
+}
+
+/*
+ * 把正在填写的响应槽移到发送队列
+ */
+static void uconn_commit_fill(UReactor *r, UConn *c) {
+    SendItem *it = c->fill;
+    if (!it) {
+        return;
+    }
+    c->fill = NULL;
+    if (it->len == 0) {
+        ureactor_release_item(r, it);
+        return;
+    }
+    uconn_enqueue(c, it);
+}
+
+/*
+ * 在响应槽中为一条响应预留空间 (一条完整 Message 的大小)
+ */
+static Message *uconn_reserve(UReactor *r, UConn *c) {
+    if (c->fill && URING_SLOT_SIZE - c->fill->len >= sizeof(Message)) {
+        return (Message *)(c->fill->base + c->fill->len);
+    }
+    uconn_commit_fill(r, c);
+
+    SendItem *it = ureactor_item(r);
+    if (!it) {
+        return NULL;
+    }
+    if (r->nslot_free > 0) {
+        it->slot = r->slot_free[--r->nslot_free];
+        it->base = r->slots + (size_t)it->slot * URING_SLOT_SIZE;
+    } else {
+        it->base = malloc(URING_SLOT_SIZE);
+        it->heap = 1;
+        if (!it->base) {
+            ureactor_release_item(r, it);
+            return NULL;
+        }
+    }
+    c->fill = it;
+    return (Message *)it->base;
+}
+
+/*
+ * 没有在途发送时，把发送队列头部的若干项作为一个发送请求提交
+ */
+static void uconn_kick_send(UReactor *r, UConn *c) {
+    if (c->inflight || !c->sendq || c->dead) {
+        return;
+    }
+
+    struct io_uring_sqe *sqe = ureactor_sqe(r);
+    sqe->fd = c->fd;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uint64_t)(uintptr_t)c | UD_SEND;
+
+    SendItem *it = c->sendq;
+    if (it->next == NULL) {
+        /* 只有一项: 一个 send */
+        sqe->opcode = IORING_OP_SEND;
+        sqe->addr = (uint64_t)(uintptr_t)it->base;
+        sqe->len = it->len;
+        if (it->slot >= 0 && r->fixed_send && it->len >= URING_ZC_MIN) {
+            /*
+             * 注册的响应槽: 零拷贝发送，内核直接引用槽所在的已固定页面。
+             * 第一个 CQE 是发送结果，之后的通知 CQE 表示内核不再引用，
+             * 槽要等到通知之后才能重用。数据少时复制比这两步更便宜。
+             */
+            sqe->opcode = IORING_OP_SEND_ZC;
+            sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+            sqe->buf_index = 0;
+            sqe->user_data = (uint64_t)(uintptr_t)it | UD_SEND_ZC;
+            it->conn = c;
+            it->zc_refs++;
+            c->zc_pending++;
+        }
+        it->busy = 1;
+        c->inflight = 1;
+    } else {
+        /* 多项: 一个 sendmsg 合并发出 */
+        int n = 0;
+        for (; it && n < URING_IOV; it = it->next, n++) {
+            c->iov[n].iov_base = it->base;
+            c->iov[n].iov_len = it->len;
+            it->busy = 1;
+        }
+        memset(&c->mh, 0, sizeof(c->mh));
+        c->mh.msg_iov = c->iov;
+        c->mh.msg_iovlen = n;
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->addr = (uint64_t)(uintptr_t)&c->mh;
+        sqe->len = 1;
+        c->inflight = n;
+    }
+    r->sends++;
+}
+
+/*
+ * 连接出错或者发完 QUIT 之前的响应: 取消接收，在途请求全部完成后释放
+ */
+static void uconn_kill(UReactor *r, UConn *c) {
+    if (!c->dead) {
+        c->dead = 1;
+        log_verbose("[uring %d] Connection closed: %s", r->id, c->peer);
+        if (c->recv_armed) {
+            uconn_cancel_recv(r, c);
+        }
+        if (c->starved) {
+            c->starved = 0;
+            r->nstarved--;
+        }
+    }
+    if (c->recv_armed || c->inflight || c->zc_pending) {
+        return;
+    }
+
+    uconn_commit_fill(r, c);
+    while (c->sendq) {
+        SendItem *it = c->sendq;
+        c->sendq = it->next;
+        ureactor_release_item(r, it);
+    }
+    close(c->fd);
+
+    if (c->prev) c->prev->next = c->next;
+    else r->conns = c->next;
+    if (c->next) c->next->prev = c->prev;
+    free(c);
+}
+
+/*
+ * 处理一条完整的请求 (非零拷贝路径): 响应写入响应槽
+ * 返回: 0=正常, -1=需要关闭连接
+ */
+static int uconn_request(UReactor *r, UConn *c, const Message *req) {
+    log_verbose("[uring %d] Received [%s] from %s, len=%d", r->id,
+                command_name(req->header.cmd), c->peer, ntohs(req->header.length));
+    r->requests++;
+
+    Message *resp = uconn_reserve(r, c);
+    if (!resp) {
+        return -1;
+    }
+    int ret = process_message(req, resp);
+    if (ret == 1) {
+        c->closing = 1;
+        return 0;
+    }
+    if (ret == 2) {
+        /* v2 的 splice/sendfile 是阻塞的长操作，这个模式不支持:
+         * 回复版本 1，客户端继续使用 v1 */
+        uint8_t version = PROTO_V1;
+        set_response(resp, RESP_OK, &version, 1);
+    }
+    c->fill->len += message_size(resp);
+    return 0;
+}
+
+/*
+ * 处理一个接收缓冲区中的数据
+ * 返回: 0=正常, -1=需要关闭连接
+ */
+static int uconn_on_data(UReactor *r, UConn *c, char *buf, size_t len, int bid) {
+    size_t off = 0;
+
+    /* 先补全上一个缓冲区末尾的半条消息 (先凑齐消息头，才知道整条消息的长度) */
+    while (c->partial_len > 0 && off < len) {
+        size_t want = HEADER_SIZE;
+        if (c->partial_len >= HEADER_SIZE) {
+            want += ntohs(((MessageHeader *)c->partial)->length);
+        }
+        if (want > sizeof(c->partial)) {
+            return -1;
+        }
+        size_t n = want - c->partial_len;
+        if (n > len - off) {
+            n = len - off;
+        }
+        memcpy(c->partial + c->partial_len, buf + off, n);
+        c->partial_len += n;
+        off += n;
+
+        ssize_t frame = frame_length(c->partial, c->partial_len);
+        if (frame < 0) {
+            return -1;
+        }
+        if (frame > 0) {
+            c->partial_len = 0;
+            if (uconn_request(r, c, (const Message *)c->partial) < 0) {
+                return -1;
+            }
+        }
+    }
+
+    while (!c->closing) {
+        ssize_t frame = frame_length(buf + off, len - off);
+        if (frame == 0) {
+            break;
+        }
+        if (frame < 0) {
+            log_verbose("[uring %d] Invalid message length from %s", r->id, c->peer);
+            return -1;
+        }
+
+        MessageHeader *header = (MessageHeader *)(buf + off);
+        if (header->cmd == CMD_ECHO && c->queued < OUT_BUF_LIMIT) {
+            /* 零拷贝回显: 请求改一个字节就是响应 */
+            log_verbose("[uring %d] Received [ECHO] from %s, len=%d (zero-copy)",
+                        r->id, c->peer, ntohs(header->length));
+            r->requests++;
+            r->zc_echoes++;
+            header->cmd = RESP_OK;
+            uconn_commit_fill(r, c);
+
+            SendItem *last = c->sendq_tail;
+            if (last && last->bid == bid && !last->busy &&
+                last->base + last->len == buf + off) {
+                /* 与上一段相邻: 合并成一段 */
+                last->len += frame;
+                c->queued += frame;
+            } else {
+                SendItem *it = ureactor_item(r);
+                if (!it) {
+                    return -1;
+                }
+                it->base = buf + off;
+                it->len = frame;
+                it->bid = bid;
+                r->buf_refs[bid]++;
+                uconn_enqueue(c, it);
+            }
+        } else if (uconn_request(r, c, (const Message *)(buf + off)) < 0) {
+            return -1;
+        }
+        off += frame;
+    }
+
+    /* 剩下的半条消息复制出来，接收缓冲区可以尽快放回环中 */
+    if (!c->closing && off < len) {
+        memcpy(c->partial, buf + off, len - off);
+        c->partial_len = len - off;
+    }
+    return 0;
+}
+
+static void ureactor_on_accept(UReactor *r, struct io_uring_cqe *cqe) {
+    if (!(cqe->flags & IORING_CQE_F_MORE) && g_running) {
+        ureactor_arm_accept(r);     /* 多发 accept 结束了 (例如出错)，重新提交 */
+    }
+    if (cqe->res < 0) {
+        if (cqe->res != -ECANCELED) {
+            log_msg("[uring %d] accept failed: %s", r->id, strerror(-cqe->res));
+        }
+        return;
+    }
+
+    int fd = cqe->res;
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    UConn *c = calloc(1, sizeof(UConn));
+    if (!c) {
+        close(fd);
+        return;
+    }
+    c->fd = fd;
+    if (g_verbose) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        char ip[INET_ADDRSTRLEN] = "?";
+        if (getpeername(fd, (struct sockaddr *)&addr, &addr_len) == 0) {
+            inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+        }
+        snprintf(c->peer, sizeof(c->peer), "%s:%d", ip, ntohs(addr.sin_port));
+        log_msg("[uring %d] Client connected: %s (fd=%d)", r->id, c->peer, fd);
+    }
+
+    c->next = r->conns;
+    if (r->conns) r->conns->prev = c;
+    r->conns = c;
+    r->accepted++;
+
+    uconn_arm_recv(r, c);
+}
+
+static void ureactor_on_recv(UReactor *r, UConn *c, struct io_uring_cqe *cqe) {
+    int more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+    if (!more) {
+        c->recv_armed = 0;
+    }
+
+    if (c->dead) {
+        /* 取消之前已经收到的数据: 丢弃 */
+        if (cqe->flags & IORING_CQE_F_BUFFER) {
+            ureactor_recycle_buf(r, cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        }
+        uconn_kill(r, c);
+        return;
+    }
+
+    if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+        int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        char *buf = r->bufs + (size_t)bid * URING_BUF_SIZE;
+
+        int ret = uconn_on_data(r, c, buf, cqe->res, bid);
+        if (r->buf_refs[bid] == 0) {
+            ureactor_recycle_buf(r, bid);   /* 没有零拷贝发送引用它，立即放回 */
+        }
+        if (ret < 0) {
+            uconn_kill(r, c);
+            return;
+        }
+
+        uconn_commit_fill(r, c);
+        uconn_kick_send(r, c);
+
+        /* 背压: 发送队列过长时停止接收 */
+        if (c->queued > OUT_BUF_LIMIT && c->recv_armed && !c->paused) {
+            c->paused = 1;
+            uconn_cancel_recv(r, c);
+        }
+        if (c->closing && !c->sendq && !c->inflight) {
+            uconn_kill(r, c);
+            return;
+        }
+    } else if (cqe->res == -ENOBUFS) {
+        /* 提供缓冲区用完: 等其他连接放回缓冲区后再提交 */
+        if (!c->starved) {
+            c->starved = 1;
+            r->nstarved++;
+        }
+    } else if (cqe->res == -ECANCELED && c->paused) {
+        /* 背压取消，发送队列变短后重新提交 */
+    } else if (cqe->res <= 0) {
+        uconn_kill(r, c);       /* 0=对端关闭, <0=出错 */
+        return;
+    }
+
+    if (!more && !c->recv_armed && !c->paused && !c->starved && !c->closing) {
+        uconn_arm_recv(r, c);
+    }
+}
+
+static void ureactor_on_send(UReactor *r, UConn *c, struct io_uring_cqe *cqe) {
+    int items = c->inflight;
+    c->inflight = 0;
+
+    if (cqe->res == -EINVAL && items == 1 && c->sendq->slot >= 0 && r->fixed_send) {
+        /* 内核不支持零拷贝发送 (Linux 6.0 之前): 之后改用普通 send */
+        log_msg("[uring %d] zero-copy send not supported, falling back", r->id);
+        r->fixed_send = 0;
+        c->sendq->busy = 0;
+        uconn_kick_send(r, c);
+        return;
+    }
+    if (cqe->res < 0 || c->dead) {
+        uconn_kill(r, c);
+        return;
+    }
+
+    /* 释放已经发完的项，部分发送的项调整起点后重新发送 */
+    size_t n = cqe->res;
+    c->queued -= n;
+    while (c->sendq && n >= c->sendq->len) {
+        SendItem *it = c->sendq;
+        n -= it->len;
+        c->sendq = it->next;
+        if (!c->sendq) c->sendq_tail = NULL;
+        if (it->zc_refs > 0) {
+            it->sent = 1;       /* 内核还在引用: 等通知 */
+        } else {
+            ureactor_release_item(r, it);
+        }
+    }
+    if (n > 0 && c->sendq) {
+        c->sendq->base += n;
+        c->sendq->len -= n;
+    }
+    for (SendItem *it = c->sendq; it; it = it->next) {
+        it->busy = 0;
+    }
+
+    uconn_kick_send(r, c);
+
+    if (c->closing && !c->sendq && !c->inflight) {
+        uconn_kill(r, c);
+        return;
+    }
+    if (c->paused && c->queued <= OUT_BUF_LIMIT / 2 && !c->recv_armed) {
+        c->paused = 0;
+        uconn_arm_recv(r, c);
+    }
+}
+
+/*
+ * 零拷贝发送的 CQE: 发送结果 (之后还有通知时带 F_MORE) 或者通知 (F_NOTIF)
+ */
+static void ureactor_on_send_zc(UReactor *r, SendItem *it, struct io_uring_cqe *cqe) {
+    UConn *c = it->conn;
+
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        /* 通知，或者不会再有通知的发送结果 (例如出错): 内核不再引用 */
+        it->zc_refs--;
+        c->zc_pending--;
+    }
+    if (cqe->flags & IORING_CQE_F_NOTIF) {
+        if (it->sent && it->zc_refs == 0) {
+            ureactor_release_item(r, it);
+        }
+        if (c->dead) {
+            uconn_kill(r, c);
+        }
+        return;
+    }
+    ureactor_on_send(r, c, cqe);
+}
+
+static void *ureactor_main(void *arg) {
+    UReactor *r = arg;
+
+    /* ring 创建时处于禁用状态: 在这里启用，本线程成为它唯一的提交者 */
+    if (r->ring_disabled && uring_enable(&r->ring) < 0) {
+        log_msg("[uring %d] failed to enable ring: %s", r->id, strerror(errno));
+        g_running = 0;
+        return NULL;
+    }
+    ureactor_arm_accept(r);
+
+    while (g_running) {
+        /* 提交本轮产生的所有请求，等待至少一个完成 (超时用于检查 g_running) */
+        int ret = uring_submit_and_wait(&r->ring, 1, 500);
+        if (ret < 0 && ret != -ETIME && ret != -EINTR && ret != -EBUSY) {
+            log_msg("[uring %d] io_uring_enter failed: %s", r->id, strerror(-ret));
+            break;
+        }
+
+        unsigned head = uring_cq_head(&r->ring);
+        unsigned tail = uring_cq_tail(&r->ring);
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = uring_cqe_at(&r->ring, head);
+            int type = cqe->user_data & UD_TYPE_MASK;
+            void *ptr = (void *)(uintptr_t)(cqe->user_data & ~UD_TYPE_MASK);
+
+            switch (type) {
+                case UD_ACCEPT:  ureactor_on_accept(r, cqe); break;
+                case UD_RECV:    ureactor_on_recv(r, ptr, cqe); break;
+                case UD_SEND:    ureactor_on_send(r, ptr, cqe); break;
+                case UD_SEND_ZC: ureactor_on_send_zc(r, ptr, cqe); break;
+                default:         break;
+            }
+        }
+        uring_cq_advance_to(&r->ring, head);
+
+        /* 发布放回的接收缓冲区，然后唤醒等缓冲区的连接 */
+        if (r->br_pending > 0) {
+            uring_buf_ring_advance(r->br, r->br_pending);
+            r->br_pending = 0;
+
+            for (UConn *c = r->conns; c && r->nstarved > 0; c = c->next) {
+                if (c->starved) {
+                    c->starved = 0;
+                    r->nstarved--;
+                    if (!c->recv_armed && !c->paused && !c->dead) {
+                        uconn_arm_recv(r, c);
+                    }
+                }
+            }
+        }
+    }
+
+    /* 关闭 ring 会取消所有在途请求，之后可以直接释放连接 */
+    uring_exit(&r->ring);
+    r->ring.fd = -1;
+    while (r->conns) {
+        UConn *c = r->conns;
+        r->conns = c->next;
+        uconn_commit_fill(r, c);
+        while (c->sendq) {
+            SendItem *it = c->sendq;
+            c->sendq = it->next;
+            ureactor_release_item(r, it);
+        }
+        close(c->fd);
+        free(c);
+    }
+    return NULL;
+}
+
+/*
+ * 创建 ring、提供缓冲区环和注册的响应槽
+ */
+static int ureactor_init(UReactor *r, int port) {
+    r->listen_fd = create_reuseport_listener(port);
+    if (r->listen_fd < 0) {
+        return -1;
+    }
+
+    /*
+     * 只有一个线程提交 (SINGLE_ISSUER)，完成处理推迟到该线程调用 io_uring_enter
+     * 时进行 (DEFER_TASKRUN，不会在任意时刻打断 reactor)。提交者是第一个启用
+     * ring 的线程，所以先以禁用状态 (R_DISABLED) 创建，在这里完成注册。
+     * 旧内核不支持这些标志时退回默认设置。
+     */
+    int ret = uring_init(&r->ring, URING_ENTRIES, URING_CQ_ENTRIES,
+                         IORING_SETUP_SUBMIT_ALL | IORING_SETUP_SINGLE_ISSUER |
+                         IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_R_DISABLED);
+    r->ring_disabled = ret == 0;
+    if (ret == -EINVAL) {
+        ret = uring_init(&r->ring, URING_ENTRIES, URING_CQ_ENTRIES, 0);
+    }
+    if (ret < 0) {
+        log_msg("io_uring_setup failed: %s", strerror(-ret));
+        return -1;
+    }
+
+    r->bufs = malloc((size_t)URING_BUFS * URING_BUF_SIZE);
+    r->br = r->bufs ? uring_setup_buf_ring(&r->ring, URING_BUFS, URING_BGID, &ret) : NULL;
+    if (!r->br) {
+        log_msg("io_uring provided buffer ring unavailable (needs Linux 5.19+): %s",
+                strerror(-ret));
+        return -1;
+    }
+    for (int i = 0; i < URING_BUFS; i++) {
+        ureactor_recycle_buf(r, i);
+    }
+    uring_buf_ring_advance(r->br, r->br_pending);
+    r->br_pending = 0;
+
+    /* 响应槽注册为一个固定缓冲区 (buf_index 0)，失败时 (例如 RLIMIT_MEMLOCK) 照常工作 */
+    r->slots = malloc((size_t)URING_SLOTS * URING_SLOT_SIZE);
+    if (!r->slots) {
+        return -1;
+    }
+    for (int i = 0; i < URING_SLOTS; i++) {
+        r->slot_free[i] = URING_SLOTS - 1 - i;
+    }
+    r->nslot_free = URING_SLOTS;
+
+    struct iovec iov = { r->slots, (size_t)URING_SLOTS * URING_SLOT_SIZE };
+    ret = uring_register_buffers(&r->ring, &iov, 1);
+    r->fixed_send = ret == 0;
+    if (ret < 0) {
+        log_msg("  -> [uring %d] fixed buffers not registered: %s", r->id, strerror(-ret));
+    }
+    return 0;
+}
+
+static void ureactor_destroy(UReactor *r) {
+    while (r->item_pool) {
+        SendItem *it = r->item_pool;
+        r->item_pool = it->next;
+        free(it);
+    }
+    if (r->br) munmap(r->br, URING_BUFS * sizeof(struct io_uring_buf));
+    free(r->bufs);
+    free(r->slots);
+    if (r->listen_fd >= 0) close(r->listen_fd);
+}
+
+/*
+ * 运行 io_uring 模式的服务器
+ */
+int run_uring_server(int port, int threads) {
+    log_msg("io_uring mode: %d reactor(s), multishot accept/recv, provided buffers", threads);
+    raise_fd_limit();
+
+    UReactor *reactors = calloc(threads, sizeof(UReactor));
+    if (!reactors) {
+        perror("calloc() failed");
+        return 1;
+    }
+    for (int i = 0; i < threads; i++) {
+        reactors[i].id = i;
+        reactors[i].listen_fd = -1;
+        reactors[i].ring.fd = -1;
+    }
+
+    /* 先在主线程中完成所有初始化，失败时直接退出 */
+    int ok = 1;
+    for (int i = 0; i < threads && ok; i++) {
+        if (ureactor_init(&reactors[i], port) < 0) {
+            ok = 0;
+        }
+    }
+
+    int started = 0;
+    if (ok) {
+        printf("Server is running on port %d (io_uring mode, %d reactors)\n", port, threads);
+        printf("Press Ctrl+C to stop\n");
+        printf("------------------------------------------\n\n");
+        fflush(stdout);
+
+        for (; started < threads; started++) {
+            if (pthread_create(&reactors[started].thread, NULL, ureactor_main,
+                               &reactors[started]) != 0) {
+                perror("pthread_create() failed");
+                g_running = 0;
+                ok = 0;
+                break;
+            }
+        }
+    }
+
+    unsigned long accepted = 0, requests = 0, sends = 0, zc = 0;
+    for (int i = 0; i < started; i++) {
+        pthread_join(reactors[i].thread, NULL);
+        accepted += reactors[i].accepted;
+        requests += reactors[i].requests;
+        sends += reactors[i].sends;
+        zc += reactors[i].zc_echoes;
+    }
+    for (int i = 0; i < threads; i++) {
+        if (reactors[i].ring.fd >= 0) {
+            uring_exit(&reactors[i].ring);
+        }
+        ureactor_destroy(&reactors[i]);
+    }
+    free(reactors);
+
+    if (started > 0) {
+        log_msg("Served %lu connection(s), %lu request(s) (%lu zero-copy echo) in %lu send(s)",
+                accepted, requests, zc, sends);
+    }
+    log_msg("Server stopped.");
+    return ok ? 0 : 1;
+}
+
+/* ============================================
+ * 主函数
+ * ============================================ */
+
+void print_usage(const char *prog) {
+    printf("Usage: %s [-p port] [-e | -u] [-t threads] [-q] [-L plugin.so]...\n", prog);
+    printf("Options:\n");
+    printf("  -p port     Server port (default: %d)\n", DEFAULT_PORT);
+    printf("  -e          Event mode: edge-triggered epoll, one reactor per thread\n");
+    printf("              (v2 sessions run on blocking threads, at most %d at a time;\n"
+           "              further HELLO v2 requests are answered with v1)\n", V2_MAX_SESSIONS);
+    printf("  -u          io_uring mode: multishot accept/recv, provided and fixed buffers\n");
+    printf("  -t threads  Reactor threads in event/io_uring mode (default: online CPUs)\n");
+    printf("  -q          Quiet: no per-connection / per-request logs\n");
+    printf("  -L plugin   Load command handlers from a plugin (repeatable, SIGHUP reloads)\n");
+    printf("  -h          Show this help\n");
+}
+
+int main(int argc, char *argv[]) {
+    int port = DEFAULT_PORT;
+    int event_mode = 0;
+    int uring_mode = 0;
+    int threads = 0;
+    const char *plugins[MAX_PLUGINS];
+    int nplugins = 0;
+    int opt;
+
+    /* 解析命令行参数 */
+    while ((opt = getopt(argc, argv, "p:eut:qL:h")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'e':
+                event_mode = 1;
+                break;
+            case 'u':
+                uring_mode = 1;
+                break;
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 'q':
+                g_verbose = 0;
+                break;
+            case 'L':
+                if (nplugins == MAX_PLUGINS) {
+                    fprintf(stderr, "Too many plugins (max %d)\n", MAX_PLUGINS);
+                    return 1;
+                }
+                plugins[nplugins++] = optarg;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    /* 设置信号处理 */
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    /* splice/sendfile 没有 MSG_NOSIGNAL，对端关闭时靠 EPIPE 返回 */
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("==========================================\n");
+    printf("     Mini Socket Server - 教学示例\n");
+    printf("==========================================\n\n");
+
+    /* 加载命令插件 (链接器自己的日志只保留警告和错误) */
+    if (nplugins > 0) {
+        log_init();
+        log_set_level(LOG_LEVEL_WARN);
+        linker_init();
+        for (int i = 0; i < nplugins; i++) {
+            if (plugin_load(plugins[i]) < 0) {
+                return 1;
+            }
+        }
+        if (plugin_start_reloader() < 0) {
+            return 1;
+        }
+    }
+
+    if (event_mode || uring_mode) {
+        if (threads <= 0) {
+            long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+            threads = ncpu > 0 ? (int)ncpu : 1;
+        }
+        return uring_mode ? run_uring_server(port, threads) : run_event_server(port, threads);
+    }
 
     /*
      * ========================================
@@ -401,7 +2717,7 @@ int main(int argc, char *argv[]) {
         struct sockaddr_in client_addr;
         socklen_t client_len = sizeof(client_addr);
 
-        log_msg("Waiting for new connection...");
+        log_verbose("Waiting for new connection...");
         int client_fd = accept(g_server_fd, (struct sockaddr *)&client_addr, &client_len);
 
         if (client_fd < 0) {
@@ -0,0 +1,246 @@
+/*
+ * uring.h - io_uring 的最小封装 (直接使用系统调用，不依赖 liburing)
+ *
+ * io_uring 由内核和用户态共享的两个环形队列组成:
+ *   SQ (提交队列): 用户态填写 SQE (请求)，推进 tail，内核消费
+ *   CQ (完成队列): 内核填写 CQE (结果)，推进 tail，用户态消费后推进 head
+ * 一次 io_uring_enter 可以提交任意多个请求并等待完成，
+ * 多发 (multishot) 请求提交一次可以产生任意多个 CQE。
+ *
+ * 队列只由一个线程操作 (每个 reactor 一个 ring)，这里不处理多线程提交。
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+typedef struct {
+    int fd;
+    unsigned features;
+
+    /* SQ */
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    struct io_uring_sqe *sqes;
+    unsigned sqe_tail;          /* 已经分配出去的 SQE */
+    unsigned sqe_submitted;     /* 已经交给内核的 SQE */
+
+    /* CQ */
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *ring_ptr;
+    size_t ring_size;
+    size_t sqes_size;
+} uring_t;
+
+/*
+ * 创建 ring
+ * 返回: 0=成功, -errno=失败
+ */
+static inline int uring_init(uring_t *ring, unsigned entries, unsigned cq_entries, unsigned flags) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+    p.flags = flags | IORING_SETUP_CQSIZE;
+    p.cq_entries = cq_entries;
+
+    int fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0) {
+        return -errno;
+    }
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        close(fd);
+        return -ENOSYS;     /* Linux 5.4 之前的内核 */
+    }
+
+    /* SQ 和 CQ 的环共用一次映射，SQE 数组单独映射 */
+    size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    ring->ring_ptr = mmap(NULL, ring->ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->ring_ptr == MAP_FAILED) {
+        int err = -errno;
+        close(fd);
+        return err;
+    }
+
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        int err = -errno;
+        munmap(ring->ring_ptr, ring->ring_size);
+        close(fd);
+        return err;
+    }
+
+    char *base = ring->ring_ptr;
+    ring->fd = fd;
+    ring->features = p.features;
+    ring->sq_head = (unsigned *)(base + p.sq_off.head);
+    ring->sq_tail = (unsigned *)(base + p.sq_off.tail);
+    ring->sq_mask = *(unsigned *)(base + p.sq_off.ring_mask);
+    ring->sq_entries = p.sq_entries;
+    ring->cq_head = (unsigned *)(base + p.cq_off.head);
+    ring->cq_tail = (unsigned *)(base + p.cq_off.tail);
+    ring->cq_mask = *(unsigned *)(base + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(base + p.cq_off.cqes);
+
+    /* SQ 的间接数组固定为恒等映射: 第 i 个槽就是第 i 个 SQE */
+    unsigned *array = (unsigned *)(base + p.sq_off.array);
+    for (unsigned i = 0; i < p.sq_entries; i++) {
+        array[i] = i;
+    }
+    return 0;
+}
+
+static inline void uring_exit(uring_t *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    munmap(ring->ring_ptr, ring->ring_size);
+    close(ring->fd);
+}
+
+/*
+ * 启用以 IORING_SETUP_R_DISABLED 创建的 ring
+ * 调用线程成为 IORING_SETUP_SINGLE_ISSUER 的唯一提交者
+ */
+static inline int uring_enable(uring_t *ring) {
+    return syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_ENABLE_RINGS, NULL, 0);
+}
+
+/*
+ * 取一个空闲的 SQE (已清零)
+ * 返回: NULL=SQ 已满，需要先提交
+ */
+static inline struct io_uring_sqe *uring_get_sqe(uring_t *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sqe_tail - head >= ring->sq_entries) {
+        return NULL;
+    }
+    struct io_uring_sqe *sqe = &ring->sqes[ring->sqe_tail & ring->sq_mask];
+    ring->sqe_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+/*
+ * 提交所有已填写的 SQE，并等待至少 wait_nr 个完成
+ * timeout_ms >= 0 时最多等待这么久 (需要 IORING_FEAT_EXT_ARG)
+ * 返回: 提交的数量, -errno=失败 (-ETIME=超时, -EINTR=被信号打断)
+ */
+static inline int uring_submit_and_wait(uring_t *ring, unsigned wait_nr, int timeout_ms) {
+    unsigned to_submit = ring->sqe_tail - ring->sqe_submitted;
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+
+    unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    void *argp = NULL;
+    size_t argsz = 0;
+
+    if (wait_nr > 0 && timeout_ms >= 0 && (ring->features & IORING_FEAT_EXT_ARG)) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+        memset(&arg, 0, sizeof(arg));
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        argp = &arg;
+        argsz = sizeof(arg);
+        flags |= IORING_ENTER_EXT_ARG;
+    }
+
+    int ret = syscall(__NR_io_uring_enter, ring->fd, to_submit, wait_nr, flags, argp, argsz);
+    if (ret < 0) {
+        return -errno;
+    }
+    ring->sqe_submitted += ret;
+    return ret;
+}
+
+/*
+ * 遍历 CQ: head 由用户态独占，tail 由内核推进
+ */
+static inline unsigned uring_cq_head(uring_t *ring) {
+    return *ring->cq_head;
+}
+
+static inline unsigned uring_cq_tail(uring_t *ring) {
+    return __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+}
+
+static inline struct io_uring_cqe *uring_cqe_at(uring_t *ring, unsigned index) {
+    return &ring->cqes[index & ring->cq_mask];
+}
+
+static inline void uring_cq_advance_to(uring_t *ring, unsigned head) {
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/*
+ * 注册固定缓冲区: 内核预先固定这些页，之后的 I/O 不需要每次再固定用户页
+ */
+static inline int uring_register_buffers(uring_t *ring, const struct iovec *iov, unsigned count) {
+    int ret = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, iov, count);
+    return ret < 0 ? -errno : 0;
+}
+
+/*
+ * 注册提供缓冲区环 (provided buffer ring)
+ * 接收请求不指定缓冲区，数据到达时由内核从环中取一个，在 CQE 中返回编号
+ * 返回: 环的地址, NULL=失败 (*err 为 -errno)
+ */
+static inline struct io_uring_buf_ring *uring_setup_buf_ring(uring_t *ring, unsigned entries,
+                                                             int bgid, int *err) {
+    size_t size = entries * sizeof(struct io_uring_buf);
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        *err = -errno;
+        return NULL;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)mem;
+    reg.ring_entries = entries;
+    reg.bgid = bgid;
+
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        *err = -errno;
+        munmap(mem, size);
+        return NULL;
+    }
+    return mem;
+}
+
+/*
+ * 把缓冲区放回环中 (offset: 本批中的第几个)，之后用 uring_buf_ring_advance 一次发布
+ */
+static inline void uring_buf_ring_add(struct io_uring_buf_ring *br, unsigned mask, int offset,
+                                      void *addr, unsigned len, unsigned short bid) {
+    struct io_uring_buf *buf = &br->bufs[(br->tail + offset) & mask];
+    buf->addr = (uint64_t)(uintptr_t)addr;
+    buf->len = len;
+    buf->bid = bid;
+}
+
+static inline void uring_buf_ring_advance(struct io_uring_buf_ring *br, int count) {
+    __atomic_store_n(&br->tail, (unsigned short)(br->tail + count), __ATOMIC_RELEASE);
+}
+
+#endif /* URING_H */
@@ -0,0 +1,59 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// 链接器内部的内存分配器
+//
+// arena: 按块（chunk）顺序分配，不能单独释放，arena_release 时整体释放。
+//        每个库一个 arena，存放名字、依赖列表、程序头副本等随库一起
+//        消亡的数据：卸载时一次释放，不必逐个 free，数据也集中在少数几块内存中。
+//
+// pool:  固定大小对象的池，对象成批（slab）分配、释放后放入空闲链表复用。
+//        所有 soinfo 都从同一个池分配，彼此相邻，遍历时缓存更友好。
+//
+// 两者都不是线程安全的：pool 由链接器的写者锁保护；
+// 每个库的 arena 只被加载该库的线程（或者映射它的工作线程）使用。
+
+typedef struct arena_chunk arena_chunk_t;
+
+typedef struct {
+    arena_chunk_t* head;        // 当前块（块之间单向链接）
+    size_t chunk_size;          // 新块的默认大小
+} arena_t;
+
+typedef struct {
+    size_t obj_size;            // 对象大小（向上对齐到 16 字节）
+    size_t per_slab;            // 每个 slab 的对象数
+    void* free_list;            // 空闲对象链表（链指针存在对象自己的开头）
+    arena_t slabs;              // slab 从这里分配（对象池存在期间不释放）
+} pool_t;
+
+// 初始化 arena（不分配内存，第一次 arena_alloc 时才分配块）
+void arena_init(arena_t* arena, size_t chunk_size);
+
+// 分配清零的内存（16 字节对齐），失败返回 NULL
+// 超过块大小的请求单独分配一块
+void* arena_alloc(arena_t* arena, size_t size);
+
+// 复制字符串到 arena 中，失败返回 NULL
+char* arena_strdup(arena_t* arena, const char* s);
+
+// 释放 arena 的所有块（之后可以继续使用）
+void arena_release(arena_t* arena);
+
+// 静态初始化对象池（与 pool_init 等价）
+#define POOL_INITIALIZER(obj_size, per_slab) \
+    { (((obj_size) + 15) & ~(size_t)15), (per_slab), NULL, \
+      { NULL, ((((obj_size) + 15) & ~(size_t)15) * (per_slab)) } }
+
+// 初始化对象池
+void pool_init(pool_t* pool, size_t obj_size, size_t per_slab);
+
+// 分配一个清零的对象，失败返回 NULL
+void* pool_alloc(pool_t* pool);
+
+// 归还对象
+void pool_free(pool_t* pool, void* obj);
+
+#endif // ARENA_H
@@ -2,37 +2,57 @@
 #define ELF_PARSER_H
 
 #include <elf.h>
+#include "linker_arch.h"
 #include <stdint.h>
 #include <stddef.h>
+#include <sys/types.h>
 
 // ELF 文件信息结构
 typedef struct {
     int fd;                     // 文件描述符
     void* map_start;            // mmap 起始地址
     size_t map_size;            // mmap 大小
-    Elf64_Ehdr* ehdr;           // ELF 头
-    Elf64_Phdr* phdr;           // 程序头表
-    Elf64_Shdr* shdr;           // 节头表
+    ElfW(Ehdr)* ehdr;           // ELF 头
+    ElfW(Phdr)* phdr;           // 程序头表
+    ElfW(Shdr)* shdr;           // 节头表
     const char* shstrtab;       // 节字符串表
 } elf_file_t;
 
-// 解析 ELF 文件
+// 加载时一次 pread 读取的大小，通常能覆盖 ELF 头和整个程序头表
+#define ELF_HEADER_READ_SIZE 1024
+
+// 加载用的 ELF 头信息：只包含 ELF 头和程序头表
+typedef struct {
+    ElfW(Ehdr)* ehdr;           // ELF 头（指向 buf）
+    ElfW(Phdr)* phdr;           // 程序头表（指向 buf 或 phdr_alloc）
+    void* phdr_alloc;           // 程序头表不在 buf 内时单独分配的内存
+    _Alignas(ElfW(Ehdr)) uint8_t buf[ELF_HEADER_READ_SIZE];
+} elf_header_t;
+
+// 从已打开的文件读取 ELF 头和程序头表（不映射文件）
+// offset: ELF 在文件中的起始偏移（普通 .so 文件为 0）
+int elf_read_header(int fd, off_t offset, elf_header_t* hdr);
+
+// 释放 elf_read_header 分配的内存
+void elf_header_release(elf_header_t* hdr);
+
+// 解析 ELF 文件（映射整个文件，包括节头表，供 elf_print_info 等工具使用）
 int elf_open(const char* path, elf_file_t* elf);
 
 // 关闭 ELF 文件
 void elf_close(elf_file_t* elf);
 
 // 验证 ELF 头
-int elf_validate_header(const Elf64_Ehdr* ehdr);
+int elf_validate_header(const ElfW(Ehdr)* ehdr);
 
 // 查找程序头
-Elf64_Phdr* elf_find_phdr(elf_file_t* elf, uint32_t type);
+ElfW(Phdr)* elf_find_phdr(elf_file_t* elf, uint32_t type);
 
 // 查找节
-Elf64_Shdr* elf_find_section(elf_file_t* elf, const char* name);
+ElfW(Shdr)* elf_find_section(elf_file_t* elf, const char* name);
 
 // 获取节数据
-void* elf_get_section_data(elf_file_t* elf, Elf64_Shdr* shdr);
+void* elf_get_section_data(elf_file_t* elf, ElfW(Shdr)* shdr);
 
 // 打印 ELF 信息（调试用）
 void elf_print_info(elf_file_t* elf);
@@ -5,10 +5,32 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <time.h>
+#include "linker_arch.h"
+#include "linker_stats.h"
+#include "arena.h"
+
+// 版本索引对应的版本（由 DT_VERDEF / DT_VERNEED 展开）
+typedef struct symbol_version {
+    const char* name;           // 版本名（指向库的字符串表），NULL 表示该索引未使用
+    uint32_t hash;              // 版本名的 ELF hash（vd_hash / vna_hash）
+    bool defined;               // 来自 DT_VERDEF（本库定义）还是 DT_VERNEED（本库依赖）
+} symbol_version_t;
 
 // SO 库信息结构（模仿 Android 的 soinfo）
 typedef struct soinfo {
-    char name[256];             // 库名
+    const char* name;           // 库名（打开时使用的路径，保存在 arena 中）
+    const char* soname;         // DT_SONAME（可能为 NULL）
+    const char* runpath;        // DT_RUNPATH，没有时取 DT_RPATH（依赖搜索路径）
+
+    // 文件身份（用于去重：不同路径指向同一文件时只加载一次）
+    dev_t st_dev;
+    ino_t st_ino;
+    off_t file_offset;          // ELF 在文件中的起始偏移（从 fd 加载打包文件时非 0）
+    off_t st_size;              // 文件大小和修改时间（重定位缓存用来判断文件是否变化）
+    struct timespec st_mtim;
 
     // 加载信息
     void* base;                 // 加载基地址
@@ -16,24 +38,58 @@ typedef struct soinfo {
     void* load_bias;            // 加载偏移（实际加载地址 - 期望地址）
 
     // ELF 结构
-    Elf64_Phdr* phdr;           // 程序头表（映射后的地址）
+    ElfW(Phdr)* phdr;           // 程序头表（映射后的地址）
     size_t phnum;               // 程序头数量
-    Elf64_Dyn* dynamic;         // 动态段
+    ElfW(Phdr)* phdr_copy;      // 程序头表不在任何段内时的副本（否则为 NULL）
+    ElfW(Dyn)* dynamic;         // 动态段
+    void* relro_start;          // PT_GNU_RELRO 覆盖的整页（重定位完成后设为只读，NULL 表示没有）
+    size_t relro_size;
+
+    // 线程局部存储（PT_TLS）
+    bool has_tls;               // 是否有 PT_TLS 段
+    bool tls_static_required;   // DF_STATIC_TLS：代码用 initial-exec 模型访问，必须放入静态 TLS
+    bool tls_static;            // TLS 块是否在静态 TLS 区中
+    const void* tls_image;      // 初始化镜像（.tdata）
+    size_t tls_filesz;          // 镜像大小，其余部分（.tbss）为零
+    size_t tls_memsz;           // TLS 块大小
+    size_t tls_align;           // TLS 块对齐
+    size_t tls_module;          // TLS 模块 ID（0 表示未注册）
+    ptrdiff_t tls_tp_offset;    // 静态 TLS 块相对线程指针的偏移（tls_static 时有效）
 
     // 符号表
-    Elf64_Sym* symtab;          // 符号表
+    ElfW(Sym)* symtab;          // 符号表
     const char* strtab;         // 字符串表
     size_t strtab_size;         // 字符串表大小
+    size_t symbol_count;        // 动态符号表条目数（第一次用到时计算，0 表示未计算）
+    struct flat_symtab* flat_symtab;    // 平铺符号表（惰性构建，NULL 表示尚未构建）
+    struct addr_symtab* addr_symtab;    // 按地址排序的符号（地址反查时惰性构建）
 
     // 哈希表（用于符号查找加速）
     uint32_t* hash;             // ELF hash
     uint32_t* gnu_hash;         // GNU hash（可选）
 
+    // 符号版本（.gnu.version / .gnu.version_d / .gnu.version_r）
+    ElfW(Half)* versym;         // DT_VERSYM：每个动态符号的版本索引（NULL 表示没有版本信息）
+    ElfW(Verdef)* verdef;       // DT_VERDEF：本库定义的版本
+    size_t verdef_count;        // DT_VERDEFNUM
+    ElfW(Verneed)* verneed;     // DT_VERNEED：本库依赖的版本
+    size_t verneed_count;       // DT_VERNEEDNUM
+    symbol_version_t* versions; // 版本索引 -> 版本（在 arena 中，没有版本信息时为 NULL）
+    size_t version_count;       // 最大版本索引 + 1
+
     // 重定位表
-    Elf64_Rela* rela;           // RELA 重定位表
+    linker_rel_t* rela;         // .rela.dyn（ARM32 为 .rel.dyn）
     size_t rela_count;          // RELA 条目数
-    Elf64_Rela* plt_rela;       // PLT RELA 重定位表
+    size_t relative_count;      // DT_RELACOUNT / DT_RELCOUNT：表开头的 RELATIVE 条目数
+    ElfW(Relr)* relr;           // DT_RELR 压缩的相对重定位（位图格式）
+    size_t relr_count;          // RELR 条目数
+    const uint8_t* android_rela;    // DT_ANDROID_RELA 打包重定位（APS2 格式）
+    size_t android_rela_size;       // 打包数据字节数
+    linker_rel_t* plt_rela;     // .rela.plt（ARM32 为 .rel.plt）
     size_t plt_rela_count;      // PLT RELA 条目数
+    ElfW(Addr)* plt_got;        // DT_PLTGOT（.got.plt 起始地址）
+    bool bind_now;              // DF_BIND_NOW / DF_1_NOW：库要求立即绑定
+    bool lazy_bound;            // PLT 是否采用延迟绑定
 
     // 初始化/析构函数
     void (*init_func)(void);    // DT_INIT
@@ -43,41 +99,271 @@ typedef struct soinfo {
     void (**fini_array)(void);  // DT_FINI_ARRAY
     size_t fini_array_count;    // DT_FINI_ARRAYSZ
 
-    // 引用计数
+    // 依赖关系（DT_NEEDED）
+    struct soinfo** needed;     // 由 mini linker 加载的依赖库
+    size_t needed_count;
+    void** system_needed;       // 委托给系统 dlopen 的依赖库句柄
+    size_t system_needed_count;
+
+    // 引用计数（dlopen 句柄数 + 依赖它的库数）
     int ref_count;
+    bool init_called;           // 构造函数是否已经执行（或已进入调度）
+    bool init_deferred;         // 构造函数推迟到第一次 dlsym（MINI_RTLD_DEFERRED_INIT）
+    uint32_t init_mark;         // 构造函数调度的代数，等于当前代数时 init_node 有效
+    size_t init_node;           // 在调度图中的节点下标
 
-    // 链表
+    // 双向链表（按加载顺序排列，也就是全局符号搜索顺序）
+    // 读者只沿 next 遍历；prev 只由写者使用，摘除节点时不必从头查找
     struct soinfo* next;
+    struct soinfo* prev;
+
+    // 已加载库索引的哈希链
+    struct soinfo* name_hash_next;
+    struct soinfo* inode_hash_next;
+
+    // 加载统计（并行任务用原子加法累加）
+    linker_stats_t stats;
+
+    // 随库一起释放的数据（名字、依赖数组、程序头副本）
+    arena_t arena;
 } soinfo_t;
 
+// 已加载库索引的桶数（2 的幂）
+#define LINKER_INDEX_BUCKETS 256
+
+// 符号查找键：符号名 + 惰性计算的 hash
+// 一次跨多个库的查找只计算一次 hash，而不是每个库各算一遍
+typedef struct {
+    const char* name;           // 符号名
+    const char* version;        // 要求的版本（NULL 表示默认版本，即不带 HIDDEN 位的定义）
+    uint32_t version_hash;      // 版本名的 ELF hash（version 非 NULL 时有效）
+    uint32_t len;               // 名字长度（has_len 为真时有效，与 GNU hash 一起计算）
+    uint32_t gnu_hash;          // GNU hash（has_gnu_hash 为真时有效）
+    uint32_t elf_hash;          // SysV ELF hash（has_elf_hash 为真时有效）
+    bool has_gnu_hash;
+    bool has_elf_hash;
+    bool has_len;
+    bool per_thread;            // 输出：找到的是 TLS 变量（地址属于调用线程，不能缓存）
+} symbol_name_t;
+
+// 平铺符号表槽位：只放比较需要的字段，4 个槽位正好一条缓存行
+typedef struct {
+    uint32_t hash;              // GNU hash
+    uint32_t len;               // 名字长度
+    const char* name;           // 名字（指向库的字符串表），NULL 表示空槽位
+} flat_symbol_slot_t;
+
+// 每个库的平铺符号表（开放寻址，只包含已定义的 GLOBAL/WEAK 符号）
+typedef struct flat_symtab {
+    size_t mask;                // 槽位数 - 1
+    uint32_t shift;             // 32 - log2(槽位数)：起始槽位取乘法散列的高位
+    uint32_t bloom_size;        // 库的 GNU hash bloom filter（bloom 为 NULL 时不使用）
+    uint32_t bloom_shift;
+    const uint64_t* bloom;
+    size_t count;               // 符号数
+    size_t tls_count;           // 不在表中的 TLS 符号数（非 0 时未命中要再查 hash 表）
+    void** addrs;               // 与 slots 一一对应的符号地址（命中后才访问）
+    flat_symbol_slot_t slots[];
+} flat_symtab_t;
+
+// 地址反查用的符号：按 value 排序，同一地址只保留一个
+typedef struct {
+    ElfW(Addr) value;           // st_value（相对 load_bias）
+    ElfW(Addr) size;            // st_size，0 表示延伸到下一个符号
+    uint32_t sym;               // 动态符号表下标
+} addr_symbol_t;
+
+// 每个库的地址排序符号数组（只包含已定义的非局部符号）
+typedef struct addr_symtab {
+    size_t count;
+    addr_symbol_t syms[];
+} addr_symtab_t;
+
+// 全局地址索引的一项：一个库映射的地址范围 [start, end)
+typedef struct {
+    uintptr_t start;
+    uintptr_t end;
+    struct soinfo* si;
+} addr_range_t;
+
+// 全局地址索引（按 start 排序，各范围互不重叠，通过 RCU 整体发布和替换）
+typedef struct {
+    size_t count;
+    addr_range_t ranges[];
+} addr_index_t;
+
+// 全局查找范围的一项：只放全局符号查找需要的字段，正好一条缓存行
+// 按加载顺序排成连续数组，全局查找顺序访问，bloom filter 排除时只读这一项
+// 和一个 bloom 字，不必再沿着 soinfo 链表跳转
+typedef struct {
+    const uint64_t* bloom;      // GNU hash 的 bloom filter（NULL 表示没有 GNU hash），bucket 数组紧随其后
+    const uint32_t* chain;      // 已经减去 symoffset，可以直接用符号下标访问
+    const ElfW(Sym)* symtab;
+    const char* strtab;
+    const ElfW(Half)* versym;   // 版本索引（NULL 表示没有版本信息）
+    struct soinfo* si;          // 命中时取 load_bias；没有 GNU hash 时退回 linker_find_symbol_ex
+    uint32_t bloom_size;
+    uint32_t bloom_shift;
+    uint32_t nbuckets;
+} __attribute__((aligned(64))) lookup_entry_t;
+
+// 全局查找范围（已加载库链表的快照，通过 RCU 整体发布和替换）
+typedef struct {
+    size_t count;
+    lookup_entry_t entries[];
+} lookup_scope_t;
+
+// 全局符号缓存条目（符号名 hash -> 解析结果）
+typedef struct {
+    uint32_t hash;              // 符号名的 GNU hash
+    uint16_t state;             // 槽位状态：空 / 有效 / 已失效（最后写入，读者据此判断）
+    uint16_t source;            // 查找来源（linker_lookup_kind_t），用于统计
+    char* name;                 // 符号名副本（由缓存持有）
+    void* addr;                 // 解析结果，NULL 表示负缓存（查找失败）
+} symcache_entry_t;
+
+// 全局符号缓存表（开放寻址哈希表，整体通过 RCU 发布和替换）
+typedef struct {
+    size_t capacity;            // 槽位数（2 的幂）
+    size_t used;                // 已占用槽位数（含已失效条目）
+    symcache_entry_t entries[]; // 槽位数组
+} symcache_table_t;
+
+// 稳定符号槽：调用者保存槽的地址，每次调用前读取 addr
+// 热替换时 addr 被原子地改为新版本中的地址，槽本身的地址不变
+typedef struct linker_slot {
+    void* addr;                 // 当前地址（必须是第一个字段，槽的地址就是 &addr）
+    struct soinfo* owner;       // 地址所属的库（热替换时转移到新版本）
+    struct linker_slot* next;   // 所有槽的单向链表（由写者锁保护）
+    char name[];                // 符号名
+} linker_slot_t;
+
 // 全局链接器状态
 typedef struct {
-    soinfo_t* soinfo_list;      // 已加载库链表
-    char error_msg[512];        // 错误信息
-    bool has_error;             // 是否有错误
+    soinfo_t* soinfo_list;      // 已加载库链表（按加载顺序）
+    soinfo_t* soinfo_tail;      // 链表尾部（追加时不必遍历）
+    lookup_scope_t* scope;      // 链表的紧凑快照，全局符号查找只访问它
+    addr_index_t* addr_index;   // 已加载库的地址范围（地址反查只访问它）
+    uint64_t adds;              // 加入链表的库的累计个数（dl_iterate_phdr 的 dlpi_adds）
+    uint64_t subs;              // 移出链表的库的累计个数（dlpi_subs）
+    soinfo_t* name_index[LINKER_INDEX_BUCKETS];     // 路径 -> soinfo
+    soinfo_t* inode_index[LINKER_INDEX_BUCKETS];    // (dev, inode) -> soinfo
+
+    // 全局符号缓存（读者无锁访问，修改时持有缓存锁）
+    symcache_table_t* symcache;
+    uint64_t symcache_generation;   // 每次作废缓存时递增，防止写入过期结果
+
+    linker_slot_t* slots;       // 稳定符号槽
 } linker_state_t;
 
+// linker_load 标志
+#define LINKER_FLAG_LAZY   0x0001   // PLT 延迟绑定（其余重定位仍立即处理）
+#define LINKER_FLAG_FLAT_SYMTAB 0x0002  // 加载时就为新库构建平铺符号表
+#define LINKER_FLAG_HUGE_TEXT   0x0004  // 代码段按 2MB 对齐，完整的 2MB 区域换成匿名大页
+#define LINKER_FLAG_PREFAULT    0x0008  // 映射时预先建立页表（只读段）/ 预读（可写段）
+
+// linker_load_ex 的附加选项
+typedef struct {
+    int threads;        // 并行映射/重定位的线程数（<= 1 表示在调用线程中串行执行）
+    bool use_fd;        // 从 fd 加载根库，而不是打开 path（path 可以为 NULL）
+    int fd;             // use_fd 时使用的文件描述符（调用者负责关闭）
+    off_t offset;       // ELF 在 fd 中的偏移，必须按页对齐（例如 zip 中未压缩的条目）
+    const char* reloc_cache_dir;    // 重定位缓存目录（NULL 表示不使用），只用于立即绑定
+    bool fresh;         // 根库总是重新加载（不复用同路径/同 inode 的已加载库），用于热替换
+} linker_load_opts_t;
+
 // 初始化链接器
 void linker_init(void);
 
-// 加载共享库
-soinfo_t* linker_load(const char* path);
+// 写者锁（可重入）：加载、卸载、构造/析构函数都在锁内执行
+// 符号查找不需要持有这把锁
+void linker_lock(void);
+void linker_unlock(void);
 
-// 卸载共享库
+// 加载共享库及其依赖（已加载的库只增加引用计数）
+soinfo_t* linker_load(const char* path, int flags);
+
+// 同 linker_load，opts 为 NULL 时等价于 linker_load
+soinfo_t* linker_load_ex(const char* path, int flags, const linker_load_opts_t* opts);
+
+// 卸载共享库（引用计数归零时连同不再使用的依赖一起卸载）
 void linker_unload(soinfo_t* si);
 
+// 获取库中符号的稳定槽（同一个库的同名符号返回同一个槽）
+// 返回: 槽，符号不存在返回 NULL
+linker_slot_t* linker_get_slot(soinfo_t* si, const char* name);
+
+// 热替换：在旧版本旁边加载新版本（并调用构造函数），把旧版本的槽全部切换到
+// 新版本，旧版本从全局查找范围和索引中移除，引用计数转移给新版本。
+// 旧版本仍然映射着，由调用者在宽限期之后用 linker_unload 卸载。
+// 新版本缺少任何一个槽的符号时放弃替换（槽保持不变）。
+// path 为 NULL 时使用旧版本的路径
+// 返回: 新版本，*retired 输出旧版本；失败返回 NULL
+soinfo_t* linker_reload(soinfo_t* si, const char* path, int flags, soinfo_t** retired);
+
+// 初始化符号查找键（hash 在第一次用到时才计算）
+void symbol_name_init(symbol_name_t* sn, const char* name);
+
+// 指定要求的版本（例如 "GLIBC_2.2.5"），之后的查找只匹配该版本的定义
+void symbol_name_set_version(symbol_name_t* sn, const char* version);
+
+// 获取 GNU hash / ELF hash（首次调用时计算并保存）
+uint32_t symbol_name_gnu_hash(symbol_name_t* sn);
+uint32_t symbol_name_elf_hash(symbol_name_t* sn);
+
+// 获取名字长度（首次调用时计算并保存）
+uint32_t symbol_name_len(symbol_name_t* sn);
+
 // 查找符号
 void* linker_find_symbol(soinfo_t* si, const char* name);
+void* linker_find_symbol_ex(soinfo_t* si, symbol_name_t* sn);
+
+// 在指定库中查找符号，必要时先构建该库的平铺符号表
+void* linker_find_symbol_indexed(soinfo_t* si, symbol_name_t* sn);
 
-// 查找全局符号（在所有已加载库中查找）
+// 批量查找：names[i] 的结果写入 addrs[i]，返回找到的个数
+// si 为 NULL 时在全局范围查找
+size_t linker_find_symbols(soinfo_t* si, const char* const* names, void** addrs, size_t count);
+
+// 查找全局符号（在所有已加载库中查找，结果会被缓存）
 void* linker_find_global_symbol(const char* name);
+void* linker_find_global_symbol_ex(symbol_name_t* sn);
+
+// 清空全局符号缓存
+void linker_flush_symbol_cache(void);
+
+// 地址反查（在 RCU 读侧临界区中调用，结果在临界区结束前有效）
+// 查找包含 addr 的库，不在任何库的映射中返回 NULL
+soinfo_t* linker_find_library_by_addr(const void* addr);
+
+// 查找库中覆盖 addr 的符号（第一次调用时构建该库的地址排序符号数组），没有返回 NULL
+const ElfW(Sym)* linker_find_symbol_by_addr(soinfo_t* si, const void* addr);
+
+// 已加载库链表（在 RCU 读侧临界区中沿 next 遍历），以及累计加入/移出的库数
+soinfo_t* linker_first_library(void);
+void linker_list_counters(uint64_t* adds, uint64_t* subs);
 
 // 执行重定位
-int linker_relocate(soinfo_t* si);
+int linker_relocate(soinfo_t* si, int flags);
 
-// 调用初始化函数
+#if ARCH_HAS_LAZY_PLT
+// 延迟绑定：第一次调用 PLT 条目时由蹦床调用，返回目标函数地址
+void* linker_lazy_fixup(soinfo_t* si, size_t reloc_index);
+#endif
+
+// 调用初始化函数（依赖库先于自身，每个库只执行一次）
 void linker_call_constructors(soinfo_t* si);
 
+// 调用初始化函数，互不依赖的子树在 threads 个线程上并行执行
+// 工作线程中的构造函数不能调用 mini_dlopen/mini_dlclose，也不能经由推迟初始化的句柄 dlsym
+void linker_call_constructors_ex(soinfo_t* si, int threads);
+
+// 把 si 及其尚未初始化的依赖的构造函数推迟到第一次经由句柄查找符号时
+void linker_defer_constructors(soinfo_t* si);
+
+// 如果 si 的构造函数被推迟且尚未执行，现在执行
+void linker_run_deferred_constructors(soinfo_t* si);
+
 // 调用析构函数
 void linker_call_destructors(soinfo_t* si);
 
@@ -90,6 +376,13 @@ const char* linker_get_error(void);
 // 清除错误
 void linker_clear_error(void);
 
+// 获取库的加载统计（快照）
+// 返回: 成功返回 0，si 为 NULL 返回 -1
+int linker_get_stats(soinfo_t* si, linker_stats_t* out);
+
+// 以 JSON Lines 格式输出加载统计，每个库一行（si 为 NULL 时输出所有已加载库）
+void linker_dump_stats(soinfo_t* si, FILE* out);
+
 // 调试：打印 soinfo
 void soinfo_print(soinfo_t* si);
 
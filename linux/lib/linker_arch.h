@@ -0,0 +1,154 @@
+#ifndef LINKER_ARCH_H
+#define LINKER_ARCH_H
+
+#include <elf.h>
+#include <link.h>
+#include <stdint.h>
+
+// 目标架构的 ELF 类型与重定位常量
+//
+// 链接器只加载与自身相同架构的库，所以一切在编译期由预定义宏决定：
+// 每个目标只编译自己的那一套重定位类型和循环，重定位时不存在按条目的架构判断。
+//
+//   架构      | ELF 类别 | 重定位表 | 延迟绑定 | TLS 变体
+//   ----------|----------|----------|----------|---------------------------
+//   x86_64    | ELF64    | RELA     | 支持     | II（块在线程指针之前）
+//   AArch64   | ELF64    | RELA     | 立即绑定 | I （块在线程指针之后），TLSDESC
+//   ARM (v7)  | ELF32    | REL      | 立即绑定 | I
+//
+// 静态 TLS 的偏移按 "块地址 - 线程指针" 计算（见 linker_tls.c），两种变体都适用。
+
+// ============ ELF 类别 ============
+
+// ElfW 与 <link.h> 中的定义相同（系统头文件没有提供时才自己定义）
+#if defined(__LP64__)
+#ifndef ElfW
+#define ElfW(type)          Elf64_##type
+#endif
+#define ELFW_R_SYM(info)    ELF64_R_SYM(info)
+#define ELFW_R_TYPE(info)   ELF64_R_TYPE(info)
+#define ELFW_ST_BIND(info)  ELF64_ST_BIND(info)
+#define ELFW_ST_TYPE(info)  ELF64_ST_TYPE(info)
+#define LINKER_ELFCLASS     ELFCLASS64
+#else
+#ifndef ElfW
+#define ElfW(type)          Elf32_##type
+#endif
+#define ELFW_R_SYM(info)    ELF32_R_SYM(info)
+#define ELFW_R_TYPE(info)   ELF32_R_TYPE(info)
+#define ELFW_ST_BIND(info)  ELF32_ST_BIND(info)
+#define ELFW_ST_TYPE(info)  ELF32_ST_TYPE(info)
+#define LINKER_ELFCLASS     ELFCLASS32
+#endif
+
+// ============ 重定位类型 ============
+//
+//   ARCH_R_ABS        S + A     绝对地址
+//   ARCH_R_GLOB_DAT   S         GOT 条目（AArch64 为 S + A，下同）
+//   ARCH_R_JUMP_SLOT  S         PLT 条目
+//   ARCH_R_RELATIVE   B + A     相对加载基址
+//   ARCH_R_TLS_DTPMOD 模块 ID   tls_index_t.module
+//   ARCH_R_TLS_DTPREL S + A     tls_index_t.offset
+//   ARCH_R_TLS_TPREL  S + A - TP  initial-exec 的线程指针偏移
+
+#if defined(__x86_64__)
+
+#define LINKER_ARCH_NAME        "x86_64"
+#define LINKER_EM               EM_X86_64
+#define ARCH_USE_RELA           1
+#define ARCH_HAS_LAZY_PLT       1
+#define ARCH_HAS_TLSDESC        0
+
+#define ARCH_R_NONE             R_X86_64_NONE
+#define ARCH_R_ABS              R_X86_64_64
+#define ARCH_R_GLOB_DAT         R_X86_64_GLOB_DAT
+#define ARCH_R_JUMP_SLOT        R_X86_64_JUMP_SLOT
+#define ARCH_R_RELATIVE         R_X86_64_RELATIVE
+#define ARCH_R_COPY             R_X86_64_COPY
+#define ARCH_R_TLS_DTPMOD       R_X86_64_DTPMOD64
+#define ARCH_R_TLS_DTPREL       R_X86_64_DTPOFF64
+#define ARCH_R_TLS_TPREL        R_X86_64_TPOFF64
+#define ARCH_IS_TLS_RELOC(type) \
+    ((type) == R_X86_64_DTPMOD64 || (type) == R_X86_64_DTPOFF64 || (type) == R_X86_64_TPOFF64)
+
+// GLOB_DAT / JUMP_SLOT 是否加上 r_addend（x86_64 为 S，AArch64 为 S + A）
+#define ARCH_GOT_USES_ADDEND    0
+
+// 统计槽位即类型本身（x86_64 的类型都小于 64）
+#define ARCH_RELOC_STAT_INDEX(type) (type)
+
+#elif defined(__aarch64__)
+
+#define LINKER_ARCH_NAME        "aarch64"
+#define LINKER_EM               EM_AARCH64
+#define ARCH_USE_RELA           1
+#define ARCH_HAS_LAZY_PLT       0
+#define ARCH_HAS_TLSDESC        1
+
+#define ARCH_R_NONE             R_AARCH64_NONE
+#define ARCH_R_ABS              R_AARCH64_ABS64
+#define ARCH_R_GLOB_DAT         R_AARCH64_GLOB_DAT
+#define ARCH_R_JUMP_SLOT        R_AARCH64_JUMP_SLOT
+#define ARCH_R_RELATIVE         R_AARCH64_RELATIVE
+#define ARCH_R_COPY             R_AARCH64_COPY
+#define ARCH_R_TLS_DTPMOD       R_AARCH64_TLS_DTPMOD
+#define ARCH_R_TLS_DTPREL       R_AARCH64_TLS_DTPREL
+#define ARCH_R_TLS_TPREL        R_AARCH64_TLS_TPREL
+#define ARCH_R_TLSDESC          R_AARCH64_TLSDESC
+#define ARCH_IS_TLS_RELOC(type) ((type) >= R_AARCH64_TLS_DTPMOD && (type) <= R_AARCH64_TLSDESC)
+
+#define ARCH_GOT_USES_ADDEND    1
+
+// 动态重定位类型从 1024 开始：1024..1071 映射到槽位 16..63，ABS64 映射到 1，其余计入最后一个槽位
+#define ARCH_RELOC_STAT_INDEX(type)                                             \
+    ((type) == R_AARCH64_NONE ? 0u :                                            \
+     (type) == R_AARCH64_ABS64 ? 1u :                                           \
+     ((type) >= 1024 && (type) < 1072) ? (uint32_t)(type) - 1008 : 63u)
+
+#elif defined(__arm__)
+
+#define LINKER_ARCH_NAME        "arm"
+#define LINKER_EM               EM_ARM
+#define ARCH_USE_RELA           0
+#define ARCH_HAS_LAZY_PLT       0
+#define ARCH_HAS_TLSDESC        0
+
+#define ARCH_R_NONE             R_ARM_NONE
+#define ARCH_R_ABS              R_ARM_ABS32
+#define ARCH_R_GLOB_DAT         R_ARM_GLOB_DAT
+#define ARCH_R_JUMP_SLOT        R_ARM_JUMP_SLOT
+#define ARCH_R_RELATIVE         R_ARM_RELATIVE
+#define ARCH_R_COPY             R_ARM_COPY
+#define ARCH_R_TLS_DTPMOD       R_ARM_TLS_DTPMOD32
+#define ARCH_R_TLS_DTPREL       R_ARM_TLS_DTPOFF32
+#define ARCH_R_TLS_TPREL        R_ARM_TLS_TPOFF32
+#define ARCH_IS_TLS_RELOC(type) ((type) >= R_ARM_TLS_DTPMOD32 && (type) <= R_ARM_TLS_TPOFF32)
+
+#define ARCH_GOT_USES_ADDEND    0
+
+#define ARCH_RELOC_STAT_INDEX(type) (type)
+
+#else
+#error "mini linker: unsupported architecture (x86_64, aarch64 and arm are supported)"
+#endif
+
+// ============ REL / RELA ============
+//
+// RELA 的加数在条目里；REL（ARM32）的加数是目标位置中已有的值（隐式加数），
+// 因此 RELOC_ADDEND 必须在写入目标位置之前读取。
+
+#if ARCH_USE_RELA
+typedef ElfW(Rela) linker_rel_t;
+#define DT_LINKER_REL           DT_RELA
+#define DT_LINKER_RELSZ         DT_RELASZ
+#define DT_LINKER_RELCOUNT      DT_RELACOUNT
+#define RELOC_ADDEND(rel, where) ((ElfW(Addr))(rel)->r_addend)
+#else
+typedef ElfW(Rel) linker_rel_t;
+#define DT_LINKER_REL           DT_REL
+#define DT_LINKER_RELSZ         DT_RELSZ
+#define DT_LINKER_RELCOUNT      DT_RELCOUNT
+#define RELOC_ADDEND(rel, where) (*(const ElfW(Addr)*)(where))
+#endif
+
+#endif // LINKER_ARCH_H
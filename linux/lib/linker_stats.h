@@ -0,0 +1,52 @@
+#ifndef LINKER_STATS_H
+#define LINKER_STATS_H
+
+#include <stdint.h>
+
+// 加载阶段（每个库分别计时）
+typedef enum {
+    LINKER_PHASE_OPEN = 0,      // 打开并解析 ELF 头
+    LINKER_PHASE_RESERVE,       // 预留地址空间
+    LINKER_PHASE_MAP,           // 映射 PT_LOAD 段和 BSS
+    LINKER_PHASE_DYNAMIC,       // 解析动态段
+    LINKER_PHASE_RELOCATE,      // 重定位（并行时为各任务耗时之和）
+    LINKER_PHASE_INIT,          // 构造函数（不含依赖库的构造函数）
+    LINKER_PHASE_COUNT
+} linker_phase_t;
+
+// 符号查找结果（重定位和延迟绑定时按来源计数）
+typedef enum {
+    LINKER_LOOKUP_LOCAL = 0,    // 库自身定义的符号
+    LINKER_LOOKUP_GLOBAL,       // 在 mini linker 加载的库中找到
+    LINKER_LOOKUP_SYSTEM,       // 通过系统 dlsym 找到
+    LINKER_LOOKUP_MISS,         // 找不到
+    LINKER_LOOKUP_COUNT
+} linker_lookup_kind_t;
+
+// 按重定位类型计数的槽位数：下标见 ARCH_RELOC_STAT_INDEX，超出的计入最后一个槽位
+#define LINKER_STATS_RELOC_TYPES 64
+
+// 单个库的加载统计
+// 所有字段都是 uint64_t 计数器，可以逐字累加
+typedef struct {
+    uint64_t phase_ns[LINKER_PHASE_COUNT];      // 各阶段耗时（纳秒）
+    uint64_t total_ns;                          // 作为根库时整次加载的墙钟时间
+    uint64_t relocs[LINKER_STATS_RELOC_TYPES];  // 按重定位类型统计的重定位数
+    uint64_t lookups[LINKER_LOOKUP_COUNT];      // 按来源统计的符号查找数
+    uint64_t lookup_cache_hits;                 // 其中命中全局符号缓存的次数
+    uint64_t bytes_mapped;                      // 映射的字节数（文件段 + 匿名 BSS）
+    uint64_t relro_shared_bytes;                // 换成共享快照页的 RELRO 字节数
+    uint64_t huge_text_bytes;                   // 换成 2MB 大页的代码字节数
+    uint64_t minor_faults;                      // 加载期间的缺页（次要）
+    uint64_t major_faults;                      // 加载期间的缺页（需要 I/O）
+    uint64_t init_funcs;                        // 调用的构造函数个数（DT_INIT + DT_INIT_ARRAY）
+    uint64_t init_wait_ns;                      // 依赖初始化完成后等待调度的时间
+} linker_stats_t;
+
+// 阶段名（用于输出）
+const char* linker_phase_name(linker_phase_t phase);
+
+// 查找来源名（用于输出）
+const char* linker_lookup_kind_name(linker_lookup_kind_t kind);
+
+#endif // LINKER_STATS_H
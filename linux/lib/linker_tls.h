@@ -0,0 +1,53 @@
+#ifndef LINKER_TLS_H
+#define LINKER_TLS_H
+
+#include "linker.h"
+
+// 线程局部存储（PT_TLS）
+//
+// 每个带 PT_TLS 的库注册为一个 TLS 模块（模块 ID 从 1 开始，卸载后复用）。
+// 两种访问方式：
+//
+//   动态模型（general/local-dynamic）：代码调用 __tls_get_addr(&{模块 ID, 偏移})，
+//       链接器把这个符号解析到 linker_tls_get_addr。每个线程有一个 DTV
+//       （模块 ID -> 本线程的 TLS 块），命中时只是一次数组访问；
+//       线程第一次访问某个模块时才分配并初始化 TLS 块。
+//
+//   静态模型（initial-exec，库带 DF_STATIC_TLS）：代码直接用 线程指针 + 偏移 访问，
+//       不经过任何函数。这类库的 TLS 块必须放在链接器预留的静态 TLS 区中，
+//       该区域位于链接器自身的初始 TLS 里，相对线程指针的偏移在所有线程中相同。
+//       空间有剩余时，动态模型的库也放进静态区，__tls_get_addr 不必再单独分配内存。
+//
+//   TLS 描述符（AArch64 的默认模型）：GOT 中的描述符指向解析函数，静态区中的模块直接
+//       返回偏移，其余模块经由 linker_tls_get_addr（见 tlsdesc_aarch64.S）。
+//
+// 静态区只分配不回收（与 glibc 相同）：卸载后的空间不会再给其他库，
+// 因此每个线程中未使用过的部分总是零，.tbss 不需要逐线程清零。
+//
+// 限制：使用 initial-exec 且 .tdata 非零的库，加载线程之外的线程要等到
+// 第一次经由 __tls_get_addr 访问该模块时才复制初始值。
+
+// 静态 TLS 区大小；其中最后 LINKER_TLS_STATIC_RESERVE 字节只留给 DF_STATIC_TLS 的库
+#define LINKER_TLS_STATIC_SIZE      4096
+#define LINKER_TLS_STATIC_RESERVE   1024
+
+// __tls_get_addr 的参数（由 DTPMOD64 / DTPOFF64 重定位填写在 GOT 中）
+typedef struct {
+    unsigned long module;       // 模块 ID
+    unsigned long offset;       // 变量在模块 TLS 块中的偏移
+} tls_index_t;
+
+// 注册库的 TLS 段（在写者锁内、重定位之前调用；没有 PT_TLS 时什么也不做）
+// 返回: 成功返回 0；DF_STATIC_TLS 的库放不进静态区时返回 -1
+int linker_tls_register(soinfo_t* si);
+
+// 注销库的 TLS 模块（各线程的 TLS 块在线程下次经由 __tls_get_addr 访问或退出时释放）
+void linker_tls_unregister(soinfo_t* si);
+
+// 与 __tls_get_addr 兼容：返回调用线程中该变量的地址
+void* linker_tls_get_addr(tls_index_t* ti);
+
+// 调用线程中库的 TLS 块（dl_iterate_phdr 的 dlpi_tls_data），尚未分配时返回 NULL（不会分配）
+void* linker_tls_block(const soinfo_t* si);
+
+#endif // LINKER_TLS_H
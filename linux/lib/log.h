@@ -11,23 +11,59 @@ typedef enum {
     LOG_LEVEL_ERROR
 } log_level_t;
 
+// 编译期最低级别（0=DEBUG ... 3=ERROR），低于它的日志调用整个被编译器删除
+// 例如 make LOG_MIN_LEVEL=2 只保留 WARN 和 ERROR
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
 // 初始化日志系统
+// 环境变量 MINI_LOG_ASYNC 非空且不为 "0" 时启用异步模式
 void log_init(void);
 
-// 设置日志级别
+// 设置日志级别（运行期；不能低于 LOG_MIN_LEVEL）
 void log_set_level(log_level_t level);
 
-// 获取时间戳字符串
+// 获取时间戳字符串（线程局部缓冲区，下次调用前有效）
 const char* log_get_timestamp(void);
 
+// 异步模式
+//
+// 调用线程只把格式串指针、文件名、行号、粗粒度时间戳和原始参数写入
+// 自己的无锁环形缓冲区（单生产者单消费者），格式化和输出由后台线程完成。
+// 字符串参数按值复制，调用返回后即可释放。
+//
+//   - ERROR 级别的日志先清空所有缓冲区，再在调用线程同步输出（随后可能 abort）
+//   - 缓冲区已满、格式串含有不支持的转换或者字符串参数超过 512 字节时，
+//     在调用线程同步输出（不会截断）
+//   - 后台线程输出后刷新 stdout 和 stderr（WARN 及以上写入 stderr）
+//   - 同一线程的日志保持顺序，不同线程之间按后台线程的轮询顺序输出
+//
+// 返回: 成功返回 0（已经启用时也返回 0），创建线程失败返回 -1
+int log_start_async(void);
+
+// 等待所有已经写入缓冲区的日志输出完毕
+void log_flush(void);
+
+// 输出剩余的日志并停止后台线程，之后回到同步模式
+void log_stop_async(void);
+
 // 内部日志输出函数（带文件名和行号）
-void log_output_ex(log_level_t level, const char* file, int line, const char* fmt, ...);
+void log_output_ex(log_level_t level, const char* file, int line, const char* fmt, ...)
+    __attribute__((format(printf, 4, 5)));
 
 // 便捷宏 - 自动传入文件名和行号
-#define LOG_DEBUG(fmt, ...) log_output_ex(LOG_LEVEL_DEBUG, __FILE__, __LINE__, fmt, ##__VA_ARGS__)
-#define LOG_INFO(fmt, ...)  log_output_ex(LOG_LEVEL_INFO,  __FILE__, __LINE__, fmt, ##__VA_ARGS__)
-#define LOG_WARN(fmt, ...)  log_output_ex(LOG_LEVEL_WARN,  __FILE__, __LINE__, fmt, ##__VA_ARGS__)
-#define LOG_ERROR(fmt, ...) log_output_ex(LOG_LEVEL_ERROR, __FILE__, __LINE__, fmt, ##__VA_ARGS__)
+// 条件是编译期常量：低于 LOG_MIN_LEVEL 的调用连同参数求值一起被删除
+#define LOG_AT(level, fmt, ...) \
+    do { \
+        if ((int)(level) >= LOG_MIN_LEVEL) \
+            log_output_ex((level), __FILE__, __LINE__, fmt, ##__VA_ARGS__); \
+    } while (0)
+
+#define LOG_DEBUG(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...)  LOG_AT(LOG_LEVEL_INFO,  fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...)  LOG_AT(LOG_LEVEL_WARN,  fmt, ##__VA_ARGS__)
+#define LOG_ERROR(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
 
 // 兼容旧代码的宏
 #define LOG(fmt, ...)      LOG_INFO(fmt, ##__VA_ARGS__)
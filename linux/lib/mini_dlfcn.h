@@ -1,11 +1,20 @@
 #ifndef MINI_DLFCN_H
 #define MINI_DLFCN_H
 
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include "linker_stats.h"
+
 // dlopen 标志
 #define MINI_RTLD_LAZY     0x0001  // 延迟绑定
 #define MINI_RTLD_NOW      0x0002  // 立即绑定
 #define MINI_RTLD_LOCAL    0x0000  // 符号不导出
 #define MINI_RTLD_GLOBAL   0x0100  // 符号全局可见
+#define MINI_RTLD_SYMINDEX 0x10000 // 加载时就构建平铺符号表（否则在第一次 dlsym 时构建）
+#define MINI_RTLD_HUGETEXT 0x20000 // 代码段尽量使用 2MB 大页（减少 iTLB 缺失，代码页不再跨进程共享）
+#define MINI_RTLD_PREFAULT 0x40000 // 加载时预先载入所有段，第一次调用不再触发缺页
+#define MINI_RTLD_DEFERRED_INIT 0x80000 // 构造函数推迟到第一次经由句柄 dlsym（RTLD_DEFAULT 查找不触发）
 
 // 特殊句柄
 #define MINI_RTLD_DEFAULT  ((void*)0)   // 默认搜索
@@ -17,12 +26,137 @@
 // 返回: 库句柄，失败返回 NULL
 void* mini_dlopen(const char* path, int flags);
 
+// dlopen_ex 扩展信息的标志（mini_dlextinfo_t.flags）
+#define MINI_DLEXT_THREADS 0x0001  // threads 字段有效
+#define MINI_DLEXT_USE_LIBRARY_FD        0x0002  // 从 library_fd 加载，path 只作为名字（可以为 NULL）
+#define MINI_DLEXT_USE_LIBRARY_FD_OFFSET 0x0004  // library_fd_offset 字段有效（必须按页对齐）
+#define MINI_DLEXT_RELOC_CACHE           0x0008  // 使用 reloc_cache_dir 中的重定位缓存（只用于立即绑定）
+#define MINI_DLEXT_PARALLEL_INIT         0x0010  // 互不依赖的库的构造函数并行执行（线程数同 threads）
+                                                 // 构造函数不能调用 mini_dlopen/mini_dlclose
+
+// dlopen_ex 扩展信息（仿照 Android 的 android_dlextinfo）
+typedef struct {
+    unsigned long flags;   // MINI_DLEXT_* 的组合
+    int threads;           // 并行加载的线程数，0 表示使用全部在线 CPU
+    int library_fd;        // MINI_DLEXT_USE_LIBRARY_FD: 库所在的文件（调用者负责关闭）
+    off_t library_fd_offset; // MINI_DLEXT_USE_LIBRARY_FD_OFFSET: ELF 在文件中的偏移
+    const char* reloc_cache_dir; // MINI_DLEXT_RELOC_CACHE: 缓存目录（多个进程可以共用）
+} mini_dlextinfo_t;
+
+// dlopen_ex - 带扩展选项加载共享库
+// extinfo: 扩展信息，可以为 NULL（等价于 mini_dlopen）
+// 没有指定 MINI_DLEXT_RELOC_CACHE 时，环境变量 MINI_LD_RELOC_CACHE 可以指定缓存目录
+void* mini_dlopen_ex(const char* path, int flags, const mini_dlextinfo_t* extinfo);
+
+// dlopen_fd - 从文件描述符加载共享库（立即绑定）
+// fd: 已打开的文件，段直接从这个 fd 映射，返回后可以关闭
+// offset: ELF 在文件中的偏移，必须按页对齐（例如打包文件中未压缩、页对齐的条目）
+// 返回: 库句柄，失败返回 NULL
+void* mini_dlopen_fd(int fd, off_t offset);
+
+// dlopen_mem - 从内存中的 ELF 镜像加载共享库（立即绑定）
+// data/size: 完整的 .so 文件内容，返回后可以释放
+// 镜像放入 memfd 后按文件映射，只读段的页可以共享，不需要解压到临时文件
+// 返回: 库句柄，失败返回 NULL
+void* mini_dlopen_mem(const void* data, size_t size);
+
 // dlsym - 获取符号地址
 // handle: dlopen 返回的句柄
 // symbol: 符号名
 // 返回: 符号地址，失败返回 NULL
 void* mini_dlsym(void* handle, const char* symbol);
 
+// dlvsym - 获取指定版本的符号地址
+// handle: dlopen 返回的句柄，或 MINI_RTLD_DEFAULT
+// symbol: 符号名
+// version: 版本名（例如 "GLIBC_2.2.5"），可以引用非默认版本（symbol@version）
+// 返回: 符号地址，失败返回 NULL
+void* mini_dlvsym(void* handle, const char* symbol, const char* version);
+
+// dlsym_many - 批量获取符号地址（一次遍历，带预取）
+// handle: dlopen 返回的句柄，或 MINI_RTLD_DEFAULT
+// symbols: 符号名数组
+// addrs: 输出数组，找不到的符号写入 NULL
+// count: 符号个数
+// 返回: 找到的符号个数
+size_t mini_dlsym_many(void* handle, const char* const* symbols, void** addrs, size_t count);
+
+// 地址反查（与 dladdr 相同的字段）
+typedef struct {
+    const char* dli_fname;  // 库名（打开时使用的路径）
+    void* dli_fbase;        // 加载偏移：文件中的地址 + dli_fbase = 内存中的地址
+    const char* dli_sname;  // 覆盖该地址的符号名，没有时为 NULL
+    void* dli_saddr;        // 该符号的地址，没有时为 NULL
+} mini_dl_info_t;
+
+// dladdr - 查找地址所在的库和符号
+// addr: 任意地址（例如采样得到的 PC）
+// info: 输出，字符串指向库的映射，dlclose 之后失效
+// 库按地址区间二分查找，库内的符号按地址二分查找（每个库第一次反查时分配并构建，之后不再分配）；
+// 只能查到动态符号表中的非局部符号。不加锁，可以高频调用；崩溃处理程序中调用前应先对
+// 关心的库各调用一次，之后的调用不会分配内存
+// 返回: addr 在某个库中返回非 0，否则返回 0
+int mini_dladdr(const void* addr, mini_dl_info_t* info);
+
+// dl_iterate_phdr - 按加载顺序对每个已加载库调用 callback（与系统的 dl_iterate_phdr 相同的参数）
+// 同一个 callback 可以先后交给系统的 dl_iterate_phdr 和这个函数，覆盖进程中所有的库
+// 遍历不加锁，callback 中不能调用 mini_dlopen/mini_dlclose/mini_dlreload
+// struct dl_phdr_info 由 <link.h> 定义（需要 _GNU_SOURCE）
+// 返回: callback 返回非 0 时停止遍历并返回该值，否则返回 0
+struct dl_phdr_info;
+int mini_dl_iterate_phdr(int (*callback)(struct dl_phdr_info* info, size_t size, void* data), void* data);
+
+// 稳定符号槽与热替换
+//
+// mini_dlsym 返回的地址在库被重新加载后失效。需要热替换的插件改为保存槽，
+// 每次调用前从槽中读取当前地址；读取和调用放在 enter/exit 之间，
+// mini_dlreload 会等这样的区间全部结束后才卸载旧版本：
+//
+//   void** slot = mini_dlsym_stable(handle, "handle_request");
+//   ...
+//   mini_dlslot_enter();
+//   ((handler_fn)mini_dlslot_get(slot))(req);
+//   mini_dlslot_exit();
+//
+// enter/exit 是无锁的（用户态 RCU 读侧临界区），可以嵌套；区间内不能调用
+// mini_dlopen/mini_dlclose/mini_dlreload。
+
+// dlsym_stable - 获取符号的稳定槽
+// handle: dlopen 返回的句柄
+// symbol: 符号名
+// 返回: 槽（同一个库的同名符号返回同一个槽，库被关闭后失效），失败返回 NULL
+void** mini_dlsym_stable(void* handle, const char* symbol);
+
+// 读取槽中的当前地址
+static inline void* mini_dlslot_get(void* const* slot) {
+    return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+}
+
+// 经由槽调用的区间（热替换在区间结束前不会卸载旧版本）
+void mini_dlslot_enter(void);
+void mini_dlslot_exit(void);
+
+// dlreload - 热替换共享库
+// handle: 当前版本的句柄（不能是其他库的依赖）
+// path: 新版本的路径，NULL 表示重新加载原路径（文件已被替换）
+// flags: 新版本的加载标志
+// 新版本加载并初始化后，旧版本 mini_dlsym_stable 得到的槽全部原子地切换到新版本；
+// 新版本缺少其中任何一个符号时替换失败，旧版本继续使用。
+// 切换后等待宽限期（所有已经开始的 enter/exit 区间结束），再卸载旧版本。
+// 旧句柄的引用全部转移给新句柄，旧句柄不能再使用。
+// 返回: 新句柄，失败返回 NULL
+void* mini_dlreload(void* handle, const char* path, int flags);
+
+// dlstats - 获取库的加载统计（各阶段耗时、重定位/符号查找计数、缺页等）
+// handle: dlopen 返回的句柄
+// 返回: 成功返回 0，失败返回 -1
+int mini_dlstats(void* handle, linker_stats_t* stats);
+
+// dlstats_dump - 以 JSON Lines 格式输出加载统计
+// handle: dlopen 返回的句柄，MINI_RTLD_DEFAULT 表示所有已加载库
+// 返回: 成功返回 0，失败返回 -1
+int mini_dlstats_dump(void* handle, FILE* out);
+
 // dlclose - 关闭共享库
 // handle: dlopen 返回的句柄
 // 返回: 成功返回 0，失败返回非 0
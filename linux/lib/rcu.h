@@ -0,0 +1,33 @@
+#ifndef RCU_H
+#define RCU_H
+
+// 用户态 RCU（读者无锁，写者等待宽限期后再释放内存）
+//
+// 读者：   rcu_read_lock() / rcu_read_unlock() 包围对共享数据的访问，可以嵌套
+// 写者：   rcu_assign_pointer() 发布新数据，rcu_synchronize() 等待旧读者退出后
+//          再释放旧数据；也可以 rcu_defer_free() 交给下一次 rcu_reclaim()
+
+// 读取被 RCU 保护的指针
+#define rcu_dereference(p)          __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+
+// 发布被 RCU 保护的指针（之前对新数据的写入对读者可见）
+#define rcu_assign_pointer(p, v)    __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+// 开始读侧临界区
+void rcu_read_lock(void);
+
+// 结束读侧临界区
+void rcu_read_unlock(void);
+
+// 等待宽限期：调用前已经开始的读侧临界区全部结束后返回
+// 不能在读侧临界区内调用
+void rcu_synchronize(void);
+
+// 推迟释放：ptr 在下一次 rcu_reclaim() 时被 free
+void rcu_defer_free(void* ptr);
+
+// 等待宽限期并释放所有推迟释放的内存
+// 不能在读侧临界区内调用
+void rcu_reclaim(void);
+
+#endif // RCU_H
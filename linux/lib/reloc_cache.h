@@ -0,0 +1,43 @@
+#ifndef RELOC_CACHE_H
+#define RELOC_CACHE_H
+
+#include "linker.h"
+
+// 符号重定位缓存（跨进程共享，类似 prelink / Android 的 RELRO 共享）
+//
+// 一次成功的立即绑定加载之后，把每个符号重定位的结果记录为
+// "提供者 + 相对提供者加载偏移的差值"写入缓存目录。之后的进程加载
+// 同一个文件、且符号搜索范围相同时，只需 基址 + 差值 即可写回，
+// 不再做任何符号查找，即使各个库的加载地址不同。
+//
+// 缓存按文件身份（dev/ino/大小/mtime/偏移）、搜索范围内所有库的身份、
+// 以及系统库的文件身份校验，任何一项不符都回退到正常重定位。
+// RELATIVE/RELR 重定位本身就不需要查找，仍然照常处理。
+
+// 用缓存完成 si 的符号重定位（不包括 RELATIVE/RELR）
+// scope: 全局符号搜索范围（已加载库链表的表头）
+// stats: 按类型累加写回的重定位个数
+// 返回: 成功返回 0；没有可用的缓存返回 -1（si 未被修改）
+int reloc_cache_apply(soinfo_t* si, soinfo_t* scope, const char* dir, linker_stats_t* stats);
+
+// 记录 si 当前的符号重定位结果（si 必须已经完成立即绑定的重定位）
+// 不支持的库（Android 打包重定位、COPY 等类型）直接跳过
+// 返回: 写入缓存返回 0，否则返回 -1
+int reloc_cache_store(soinfo_t* si, soinfo_t* scope, const char* dir);
+
+// RELRO 快照（同一目录下的 .relro 文件）
+//
+// 重定位后的 RELRO 页内容取决于加载地址。第一个进程把 RELRO 页写入
+// 快照并记录加载地址；之后的进程优先在同一地址加载，重定位完成后，
+// 与快照内容相同的页被换成映射自快照文件的只读页，由页缓存共享。
+// 指向系统库（例如 libc）的页在各进程中通常不同，仍然是私有的。
+
+// 快照记录的加载地址（没有可用的快照返回 NULL），用作 mmap 的地址提示
+void* reloc_cache_relro_base(const soinfo_t* si, const char* dir);
+
+// 共享 RELRO 页：调用前 RELRO 已经重定位完成并设为只读
+// 没有快照时写入快照；加载地址与快照不同时什么也不做
+// 返回: 换成共享页的字节数
+uint64_t reloc_cache_share_relro(soinfo_t* si, const char* dir);
+
+#endif // RELOC_CACHE_H
@@ -0,0 +1,29 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// 简单的固定大小线程池（用于并行映射和重定位）
+
+// 任务函数
+typedef void (*thread_pool_fn)(void* arg);
+
+typedef struct thread_pool thread_pool_t;
+
+// 创建线程池
+// threads: 参与执行任务的线程总数（包括调用 thread_pool_wait 的线程）
+// 返回: 线程池，失败返回 NULL
+thread_pool_t* thread_pool_create(int threads);
+
+// 提交任务（先提交的先执行）
+// 返回: 成功返回 0，失败返回 -1
+int thread_pool_submit(thread_pool_t* pool, thread_pool_fn fn, void* arg);
+
+// 等待所有已提交的任务完成；调用线程也会执行队列中的任务
+void thread_pool_wait(thread_pool_t* pool);
+
+// 销毁线程池（先等待剩余任务完成）
+void thread_pool_destroy(thread_pool_t* pool);
+
+// 在线的 CPU 数量
+int thread_pool_cpu_count(void);
+
+#endif // THREAD_POOL_H
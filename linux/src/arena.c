@@ -0,0 +1,130 @@
+/**
+ * =============================================================================
+ * arena.c - 链接器内部的内存分配器
+ * =============================================================================
+ *
+ * 每加载一个库原来要做好几次 calloc：soinfo 本身（含 256 字节的名字数组）、
+ * 依赖数组、程序头副本……这些小块散落在堆中，卸载时还要逐个释放。
+ *
+ *   arena:  块内顺序分配（指针前移），块用完再 malloc 一个新块
+ *
+ *           head ─► [chunk | used ····· free ]
+ *                      └─► [chunk | ········· ] ─► NULL
+ *
+ *   pool:   一次分配 per_slab 个对象（slab），对象释放后挂到空闲链表上，
+ *           下一次分配优先复用。slab 来自池自己的 arena。
+ *
+ * =============================================================================
+ */
+
+#include "arena.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN 16
+#define ALIGN_UP(x) (((x) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+struct arena_chunk {
+    arena_chunk_t* next;
+    size_t size;                /* data 的大小 */
+    size_t used;                /* 已分配的字节数 */
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+void arena_init(arena_t* arena, size_t chunk_size) {
+    arena->head = NULL;
+    arena->chunk_size = chunk_size;
+}
+
+/**
+ * arena_alloc - 从 arena 分配内存
+ * @arena: arena
+ * @size: 字节数
+ *
+ * 比块大小还大的请求单独占一块，挂在当前块之后，
+ * 当前块剩余的空间还可以继续使用。
+ *
+ * 返回: 清零的内存，失败返回 NULL
+ */
+void* arena_alloc(arena_t* arena, size_t size) {
+    size = ALIGN_UP(size ? size : 1);
+
+    arena_chunk_t* chunk = arena->head;
+    if (chunk && chunk->size - chunk->used >= size) {
+        void* p = chunk->data + chunk->used;
+        chunk->used += size;
+        return p;
+    }
+
+    size_t data_size = size > arena->chunk_size ? size : arena->chunk_size;
+    arena_chunk_t* fresh = (arena_chunk_t*)calloc(1, sizeof(arena_chunk_t) + data_size);
+    if (!fresh) return NULL;
+    fresh->size = data_size;
+    fresh->used = size;
+
+    if (chunk && data_size > arena->chunk_size) {
+        fresh->next = chunk->next;
+        chunk->next = fresh;
+    } else {
+        fresh->next = chunk;
+        arena->head = fresh;
+    }
+    return fresh->data;
+}
+
+char* arena_strdup(arena_t* arena, const char* s) {
+    size_t len = strlen(s);
+    char* copy = (char*)arena_alloc(arena, len + 1);
+    if (copy) memcpy(copy, s, len + 1);
+    return copy;
+}
+
+void arena_release(arena_t* arena) {
+    arena_chunk_t* chunk = arena->head;
+    while (chunk) {
+        arena_chunk_t* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+}
+
+void pool_init(pool_t* pool, size_t obj_size, size_t per_slab) {
+    pool->obj_size = ALIGN_UP(obj_size < sizeof(void*) ? sizeof(void*) : obj_size);
+    pool->per_slab = per_slab ? per_slab : 1;
+    pool->free_list = NULL;
+    arena_init(&pool->slabs, pool->obj_size * pool->per_slab);
+}
+
+/**
+ * pool_alloc - 从对象池分配一个对象
+ * @pool: 对象池
+ *
+ * 空闲链表为空时分配一个新 slab，把其中的对象全部挂到空闲链表上。
+ *
+ * 返回: 清零的对象，失败返回 NULL
+ */
+void* pool_alloc(pool_t* pool) {
+    if (!pool->free_list) {
+        unsigned char* slab = (unsigned char*)arena_alloc(&pool->slabs, pool->obj_size * pool->per_slab);
+        if (!slab) return NULL;
+        /* 倒序入链，分配顺序与地址顺序一致 */
+        for (size_t i = pool->per_slab; i > 0; i--) {
+            void* obj = slab + (i - 1) * pool->obj_size;
+            *(void**)obj = pool->free_list;
+            pool->free_list = obj;
+        }
+    }
+
+    void* obj = pool->free_list;
+    pool->free_list = *(void**)obj;
+    memset(obj, 0, pool->obj_size);
+    return obj;
+}
+
+void pool_free(pool_t* pool, void* obj) {
+    if (!obj) return;
+    *(void**)obj = pool->free_list;
+    pool->free_list = obj;
+}
@@ -1,27 +1,128 @@
+#define _GNU_SOURCE
 #include "mini_dlfcn.h"
 #include "linker.h"
+#include "linker_tls.h"
+#include "thread_pool.h"
+#include "rcu.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// dlopen 标志 -> linker 标志
+// 只有明确要求 MINI_RTLD_LAZY 时才延迟绑定；MINI_RTLD_NOW 优先
+static int to_linker_flags(int flags) {
+    int linker_flags = 0;
+    if ((flags & MINI_RTLD_LAZY) && !(flags & MINI_RTLD_NOW)) {
+        linker_flags |= LINKER_FLAG_LAZY;
+    }
+    if (flags & MINI_RTLD_SYMINDEX) {
+        linker_flags |= LINKER_FLAG_FLAT_SYMTAB;
+    }
+    if (flags & MINI_RTLD_HUGETEXT) {
+        linker_flags |= LINKER_FLAG_HUGE_TEXT;
+    }
+    if (flags & MINI_RTLD_PREFAULT) {
+        linker_flags |= LINKER_FLAG_PREFAULT;
+    }
+    return linker_flags;
+}
 
 // dlopen - 加载共享库
 void* mini_dlopen(const char* path, int flags) {
-    (void)flags;  // 目前忽略 flags
+    return mini_dlopen_ex(path, flags, NULL);
+}
 
-    if (!path) {
+// dlopen_ex - 带扩展选项加载共享库
+void* mini_dlopen_ex(const char* path, int flags, const mini_dlextinfo_t* extinfo) {
+    bool use_fd = extinfo && (extinfo->flags & MINI_DLEXT_USE_LIBRARY_FD);
+    if (!path && !use_fd) {
         linker_set_error("dlopen: path is NULL");
         return NULL;
     }
 
+    linker_load_opts_t opts = { .threads = 1 };
+    if (extinfo && (extinfo->flags & MINI_DLEXT_THREADS)) {
+        opts.threads = extinfo->threads > 0 ? extinfo->threads : thread_pool_cpu_count();
+    }
+    if (use_fd) {
+        opts.use_fd = true;
+        opts.fd = extinfo->library_fd;
+        if (extinfo->flags & MINI_DLEXT_USE_LIBRARY_FD_OFFSET) {
+            opts.offset = extinfo->library_fd_offset;
+        }
+    }
+    if (extinfo && (extinfo->flags & MINI_DLEXT_RELOC_CACHE)) {
+        opts.reloc_cache_dir = extinfo->reloc_cache_dir;
+    } else {
+        opts.reloc_cache_dir = getenv("MINI_LD_RELOC_CACHE");
+    }
+
+    // 加载和构造函数在同一个写者临界区内：其他线程的 dlopen 不会看到未初始化的库
+    linker_lock();
+
     // 加载库
-    soinfo_t* si = linker_load(path);
-    if (!si) {
+    soinfo_t* si = linker_load_ex(path, to_linker_flags(flags), &opts);
+    if (si && (flags & MINI_RTLD_DEFERRED_INIT)) {
+        // 构造函数推迟到第一次 dlsym
+        linker_defer_constructors(si);
+    } else if (si) {
+        // 调用构造函数
+        int init_threads = 1;
+        if (extinfo && (extinfo->flags & MINI_DLEXT_PARALLEL_INIT)) {
+            init_threads = opts.threads > 1 ? opts.threads : thread_pool_cpu_count();
+        }
+        linker_call_constructors_ex(si, init_threads);
+    }
+
+    linker_unlock();
+    return (void*)si;
+}
+
+// dlopen_fd - 从文件描述符加载共享库
+void* mini_dlopen_fd(int fd, off_t offset) {
+    mini_dlextinfo_t extinfo = {
+        .flags = MINI_DLEXT_USE_LIBRARY_FD | MINI_DLEXT_USE_LIBRARY_FD_OFFSET,
+        .library_fd = fd,
+        .library_fd_offset = offset,
+    };
+    return mini_dlopen_ex(NULL, MINI_RTLD_NOW, &extinfo);
+}
+
+// dlopen_mem - 从内存中的 ELF 镜像加载共享库
+void* mini_dlopen_mem(const void* data, size_t size) {
+    if (!data || size == 0) {
+        linker_set_error("dlopen_mem: empty image");
         return NULL;
     }
 
-    // 调用构造函数
-    linker_call_constructors(si);
+    // memfd 的页在页缓存中，段按 MAP_PRIVATE 映射，只读段不会被复制
+    int fd = memfd_create("mini_dlopen_mem", MFD_CLOEXEC);
+    if (fd < 0) {
+        linker_set_error("dlopen_mem: memfd_create failed: %s", strerror(errno));
+        return NULL;
+    }
 
-    return (void*)si;
+    const char* p = (const char*)data;
+    size_t left = size;
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            linker_set_error("dlopen_mem: write to memfd failed: %s", strerror(errno));
+            close(fd);
+            return NULL;
+        }
+        p += n;
+        left -= (size_t)n;
+    }
+
+    // 映射建立后 memfd 由映射持有，可以立即关闭
+    void* handle = mini_dlopen_fd(fd, 0);
+    close(fd);
+    return handle;
 }
 
 // dlsym - 获取符号地址
@@ -31,9 +132,13 @@ void* mini_dlsym(void* handle, const char* symbol) {
         return NULL;
     }
 
+    // 查找键只构造一次，hash 在各个库之间复用
+    symbol_name_t sn;
+    symbol_name_init(&sn, symbol);
+
     if (handle == MINI_RTLD_DEFAULT) {
         // 在所有已加载库中查找
-        void* addr = linker_find_global_symbol(symbol);
+        void* addr = linker_find_global_symbol_ex(&sn);
         if (!addr) {
             linker_set_error("dlsym: symbol not found: %s", symbol);
         }
@@ -46,9 +151,10 @@ void* mini_dlsym(void* handle, const char* symbol) {
         return NULL;
     }
 
-    // 在指定库中查找
+    // 在指定库中查找（第一次查找时构建该库的平铺符号表）
     soinfo_t* si = (soinfo_t*)handle;
-    void* addr = linker_find_symbol(si, symbol);
+    linker_run_deferred_constructors(si);
+    void* addr = linker_find_symbol_indexed(si, &sn);
 
     if (!addr) {
         linker_set_error("dlsym: symbol not found in %s: %s", si->name, symbol);
@@ -57,6 +163,181 @@ void* mini_dlsym(void* handle, const char* symbol) {
     return addr;
 }
 
+// dlvsym - 获取指定版本的符号地址
+void* mini_dlvsym(void* handle, const char* symbol, const char* version) {
+    if (!symbol || !version) {
+        linker_set_error("dlvsym: symbol or version is NULL");
+        return NULL;
+    }
+
+    symbol_name_t sn;
+    symbol_name_init(&sn, symbol);
+    symbol_name_set_version(&sn, version);
+
+    if (handle == MINI_RTLD_DEFAULT) {
+        void* addr = linker_find_global_symbol_ex(&sn);
+        if (!addr) {
+            linker_set_error("dlvsym: symbol not found: %s@%s", symbol, version);
+        }
+        return addr;
+    }
+
+    if (handle == MINI_RTLD_NEXT) {
+        linker_set_error("dlvsym: RTLD_NEXT not implemented");
+        return NULL;
+    }
+
+    soinfo_t* si = (soinfo_t*)handle;
+    linker_run_deferred_constructors(si);
+    void* addr = linker_find_symbol_indexed(si, &sn);
+    if (!addr) {
+        linker_set_error("dlvsym: symbol not found in %s: %s@%s", si->name, symbol, version);
+    }
+    return addr;
+}
+
+// dlsym_many - 批量获取符号地址
+size_t mini_dlsym_many(void* handle, const char* const* symbols, void** addrs, size_t count) {
+    if (!symbols || !addrs) {
+        linker_set_error("dlsym_many: symbols or addrs is NULL");
+        return 0;
+    }
+
+    if (handle == MINI_RTLD_NEXT) {
+        linker_set_error("dlsym_many: RTLD_NEXT not implemented");
+        return 0;
+    }
+
+    soinfo_t* si = handle == MINI_RTLD_DEFAULT ? NULL : (soinfo_t*)handle;
+    linker_run_deferred_constructors(si);
+    size_t found = linker_find_symbols(si, symbols, addrs, count);
+
+    if (found < count) {
+        // 与 dlsym 一致：报告第一个找不到的符号
+        for (size_t i = 0; i < count; i++) {
+            if (!addrs[i]) {
+                linker_set_error("dlsym_many: symbol not found: %s", symbols[i]);
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+// dladdr - 查找地址所在的库和符号
+int mini_dladdr(const void* addr, mini_dl_info_t* info) {
+    if (!info) {
+        linker_set_error("dladdr: info is NULL");
+        return 0;
+    }
+
+    // 临界区内库不会被释放，返回的字符串在 dlclose 之前都有效
+    rcu_read_lock();
+    soinfo_t* si = linker_find_library_by_addr(addr);
+    if (si) {
+        const ElfW(Sym)* sym = linker_find_symbol_by_addr(si, addr);
+        info->dli_fname = si->name;
+        info->dli_fbase = si->load_bias;
+        info->dli_sname = sym ? si->strtab + sym->st_name : NULL;
+        info->dli_saddr = sym ? (uint8_t*)si->load_bias + sym->st_value : NULL;
+    }
+    rcu_read_unlock();
+
+    if (!si) {
+        linker_set_error("dladdr: %p is not in any loaded library", addr);
+        return 0;
+    }
+    return 1;
+}
+
+// dl_iterate_phdr - 遍历已加载库的程序头
+int mini_dl_iterate_phdr(int (*callback)(struct dl_phdr_info* info, size_t size, void* data), void* data) {
+    if (!callback) {
+        linker_set_error("dl_iterate_phdr: callback is NULL");
+        return -1;
+    }
+
+    uint64_t adds, subs;
+    linker_list_counters(&adds, &subs);
+
+    int result = 0;
+    rcu_read_lock();
+    for (soinfo_t* si = linker_first_library(); si && result == 0; si = rcu_dereference(si->next)) {
+        struct dl_phdr_info info = {
+            .dlpi_addr = (ElfW(Addr))si->load_bias,
+            .dlpi_name = si->name,
+            .dlpi_phdr = si->phdr,
+            .dlpi_phnum = (ElfW(Half))si->phnum,
+            .dlpi_adds = adds,
+            .dlpi_subs = subs,
+            .dlpi_tls_modid = si->tls_module,
+            .dlpi_tls_data = linker_tls_block(si),
+        };
+        result = callback(&info, sizeof(info), data);
+    }
+    rcu_read_unlock();
+    return result;
+}
+
+// dlsym_stable - 获取符号的稳定槽
+void** mini_dlsym_stable(void* handle, const char* symbol) {
+    if (!handle || handle == MINI_RTLD_NEXT || !symbol) {
+        linker_set_error("dlsym_stable: invalid handle or symbol is NULL");
+        return NULL;
+    }
+
+    linker_run_deferred_constructors((soinfo_t*)handle);
+    linker_slot_t* slot = linker_get_slot((soinfo_t*)handle, symbol);
+    return slot ? &slot->addr : NULL;
+}
+
+void mini_dlslot_enter(void) {
+    rcu_read_lock();
+}
+
+void mini_dlslot_exit(void) {
+    rcu_read_unlock();
+}
+
+// dlreload - 热替换共享库
+void* mini_dlreload(void* handle, const char* path, int flags) {
+    if (!handle || handle == MINI_RTLD_NEXT) {
+        linker_set_error("dlreload: invalid handle");
+        return NULL;
+    }
+
+    soinfo_t* retired = NULL;
+    soinfo_t* si = linker_reload((soinfo_t*)handle, path, to_linker_flags(flags), &retired);
+    if (!si) {
+        return NULL;
+    }
+
+    // 槽已经指向新版本：等待仍可能在旧版本中执行的调用结束，再卸载旧版本
+    // （不持有写者锁，其他线程的加载不受宽限期影响）
+    rcu_synchronize();
+    linker_unload(retired);
+    return si;
+}
+
+// dlstats - 获取库的加载统计
+int mini_dlstats(void* handle, linker_stats_t* stats) {
+    if (!handle || handle == MINI_RTLD_NEXT || !stats) {
+        linker_set_error("dlstats: invalid handle or stats is NULL");
+        return -1;
+    }
+    return linker_get_stats((soinfo_t*)handle, stats);
+}
+
+// dlstats_dump - 以 JSON Lines 格式输出加载统计
+int mini_dlstats_dump(void* handle, FILE* out) {
+    if (handle == MINI_RTLD_NEXT || !out) {
+        linker_set_error("dlstats_dump: invalid handle or out is NULL");
+        return -1;
+    }
+    linker_dump_stats(handle == MINI_RTLD_DEFAULT ? NULL : (soinfo_t*)handle, out);
+    return 0;
+}
+
 // dlclose - 关闭共享库
 int mini_dlclose(void* handle) {
     if (!handle) {
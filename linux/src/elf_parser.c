@@ -8,7 +8,7 @@
 #include <sys/stat.h>
 
 // 验证 ELF 头
-int elf_validate_header(const Elf64_Ehdr* ehdr) {
+int elf_validate_header(const ElfW(Ehdr)* ehdr) {
     // 检查 ELF 魔数
     if (ehdr->e_ident[EI_MAG0] != ELFMAG0 ||
         ehdr->e_ident[EI_MAG1] != ELFMAG1 ||
@@ -18,9 +18,9 @@ int elf_validate_header(const Elf64_Ehdr* ehdr) {
         return -1;
     }
 
-    // 检查 64 位
-    if (ehdr->e_ident[EI_CLASS] != ELFCLASS64) {
-        fprintf(stderr, "Error: Not a 64-bit ELF\n");
+    // 检查 ELF 类别与链接器自身一致（ELF64 / ARM 为 ELF32）
+    if (ehdr->e_ident[EI_CLASS] != LINKER_ELFCLASS) {
+        fprintf(stderr, "Error: Not a %d-bit ELF\n", LINKER_ELFCLASS == ELFCLASS64 ? 64 : 32);
         return -1;
     }
 
@@ -36,15 +36,67 @@ int elf_validate_header(const Elf64_Ehdr* ehdr) {
         return -1;
     }
 
-    // 检查是 x86_64 架构
-    if (ehdr->e_machine != EM_X86_64) {
-        fprintf(stderr, "Error: Not x86_64 architecture\n");
+    // 检查架构与链接器自身一致
+    if (ehdr->e_machine != LINKER_EM) {
+        fprintf(stderr, "Error: Not " LINKER_ARCH_NAME " architecture\n");
         return -1;
     }
 
     return 0;
 }
 
+// 读取 ELF 头和程序头表
+int elf_read_header(int fd, off_t offset, elf_header_t* hdr) {
+    hdr->ehdr = NULL;
+    hdr->phdr = NULL;
+    hdr->phdr_alloc = NULL;
+
+    // 一次 pread 读取文件开头，大多数库的程序头表紧跟在 ELF 头后面
+    ssize_t n = pread(fd, hdr->buf, sizeof(hdr->buf), offset);
+    if (n < (ssize_t)sizeof(ElfW(Ehdr))) {
+        fprintf(stderr, "Error: File too small for an ELF header\n");
+        return -1;
+    }
+
+    ElfW(Ehdr)* ehdr = (ElfW(Ehdr)*)hdr->buf;
+    if (elf_validate_header(ehdr) < 0) {
+        return -1;
+    }
+    if (ehdr->e_phnum == 0 || ehdr->e_phentsize != sizeof(ElfW(Phdr))) {
+        fprintf(stderr, "Error: Invalid program header table\n");
+        return -1;
+    }
+    hdr->ehdr = ehdr;
+
+    size_t phdr_size = (size_t)ehdr->e_phnum * sizeof(ElfW(Phdr));
+    if (ehdr->e_phoff % sizeof(ElfW(Addr)) == 0 &&
+        ehdr->e_phoff <= (size_t)n && phdr_size <= (size_t)n - ehdr->e_phoff) {
+        hdr->phdr = (ElfW(Phdr)*)(hdr->buf + ehdr->e_phoff);
+        return 0;
+    }
+
+    // 程序头表不在第一块里，单独读一次
+    hdr->phdr_alloc = malloc(phdr_size);
+    if (!hdr->phdr_alloc) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return -1;
+    }
+    if (pread(fd, hdr->phdr_alloc, phdr_size, offset + (off_t)ehdr->e_phoff) != (ssize_t)phdr_size) {
+        fprintf(stderr, "Error: Failed to read program headers\n");
+        elf_header_release(hdr);
+        return -1;
+    }
+    hdr->phdr = (ElfW(Phdr)*)hdr->phdr_alloc;
+    return 0;
+}
+
+// 释放 ELF 头信息
+void elf_header_release(elf_header_t* hdr) {
+    free(hdr->phdr_alloc);
+    hdr->phdr_alloc = NULL;
+    hdr->phdr = NULL;
+}
+
 // 打开并映射 ELF 文件
 int elf_open(const char* path, elf_file_t* elf) {
     struct stat st;
@@ -75,7 +127,7 @@ int elf_open(const char* path, elf_file_t* elf) {
     }
 
     // 解析 ELF 头
-    elf->ehdr = (Elf64_Ehdr*)elf->map_start;
+    elf->ehdr = (ElfW(Ehdr)*)elf->map_start;
     if (elf_validate_header(elf->ehdr) < 0) {
         munmap(elf->map_start, elf->map_size);
         close(elf->fd);
@@ -84,16 +136,16 @@ int elf_open(const char* path, elf_file_t* elf) {
 
     // 解析程序头表
     if (elf->ehdr->e_phoff != 0) {
-        elf->phdr = (Elf64_Phdr*)((uint8_t*)elf->map_start + elf->ehdr->e_phoff);
+        elf->phdr = (ElfW(Phdr)*)((uint8_t*)elf->map_start + elf->ehdr->e_phoff);
     }
 
     // 解析节头表
     if (elf->ehdr->e_shoff != 0) {
-        elf->shdr = (Elf64_Shdr*)((uint8_t*)elf->map_start + elf->ehdr->e_shoff);
+        elf->shdr = (ElfW(Shdr)*)((uint8_t*)elf->map_start + elf->ehdr->e_shoff);
 
         // 获取节字符串表
         if (elf->ehdr->e_shstrndx != SHN_UNDEF) {
-            Elf64_Shdr* shstrtab_hdr = &elf->shdr[elf->ehdr->e_shstrndx];
+            ElfW(Shdr)* shstrtab_hdr = &elf->shdr[elf->ehdr->e_shstrndx];
             elf->shstrtab = (const char*)((uint8_t*)elf->map_start + shstrtab_hdr->sh_offset);
         }
     }
@@ -114,7 +166,7 @@ void elf_close(elf_file_t* elf) {
 }
 
 // 查找程序头
-Elf64_Phdr* elf_find_phdr(elf_file_t* elf, uint32_t type) {
+ElfW(Phdr)* elf_find_phdr(elf_file_t* elf, uint32_t type) {
     if (!elf->phdr) return NULL;
 
     for (size_t i = 0; i < elf->ehdr->e_phnum; i++) {
@@ -126,7 +178,7 @@ Elf64_Phdr* elf_find_phdr(elf_file_t* elf, uint32_t type) {
 }
 
 // 查找节
-Elf64_Shdr* elf_find_section(elf_file_t* elf, const char* name) {
+ElfW(Shdr)* elf_find_section(elf_file_t* elf, const char* name) {
     if (!elf->shdr || !elf->shstrtab) return NULL;
 
     for (size_t i = 0; i < elf->ehdr->e_shnum; i++) {
@@ -139,7 +191,7 @@ Elf64_Shdr* elf_find_section(elf_file_t* elf, const char* name) {
 }
 
 // 获取节数据
-void* elf_get_section_data(elf_file_t* elf, Elf64_Shdr* shdr) {
+void* elf_get_section_data(elf_file_t* elf, ElfW(Shdr)* shdr) {
     if (!shdr) return NULL;
     return (uint8_t*)elf->map_start + shdr->sh_offset;
 }
@@ -156,7 +208,7 @@ void elf_print_info(elf_file_t* elf) {
     printf("\n=== Program Headers ===\n");
     if (elf->phdr) {
         for (size_t i = 0; i < elf->ehdr->e_phnum; i++) {
-            Elf64_Phdr* ph = &elf->phdr[i];
+            ElfW(Phdr)* ph = &elf->phdr[i];
             const char* type_name;
             switch (ph->p_type) {
                 case PT_NULL:    type_name = "NULL"; break;
@@ -185,7 +237,7 @@ void elf_print_info(elf_file_t* elf) {
     printf("\n=== Sections ===\n");
     if (elf->shdr && elf->shstrtab) {
         for (size_t i = 0; i < elf->ehdr->e_shnum; i++) {
-            Elf64_Shdr* sh = &elf->shdr[i];
+            ElfW(Shdr)* sh = &elf->shdr[i];
             const char* name = elf->shstrtab + sh->sh_name;
             printf("[%2zu] %-20s addr=0x%08lx size=0x%06lx\n",
                    i, name,
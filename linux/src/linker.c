@@ -43,6 +43,10 @@
 #include "linker.h"
 #include "elf_parser.h"
 #include "log.h"
+#include "thread_pool.h"
+#include "rcu.h"
+#include "reloc_cache.h"
+#include "linker_tls.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -51,6 +55,10 @@
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <limits.h>
+#include <pthread.h>
 #include <dlfcn.h>  /* 用于 dlsym(RTLD_DEFAULT, ...) 从系统库查找符号 */
 
 /* =============================================================================
@@ -61,11 +69,33 @@
 /*
  * 全局链接器状态
  * - soinfo_list: 已加载库的链表头
- * - error_msg: 最近一次错误信息
- * - has_error: 是否有错误发生
+ * - name_index / inode_index: 已加载库索引
+ * - symcache: 全局符号缓存
+ *
+ * 并发模型：
+ *   - 写者（加载、卸载、构造/析构函数）持有可重入的 g_linker_lock，互相串行
+ *   - 读者（全局符号查找、dlsym）不加锁，用 RCU 读侧临界区访问
+ *     soinfo_list 和符号缓存；写者摘除节点后等待宽限期再释放
+ *   - 符号缓存的插入可能来自任意读者，由 g_symcache_lock 串行化
+ *   - 错误信息是线程局部的（与 dlerror 相同）
  */
 static linker_state_t g_linker = {0};
 
+static pthread_mutex_t g_linker_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static pthread_mutex_t g_symcache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* soinfo 对象池（由写者锁保护）：所有 soinfo 集中在少数几个相邻的 slab 中 */
+#define SOINFO_PER_SLAB 32
+static pool_t g_soinfo_pool = POOL_INITIALIZER(sizeof(soinfo_t), SOINFO_PER_SLAB);
+
+/* 每个库的 arena 块大小：名字、依赖数组通常一块就放得下 */
+#define SOINFO_ARENA_CHUNK 1024
+
+/* 线程局部的错误状态 */
+#define LINKER_ERROR_MAX 512
+static __thread char t_error_msg[LINKER_ERROR_MAX];
+static __thread bool t_has_error = false;
+
 /* =============================================================================
  * 内存页对齐宏
  * =============================================================================
@@ -84,6 +114,32 @@ static linker_state_t g_linker = {0};
 #define PAGE_END(x) PAGE_START((x) + PAGE_SIZE - 1)     /* 向上对齐 */
 #define PAGE_OFFSET(x) ((x) & ~PAGE_MASK)               /* 页内偏移 */
 
+/* x86_64 透明大页（PMD 级别）的大小 */
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+
+/* =============================================================================
+ * Android 扩展的动态段标签
+ * =============================================================================
+ *
+ * 这些标签由 bionic linker 定义，标准 elf.h 中没有。
+ * 使用 lld 的 --pack-dyn-relocs=android 生成。
+ */
+#define DT_ANDROID_REL      (DT_LOOS + 2)           /* 0x6000000f */
+#define DT_ANDROID_RELSZ    (DT_LOOS + 3)           /* 0x60000010 */
+#define DT_ANDROID_RELA     (DT_LOOS + 4)           /* 0x60000011 */
+#define DT_ANDROID_RELASZ   (DT_LOOS + 5)           /* 0x60000012 */
+#define DT_ANDROID_RELR     0x6fffe000              /* 早期的 RELR 标签 */
+#define DT_ANDROID_RELRSZ   0x6fffe001
+
+/* 本架构使用的打包重定位标签（RELA 架构为 DT_ANDROID_RELA，ARM32 为 DT_ANDROID_REL）*/
+#if ARCH_USE_RELA
+#define DT_LINKER_ANDROID_REL   DT_ANDROID_RELA
+#define DT_LINKER_ANDROID_RELSZ DT_ANDROID_RELASZ
+#else
+#define DT_LINKER_ANDROID_REL   DT_ANDROID_REL
+#define DT_LINKER_ANDROID_RELSZ DT_ANDROID_RELSZ
+#endif
+
 /* =============================================================================
  * 错误处理函数
  * =============================================================================
@@ -96,7 +152,27 @@ static linker_state_t g_linker = {0};
  * 应该在程序开始时调用一次。
  */
 void linker_init(void) {
+    linker_lock();
+    linker_flush_symbol_cache();
+    rcu_reclaim();
     memset(&g_linker, 0, sizeof(g_linker));
+    linker_unlock();
+}
+
+/**
+ * linker_lock - 获取写者锁
+ *
+ * 锁是可重入的：构造函数里再调用 mini_dlopen 不会死锁。
+ */
+void linker_lock(void) {
+    pthread_mutex_lock(&g_linker_lock);
+}
+
+/**
+ * linker_unlock - 释放写者锁
+ */
+void linker_unlock(void) {
+    pthread_mutex_unlock(&g_linker_lock);
 }
 
 /**
@@ -104,29 +180,29 @@ void linker_init(void) {
  * @fmt: printf 风格的格式字符串
  * @...: 可变参数
  *
- * 类似于 dlerror() 的实现，保存最近一次的错误信息。
+ * 类似于 dlerror() 的实现，保存当前线程最近一次的错误信息。
  * 使用 vsnprintf 防止缓冲区溢出。
  */
 void linker_set_error(const char* fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    vsnprintf(g_linker.error_msg, sizeof(g_linker.error_msg), fmt, args);
+    vsnprintf(t_error_msg, sizeof(t_error_msg), fmt, args);
     va_end(args);
-    g_linker.has_error = true;
+    t_has_error = true;
 }
 
 /**
  * linker_get_error - 获取错误信息
  *
- * 返回最近一次的错误信息，并清除错误状态。
+ * 返回当前线程最近一次的错误信息，并清除错误状态。
  * 这与标准 dlerror() 的行为一致：每次调用后错误会被清除。
  *
  * 返回: 错误信息字符串，如果没有错误则返回 NULL
  */
 const char* linker_get_error(void) {
-    if (g_linker.has_error) {
-        g_linker.has_error = false;
-        return g_linker.error_msg;
+    if (t_has_error) {
+        t_has_error = false;
+        return t_error_msg;
     }
     return NULL;
 }
@@ -137,8 +213,8 @@ const char* linker_get_error(void) {
  * 手动清除错误标志和错误信息。
  */
 void linker_clear_error(void) {
-    g_linker.has_error = false;
-    g_linker.error_msg[0] = '\0';
+    t_has_error = false;
+    t_error_msg[0] = '\0';
 }
 
 /* =============================================================================
@@ -169,9 +245,9 @@ void linker_clear_error(void) {
  *
  * 返回: 页对齐后的总大小，如果没有可加载段则返回 0
  */
-static size_t calculate_load_size(Elf64_Phdr* phdr, size_t phnum) {
-    Elf64_Addr min_vaddr = (Elf64_Addr)-1;  /* 初始化为最大值 */
-    Elf64_Addr max_vaddr = 0;
+static size_t calculate_load_size(ElfW(Phdr)* phdr, size_t phnum) {
+    ElfW(Addr) min_vaddr = (ElfW(Addr))-1;  /* 初始化为最大值 */
+    ElfW(Addr) max_vaddr = 0;
 
     /* 遍历所有程序头，只关心 PT_LOAD 类型 */
     for (size_t i = 0; i < phnum; i++) {
@@ -183,7 +259,7 @@ static size_t calculate_load_size(Elf64_Phdr* phdr, size_t phnum) {
         }
 
         /* 更新最大虚拟地址 (段起始 + 内存大小) */
-        Elf64_Addr end = phdr[i].p_vaddr + phdr[i].p_memsz;
+        ElfW(Addr) end = phdr[i].p_vaddr + phdr[i].p_memsz;
         if (end > max_vaddr) {
             max_vaddr = end;
         }
@@ -219,16 +295,245 @@ static int elf_to_mmap_prot(uint32_t p_flags) {
     return prot;
 }
 
+/**
+ * reserve_aligned - 预留地址空间，使 base + align_off 按 align 对齐
+ * @size: 预留大小（页对齐）
+ * @align: 对齐粒度（2 的幂）
+ * @align_off: 需要对齐的位置在预留区中的偏移（页对齐）
+ *
+ * 多预留 align 字节，再把首尾多余的部分释放掉。
+ *
+ * 返回: 预留区起始地址，失败返回 MAP_FAILED
+ */
+static void* reserve_aligned(size_t size, size_t align, size_t align_off) {
+    size_t span = size + align;
+    uint8_t* raw = (uint8_t*)mmap(NULL, span, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return MAP_FAILED;
+
+    uintptr_t target = ((uintptr_t)raw + align_off + align - 1) & ~(uintptr_t)(align - 1);
+    uint8_t* base = (uint8_t*)(target - align_off);
+    if (base > raw) {
+        munmap(raw, base - raw);
+    }
+    if (raw + span > base + size) {
+        munmap(base + size, raw + span - (base + size));
+    }
+    return base;
+}
+
+/**
+ * remap_huge - 把 [start, end) 中按 2MB 对齐的部分换成匿名大页
+ * @start: 区间起始地址（已映射）
+ * @end: 区间结束地址
+ * @prot: 替换后的访问权限
+ *
+ * 文件映射的代码段只有在文件偏移也按 2MB 对齐、且内核支持只读文件 THP 时
+ * 才可能用上大页，普通的 .so 都不满足。这里把内容复制到一块 2MB 对齐、
+ * MADV_HUGEPAGE 的匿名内存中，再用 mremap 原子地替换原来的映射。
+ * 代价是这些页不再与其他进程共享页缓存。
+ *
+ * 返回: 换成大页的字节数（失败时原映射保持不变，返回 0）
+ */
+static size_t remap_huge(ElfW(Addr) start, ElfW(Addr) end, int prot) {
+    ElfW(Addr) huge_start = (start + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    ElfW(Addr) huge_end = end & ~(HUGE_PAGE_SIZE - 1);
+    if (huge_end <= huge_start) return 0;
+
+    size_t len = huge_end - huge_start;
+    void* huge = reserve_aligned(len, HUGE_PAGE_SIZE, 0);
+    if (huge == MAP_FAILED) return 0;
+
+    if (mprotect(huge, len, PROT_READ | PROT_WRITE) < 0) {
+        munmap(huge, len);
+        return 0;
+    }
+    madvise(huge, len, MADV_HUGEPAGE);
+    memcpy(huge, (void*)huge_start, len);
+
+    if (mprotect(huge, len, prot) < 0 ||
+        mremap(huge, len, len, MREMAP_MAYMOVE | MREMAP_FIXED, (void*)huge_start) == MAP_FAILED) {
+        munmap(huge, len);
+        return 0;
+    }
+    return len;
+}
+
+/* =============================================================================
+ * 加载统计
+ * =============================================================================
+ *
+ * 每个 soinfo 内嵌一份 linker_stats_t，记录：
+ *   - 各阶段耗时（CLOCK_MONOTONIC，纳秒）
+ *   - 按类型的重定位数、按来源的符号查找数
+ *   - 映射的字节数、加载期间的缺页数（getrusage(RUSAGE_THREAD) 的差值）
+ *
+ * 重定位可能被切分给多个线程，每个任务先在本地的 reloc_ctx_t 中计数，
+ * 结束时再用原子加法一次性合并，热路径上没有共享写入。
+ */
+
+static const char* const g_phase_names[LINKER_PHASE_COUNT] = {
+    "open", "reserve", "map", "dynamic", "relocate", "init"
+};
+
+static const char* const g_lookup_names[LINKER_LOOKUP_COUNT] = {
+    "local", "global", "system", "miss"
+};
+
+const char* linker_phase_name(linker_phase_t phase) {
+    return (unsigned)phase < LINKER_PHASE_COUNT ? g_phase_names[phase] : "unknown";
+}
+
+const char* linker_lookup_kind_name(linker_lookup_kind_t kind) {
+    return (unsigned)kind < LINKER_LOOKUP_COUNT ? g_lookup_names[kind] : "unknown";
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* 一段被统计区间的起点：时间和当前线程的缺页数 */
+typedef struct {
+    uint64_t start_ns;
+    uint64_t minor_faults;
+    uint64_t major_faults;
+} stats_span_t;
+
+static void span_begin(stats_span_t* span) {
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    span->minor_faults = (uint64_t)ru.ru_minflt;
+    span->major_faults = (uint64_t)ru.ru_majflt;
+    span->start_ns = now_ns();
+}
+
+/* 区间结束：耗时计入 phase，缺页计入 stats */
+static void span_end(const stats_span_t* span, linker_stats_t* stats, linker_phase_t phase) {
+    stats->phase_ns[phase] += now_ns() - span->start_ns;
+
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    stats->minor_faults += (uint64_t)ru.ru_minflt - span->minor_faults;
+    stats->major_faults += (uint64_t)ru.ru_majflt - span->major_faults;
+}
+
+/* 结束当前阶段并立即开始下一阶段 */
+static void span_next(stats_span_t* span, linker_stats_t* stats, linker_phase_t phase) {
+    span_end(span, stats, phase);
+    span_begin(span);
+}
+
+static void stats_count_reloc(linker_stats_t* stats, uint32_t type, uint64_t n) {
+    uint32_t slot = ARCH_RELOC_STAT_INDEX(type);
+    stats->relocs[slot < LINKER_STATS_RELOC_TYPES ? slot : LINKER_STATS_RELOC_TYPES - 1] += n;
+}
+
+/**
+ * stats_merge - 把本地统计累加到库的统计中
+ * @dst: 库的统计（可能被多个线程同时累加）
+ * @src: 本地统计
+ */
+static void stats_merge(linker_stats_t* dst, const linker_stats_t* src) {
+    _Static_assert(sizeof(linker_stats_t) % sizeof(uint64_t) == 0,
+                   "linker_stats_t must consist of uint64_t counters");
+    uint64_t* d = (uint64_t*)dst;
+    const uint64_t* v = (const uint64_t*)src;
+    for (size_t i = 0; i < sizeof(linker_stats_t) / sizeof(uint64_t); i++) {
+        if (v[i]) __atomic_fetch_add(&d[i], v[i], __ATOMIC_RELAXED);
+    }
+}
+
 /* =============================================================================
  * 动态段解析
  * =============================================================================
  */
 
+/**
+ * parse_versions - 把 DT_VERDEF / DT_VERNEED 展开成按版本索引访问的数组
+ * @si: 共享库信息（字符串表已确定）
+ *
+ * .gnu.version 中每个符号只记录一个 16 位的版本索引（最高位 HIDDEN
+ * 表示非默认版本）。定义和依赖的版本共用同一个索引空间：
+ *
+ *   ElfW(Verdef)  vd_ndx  -> vd_hash,  Verdaux.vda_name   （本库定义的版本）
+ *   ElfW(Vernaux) vna_other -> vna_hash, vna_name          （本库依赖的版本）
+ *
+ * 两张表都是变长链表（vd_next / vn_next / vna_next 是相对偏移），
+ * 这里只遍历一次，之后按索引直接取版本名和 hash。
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+static int parse_versions(soinfo_t* si) {
+    if (!si->versym) return 0;
+
+    /* 第一遍：找出最大的版本索引 */
+    size_t max_index = VER_NDX_GLOBAL;
+    const uint8_t* p = (const uint8_t*)si->verdef;
+    for (size_t i = 0; p && i < si->verdef_count; i++) {
+        const ElfW(Verdef)* vd = (const ElfW(Verdef)*)p;
+        if ((size_t)(vd->vd_ndx & 0x7fff) > max_index) max_index = vd->vd_ndx & 0x7fff;
+        if (vd->vd_next == 0) break;
+        p += vd->vd_next;
+    }
+    p = (const uint8_t*)si->verneed;
+    for (size_t i = 0; p && i < si->verneed_count; i++) {
+        const ElfW(Verneed)* vn = (const ElfW(Verneed)*)p;
+        const uint8_t* a = p + vn->vn_aux;
+        for (size_t j = 0; j < vn->vn_cnt; j++) {
+            const ElfW(Vernaux)* vna = (const ElfW(Vernaux)*)a;
+            if ((size_t)(vna->vna_other & 0x7fff) > max_index) max_index = vna->vna_other & 0x7fff;
+            if (vna->vna_next == 0) break;
+            a += vna->vna_next;
+        }
+        if (vn->vn_next == 0) break;
+        p += vn->vn_next;
+    }
+
+    si->versions = (symbol_version_t*)arena_alloc(&si->arena, (max_index + 1) * sizeof(symbol_version_t));
+    if (!si->versions) {
+        linker_set_error("Out of memory");
+        return -1;
+    }
+    si->version_count = max_index + 1;
+
+    /* 第二遍：填写版本名和 hash */
+    p = (const uint8_t*)si->verdef;
+    for (size_t i = 0; p && i < si->verdef_count; i++) {
+        const ElfW(Verdef)* vd = (const ElfW(Verdef)*)p;
+        const ElfW(Verdaux)* aux = (const ElfW(Verdaux)*)(p + vd->vd_aux);
+        symbol_version_t* v = &si->versions[vd->vd_ndx & 0x7fff];
+        v->name = si->strtab + aux->vda_name;
+        v->hash = vd->vd_hash;
+        v->defined = true;
+        if (vd->vd_next == 0) break;
+        p += vd->vd_next;
+    }
+    p = (const uint8_t*)si->verneed;
+    for (size_t i = 0; p && i < si->verneed_count; i++) {
+        const ElfW(Verneed)* vn = (const ElfW(Verneed)*)p;
+        const uint8_t* a = p + vn->vn_aux;
+        for (size_t j = 0; j < vn->vn_cnt; j++) {
+            const ElfW(Vernaux)* vna = (const ElfW(Vernaux)*)a;
+            symbol_version_t* v = &si->versions[vna->vna_other & 0x7fff];
+            v->name = si->strtab + vna->vna_name;
+            v->hash = vna->vna_hash;
+            v->defined = false;
+            if (vna->vna_next == 0) break;
+            a += vna->vna_next;
+        }
+        if (vn->vn_next == 0) break;
+        p += vn->vn_next;
+    }
+
+    return 0;
+}
+
 /**
  * parse_dynamic - 解析动态段 (PT_DYNAMIC)
  * @si: 共享库信息结构体
  *
- * 动态段包含了动态链接所需的所有信息，是一个 Elf64_Dyn 数组，
+ * 动态段包含了动态链接所需的所有信息，是一个 ElfW(Dyn) 数组，
  * 每个条目包含一个标签 (d_tag) 和一个值 (d_un)。
  *
  * 重要的动态段标签：
@@ -240,10 +545,21 @@ static int elf_to_mmap_prot(uint32_t p_flags) {
  *   DT_STRSZ       | 字符串表大小
  *   DT_HASH        | ELF hash 表地址（用于符号查找加速）
  *   DT_GNU_HASH    | GNU hash 表地址（更快的符号查找）
- *   DT_RELA        | RELA 重定位表地址
+ *   DT_RELA        | RELA 重定位表地址（ARM32 为 DT_REL，下同）
  *   DT_RELASZ      | RELA 重定位表大小
+ *   DT_RELACOUNT   | RELA 表开头连续 RELATIVE 条目的个数
+ *   DT_RELR        | 压缩的相对重定位（位图格式）
+ *   DT_ANDROID_RELA| Android 打包重定位（APS2 格式）
  *   DT_JMPREL      | PLT 重定位表地址
  *   DT_PLTRELSZ    | PLT 重定位表大小
+ *   DT_PLTGOT      | .got.plt 地址（延迟绑定时写入 GOT[1]/GOT[2]）
+ *   DT_FLAGS(_1)   | 标志位，这里只关心 BIND_NOW 和 STATIC_TLS
+ *   DT_VERSYM      | 每个动态符号的版本索引（.gnu.version）
+ *   DT_VERDEF(NUM) | 本库定义的版本（.gnu.version_d）
+ *   DT_VERNEED(NUM)| 本库依赖的版本（.gnu.version_r）
+ *   DT_NEEDED      | 依赖库名（在加载依赖时再遍历）
+ *   DT_SONAME      | 库自身的名字
+ *   DT_RUNPATH     | 依赖搜索路径（没有时使用旧式的 DT_RPATH）
  *   DT_INIT        | 初始化函数地址
  *   DT_FINI        | 析构函数地址
  *   DT_INIT_ARRAY  | 初始化函数数组地址
@@ -257,17 +573,22 @@ static int parse_dynamic(soinfo_t* si) {
         return -1;
     }
 
+    /* 字符串类的条目要等 DT_STRTAB 确定之后才能解析 */
+    ElfW(Dyn)* soname_dyn = NULL;
+    ElfW(Dyn)* runpath_dyn = NULL;
+    ElfW(Dyn)* rpath_dyn = NULL;
+
     /*
      * 遍历动态段数组，直到遇到 DT_NULL 结束标记。
      * 每个条目的 d_un 是一个联合体，可能是地址 (d_ptr) 或值 (d_val)。
      * 这里的地址是相对于文件开头的偏移，需要加上 load_bias 得到实际内存地址。
      */
-    for (Elf64_Dyn* d = si->dynamic; d->d_tag != DT_NULL; d++) {
+    for (ElfW(Dyn)* d = si->dynamic; d->d_tag != DT_NULL; d++) {
         switch (d->d_tag) {
             /* ============ 符号表相关 ============ */
             case DT_SYMTAB:
                 /* 符号表：包含所有符号的定义 */
-                si->symtab = (Elf64_Sym*)((uint8_t*)si->load_bias + d->d_un.d_ptr);
+                si->symtab = (ElfW(Sym)*)((uint8_t*)si->load_bias + d->d_un.d_ptr);
                 break;
 
             case DT_STRTAB:
@@ -301,24 +622,87 @@ static int parse_dynamic(soinfo_t* si) {
                 break;
 
             /* ============ 重定位表 ============ */
-            case DT_RELA:
-                /* RELA 重定位表：用于修正数据引用 */
-                si->rela = (Elf64_Rela*)((uint8_t*)si->load_bias + d->d_un.d_ptr);
+            case DT_LINKER_REL:
+                /* RELA（ARM32 为 REL）重定位表：用于修正数据引用 */
+                si->rela = (linker_rel_t*)((uint8_t*)si->load_bias + d->d_un.d_ptr);
+                break;
+
+            case DT_LINKER_RELSZ:
+                /* 表大小，除以条目大小得到条目数 */
+                si->rela_count = d->d_un.d_val / sizeof(linker_rel_t);
+                break;
+
+            case DT_LINKER_RELCOUNT:
+                /*
+                 * 链接器把所有 RELATIVE 排在重定位表最前面，
+                 * 并用 DT_RELACOUNT 记录它们的个数 (-z combreloc，默认开启)
+                 */
+                si->relative_count = d->d_un.d_val;
+                break;
+
+            case DT_RELR:
+            case DT_ANDROID_RELR:
+                /* RELR：只编码地址的相对重定位，每个条目 8 字节可覆盖最多 63 个位置 */
+                si->relr = (ElfW(Relr)*)((uint8_t*)si->load_bias + d->d_un.d_ptr);
+                break;
+
+            case DT_RELRSZ:
+            case DT_ANDROID_RELRSZ:
+                si->relr_count = d->d_un.d_val / sizeof(ElfW(Relr));
+                break;
+
+            case DT_LINKER_ANDROID_REL:
+                /* Android 打包重定位：SLEB128 编码的分组 RELA（ARM32 为 REL）流 */
+                si->android_rela = (const uint8_t*)si->load_bias + d->d_un.d_ptr;
                 break;
 
-            case DT_RELASZ:
-                /* RELA 表大小，除以条目大小得到条目数 */
-                si->rela_count = d->d_un.d_val / sizeof(Elf64_Rela);
+            case DT_LINKER_ANDROID_RELSZ:
+                si->android_rela_size = d->d_un.d_val;
                 break;
 
             case DT_JMPREL:
                 /* PLT 重定位表：用于修正函数调用 */
-                si->plt_rela = (Elf64_Rela*)((uint8_t*)si->load_bias + d->d_un.d_ptr);
+                si->plt_rela = (linker_rel_t*)((uint8_t*)si->load_bias + d->d_un.d_ptr);
                 break;
 
             case DT_PLTRELSZ:
                 /* PLT 重定位表大小 */
-                si->plt_rela_count = d->d_un.d_val / sizeof(Elf64_Rela);
+                si->plt_rela_count = d->d_un.d_val / sizeof(linker_rel_t);
+                break;
+
+            case DT_PLTGOT:
+                /* .got.plt：GOT[0] 是 _DYNAMIC，GOT[1]/GOT[2] 留给动态链接器 */
+                si->plt_got = (ElfW(Addr)*)((uint8_t*)si->load_bias + d->d_un.d_ptr);
+                break;
+
+            case DT_FLAGS:
+                if (d->d_un.d_val & DF_BIND_NOW) si->bind_now = true;
+                if (d->d_un.d_val & DF_STATIC_TLS) si->tls_static_required = true;
+                break;
+
+            case DT_FLAGS_1:
+                if (d->d_un.d_val & DF_1_NOW) si->bind_now = true;
+                break;
+
+            /* ============ 符号版本 ============ */
+            case DT_VERSYM:
+                si->versym = (ElfW(Half)*)((uint8_t*)si->load_bias + d->d_un.d_ptr);
+                break;
+
+            case DT_VERDEF:
+                si->verdef = (ElfW(Verdef)*)((uint8_t*)si->load_bias + d->d_un.d_ptr);
+                break;
+
+            case DT_VERDEFNUM:
+                si->verdef_count = d->d_un.d_val;
+                break;
+
+            case DT_VERNEED:
+                si->verneed = (ElfW(Verneed)*)((uint8_t*)si->load_bias + d->d_un.d_ptr);
+                break;
+
+            case DT_VERNEEDNUM:
+                si->verneed_count = d->d_un.d_val;
                 break;
 
             /* ============ 初始化/析构函数 ============ */
@@ -351,6 +735,19 @@ static int parse_dynamic(soinfo_t* si) {
                 /* 析构函数数组大小 */
                 si->fini_array_count = d->d_un.d_val / sizeof(void*);
                 break;
+
+            /* ============ 库名与依赖搜索路径 ============ */
+            case DT_SONAME:
+                soname_dyn = d;
+                break;
+
+            case DT_RUNPATH:
+                runpath_dyn = d;
+                break;
+
+            case DT_RPATH:
+                rpath_dyn = d;
+                break;
         }
     }
 
@@ -360,7 +757,17 @@ static int parse_dynamic(soinfo_t* si) {
         return -1;
     }
 
-    return 0;
+    if (soname_dyn) {
+        si->soname = si->strtab + soname_dyn->d_un.d_val;
+    }
+    /* 与 glibc 一致：存在 DT_RUNPATH 时忽略 DT_RPATH */
+    if (runpath_dyn) {
+        si->runpath = si->strtab + runpath_dyn->d_un.d_val;
+    } else if (rpath_dyn) {
+        si->runpath = si->strtab + rpath_dyn->d_un.d_val;
+    }
+
+    return parse_versions(si);
 }
 
 /* =============================================================================
@@ -372,19 +779,49 @@ static int parse_dynamic(soinfo_t* si) {
  * get_symbol_count - 获取符号数量
  * @si: 共享库信息
  *
- * 从 ELF hash 表获取符号数量。
- * ELF hash 表的 nchain 字段等于符号数量。
+ * 动态段里没有直接记录符号数量，只能间接推算：
+ *   1. ELF hash 表的 nchain 字段等于符号数量
+ *   2. GNU hash：找到最大的 bucket 起点，沿 chain 走到结束标记
+ *   3. 都没有时：链接器通常把 .dynstr 紧跟在 .dynsym 之后
+ *
+ * 结果保存在 si->symbol_count 中。
  *
- * 返回: 符号数量，如果没有 hash 表则返回一个默认值
+ * 返回: 符号数量，无法推算时返回一个默认值
  */
 static size_t get_symbol_count(soinfo_t* si) {
+    if (si->symbol_count) {
+        return si->symbol_count;
+    }
+
+    size_t count = 256;     /* 无法推算时的默认上限 */
     if (si->hash) {
         /* ELF hash 结构: [nbucket, nchain, ...] */
         /* nchain 等于符号数量 */
-        return si->hash[1];
+        count = si->hash[1];
+    } else if (si->gnu_hash) {
+        uint32_t* gnu = si->gnu_hash;
+        uint32_t nbuckets = gnu[0];
+        uint32_t symoffset = gnu[1];
+        uint32_t bloom_size = gnu[2];
+        uint32_t* buckets = (uint32_t*)((uint64_t*)&gnu[4] + bloom_size);
+        uint32_t* chain = &buckets[nbuckets];
+
+        uint32_t last = 0;
+        for (uint32_t i = 0; i < nbuckets; i++) {
+            if (buckets[i] > last) last = buckets[i];
+        }
+        if (last < symoffset) {
+            count = symoffset;
+        } else {
+            while (!(chain[last - symoffset] & 1)) last++;
+            count = (size_t)last + 1;
+        }
+    } else if ((const char*)si->strtab > (const char*)si->symtab) {
+        count = (size_t)((const char*)si->strtab - (const char*)si->symtab) / sizeof(ElfW(Sym));
     }
-    /* 没有 hash 表时使用默认上限 */
-    return 256;
+
+    si->symbol_count = count;
+    return count;
 }
 
 /**
@@ -435,10 +872,161 @@ static uint32_t gnu_hash(const char* name) {
     return h;
 }
 
+/**
+ * symbol_name_init - 初始化符号查找键
+ * @sn: 查找键
+ * @name: 符号名称
+ *
+ * 只记录名字，两种 hash 都推迟到真正需要时再计算：
+ * 只有 GNU hash 的库永远不会触发 ELF hash 的计算，反之亦然。
+ */
+void symbol_name_init(symbol_name_t* sn, const char* name) {
+    sn->name = name;
+    sn->version = NULL;
+    sn->version_hash = 0;
+    sn->len = 0;
+    sn->gnu_hash = 0;
+    sn->elf_hash = 0;
+    sn->has_gnu_hash = false;
+    sn->has_elf_hash = false;
+    sn->has_len = false;
+    sn->per_thread = false;
+}
+
+/**
+ * symbol_name_set_version - 指定查找要求的版本
+ * @sn: 查找键
+ * @version: 版本名（NULL 表示默认版本）
+ *
+ * 版本名的 hash 与 vd_hash / vna_hash 相同，都是 ELF hash。
+ */
+void symbol_name_set_version(symbol_name_t* sn, const char* version) {
+    sn->version = version;
+    sn->version_hash = version ? elf_hash(version) : 0;
+}
+
+/**
+ * symbol_name_gnu_hash - 获取 GNU hash（惰性计算）
+ * @sn: 查找键
+ */
+uint32_t symbol_name_gnu_hash(symbol_name_t* sn) {
+    if (!sn->has_gnu_hash) {
+        /* 同一次遍历顺便得到长度，平铺符号表需要 */
+        uint32_t h = 5381;
+        const unsigned char* s = (const unsigned char*)sn->name;
+        while (*s) {
+            h = (h << 5) + h + *s++;
+        }
+        sn->gnu_hash = h;
+        sn->has_gnu_hash = true;
+        sn->len = (uint32_t)(s - (const unsigned char*)sn->name);
+        sn->has_len = true;
+    }
+    return sn->gnu_hash;
+}
+
+/**
+ * symbol_name_len - 获取名字长度（惰性计算）
+ * @sn: 查找键
+ */
+uint32_t symbol_name_len(symbol_name_t* sn) {
+    if (!sn->has_len) {
+        sn->len = (uint32_t)strlen(sn->name);
+        sn->has_len = true;
+    }
+    return sn->len;
+}
+
+/**
+ * symbol_name_elf_hash - 获取 ELF hash（惰性计算）
+ * @sn: 查找键
+ */
+uint32_t symbol_name_elf_hash(symbol_name_t* sn) {
+    if (!sn->has_elf_hash) {
+        sn->elf_hash = elf_hash(sn->name);
+        sn->has_elf_hash = true;
+    }
+    return sn->elf_hash;
+}
+
+/*
+ * 符号版本匹配（与 glibc / bionic 的规则相同）：
+ *
+ *   查找不要求版本：  只匹配默认版本（版本索引没有 HIDDEN 位）
+ *   查找要求版本 V：  先在定义方的 DT_VERDEF 中找到 V 的索引（比较 hash，
+ *                     相等时才比较名字），只匹配该索引的定义；
+ *                     定义方没有 V 时只匹配不带版本的定义（VER_NDX_GLOBAL）
+ *   定义方没有 .gnu.version：任何定义都匹配
+ *
+ * 要求的索引在每个库中只计算一次，之后沿 hash 链比较的只是 16 位整数，
+ * 而且在 strcmp 之前比较。
+ */
+#define VERSYM_HIDDEN   0x8000      /* 非默认版本：只能按版本名引用 */
+#define VERSYM_INDEX(v) ((v) & 0x7fff)
+#define VERSION_DEFAULT 0xffff      /* version_wanted：查找不要求版本 */
+#define VERSION_UNKNOWN (-1)        /* 尚未计算 */
+
+/**
+ * version_wanted - 计算查找要求的版本在库中的版本索引
+ * @si: 定义方
+ * @sn: 符号查找键
+ *
+ * 返回: 版本索引，或者 VERSION_DEFAULT
+ */
+static int version_wanted(const soinfo_t* si, const symbol_name_t* sn) {
+    if (!sn->version) return VERSION_DEFAULT;
+
+    for (size_t i = 0; i < si->version_count; i++) {
+        const symbol_version_t* v = &si->versions[i];
+        if (v->defined && v->hash == sn->version_hash && strcmp(v->name, sn->version) == 0) {
+            return (int)i;
+        }
+    }
+    return VER_NDX_GLOBAL;
+}
+
+/**
+ * version_match - 检查符号的版本是否满足要求
+ * @si: 定义方
+ * @sym_idx: 符号下标
+ * @sn: 符号查找键
+ * @wanted: 缓存的 version_wanted 结果（VERSION_UNKNOWN 时在这里计算）
+ */
+static inline bool version_match(const soinfo_t* si, size_t sym_idx, const symbol_name_t* sn,
+                                 int* wanted) {
+    if (!si->versym) return true;
+
+    ElfW(Half) v = si->versym[sym_idx];
+    if (*wanted == VERSION_UNKNOWN) {
+        *wanted = version_wanted(si, sn);
+    }
+    if (*wanted == VERSION_DEFAULT) {
+        return (v & VERSYM_HIDDEN) == 0;
+    }
+    return VERSYM_INDEX(v) == *wanted;
+}
+
+/**
+ * required_version - 取出重定位引用的符号要求的版本
+ * @si: 引用方
+ * @sym_idx: 引用的符号下标
+ * @sn: 符号查找键，有版本要求时写入版本名和 hash
+ */
+static void required_version(const soinfo_t* si, uint32_t sym_idx, symbol_name_t* sn) {
+    if (!si->versym) return;
+
+    size_t index = VERSYM_INDEX(si->versym[sym_idx]);
+    if (index <= VER_NDX_GLOBAL || index >= si->version_count || !si->versions[index].name) {
+        return;
+    }
+    sn->version = si->versions[index].name;
+    sn->version_hash = si->versions[index].hash;
+}
+
 /**
  * gnu_lookup - 使用 GNU hash 查找符号
  * @si: 共享库信息
- * @name: 符号名称
+ * @sn: 符号查找键（hash 只计算一次）
  *
  * GNU hash 表结构比 ELF hash 更复杂但更高效：
  *
@@ -463,7 +1051,7 @@ static uint32_t gnu_hash(const char* name) {
  *
  * 返回: 符号指针，未找到返回 NULL
  */
-static Elf64_Sym* gnu_lookup(soinfo_t* si, const char* name) {
+static ElfW(Sym)* gnu_lookup(soinfo_t* si, symbol_name_t* sn) {
     if (!si->gnu_hash) return NULL;
 
     /* 解析 GNU hash 头部 */
@@ -478,7 +1066,8 @@ static Elf64_Sym* gnu_lookup(soinfo_t* si, const char* name) {
     uint32_t* buckets = (uint32_t*)&bloom[bloom_size];
     uint32_t* chain = &buckets[nbuckets];
 
-    uint32_t h1 = gnu_hash(name);
+    uint32_t h1 = symbol_name_gnu_hash(sn);
+    int wanted = VERSION_UNKNOWN;
 
     /*
      * Bloom filter 检查
@@ -499,16 +1088,17 @@ static Elf64_Sym* gnu_lookup(soinfo_t* si, const char* name) {
 
     /* 遍历 chain */
     do {
-        Elf64_Sym* sym = &si->symtab[n];
+        ElfW(Sym)* sym = &si->symtab[n];
         uint32_t h2 = chain[n - symoffset];
 
         /*
          * 比较 hash 的高 31 位
          * 最低位用作 chain 结束标记，所以只比较高 31 位
+         * 版本不符的同名符号（例如 foo@V1 和 foo@@V2）在 strcmp 之前排除
          */
-        if (((h1 ^ h2) >> 1) == 0) {
+        if (((h1 ^ h2) >> 1) == 0 && version_match(si, n, sn, &wanted)) {
             const char* sym_name = si->strtab + sym->st_name;
-            if (strcmp(sym_name, name) == 0) {
+            if (strcmp(sym_name, sn->name) == 0) {
                 return sym;  /* 找到匹配 */
             }
         }
@@ -522,47 +1112,345 @@ static Elf64_Sym* gnu_lookup(soinfo_t* si, const char* name) {
 }
 
 /**
- * linker_find_symbol - 在指定库中查找符号
- * @si: 共享库信息
- * @name: 符号名称
+ * symbol_address - 已定义符号在调用线程看来的地址
+ * @si: 定义该符号的库
+ * @sym: 符号（已定义）
+ * @sn: 查找键，TLS 符号时设置 sn->per_thread（结果不能缓存）
  *
- * 查找策略：
- *   1. 优先使用 GNU hash（更快）
- *   2. 其次使用 ELF hash
- *   3. 最后使用线性搜索（作为后备）
+ * 普通符号是 load_bias + st_value；TLS 符号的 st_value 是 TLS 块内的偏移，
+ * 地址是调用线程中该变量的位置（与 glibc 的 dlsym 相同，必要时为本线程分配块）。
+ *
+ * 返回: 符号地址，TLS 块分配失败返回 NULL
+ */
+static void* symbol_address(const soinfo_t* si, const ElfW(Sym)* sym, symbol_name_t* sn) {
+    if (ELFW_ST_TYPE(sym->st_info) == STT_TLS) {
+        sn->per_thread = true;
+        if (!si->tls_module) return NULL;
+        tls_index_t ti = { si->tls_module, sym->st_value };
+        return linker_tls_get_addr(&ti);
+    }
+    return (uint8_t*)si->load_bias + sym->st_value;
+}
+
+/* =============================================================================
+ * 平铺符号表
+ * =============================================================================
+ *
+ * 同一个库被反复 dlsym 时（例如按用户输入的名字分发），每次都要走
+ * bloom filter -> bucket -> chain，并对每个候选做 strcmp。
+ *
+ * 平铺符号表把库中所有已定义的导出符号（TLS 变量除外）放进一张开放寻址表：
+ *
+ *   slots[]:  { hash, len, name } ...   16 字节一个槽位，线性探测
+ *   addrs[]:  { addr } ...              与 slots 下标一一对应
+ *
+ * 探测只读取 slots，hash 和长度都相等时才 memcmp 名字，
+ * 命中后才访问 addrs。负载因子不超过 1/2。
+ *
+ * 起始槽位取 (hash * 黄金比例常数) 的高位，而不是 hash 的低位：名字相近的
+ * 符号（sym_0、sym_1 ...）的 GNU hash 也相近，直接取低位会连成很长的簇，
+ * 未命中要一直探测到空槽位。库有 GNU hash 时，探测前先查它的 bloom filter，
+ * 绝大多数未命中不会访问槽位（与只查 hash 表时一样快）。
+ *
+ * 构建时机：第一次 linker_find_symbol_indexed（mini_dlsym 指定句柄）时，
+ * 或者加载时指定了 LINKER_FLAG_FLAT_SYMTAB。表构建完成后用 CAS 发布，
+ * 多个线程同时构建时只保留一张，其余的直接丢弃。
+ */
+
+/* 起始槽位：乘法散列取高位，打散相邻的 hash 值 */
+static inline size_t flat_symtab_slot(const flat_symtab_t* flat, uint32_t hash) {
+    return (uint32_t)(hash * 0x9E3779B1u) >> flat->shift;
+}
+
+/**
+ * flat_symtab_lookup - 在平铺符号表中查找
+ * @flat: 平铺符号表
+ * @sn: 符号查找键
  *
  * 返回: 符号地址，未找到返回 NULL
  */
-void* linker_find_symbol(soinfo_t* si, const char* name) {
-    if (!si || !si->symtab || !si->strtab) {
-        return NULL;
+static void* flat_symtab_lookup(flat_symtab_t* flat, symbol_name_t* sn) {
+    uint32_t hash = symbol_name_gnu_hash(sn);
+    if (flat->bloom) {
+        uint64_t word = flat->bloom[(hash / 64) % flat->bloom_size];
+        uint64_t mask = (1ULL << (hash % 64)) | (1ULL << ((hash >> flat->bloom_shift) % 64));
+        if ((word & mask) != mask) {
+            return NULL;  /* 库中肯定没有这个符号 */
+        }
     }
 
-    Elf64_Sym* sym = NULL;
+    uint32_t len = symbol_name_len(sn);
+    for (size_t i = flat_symtab_slot(flat, hash); ; i = (i + 1) & flat->mask) {
+        flat_symbol_slot_t* slot = &flat->slots[i];
+        if (!slot->name) {
+            return NULL;
+        }
+        if (slot->hash == hash && slot->len == len &&
+            memcmp(slot->name, sn->name, len) == 0) {
+            return flat->addrs[i];
+        }
+    }
+}
 
-    /* ============ 方法 1: GNU hash 查找 ============ */
+/* 非默认版本（foo@V1）不放入平铺表：不带版本的查找不应该找到它们 */
+static inline bool flat_symtab_hidden(const soinfo_t* si, size_t sym_idx) {
+    return si->versym && (si->versym[sym_idx] & VERSYM_HIDDEN);
+}
+
+/**
+ * flat_symtab_build - 为库构建平铺符号表
+ * @si: 共享库信息
+ *
+ * 同名符号只保留符号表中下标最小的那个（与 hash 链的查找顺序一致）。
+ * 表中只有默认版本的定义，要求版本的查找不使用这张表。
+ * TLS 符号的地址因线程而异，不放入表中（只记录个数，见 flat_symtab_find）。
+ *
+ * 返回: 新建的表，内存不足返回 NULL
+ */
+static flat_symtab_t* flat_symtab_build(soinfo_t* si) {
+    size_t sym_count = get_symbol_count(si);
+
+    /* 先数出导出符号，决定表的大小 */
+    size_t count = 0, tls_count = 0;
+    for (size_t i = 1; i < sym_count; i++) {
+        ElfW(Sym)* sym = &si->symtab[i];
+        unsigned char bind = ELFW_ST_BIND(sym->st_info);
+        if (sym->st_name != 0 && sym->st_shndx != SHN_UNDEF &&
+            (bind == STB_GLOBAL || bind == STB_WEAK) && !flat_symtab_hidden(si, i)) {
+            if (ELFW_ST_TYPE(sym->st_info) == STT_TLS) tls_count++;
+            else count++;
+        }
+    }
+
+    size_t capacity = 16;
+    uint32_t bits = 4;
+    while (capacity < count * 2) {
+        capacity <<= 1;
+        bits++;
+    }
+
+    flat_symtab_t* flat = (flat_symtab_t*)calloc(
+        1, sizeof(flat_symtab_t) + capacity * (sizeof(flat_symbol_slot_t) + sizeof(void*)));
+    if (!flat) return NULL;
+
+    flat->mask = capacity - 1;
+    flat->shift = 32 - bits;
+    flat->tls_count = tls_count;
     if (si->gnu_hash) {
-        sym = gnu_lookup(si, name);
-        if (sym && sym->st_shndx != SHN_UNDEF) {
-            /*
-             * 检查符号绑定类型：
-             * STB_GLOBAL: 全局符号，可以被其他库引用
-             * STB_WEAK: 弱符号，可以被强符号覆盖
-             */
-            unsigned char bind = ELF64_ST_BIND(sym->st_info);
-            if (bind == STB_GLOBAL || bind == STB_WEAK) {
-                return (uint8_t*)si->load_bias + sym->st_value;
+        /* 表中的符号都在 GNU hash 中（已定义的导出符号），bloom filter 可以直接沿用 */
+        flat->bloom_size = si->gnu_hash[2];
+        flat->bloom_shift = si->gnu_hash[3];
+        flat->bloom = (const uint64_t*)&si->gnu_hash[4];
+    }
+    flat->addrs = (void**)&flat->slots[capacity];
+
+    for (size_t i = 1; i < sym_count; i++) {
+        ElfW(Sym)* sym = &si->symtab[i];
+        unsigned char bind = ELFW_ST_BIND(sym->st_info);
+        if (sym->st_name == 0 || sym->st_shndx == SHN_UNDEF ||
+            (bind != STB_GLOBAL && bind != STB_WEAK) || flat_symtab_hidden(si, i) ||
+            ELFW_ST_TYPE(sym->st_info) == STT_TLS) {
+            continue;
+        }
+
+        symbol_name_t sn;
+        symbol_name_init(&sn, si->strtab + sym->st_name);
+        uint32_t hash = symbol_name_gnu_hash(&sn);
+
+        size_t j = flat_symtab_slot(flat, hash);
+        while (flat->slots[j].name) {
+            if (flat->slots[j].hash == hash && flat->slots[j].len == sn.len &&
+                memcmp(flat->slots[j].name, sn.name, sn.len) == 0) {
+                break;
             }
+            j = (j + 1) & flat->mask;
         }
+        if (flat->slots[j].name) continue;      /* 重复的名字 */
+
+        flat->slots[j].hash = hash;
+        flat->slots[j].len = sn.len;
+        flat->slots[j].name = sn.name;
+        flat->addrs[j] = (uint8_t*)si->load_bias + sym->st_value;
+        flat->count++;
     }
 
-    /* ============ 方法 2: ELF hash 查找 ============ */
-    if (si->hash) {
-        uint32_t nbucket = si->hash[0];
-        uint32_t* bucket = &si->hash[2];
-        uint32_t* chain = &si->hash[2 + nbucket];
+    return flat;
+}
 
-        uint32_t hash = elf_hash(name);
+/**
+ * flat_symtab_get - 获取库的平铺符号表，不存在时构建
+ * @si: 共享库信息
+ *
+ * 返回: 平铺符号表，内存不足返回 NULL（调用者退回到 hash 表查找）
+ */
+static flat_symtab_t* flat_symtab_get(soinfo_t* si) {
+    flat_symtab_t* flat = __atomic_load_n(&si->flat_symtab, __ATOMIC_ACQUIRE);
+    if (flat || !si->symtab || !si->strtab) {
+        return flat;
+    }
+
+    flat = flat_symtab_build(si);
+    if (!flat) return NULL;
+
+    flat_symtab_t* expected = NULL;
+    if (!__atomic_compare_exchange_n(&si->flat_symtab, &expected, flat, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        /* 其他线程先完成了构建 */
+        free(flat);
+        return expected;
+    }
+
+    LOG("[linker] Built flat symbol table for %s (%zu symbols, %zu slots)\n",
+        si->name, flat->count, flat->mask + 1);
+    return flat;
+}
+
+static const ElfW(Sym)* find_symbol_entry(soinfo_t* si, symbol_name_t* sn);
+
+/**
+ * flat_symtab_find - 在平铺符号表中查找，必要时补查 hash 表
+ * @si: 共享库信息
+ * @flat: si 的平铺符号表
+ * @sn: 符号查找键（不要求版本）
+ *
+ * 表中没有 TLS 符号：库导出了 TLS 变量时，未命中还要查一次 hash 表。
+ *
+ * 返回: 符号地址，未找到返回 NULL
+ */
+static void* flat_symtab_find(soinfo_t* si, flat_symtab_t* flat, symbol_name_t* sn) {
+    void* addr = flat_symtab_lookup(flat, sn);
+    if (addr || !flat->tls_count) {
+        return addr;
+    }
+    const ElfW(Sym)* sym = find_symbol_entry(si, sn);
+    return sym ? symbol_address(si, sym, sn) : NULL;
+}
+
+/**
+ * linker_find_symbol_indexed - 在指定库中查找符号（使用平铺符号表）
+ * @si: 共享库信息
+ * @sn: 符号查找键
+ *
+ * 第一次调用时为该库构建平铺符号表，之后的查找都只查这张表。
+ * 要求版本的查找（mini_dlvsym）直接查 hash 表。
+ *
+ * 返回: 符号地址，未找到返回 NULL
+ */
+void* linker_find_symbol_indexed(soinfo_t* si, symbol_name_t* sn) {
+    if (!si) return NULL;
+
+    flat_symtab_t* flat = sn->version ? NULL : flat_symtab_get(si);
+    if (flat) {
+        return flat_symtab_find(si, flat, sn);
+    }
+    return linker_find_symbol_ex(si, sn);
+}
+
+/* 批量查找时一组的大小：先算完一组的 hash 并发出预取，再逐个探测 */
+#define FIND_BATCH 16
+
+/**
+ * linker_find_symbols - 批量查找符号
+ * @si: 共享库信息，NULL 表示全局查找
+ * @names: 符号名数组
+ * @addrs: 输出数组
+ * @count: 符号个数
+ *
+ * 每组 FIND_BATCH 个名字分两遍处理：
+ *   1. 计算 hash，预取各自的第一个探测槽位
+ *   2. 探测（此时槽位多半已经在缓存中）
+ * 这样多个名字的缓存未命中可以重叠，而不是一个接一个地等待。
+ *
+ * 返回: 找到的符号个数
+ */
+size_t linker_find_symbols(soinfo_t* si, const char* const* names, void** addrs, size_t count) {
+    flat_symtab_t* flat = si ? flat_symtab_get(si) : NULL;
+    size_t found = 0;
+
+    for (size_t base = 0; base < count; base += FIND_BATCH) {
+        size_t n = count - base < FIND_BATCH ? count - base : FIND_BATCH;
+        symbol_name_t sn[FIND_BATCH];
+
+        for (size_t i = 0; i < n; i++) {
+            symbol_name_init(&sn[i], names[base + i]);
+            uint32_t hash = symbol_name_gnu_hash(&sn[i]);
+            if (flat) {
+                __builtin_prefetch(&flat->slots[flat_symtab_slot(flat, hash)]);
+            }
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            void* addr;
+            if (flat) {
+                addr = flat_symtab_find(si, flat, &sn[i]);
+            } else if (si) {
+                addr = linker_find_symbol_ex(si, &sn[i]);
+            } else {
+                addr = linker_find_global_symbol_ex(&sn[i]);
+            }
+            addrs[base + i] = addr;
+            if (addr) found++;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * linker_find_symbol - 在指定库中查找符号
+ * @si: 共享库信息
+ * @name: 符号名称
+ *
+ * linker_find_symbol_ex 的简单封装，适合只查一个库的场景。
+ *
+ * 返回: 符号地址，未找到返回 NULL
+ */
+void* linker_find_symbol(soinfo_t* si, const char* name) {
+    symbol_name_t sn;
+    symbol_name_init(&sn, name);
+    return linker_find_symbol_ex(si, &sn);
+}
+
+/**
+ * find_symbol_entry - 在 hash 表中查找符号（不使用平铺符号表）
+ * @si: 共享库信息
+ * @sn: 符号查找键，hash 会被缓存在其中供后续库复用
+ *
+ * 查找策略：
+ *   1. 优先使用 GNU hash（更快）
+ *   2. 其次使用 ELF hash
+ *   3. 最后使用线性搜索（作为后备）
+ *
+ * 返回: 已定义的 GLOBAL/WEAK 符号，未找到返回 NULL
+ */
+static const ElfW(Sym)* find_symbol_entry(soinfo_t* si, symbol_name_t* sn) {
+    const char* name = sn->name;
+    ElfW(Sym)* sym = NULL;
+    int wanted = VERSION_UNKNOWN;
+
+    /* ============ 方法 1: GNU hash 查找 ============ */
+    if (si->gnu_hash) {
+        sym = gnu_lookup(si, sn);
+        if (sym && sym->st_shndx != SHN_UNDEF) {
+            /*
+             * 检查符号绑定类型：
+             * STB_GLOBAL: 全局符号，可以被其他库引用
+             * STB_WEAK: 弱符号，可以被强符号覆盖
+             */
+            unsigned char bind = ELFW_ST_BIND(sym->st_info);
+            if (bind == STB_GLOBAL || bind == STB_WEAK) {
+                return sym;
+            }
+        }
+    }
+
+    /* ============ 方法 2: ELF hash 查找 ============ */
+    if (si->hash) {
+        uint32_t nbucket = si->hash[0];
+        uint32_t* bucket = &si->hash[2];
+        uint32_t* chain = &si->hash[2 + nbucket];
+
+        uint32_t hash = symbol_name_elf_hash(sn);
 
         /*
          * ELF hash 查找过程：
@@ -573,13 +1461,13 @@ void* linker_find_symbol(soinfo_t* si, const char* name) {
             sym = &si->symtab[i];
             const char* sym_name = si->strtab + sym->st_name;
 
-            if (strcmp(sym_name, name) == 0) {
+            if (version_match(si, i, sn, &wanted) && strcmp(sym_name, name) == 0) {
                 if (sym->st_shndx == SHN_UNDEF) {
                     continue;  /* 未定义符号，继续搜索 */
                 }
-                unsigned char bind = ELF64_ST_BIND(sym->st_info);
+                unsigned char bind = ELFW_ST_BIND(sym->st_info);
                 if (bind == STB_GLOBAL || bind == STB_WEAK) {
-                    return (uint8_t*)si->load_bias + sym->st_value;
+                    return sym;
                 }
             }
         }
@@ -593,13 +1481,13 @@ void* linker_find_symbol(soinfo_t* si, const char* name) {
             if (sym->st_name == 0) continue;
 
             const char* sym_name = si->strtab + sym->st_name;
-            if (strcmp(sym_name, name) == 0) {
+            if (version_match(si, i, sn, &wanted) && strcmp(sym_name, name) == 0) {
                 if (sym->st_shndx == SHN_UNDEF) {
                     continue;
                 }
-                unsigned char bind = ELF64_ST_BIND(sym->st_info);
+                unsigned char bind = ELFW_ST_BIND(sym->st_info);
                 if (bind == STB_GLOBAL || bind == STB_WEAK) {
-                    return (uint8_t*)si->load_bias + sym->st_value;
+                    return sym;
                 }
             }
         }
@@ -609,271 +1497,1763 @@ void* linker_find_symbol(soinfo_t* si, const char* name) {
 }
 
 /**
- * linker_find_global_symbol - 在所有已加载库中查找符号
- * @name: 符号名称
- *
- * 查找顺序：
- *   1. 首先在我们自己加载的库中查找
- *   2. 然后通过系统的 dlsym(RTLD_DEFAULT) 查找系统库
+ * linker_find_symbol_ex - 在指定库中查找符号（使用预计算的 hash）
+ * @si: 共享库信息
+ * @sn: 符号查找键，hash 会被缓存在其中供后续库复用
  *
- * 这样可以让加载的库调用 libc 函数（如 printf）。
+ * 已经构建了平铺符号表时先查这张表（见 flat_symtab_find），
+ * 否则按 find_symbol_entry 的顺序查 hash 表。
  *
  * 返回: 符号地址，未找到返回 NULL
  */
-void* linker_find_global_symbol(const char* name) {
-    /* 先在我们加载的库中查找 */
-    for (soinfo_t* si = g_linker.soinfo_list; si != NULL; si = si->next) {
-        void* sym = linker_find_symbol(si, name);
-        if (sym) return sym;
+void* linker_find_symbol_ex(soinfo_t* si, symbol_name_t* sn) {
+    if (!si || !si->symtab || !si->strtab) {
+        return NULL;
     }
 
-    /*
-     * 从系统库中查找
-     * RTLD_DEFAULT 表示在默认搜索范围内查找
-     * 这允许加载的 .so 调用 libc 函数
-     */
-    void* sym = dlsym(RTLD_DEFAULT, name);
-    if (sym) {
-        return sym;
+    /* 表中只有默认版本，要求版本的查找走 hash 表 */
+    flat_symtab_t* flat = __atomic_load_n(&si->flat_symtab, __ATOMIC_ACQUIRE);
+    if (flat && !sn->version) {
+        return flat_symtab_find(si, flat, sn);
     }
 
-    return NULL;
+    const ElfW(Sym)* sym = find_symbol_entry(si, sn);
+    return sym ? symbol_address(si, sym, sn) : NULL;
 }
 
 /* =============================================================================
- * 重定位
+ * 全局符号缓存
  * =============================================================================
- */
-
-/**
- * do_reloc - 执行单个重定位
- * @si: 共享库信息
- * @rela: 重定位条目
  *
- * 重定位是动态链接的核心步骤之一。
- * 当共享库被加载到内存中时，其代码和数据中的某些地址引用需要被修正，
- * 因为库的实际加载地址可能与编译时预期的地址不同。
+ * 每个未定义符号在重定位时都要调用 linker_find_global_symbol：
+ * 遍历所有已加载库，最后再回退到 dlsym(RTLD_DEFAULT)。
+ * 多个插件往往导入同一批 libc 符号，这些重复查找会占据大部分加载时间。
  *
- * RELA 重定位条目结构：
- *   struct Elf64_Rela {
- *       Elf64_Addr r_offset;   // 需要修正的位置（相对于段起始）
- *       Elf64_Xword r_info;    // 符号索引和重定位类型
- *       Elf64_Sxword r_addend; // 加数
- *   };
+ * 这里用一张开放寻址（线性探测）的哈希表缓存 "符号名 -> 地址"，
+ * 查找失败的结果也会被缓存（负缓存），弱未定义符号因此只会查找一次。
  *
- * r_info 的解析：
- *   - 高 32 位: 符号索引 (ELF64_R_SYM)
- *   - 低 32 位: 重定位类型 (ELF64_R_TYPE)
+ * 失效策略：
+ *   - 加载新库：只作废新库自己定义的那些符号名，其他名字的解析结果不变
+ *   - 卸载库：  整表清空（卸载很少发生，没必要精确追踪）
  *
- * 返回: 成功返回 0，失败返回 -1
+ * 注意：绕过 mini linker 直接用系统 dlopen 加载的库不会触发失效，
+ * 必要时可以手动调用 linker_flush_symbol_cache()。
+ *
+ * 并发：整张表通过 RCU 发布。查找无锁；插入、扩容、作废持有 g_symcache_lock。
+ * 被替换的旧表和名字推迟到宽限期之后释放。
+ * 慢速路径（遍历所有库 + dlsym）在锁外执行，并行重定位时不会互相阻塞。
  */
-static int do_reloc(soinfo_t* si, Elf64_Rela* rela) {
-    /* 提取重定位类型和符号索引 */
-    uint32_t type = ELF64_R_TYPE(rela->r_info);
-    uint32_t sym_idx = ELF64_R_SYM(rela->r_info);
 
-    /* 计算需要修正的内存地址 */
-    void* reloc_addr = (uint8_t*)si->load_bias + rela->r_offset;
-    void* sym_addr = NULL;
+#define SYMCACHE_INITIAL_CAPACITY 1024
 
-    /* 如果有符号索引，查找符号地址 */
-    if (sym_idx != 0) {
-        Elf64_Sym* sym = &si->symtab[sym_idx];
-        const char* sym_name = si->strtab + sym->st_name;
+/*
+ * 要求版本的查找以 "name@version" 作为缓存的键，hash 仍然只取名字部分
+ * （同名的不同版本落在同一条探测链上，由 strcmp 区分）。
+ * 键超过这个长度时不缓存。
+ */
+#define SYMCACHE_KEY_MAX 512
 
-        /*
-         * 符号查找策略：
-         * 1. 如果符号在当前库中已定义（st_shndx != SHN_UNDEF），使用本地定义
-         * 2. 否则在全局范围（其他库和系统库）中查找
-         */
-        if (sym->st_shndx != SHN_UNDEF) {
-            sym_addr = (uint8_t*)si->load_bias + sym->st_value;
-        } else {
-            sym_addr = linker_find_global_symbol(sym_name);
-        }
+/* 槽位状态 */
+#define SYMCACHE_EMPTY 0        /* 从未使用（探测链在此终止）*/
+#define SYMCACHE_LIVE  1        /* 有效条目 */
+#define SYMCACHE_DEAD  2        /* 已失效（墓碑，探测时跳过但不终止）*/
 
-        /* 如果非弱符号找不到，记录警告但继续执行 */
-        if (!sym_addr && ELF64_ST_BIND(sym->st_info) != STB_WEAK) {
-            LOG_WARN("Cannot find symbol: %s\n", sym_name);
-            /* 允许继续，某些符号可能是可选的 */
+/**
+ * symcache_lookup - 在缓存中查找符号
+ * @hash: 符号名的 GNU hash
+ * @name: 符号名称
+ *
+ * 无锁读取，调用者必须处于 RCU 读侧临界区中。
+ * 槽位的 state 最后写入，读到 LIVE 时其余字段一定已经写好。
+ *
+ * 返回: 有效条目指针，未命中返回 NULL
+ */
+static symcache_entry_t* symcache_lookup(uint32_t hash, const char* name) {
+    symcache_table_t* table = rcu_dereference(g_linker.symcache);
+    if (!table) return NULL;
+
+    size_t mask = table->capacity - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        symcache_entry_t* e = &table->entries[i];
+        uint16_t state = __atomic_load_n(&e->state, __ATOMIC_ACQUIRE);
+        if (state == SYMCACHE_EMPTY) {
+            return NULL;
+        }
+        if (state == SYMCACHE_LIVE && e->hash == hash &&
+            strcmp(e->name, name) == 0) {
+            return e;
         }
     }
+}
 
-    /*
-     * 根据重定位类型执行修正
-     *
-     * x86_64 常见重定位类型：
-     *
-     *   类型                | 计算公式    | 说明
-     *   --------------------|-------------|----------------------------------
-     *   R_X86_64_NONE       | -           | 无操作
-     *   R_X86_64_64         | S + A       | 64 位绝对地址
-     *   R_X86_64_GLOB_DAT   | S           | GOT 条目（全局数据）
-     *   R_X86_64_JUMP_SLOT  | S           | PLT 条目（函数调用）
-     *   R_X86_64_RELATIVE   | B + A       | 相对于加载基址
-     *   R_X86_64_COPY       | -           | 复制符号内容
-     *
-     *   其中: S = 符号地址, A = addend, B = load_bias
-     */
-    switch (type) {
-        case R_X86_64_NONE:
-            /* 无操作，占位符 */
-            break;
-
-        case R_X86_64_64:
-            /*
-             * 绝对地址重定位: S + A
-             * 用于直接引用符号地址的情况
-             * 例如: static void* ptr = &some_func;
-             */
-            *(uint64_t*)reloc_addr = (uint64_t)sym_addr + rela->r_addend;
-            break;
+/**
+ * symcache_grow - 扩容（或首次分配）缓存（持有 g_symcache_lock）
+ *
+ * 新表容量翻倍，只迁移有效条目。旧表和墓碑的名字可能还有读者在访问，
+ * 推迟到宽限期之后释放。
+ *
+ * 返回: 成功返回 0，内存不足返回 -1
+ */
+static int symcache_grow(void) {
+    symcache_table_t* old = g_linker.symcache;
+    size_t new_capacity = old ? old->capacity * 2 : SYMCACHE_INITIAL_CAPACITY;
+    symcache_table_t* table = (symcache_table_t*)calloc(
+        1, sizeof(symcache_table_t) + new_capacity * sizeof(symcache_entry_t));
+    if (!table) return -1;
+
+    table->capacity = new_capacity;
+    size_t mask = new_capacity - 1;
+    for (size_t i = 0; old && i < old->capacity; i++) {
+        symcache_entry_t* e = &old->entries[i];
+        if (e->state == SYMCACHE_DEAD) {
+            rcu_defer_free(e->name);
+            continue;
+        }
+        if (e->state != SYMCACHE_LIVE) continue;
 
-        case R_X86_64_GLOB_DAT:
-            /*
-             * 全局数据偏移表 (GOT) 条目: S
-             * 用于访问全局变量
-             * GOT 中存储变量的实际地址
-             */
-            *(uint64_t*)reloc_addr = (uint64_t)sym_addr;
-            break;
+        size_t j = e->hash & mask;
+        while (table->entries[j].state != SYMCACHE_EMPTY) {
+            j = (j + 1) & mask;
+        }
+        table->entries[j] = *e;
+        table->used++;
+    }
 
-        case R_X86_64_JUMP_SLOT:
-            /*
-             * 过程链接表 (PLT) 条目: S
-             * 用于函数调用
-             * PLT 中存储函数的实际地址
-             */
-            *(uint64_t*)reloc_addr = (uint64_t)sym_addr;
-            break;
+    rcu_assign_pointer(g_linker.symcache, table);
+    rcu_defer_free(old);
+    return 0;
+}
 
-        case R_X86_64_RELATIVE:
-            /*
-             * 相对地址重定位: B + A
-             * 这是最常见的重定位类型
-             * 用于与位置无关代码 (PIC) 中的地址计算
-             * 不需要符号查找，只需加上加载偏移
-             */
-            *(uint64_t*)reloc_addr = (uint64_t)si->load_bias + rela->r_addend;
-            break;
+/**
+ * symcache_insert - 把一次全局查找的结果放入缓存（持有 g_symcache_lock）
+ * @hash: 符号名的 GNU hash
+ * @name: 符号名称
+ * @addr: 查找结果（NULL 表示未找到）
+ * @source: 结果来源（linker_lookup_kind_t），命中缓存时用于统计
+ *
+ * 缓存只是加速手段，内存不足时直接放弃缓存即可。
+ */
+static void symcache_insert(uint32_t hash, const char* name, void* addr, uint16_t source) {
+    /* 负载因子超过 3/4 时扩容（墓碑也占用探测链）*/
+    symcache_table_t* table = g_linker.symcache;
+    if (!table || (table->used + 1) * 4 > table->capacity * 3) {
+        if (symcache_grow() < 0) return;
+        table = g_linker.symcache;
+    }
 
-        case R_X86_64_COPY:
-            /*
-             * 复制重定位
-             * 将符号的内容复制到目标位置
-             * 主要用于可执行文件中的全局变量
-             */
-            if (sym_addr) {
-                Elf64_Sym* sym = &si->symtab[sym_idx];
-                memcpy(reloc_addr, sym_addr, sym->st_size);
-            }
-            break;
+    char* copy = strdup(name);
+    if (!copy) return;
 
-        default:
-            LOG_WARN("Unsupported relocation type: %u\n", type);
-            break;
+    size_t mask = table->capacity - 1;
+    size_t i = hash & mask;
+    while (table->entries[i].state != SYMCACHE_EMPTY) {
+        i = (i + 1) & mask;
     }
 
-    return 0;
+    symcache_entry_t* e = &table->entries[i];
+    e->hash = hash;
+    e->name = copy;
+    e->addr = addr;
+    e->source = source;
+    __atomic_store_n(&e->state, SYMCACHE_LIVE, __ATOMIC_RELEASE);
+    table->used++;
 }
 
 /**
- * linker_relocate - 执行所有重定位
- * @si: 共享库信息
+ * symcache_invalidate_for - 加载新库后作废受影响的缓存条目
+ * @si: 新加载的库
  *
- * 处理两种类型的重定位表：
- *   1. RELA (.rela.dyn): 数据重定位
- *   2. PLT RELA (.rela.plt): 函数调用重定位
- *
- * 返回: 成功返回 0，失败返回 -1
+ * 只有新库自己定义的符号名，其全局解析结果才可能改变
+ * （之前的负缓存、或者原本来自系统库的结果）。
+ * 这些条目被标记为墓碑，其余条目继续有效。
  */
-int linker_relocate(soinfo_t* si) {
-    /* 处理 RELA 重定位（数据引用）*/
-    if (si->rela) {
-        for (size_t i = 0; i < si->rela_count; i++) {
-            if (do_reloc(si, &si->rela[i]) < 0) {
-                return -1;
-            }
+static void symcache_invalidate_for(soinfo_t* si) {
+    pthread_mutex_lock(&g_symcache_lock);
+    __atomic_add_fetch(&g_linker.symcache_generation, 1, __ATOMIC_RELEASE);
+
+    symcache_table_t* table = g_linker.symcache;
+    for (size_t i = 0; table && i < table->capacity; i++) {
+        symcache_entry_t* e = &table->entries[i];
+        if (e->state != SYMCACHE_LIVE) continue;
+
+        /* 缓存里已经存着 GNU hash，不必重新计算 */
+        symbol_name_t sn;
+        char name[SYMCACHE_KEY_MAX];
+        const char* at = strchr(e->name, '@');
+        if (at) {
+            snprintf(name, sizeof(name), "%.*s", (int)(at - e->name), e->name);
+            symbol_name_init(&sn, name);
+            symbol_name_set_version(&sn, at + 1);
+        } else {
+            symbol_name_init(&sn, e->name);
         }
-    }
+        sn.gnu_hash = e->hash;
+        sn.has_gnu_hash = true;
 
-    /* 处理 PLT 重定位（函数调用）*/
-    if (si->plt_rela) {
-        for (size_t i = 0; i < si->plt_rela_count; i++) {
-            if (do_reloc(si, &si->plt_rela[i]) < 0) {
-                return -1;
-            }
+        if (linker_find_symbol_ex(si, &sn)) {
+            __atomic_store_n(&e->state, SYMCACHE_DEAD, __ATOMIC_RELEASE);
         }
     }
+    pthread_mutex_unlock(&g_symcache_lock);
+}
 
-    return 0;
+/**
+ * linker_flush_symbol_cache - 清空全局符号缓存
+ *
+ * 卸载库时调用：被卸载库提供的地址全部失效。
+ * 旧表在下一次 rcu_reclaim() 时释放。
+ */
+void linker_flush_symbol_cache(void) {
+    pthread_mutex_lock(&g_symcache_lock);
+    __atomic_add_fetch(&g_linker.symcache_generation, 1, __ATOMIC_RELEASE);
+
+    symcache_table_t* table = g_linker.symcache;
+    rcu_assign_pointer(g_linker.symcache, NULL);
+    for (size_t i = 0; table && i < table->capacity; i++) {
+        if (table->entries[i].state != SYMCACHE_EMPTY) {
+            rcu_defer_free(table->entries[i].name);
+        }
+    }
+    rcu_defer_free(table);
+    pthread_mutex_unlock(&g_symcache_lock);
 }
 
 /* =============================================================================
- * 库加载与卸载
+ * 地址反查
  * =============================================================================
- */
-
-/**
- * linker_load - 加载共享库
- * @path: 共享库文件路径
  *
- * 这是链接器的核心函数，完整的加载流程如下：
+ * 采样分析器和崩溃处理程序需要把 PC 还原成 (库, 符号)，而系统的 dladdr
+ * 看不到我们加载的库。反查分两级，每级都是二分查找：
  *
- *   1. 打开并解析 ELF 文件
- *   2. 分配 soinfo 结构体
- *   3. 计算需要的内存大小
- *   4. 预留地址空间 (PROT_NONE)
- *   5. 映射每个 PT_LOAD 段
- *   6. 处理 BSS 段
- *   7. 解析动态段
- *   8. 执行重定位
- *   9. 添加到已加载库列表
+ *   全局地址索引 addr_index:  [start, end) -> soinfo，按 start 排序
+ *       各库的映射互不重叠，排好序的区间数组就足够（不需要区间树），
+ *       与全局查找范围一样在链表变化时重建，通过 RCU 整体替换
  *
- * 返回: 成功返回 soinfo 指针，失败返回 NULL
+ *   每个库的 addr_symtab:     st_value 排序的已定义符号（第一次反查时构建）
+ *       找最后一个 st_value <= 偏移 的符号；st_size 为 0 的符号（汇编函数）
+ *       视为延伸到下一个符号
+ *
+ * 读者不加锁：整个反查在 RCU 读侧临界区中进行，卸载在宽限期之后才释放库。
  */
-soinfo_t* linker_load(const char* path) {
-    elf_file_t elf;
-    soinfo_t* si = NULL;
-    int fd = -1;
 
-    LOG("[linker] Loading: %s\n", path);
+static int addr_range_cmp(const void* a, const void* b) {
+    uintptr_t x = ((const addr_range_t*)a)->start;
+    uintptr_t y = ((const addr_range_t*)b)->start;
+    return x < y ? -1 : x > y;
+}
 
-    /* ============ 步骤 1: 打开 ELF 文件 ============ */
-    if (elf_open(path, &elf) < 0) {
-        linker_set_error("Failed to open: %s", path);
-        return NULL;
+/**
+ * addr_index_rebuild - 按已加载库链表重建全局地址索引（持有写者锁）
+ *
+ * 由 scope_rebuild 调用。旧索引在下一次 rcu_reclaim() 时释放；
+ * 内存不足时发布 NULL，反查退回遍历链表。
+ */
+static void addr_index_rebuild(void) {
+    size_t count = 0;
+    for (soinfo_t* si = g_linker.soinfo_list; si; si = si->next) {
+        if (si->base) count++;
     }
 
-    /* ============ 步骤 2: 分配 soinfo ============ */
-    si = (soinfo_t*)calloc(1, sizeof(soinfo_t));
-    if (!si) {
-        linker_set_error("Out of memory");
-        elf_close(&elf);
-        return NULL;
+    addr_index_t* index = NULL;
+    if (count) {
+        index = (addr_index_t*)malloc(sizeof(addr_index_t) + count * sizeof(addr_range_t));
+    }
+    if (index) {
+        size_t n = 0;
+        for (soinfo_t* si = g_linker.soinfo_list; si; si = si->next) {
+            if (!si->base) continue;
+            index->ranges[n++] = (addr_range_t){ (uintptr_t)si->base, (uintptr_t)si->base + si->size, si };
+        }
+        qsort(index->ranges, n, sizeof(addr_range_t), addr_range_cmp);
+        index->count = n;
+    } else if (count) {
+        LOG_WARN("[linker] Out of memory building address index, falling back to list walk\n");
     }
 
-    strncpy(si->name, path, sizeof(si->name) - 1);
-    si->phdr = elf.phdr;
-    si->phnum = elf.ehdr->e_phnum;
+    addr_index_t* old = g_linker.addr_index;
+    rcu_assign_pointer(g_linker.addr_index, index);
+    rcu_defer_free(old);
+}
 
-    /* ============ 步骤 3: 计算加载大小 ============ */
-    size_t load_size = calculate_load_size(elf.phdr, elf.ehdr->e_phnum);
-    if (load_size == 0) {
-        linker_set_error("No loadable segments");
-        goto error;
+/**
+ * linker_find_library_by_addr - 查找包含地址的库（在 RCU 读侧临界区中调用）
+ * @addr: 任意地址
+ *
+ * 返回: 库，地址不在任何已加载库的映射中返回 NULL
+ */
+soinfo_t* linker_find_library_by_addr(const void* addr) {
+    uintptr_t a = (uintptr_t)addr;
+    addr_index_t* index = rcu_dereference(g_linker.addr_index);
+
+    if (!index) {
+        for (soinfo_t* si = rcu_dereference(g_linker.soinfo_list); si; si = rcu_dereference(si->next)) {
+            if (si->base && a >= (uintptr_t)si->base && a - (uintptr_t)si->base < si->size) {
+                return si;
+            }
+        }
+        return NULL;
     }
-    si->size = load_size;
 
-    /* ============ 步骤 4: 找到最小虚拟地址 ============ */
-    Elf64_Addr min_vaddr = (Elf64_Addr)-1;
-    for (size_t i = 0; i < elf.ehdr->e_phnum; i++) {
-        if (elf.phdr[i].p_type == PT_LOAD && elf.phdr[i].p_vaddr < min_vaddr) {
-            min_vaddr = elf.phdr[i].p_vaddr;
-        }
+    /* 最后一个 start <= a 的区间 */
+    size_t lo = 0, hi = index->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index->ranges[mid].start <= a) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0 || a >= index->ranges[lo - 1].end) {
+        return NULL;
+    }
+    return index->ranges[lo - 1].si;
+}
+
+/* 参与反查的符号：已定义、非局部、代表代码或数据的位置 */
+static inline bool addr_symbol_wanted(const ElfW(Sym)* sym) {
+    unsigned char type = ELFW_ST_TYPE(sym->st_info);
+    return sym->st_shndx != SHN_UNDEF && sym->st_value != 0 &&
+           ELFW_ST_BIND(sym->st_info) != STB_LOCAL &&
+           type != STT_TLS && type != STT_SECTION && type != STT_FILE;
+}
+
+static int addr_symbol_cmp(const void* a, const void* b) {
+    const addr_symbol_t* x = (const addr_symbol_t*)a;
+    const addr_symbol_t* y = (const addr_symbol_t*)b;
+    if (x->value != y->value) return x->value < y->value ? -1 : 1;
+    /* 同一地址的别名中有大小的排在前面，下标小的优先（结果稳定） */
+    if ((x->size == 0) != (y->size == 0)) return x->size ? -1 : 1;
+    return x->sym < y->sym ? -1 : x->sym > y->sym;
+}
+
+/**
+ * addr_symtab_build - 为库构建按地址排序的符号数组
+ * @si: 共享库信息
+ *
+ * 返回: 符号数组，内存不足返回 NULL
+ */
+static addr_symtab_t* addr_symtab_build(soinfo_t* si) {
+    size_t total = get_symbol_count(si);
+    size_t count = 0;
+    for (size_t i = 1; i < total; i++) {
+        if (addr_symbol_wanted(&si->symtab[i])) count++;
+    }
+
+    addr_symtab_t* table = (addr_symtab_t*)malloc(sizeof(addr_symtab_t) + count * sizeof(addr_symbol_t));
+    if (!table) return NULL;
+
+    size_t n = 0;
+    for (size_t i = 1; i < total; i++) {
+        const ElfW(Sym)* sym = &si->symtab[i];
+        if (!addr_symbol_wanted(sym)) continue;
+        table->syms[n++] = (addr_symbol_t){ sym->st_value, sym->st_size, (uint32_t)i };
+    }
+    qsort(table->syms, n, sizeof(addr_symbol_t), addr_symbol_cmp);
+
+    /* 同一地址只保留第一个（别名），二分查找的结果因此唯一 */
+    size_t out = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (out && table->syms[out - 1].value == table->syms[i].value) continue;
+        table->syms[out++] = table->syms[i];
+    }
+    table->count = out;
+    return table;
+}
+
+/**
+ * addr_symtab_get - 获取库的地址排序符号数组，不存在时构建
+ * @si: 共享库信息
+ *
+ * 与 flat_symtab_get 相同：并发构建时只有一个结果被发布，其余的被丢弃。
+ *
+ * 返回: 符号数组，没有符号表或内存不足返回 NULL
+ */
+static addr_symtab_t* addr_symtab_get(soinfo_t* si) {
+    addr_symtab_t* table = __atomic_load_n(&si->addr_symtab, __ATOMIC_ACQUIRE);
+    if (table || !si->symtab || !si->strtab) {
+        return table;
+    }
+
+    table = addr_symtab_build(si);
+    if (!table) return NULL;
+
+    addr_symtab_t* expected = NULL;
+    if (!__atomic_compare_exchange_n(&si->addr_symtab, &expected, table, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        free(table);
+        return expected;
+    }
+    LOG("[linker] Built address index for %s (%zu symbols)\n", si->name, table->count);
+    return table;
+}
+
+/**
+ * linker_find_symbol_by_addr - 查找覆盖地址的符号（在 RCU 读侧临界区中调用）
+ * @si: 包含该地址的库
+ * @addr: 库映射中的地址
+ *
+ * 返回: 符号，地址前面没有符号、或者落在上一个符号的范围之外返回 NULL
+ */
+const ElfW(Sym)* linker_find_symbol_by_addr(soinfo_t* si, const void* addr) {
+    ElfW(Addr) offset = (ElfW(Addr))((uintptr_t)addr - (uintptr_t)si->load_bias);
+    addr_symtab_t* table = addr_symtab_get(si);
+
+    if (!table) {
+        /* 内存不足：逐个比较（没有符号表时 symbol_count 为 0） */
+        const ElfW(Sym)* best = NULL;
+        size_t total = si->symtab && si->strtab ? get_symbol_count(si) : 0;
+        for (size_t i = 1; i < total; i++) {
+            const ElfW(Sym)* sym = &si->symtab[i];
+            if (addr_symbol_wanted(sym) && sym->st_value <= offset &&
+                (!best || sym->st_value > best->st_value)) {
+                best = sym;
+            }
+        }
+        if (best && best->st_size && offset - best->st_value >= best->st_size) {
+            return NULL;
+        }
+        return best;
+    }
+
+    /* 最后一个 value <= offset 的符号 */
+    size_t lo = 0, hi = table->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (table->syms[mid].value <= offset) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) {
+        return NULL;
+    }
+    const addr_symbol_t* match = &table->syms[lo - 1];
+    if (match->size && offset - match->value >= match->size) {
+        return NULL;
+    }
+    return &si->symtab[match->sym];
+}
+
+/**
+ * linker_first_library - 已加载库链表的第一个库（在 RCU 读侧临界区中调用）
+ *
+ * 返回: 第一个库，没有已加载的库返回 NULL
+ */
+soinfo_t* linker_first_library(void) {
+    return rcu_dereference(g_linker.soinfo_list);
+}
+
+/**
+ * linker_list_counters - 累计加入和移出已加载库链表的库数
+ * @adds: 输出加入的个数
+ * @subs: 输出移出的个数
+ *
+ * 两个值都没有变化时，链表与上次看到的相同（调用者可以复用缓存的结果）。
+ */
+void linker_list_counters(uint64_t* adds, uint64_t* subs) {
+    *adds = __atomic_load_n(&g_linker.adds, __ATOMIC_ACQUIRE);
+    *subs = __atomic_load_n(&g_linker.subs, __ATOMIC_ACQUIRE);
+}
+
+/* =============================================================================
+ * 全局查找范围
+ * =============================================================================
+ *
+ * 全局符号查找（重定位时每个未缓存的符号都要走一遍）原来沿 soinfo 链表
+ * 逐个库查找：每个库都要先跳到 soinfo（一次缓存未命中），再读 gnu_hash
+ * 头部（又一次），然后才能检查 bloom filter。绝大多数库都在 bloom 这一步
+ * 被排除，前两次未命中纯粹是浪费。
+ *
+ * 这里把查找需要的字段（bloom、chain、symtab、strtab、versym）按加载
+ * 顺序复制成连续数组，每项一条缓存行，硬件预取可以跟上顺序访问。
+ * 数组在链表变化时由写者重建，通过 RCU 整体替换；库映射完成后这些字段
+ * 不再变化，快照不会过期。
+ */
+
+/**
+ * scope_entry_init - 填写一个库的查找项
+ * @e: 查找项
+ * @si: 共享库信息（已映射并解析动态段）
+ */
+static void scope_entry_init(lookup_entry_t* e, soinfo_t* si) {
+    memset(e, 0, sizeof(*e));
+    e->si = si;
+    e->symtab = si->symtab;
+    e->strtab = si->strtab;
+    e->versym = si->versym;
+
+    if (si->gnu_hash && si->symtab && si->strtab) {
+        const uint32_t* gnu = si->gnu_hash;
+        e->nbuckets = gnu[0];
+        e->bloom_size = gnu[2];
+        e->bloom_shift = gnu[3];
+        e->bloom = (const uint64_t*)&gnu[4];
+        const uint32_t* buckets = (const uint32_t*)&e->bloom[e->bloom_size];
+        e->chain = buckets + e->nbuckets - gnu[1];
+    }
+}
+
+/**
+ * scope_entry_lookup - 在一个查找项中查找符号
+ * @e: 查找项
+ * @sn: 符号查找键
+ *
+ * 与 gnu_lookup 相同的步骤，只是字段都来自查找项本身。
+ * 没有 GNU hash、或者匹配到的符号不可用（未定义、局部）时，
+ * 交给 linker_find_symbol_ex 按原来的顺序处理。
+ *
+ * 返回: 符号地址，未找到返回 NULL
+ */
+static void* scope_entry_lookup(const lookup_entry_t* e, symbol_name_t* sn) {
+    if (!e->bloom) {
+        return linker_find_symbol_ex(e->si, sn);
+    }
+
+    uint32_t h1 = symbol_name_gnu_hash(sn);
+    uint64_t word = e->bloom[(h1 / 64) % e->bloom_size];
+    uint64_t mask = (1ULL << (h1 % 64)) | (1ULL << ((h1 >> e->bloom_shift) % 64));
+    if ((word & mask) != mask) {
+        return NULL;
+    }
+
+    const uint32_t* buckets = (const uint32_t*)&e->bloom[e->bloom_size];
+    uint32_t n = buckets[h1 % e->nbuckets];
+    if (n == 0) {
+        return NULL;
+    }
+
+    int wanted = VERSION_UNKNOWN;
+    do {
+        uint32_t h2 = e->chain[n];
+        if (((h1 ^ h2) >> 1) == 0 && (!e->versym || version_match(e->si, n, sn, &wanted))) {
+            const ElfW(Sym)* sym = &e->symtab[n];
+            if (strcmp(e->strtab + sym->st_name, sn->name) == 0) {
+                unsigned char bind = ELFW_ST_BIND(sym->st_info);
+                if (sym->st_shndx != SHN_UNDEF && (bind == STB_GLOBAL || bind == STB_WEAK)) {
+                    return symbol_address(e->si, sym, sn);
+                }
+                return linker_find_symbol_ex(e->si, sn);
+            }
+        }
+        if (h2 & 1) break;
+        n++;
+    } while (1);
+
+    return NULL;
+}
+
+/**
+ * scope_rebuild - 按已加载库链表重建全局查找范围
+ *
+ * 链表变化（加载、卸载）之后、作废符号缓存之前由写者调用，
+ * 这样看到新 generation 的读者一定也看到新数组。
+ * 旧数组在下一次 rcu_reclaim() 时释放。内存不足时发布 NULL，
+ * 全局查找退回遍历链表。同时重建全局地址索引。
+ */
+static void scope_rebuild(void) {
+    size_t count = 0;
+    for (soinfo_t* si = g_linker.soinfo_list; si; si = si->next) count++;
+
+    lookup_scope_t* scope = NULL;
+    if (count) {
+        scope = (lookup_scope_t*)aligned_alloc(
+            _Alignof(lookup_entry_t), sizeof(lookup_scope_t) + count * sizeof(lookup_entry_t));
+    }
+    if (scope) {
+        size_t i = 0;
+        for (soinfo_t* si = g_linker.soinfo_list; si; si = si->next) {
+            scope_entry_init(&scope->entries[i++], si);
+        }
+        scope->count = count;
+    } else if (count) {
+        LOG_WARN("[linker] Out of memory building lookup scope, falling back to list walk\n");
+    }
+
+    lookup_scope_t* old = g_linker.scope;
+    rcu_assign_pointer(g_linker.scope, scope);
+    rcu_defer_free(old);
+
+    /* 地址索引与查找范围一样只随链表变化 */
+    addr_index_rebuild();
+}
+
+/**
+ * builtin_symbol - 链接器自己提供给被加载库的符号
+ * @name: 符号名
+ *
+ * __tls_get_addr 必须由管理 TLS 模块的链接器提供：系统 ld.so 的版本
+ * 不认识我们分配的模块 ID。不比较版本（引用方通常要求 GLIBC_2.3）。
+ *
+ * 返回: 符号地址，不是内置符号返回 NULL
+ */
+static void* builtin_symbol(const char* name) {
+    if (name[0] == '_' && strcmp(name, "__tls_get_addr") == 0) {
+        return (void*)linker_tls_get_addr;
+    }
+    return NULL;
+}
+
+static void* global_lookup(symbol_name_t* sn, linker_stats_t* stats);
+
+/**
+ * linker_find_global_symbol - 在所有已加载库中查找符号
+ * @name: 符号名称
+ *
+ * linker_find_global_symbol_ex 的简单封装。
+ *
+ * 返回: 符号地址，未找到返回 NULL
+ */
+void* linker_find_global_symbol(const char* name) {
+    symbol_name_t sn;
+    symbol_name_init(&sn, name);
+    return linker_find_global_symbol_ex(&sn);
+}
+
+/**
+ * linker_find_global_symbol_ex - 在所有已加载库中查找符号
+ * @sn: 符号查找键
+ *
+ * 整个查找过程（缓存 + 所有库）共享同一个查找键，
+ * 名字最多只被 GNU hash 和 ELF hash 各计算一次。
+ *
+ * 查找顺序：
+ *   0. 先查全局符号缓存，命中则直接返回（包括负缓存）
+ *   1. 首先在我们自己加载的库中查找
+ *   2. 然后通过系统的 dlsym(RTLD_DEFAULT) 查找系统库（要求版本时用 dlvsym）
+ *
+ * 这样可以让加载的库调用 libc 函数（如 printf）。
+ * 无论成功与否，结果都会写入缓存。
+ *
+ * 整个查找在 RCU 读侧临界区中进行，命中缓存时不获取任何锁。
+ * 查找期间如果有库被加载或卸载（generation 变化），结果不写入缓存。
+ *
+ * 返回: 符号地址，未找到返回 NULL
+ */
+void* linker_find_global_symbol_ex(symbol_name_t* sn) {
+    return global_lookup(sn, NULL);
+}
+
+/**
+ * global_lookup - linker_find_global_symbol_ex 的实现
+ * @sn: 符号查找键
+ * @stats: 按结果来源计数（可以为 NULL）
+ *
+ * 返回: 符号地址，未找到返回 NULL
+ */
+static void* global_lookup(symbol_name_t* sn, linker_stats_t* stats) {
+    const char* name = sn->name;
+    uint32_t hash = symbol_name_gnu_hash(sn);
+
+    /* 缓存的键：不要求版本时就是名字 */
+    char key_buf[SYMCACHE_KEY_MAX];
+    const char* key = name;
+    if (sn->version) {
+        int n = snprintf(key_buf, sizeof(key_buf), "%s@%s", name, sn->version);
+        key = n > 0 && (size_t)n < sizeof(key_buf) ? key_buf : NULL;
+    }
+
+    rcu_read_lock();
+    symcache_entry_t* cached = key ? symcache_lookup(hash, key) : NULL;
+    if (cached) {
+        void* cached_addr = cached->addr;
+        if (stats) {
+            stats->lookups[cached->source]++;
+            stats->lookup_cache_hits++;
+        }
+        rcu_read_unlock();
+        return cached_addr;
+    }
+
+    uint64_t generation = __atomic_load_n(&g_linker.symcache_generation, __ATOMIC_ACQUIRE);
+    uint16_t source = LINKER_LOOKUP_GLOBAL;
+
+    /* 链接器自己提供的符号（与 ld.so 相同，先于所有库）*/
+    void* addr = builtin_symbol(name);
+
+    /* 先在我们加载的库中查找（顺序访问紧凑数组；没有数组时遍历链表）*/
+    lookup_scope_t* scope = rcu_dereference(g_linker.scope);
+    if (scope) {
+        for (size_t i = 0; i < scope->count && !addr; i++) {
+            addr = scope_entry_lookup(&scope->entries[i], sn);
+        }
+    } else {
+        for (soinfo_t* si = rcu_dereference(g_linker.soinfo_list); si != NULL && !addr;
+             si = rcu_dereference(si->next)) {
+            addr = linker_find_symbol_ex(si, sn);
+        }
+    }
+
+    /*
+     * 从系统库中查找
+     * RTLD_DEFAULT 表示在默认搜索范围内查找
+     * 这允许加载的 .so 调用 libc 函数
+     */
+    if (!addr) {
+        addr = sn->version ? dlvsym(RTLD_DEFAULT, name, sn->version) : dlsym(RTLD_DEFAULT, name);
+        source = addr ? LINKER_LOOKUP_SYSTEM : LINKER_LOOKUP_MISS;
+    }
+    if (stats) {
+        stats->lookups[source]++;
+    }
+
+    /* 其他线程可能同时解析了同一个名字，只保留一个条目；TLS 变量的地址因线程而异，不缓存 */
+    pthread_mutex_lock(&g_symcache_lock);
+    if (key && !sn->per_thread && g_linker.symcache_generation == generation &&
+        !symcache_lookup(hash, key)) {
+        symcache_insert(hash, key, addr, source);
+    }
+    pthread_mutex_unlock(&g_symcache_lock);
+
+    rcu_read_unlock();
+    return addr;
+}
+
+/* =============================================================================
+ * 重定位
+ * =============================================================================
+ */
+
+/*
+ * 重定位上下文：一次重定位任务（一个区间、或者一个库的其余部分）
+ * 的本地统计，任务结束时合并到 si->stats。
+ */
+typedef struct {
+    soinfo_t* si;
+    linker_stats_t stats;
+} reloc_ctx_t;
+
+static void reloc_ctx_init(reloc_ctx_t* ctx, soinfo_t* si) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->si = si;
+}
+
+/**
+ * resolve_symbol - 解析重定位引用的符号
+ * @ctx: 重定位上下文
+ * @sym_idx: 符号表索引（非 0）
+ *
+ * 符号查找策略：
+ *   1. 如果符号在当前库中已定义（st_shndx != SHN_UNDEF），使用本地定义
+ *   2. 否则在全局范围（其他库和系统库）中查找
+ *
+ * 返回: 符号地址，找不到返回 NULL
+ */
+static void* resolve_symbol(reloc_ctx_t* ctx, uint32_t sym_idx) {
+    soinfo_t* si = ctx->si;
+    ElfW(Sym)* sym = &si->symtab[sym_idx];
+    const char* sym_name = si->strtab + sym->st_name;
+    void* sym_addr;
+
+    if (sym->st_shndx != SHN_UNDEF) {
+        sym_addr = (uint8_t*)si->load_bias + sym->st_value;
+        ctx->stats.lookups[LINKER_LOOKUP_LOCAL]++;
+    } else {
+        /* 按引用方 .gnu.version_r 记录的版本查找（例如 memcpy@GLIBC_2.14）*/
+        symbol_name_t sn;
+        symbol_name_init(&sn, sym_name);
+        required_version(si, sym_idx, &sn);
+        sym_addr = global_lookup(&sn, &ctx->stats);
+    }
+
+    /* 如果非弱符号找不到，记录警告但继续执行 */
+    if (!sym_addr && ELFW_ST_BIND(sym->st_info) != STB_WEAK) {
+        LOG_WARN("Cannot find symbol: %s\n", sym_name);
+        /* 允许继续，某些符号可能是可选的 */
+    }
+
+    return sym_addr;
+}
+
+/**
+ * resolve_tls_symbol - 解析 TLS 重定位引用的符号
+ * @ctx: 重定位上下文
+ * @sym_idx: 符号下标（0 表示模块自身，例如 local-dynamic 的 DTPMOD64）
+ * @def: 输出定义该符号的库
+ * @value: 输出符号在定义方 TLS 块中的偏移（st_value）
+ *
+ * TLS 符号的 st_value 是块内偏移而不是地址，查找结果也不能放进全局符号缓存。
+ * 这里按全局搜索顺序逐个库的 hash 表查找，直接取定义的 st_value。
+ * 定义在系统库中的 TLS 符号不支持。
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+static int resolve_tls_symbol(reloc_ctx_t* ctx, uint32_t sym_idx, soinfo_t** def, ElfW(Addr)* value) {
+    soinfo_t* si = ctx->si;
+    *def = si;
+    *value = 0;
+    if (sym_idx == 0) return 0;
+
+    ElfW(Sym)* sym = &si->symtab[sym_idx];
+    if (sym->st_shndx != SHN_UNDEF) {
+        *value = sym->st_value;
+        ctx->stats.lookups[LINKER_LOOKUP_LOCAL]++;
+        return 0;
+    }
+
+    symbol_name_t sn;
+    symbol_name_init(&sn, si->strtab + sym->st_name);
+    required_version(si, sym_idx, &sn);
+
+    const ElfW(Sym)* found = NULL;
+    rcu_read_lock();
+    for (soinfo_t* it = rcu_dereference(g_linker.soinfo_list); it && !found; it = rcu_dereference(it->next)) {
+        if (!it->has_tls || !it->symtab || !it->strtab) continue;
+        found = find_symbol_entry(it, &sn);
+        if (found && ELFW_ST_TYPE(found->st_info) != STT_TLS) {
+            found = NULL;
+        }
+        if (found) {
+            *def = it;
+            *value = found->st_value;
+        }
+    }
+    rcu_read_unlock();
+
+    if (!found) {
+        ctx->stats.lookups[LINKER_LOOKUP_MISS]++;
+        linker_set_error("Cannot resolve TLS symbol %s in %s", sn.name, si->name);
+        return -1;
+    }
+    ctx->stats.lookups[LINKER_LOOKUP_GLOBAL]++;
+    return 0;
+}
+
+#if ARCH_HAS_TLSDESC
+/*
+ * TLSDESC 解析函数（tlsdesc_aarch64.S），地址写入描述符的第一个字。
+ * 代码通过 blr 调用它们，x0 指向描述符，返回变量相对线程指针的偏移；
+ * 除 x0 外不得破坏任何寄存器，因此只能用汇编实现。
+ */
+extern void linker_tlsdesc_static(void);
+extern void linker_tlsdesc_dynamic(void);
+
+/* 动态描述符的参数：模块 ID << TLSDESC_MODULE_SHIFT | 块内偏移（与 tlsdesc_aarch64.S 一致）*/
+#define TLSDESC_MODULE_SHIFT 48
+
+/**
+ * do_tlsdesc - 填写一个 TLS 描述符
+ * @def: 定义方（已注册 TLS 模块）
+ * @offset: 变量在定义方 TLS 块中的偏移（S + A）
+ * @desc: 描述符 { 解析函数, 参数 }
+ *
+ * 静态 TLS 中的模块在所有线程里偏移相同，参数直接就是结果；
+ * 否则参数编码模块 ID 和块内偏移，每次调用经由 linker_tls_get_addr 求地址。
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+static int do_tlsdesc(const soinfo_t* def, ElfW(Addr) offset, void* desc) {
+    ElfW(Addr)* d = (ElfW(Addr)*)desc;
+
+    if (def->tls_static) {
+        d[1] = (ElfW(Addr))def->tls_tp_offset + offset;
+        d[0] = (ElfW(Addr))linker_tlsdesc_static;
+        return 0;
+    }
+
+    if (def->tls_module >> (64 - TLSDESC_MODULE_SHIFT) || offset >> TLSDESC_MODULE_SHIFT) {
+        linker_set_error("TLS descriptor out of range in %s", def->name);
+        return -1;
+    }
+    d[1] = ((ElfW(Addr))def->tls_module << TLSDESC_MODULE_SHIFT) | offset;
+    d[0] = (ElfW(Addr))linker_tlsdesc_dynamic;
+    return 0;
+}
+#endif
+
+/**
+ * do_tls_reloc - 执行 TLS 重定位
+ * @ctx: 重定位上下文
+ * @rela: 重定位条目
+ * @reloc_addr: 需要修正的位置
+ *
+ *   TLS_DTPMOD:  GOT 中 tls_index_t 的模块 ID（__tls_get_addr 的第一个字段）
+ *   TLS_DTPREL:  tls_index_t 的偏移
+ *   TLS_TPREL:   initial-exec 代码使用的线程指针相对偏移，定义方必须在静态 TLS 中
+ *   TLSDESC:     (AArch64) TLS 描述符，见 do_tlsdesc
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+static int do_tls_reloc(reloc_ctx_t* ctx, const linker_rel_t* rela, void* reloc_addr) {
+    uint32_t type = ELFW_R_TYPE(rela->r_info);
+    ElfW(Addr) addend = RELOC_ADDEND(rela, reloc_addr);
+    soinfo_t* def;
+    ElfW(Addr) value;
+
+    if (resolve_tls_symbol(ctx, ELFW_R_SYM(rela->r_info), &def, &value) < 0) {
+        return -1;
+    }
+    if (!def->tls_module) {
+        linker_set_error("TLS relocation against %s, which has no PT_TLS", def->name);
+        return -1;
+    }
+
+    switch (type) {
+        case ARCH_R_TLS_DTPMOD:
+            *(ElfW(Addr)*)reloc_addr = def->tls_module;
+            break;
+
+        case ARCH_R_TLS_DTPREL:
+            *(ElfW(Addr)*)reloc_addr = value + addend;
+            break;
+
+        case ARCH_R_TLS_TPREL:
+            if (!def->tls_static) {
+                linker_set_error("Initial-exec TLS access to %s, which is not in static TLS", def->name);
+                return -1;
+            }
+            *(ElfW(Addr)*)reloc_addr = (ElfW(Addr))def->tls_tp_offset + value + addend;
+            break;
+
+#if ARCH_HAS_TLSDESC
+        case ARCH_R_TLSDESC:
+            return do_tlsdesc(def, value + addend, reloc_addr);
+#endif
+    }
+    return 0;
+}
+
+/**
+ * do_reloc - 执行单个重定位
+ * @ctx: 重定位上下文（共享库信息 + 本地统计）
+ * @rela: 重定位条目
+ *
+ * 重定位是动态链接的核心步骤之一。
+ * 当共享库被加载到内存中时，其代码和数据中的某些地址引用需要被修正，
+ * 因为库的实际加载地址可能与编译时预期的地址不同。
+ *
+ * RELA 重定位条目结构（ARM32 的 REL 条目没有 r_addend，加数是目标位置中原有的值）：
+ *   struct Elf64_Rela {
+ *       Elf64_Addr r_offset;   // 需要修正的位置（相对于段起始）
+ *       Elf64_Xword r_info;    // 符号索引和重定位类型
+ *       Elf64_Sxword r_addend; // 加数
+ *   };
+ *
+ * r_info 的解析：
+ *   - ELF64: 高 32 位为符号索引，低 32 位为重定位类型
+ *   - ELF32: 高 24 位为符号索引，低 8 位为重定位类型
+ *
+ * 类型常量来自 linker_arch.h，每个架构只编译自己的那一组 case。
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+static int do_reloc(reloc_ctx_t* ctx, linker_rel_t* rela) {
+    soinfo_t* si = ctx->si;
+
+    /* 提取重定位类型和符号索引 */
+    uint32_t type = ELFW_R_TYPE(rela->r_info);
+    uint32_t sym_idx = ELFW_R_SYM(rela->r_info);
+    stats_count_reloc(&ctx->stats, type, 1);
+
+    /* 计算需要修正的内存地址 */
+    ElfW(Addr)* reloc_addr = (ElfW(Addr)*)((uint8_t*)si->load_bias + rela->r_offset);
+    void* sym_addr = NULL;
+
+    /* TLS 重定位需要的是定义方的模块和偏移，而不是地址 */
+    if (ARCH_IS_TLS_RELOC(type)) {
+        return do_tls_reloc(ctx, rela, reloc_addr);
+    }
+
+    /* 如果有符号索引，查找符号地址 */
+    if (sym_idx != 0) {
+        sym_addr = resolve_symbol(ctx, sym_idx);
+    }
+
+    /*
+     * 根据重定位类型执行修正
+     *
+     *   类型          | x86_64             | AArch64             | ARM        | 计算公式
+     *   --------------|--------------------|---------------------|------------|----------
+     *   NONE          | R_X86_64_NONE      | R_AARCH64_NONE      | R_ARM_NONE | -
+     *   ABS           | R_X86_64_64        | R_AARCH64_ABS64     | ABS32      | S + A
+     *   GLOB_DAT      | R_X86_64_GLOB_DAT  | R_AARCH64_GLOB_DAT  | GLOB_DAT   | S (AArch64: S + A)
+     *   JUMP_SLOT     | R_X86_64_JUMP_SLOT | R_AARCH64_JUMP_SLOT | JUMP_SLOT  | S (AArch64: S + A)
+     *   RELATIVE      | R_X86_64_RELATIVE  | R_AARCH64_RELATIVE  | RELATIVE   | B + A
+     *   COPY          | R_X86_64_COPY      | R_AARCH64_COPY      | COPY       | 复制符号内容
+     *   TLS_*         | DTPMOD64/DTPOFF64/TPOFF64 | TLS_DTPMOD/DTPREL/TPREL, TLSDESC | TLS_*32 | 见 do_tls_reloc
+     *
+     *   其中: S = 符号地址, A = addend, B = load_bias
+     */
+    switch (type) {
+        case ARCH_R_NONE:
+            /* 无操作，占位符 */
+            break;
+
+        case ARCH_R_ABS:
+            /*
+             * 绝对地址重定位: S + A
+             * 用于直接引用符号地址的情况
+             * 例如: static void* ptr = &some_func;
+             */
+            *reloc_addr = (ElfW(Addr))sym_addr + RELOC_ADDEND(rela, reloc_addr);
+            break;
+
+        case ARCH_R_GLOB_DAT:
+            /*
+             * 全局数据偏移表 (GOT) 条目: S
+             * 用于访问全局变量
+             * GOT 中存储变量的实际地址
+             */
+        case ARCH_R_JUMP_SLOT:
+            /*
+             * 过程链接表 (PLT) 条目: S
+             * 用于函数调用
+             * PLT 中存储函数的实际地址
+             */
+#if ARCH_GOT_USES_ADDEND
+            *reloc_addr = (ElfW(Addr))sym_addr + RELOC_ADDEND(rela, reloc_addr);
+#else
+            *reloc_addr = (ElfW(Addr))sym_addr;
+#endif
+            break;
+
+        case ARCH_R_RELATIVE:
+            /*
+             * 相对地址重定位: B + A
+             * 这是最常见的重定位类型
+             * 用于与位置无关代码 (PIC) 中的地址计算
+             * 不需要符号查找，只需加上加载偏移
+             */
+            *reloc_addr = (ElfW(Addr))si->load_bias + RELOC_ADDEND(rela, reloc_addr);
+            break;
+
+        case ARCH_R_COPY:
+            /*
+             * 复制重定位
+             * 将符号的内容复制到目标位置
+             * 主要用于可执行文件中的全局变量
+             */
+            if (sym_addr) {
+                ElfW(Sym)* sym = &si->symtab[sym_idx];
+                memcpy(reloc_addr, sym_addr, sym->st_size);
+            }
+            break;
+
+        default:
+            LOG_WARN("Unsupported relocation type: %u\n", type);
+            break;
+    }
+
+    return 0;
+}
+
+/**
+ * relocate_relative - 批量处理 RELATIVE 重定位
+ * @si: 共享库信息
+ * @rela: 第一个 RELATIVE 条目
+ * @count: 条目个数（调用者保证全部是 RELATIVE）
+ *
+ * 大型 C++ 库中 RELATIVE 通常占全部重定位的 80% 以上（虚表、字符串指针表等），
+ * 它们不需要符号查找，只需 *where = B + A。
+ * 这里跳过类型判断和函数调用开销。
+ *
+ * 每次先读出 4 个条目再统一写入：写入地址任意分布，SIMD 对散列写入帮不上忙，
+ * 但先读后写可以让编译器不必担心写入与后续条目的读取互相别名，
+ * 4 组读取得以并行发射。
+ *
+ * 条目和字长随架构在编译期确定：RELA 从条目读加数，
+ * ARM32 的 REL 从目标位置读隐式加数（同样在 4 个写入之前读完）。
+ */
+static void relocate_relative(soinfo_t* si, const linker_rel_t* rela, size_t count) {
+    uint8_t* bias = (uint8_t*)si->load_bias;
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        ElfW(Addr)* where0 = (ElfW(Addr)*)(bias + rela[i + 0].r_offset);
+        ElfW(Addr)* where1 = (ElfW(Addr)*)(bias + rela[i + 1].r_offset);
+        ElfW(Addr)* where2 = (ElfW(Addr)*)(bias + rela[i + 2].r_offset);
+        ElfW(Addr)* where3 = (ElfW(Addr)*)(bias + rela[i + 3].r_offset);
+        ElfW(Addr) add0 = RELOC_ADDEND(&rela[i + 0], where0), add1 = RELOC_ADDEND(&rela[i + 1], where1);
+        ElfW(Addr) add2 = RELOC_ADDEND(&rela[i + 2], where2), add3 = RELOC_ADDEND(&rela[i + 3], where3);
+
+        *where0 = (ElfW(Addr))bias + add0;
+        *where1 = (ElfW(Addr))bias + add1;
+        *where2 = (ElfW(Addr))bias + add2;
+        *where3 = (ElfW(Addr))bias + add3;
+    }
+
+    for (; i < count; i++) {
+        ElfW(Addr)* where = (ElfW(Addr)*)(bias + rela[i].r_offset);
+        *where = (ElfW(Addr))bias + RELOC_ADDEND(&rela[i], where);
+    }
+}
+
+/* =============================================================================
+ * 压缩重定位 (DT_RELR / Android APS2)
+ * =============================================================================
+ *
+ * 普通 RELA 条目每个 24 字节，而 RELATIVE 重定位其实只需要一个地址。
+ * 两种压缩格式都能把重定位表缩小一个数量级，加载时读取和触碰的页更少。
+ */
+
+/**
+ * relocate_relr - 处理 DT_RELR 相对重定位
+ * @ctx: 重定位上下文
+ *
+ * RELR 表由两种条目组成（用最低位区分）：
+ *
+ *   偶数条目：地址 —— 重定位该位置，并把 "下一个位置" 设为 addr + 8
+ *   奇数条目：位图 —— 第 1..63 位依次对应 "下一个位置" 起的 63 个字，
+ *             位为 1 则重定位该字；处理完后 "下一个位置" 前进 63 个字
+ *
+ * RELR 的加数就是目标位置中已有的值（隐式加数），所以操作是 *where += B。
+ * 位图用 ctz 跳过 0 位，只访问需要修正的字。
+ */
+static void relocate_relr(reloc_ctx_t* ctx) {
+    soinfo_t* si = ctx->si;
+    ElfW(Addr) bias = (ElfW(Addr))si->load_bias;
+    ElfW(Addr)* where = NULL;
+    uint64_t applied = 0;
+
+    for (size_t i = 0; i < si->relr_count; i++) {
+        ElfW(Relr) entry = si->relr[i];
+
+        if ((entry & 1) == 0) {
+            where = (ElfW(Addr)*)(bias + entry);
+            *where++ += bias;
+            applied++;
+            continue;
+        }
+
+        applied += (uint64_t)__builtin_popcountll(entry >> 1);
+        for (ElfW(Relr) bits = entry >> 1; bits != 0; bits &= bits - 1) {
+            where[__builtin_ctzll(bits)] += bias;
+        }
+        where += 8 * sizeof(ElfW(Relr)) - 1;
+    }
+
+    /* 统计上按 RELATIVE 计数 */
+    stats_count_reloc(&ctx->stats, ARCH_R_RELATIVE, applied);
+}
+
+/*
+ * APS2 分组标志
+ *
+ * 打包流以 "APS2" 开头，之后全部是 SLEB128 整数：
+ *
+ *   重定位总数, 初始 r_offset
+ *   分组 × N:
+ *     组大小, 组标志
+ *     [offset 增量]   若 GROUPED_BY_OFFSET_DELTA
+ *     [r_info]        若 GROUPED_BY_INFO
+ *     [addend 增量]   若 HAS_ADDEND 且 GROUPED_BY_ADDEND
+ *     每条重定位:
+ *       [offset 增量] 若非 GROUPED_BY_OFFSET_DELTA
+ *       [r_info]      若非 GROUPED_BY_INFO
+ *       [addend 增量] 若 HAS_ADDEND 且非 GROUPED_BY_ADDEND
+ *
+ * 组内共有的字段只编码一次，offset 和 addend 都以增量形式存储。
+ */
+#define APS2_GROUPED_BY_INFO            0x1
+#define APS2_GROUPED_BY_OFFSET_DELTA    0x2
+#define APS2_GROUPED_BY_ADDEND          0x4
+#define APS2_GROUP_HAS_ADDEND           0x8
+
+/* SLEB128 读取器 */
+typedef struct {
+    const uint8_t* cur;
+    const uint8_t* end;
+    bool error;             /* 读越界 */
+} sleb128_reader_t;
+
+static int64_t sleb128_read(sleb128_reader_t* r) {
+    uint64_t value = 0;
+    unsigned shift = 0;
+    uint8_t byte;
+
+    do {
+        if (r->cur >= r->end || shift >= 64) {
+            r->error = true;
+            return 0;
+        }
+        byte = *r->cur++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    /* 符号扩展 */
+    if (shift < 64 && (byte & 0x40)) {
+        value |= ~(uint64_t)0 << shift;
+    }
+    return (int64_t)value;
+}
+
+/* 解码缓冲区大小：攒够一批再统一处理，RELATIVE 的整段走快速路径 */
+#define APS2_BATCH 64
+
+/**
+ * apply_rela_batch - 处理一批解码出的 RELA 条目
+ * @ctx: 重定位上下文
+ * @batch: 条目数组
+ * @count: 条目数
+ *
+ * 连续的 RELATIVE 条目交给 relocate_relative，其余逐条交给 do_reloc。
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+static int apply_rela_batch(reloc_ctx_t* ctx, linker_rel_t* batch, size_t count) {
+    size_t i = 0;
+    while (i < count) {
+        size_t run = i;
+        while (run < count && ELFW_R_TYPE(batch[run].r_info) == ARCH_R_RELATIVE) {
+            run++;
+        }
+        if (run > i) {
+            relocate_relative(ctx->si, &batch[i], run - i);
+            stats_count_reloc(&ctx->stats, ARCH_R_RELATIVE, run - i);
+            i = run;
+            continue;
+        }
+        if (do_reloc(ctx, &batch[i]) < 0) {
+            return -1;
+        }
+        i++;
+    }
+    return 0;
+}
+
+/**
+ * relocate_android_packed - 处理 DT_ANDROID_RELA 打包重定位
+ * @ctx: 重定位上下文
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+static int relocate_android_packed(reloc_ctx_t* ctx) {
+    soinfo_t* si = ctx->si;
+    const uint8_t* data = si->android_rela;
+    size_t size = si->android_rela_size;
+
+    if (size < 4 || memcmp(data, "APS2", 4) != 0) {
+        linker_set_error("Unsupported packed relocation format in %s", si->name);
+        return -1;
+    }
+
+    sleb128_reader_t r = { data + 4, data + size, false };
+    int64_t remaining = sleb128_read(&r);
+    linker_rel_t reloc = {0};
+    reloc.r_offset = (ElfW(Addr))sleb128_read(&r);
+
+    linker_rel_t batch[APS2_BATCH];
+    size_t batch_count = 0;
+
+    while (remaining > 0 && !r.error) {
+        int64_t group_size = sleb128_read(&r);
+        int64_t group_flags = sleb128_read(&r);
+        int64_t group_offset_delta = 0;
+
+        if (group_size <= 0 || group_size > remaining) {
+            r.error = true;
+            break;
+        }
+
+        if (group_flags & APS2_GROUPED_BY_OFFSET_DELTA) {
+            group_offset_delta = sleb128_read(&r);
+        }
+        if (group_flags & APS2_GROUPED_BY_INFO) {
+            reloc.r_info = (ElfW(Xword))sleb128_read(&r);
+        }
+#if ARCH_USE_RELA
+        if (group_flags & APS2_GROUP_HAS_ADDEND) {
+            if (group_flags & APS2_GROUPED_BY_ADDEND) {
+                reloc.r_addend += sleb128_read(&r);
+            }
+        } else {
+            /* 不带加数的组，加数为 0 */
+            reloc.r_addend = 0;
+        }
+#else
+        /* REL 条目没有加数字段，加数在目标位置中 */
+        if (group_flags & APS2_GROUP_HAS_ADDEND) {
+            r.error = true;
+            break;
+        }
+#endif
+
+        for (int64_t i = 0; i < group_size && !r.error; i++) {
+            if (group_flags & APS2_GROUPED_BY_OFFSET_DELTA) {
+                reloc.r_offset += group_offset_delta;
+            } else {
+                reloc.r_offset += sleb128_read(&r);
+            }
+            if (!(group_flags & APS2_GROUPED_BY_INFO)) {
+                reloc.r_info = (ElfW(Xword))sleb128_read(&r);
+            }
+#if ARCH_USE_RELA
+            if ((group_flags & APS2_GROUP_HAS_ADDEND) &&
+                !(group_flags & APS2_GROUPED_BY_ADDEND)) {
+                reloc.r_addend += sleb128_read(&r);
+            }
+#endif
+
+            batch[batch_count++] = reloc;
+            if (batch_count == APS2_BATCH) {
+                if (apply_rela_batch(ctx, batch, batch_count) < 0) return -1;
+                batch_count = 0;
+            }
+        }
+        remaining -= group_size;
+    }
+
+    if (r.error) {
+        linker_set_error("Corrupt packed relocations in %s", si->name);
+        return -1;
+    }
+
+    return apply_rela_batch(ctx, batch, batch_count);
+}
+
+/* =============================================================================
+ * 延迟绑定 (Lazy Binding)
+ * =============================================================================
+ *
+ * 立即绑定时，每个 JUMP_SLOT 都要在加载阶段做一次全局符号查找，
+ * 即使对应的函数在进程生命周期内从未被调用。
+ * 延迟绑定把这次查找推迟到函数第一次被调用时：
+ *
+ *   调用 foo@plt
+ *        │
+ *        ▼
+ *   PLT[n]: jmp *GOT[n]  ──(首次调用时 GOT[n] 指回 PLT[n] 的下一条指令)
+ *           push n                       # .rela.plt 中的重定位索引
+ *           jmp PLT0
+ *        │
+ *        ▼
+ *   PLT0:   push GOT[1]                  # 我们放入的 soinfo 指针
+ *           jmp *GOT[2]                  # 我们放入的解析蹦床
+ *        │
+ *        ▼
+ *   linker_plt_trampoline (plt_trampoline_x86_64.S)
+ *           保存参数寄存器 → linker_lazy_fixup(si, n) → 恢复寄存器
+ *           → 跳转到真正的 foo（GOT[n] 已被改写，之后的调用不再经过这里）
+ *
+ * 链接器生成的 GOT[n] 初值是 PLT[n] 中 push 指令的链接时地址，
+ * 加载时只需要加上 load_bias 即可。
+ *
+ * 蹦床依赖架构的 PLT 布局和调用约定，目前只有 x86_64 实现（ARCH_HAS_LAZY_PLT）；
+ * 其他架构总是立即绑定。
+ */
+#if ARCH_HAS_LAZY_PLT
+
+/* 解析蹦床（汇编实现），地址写入 GOT[2] */
+extern void linker_plt_trampoline(void);
+
+/**
+ * setup_lazy_plt - 为 PLT 重定位安装延迟绑定
+ * @ctx: 重定位上下文
+ *
+ * 只有 JUMP_SLOT 可以延迟，表中其他类型的条目仍然立即处理。
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+static int setup_lazy_plt(reloc_ctx_t* ctx) {
+    soinfo_t* si = ctx->si;
+    for (size_t i = 0; i < si->plt_rela_count; i++) {
+        linker_rel_t* rela = &si->plt_rela[i];
+        if (ELFW_R_TYPE(rela->r_info) == ARCH_R_JUMP_SLOT) {
+            /* GOT[n] 现在指向 PLT[n]+6，只需修正加载偏移 */
+            uint64_t* slot = (uint64_t*)((uint8_t*)si->load_bias + rela->r_offset);
+            *slot += (uint64_t)si->load_bias;
+        } else if (do_reloc(ctx, rela) < 0) {
+            return -1;
+        }
+    }
+
+    si->plt_got[1] = (ElfW(Addr))si;
+    si->plt_got[2] = (ElfW(Addr))linker_plt_trampoline;
+    si->lazy_bound = true;
+    return 0;
+}
+
+/**
+ * linker_lazy_fixup - 解析一个延迟绑定的 PLT 条目
+ * @si: 共享库信息（来自 GOT[1]）
+ * @reloc_index: .rela.plt 中的条目索引（PLT 条目压栈的值）
+ *
+ * 由 linker_plt_trampoline 调用：查找符号、改写 GOT 条目，
+ * 返回值就是蹦床接下来要跳转的目标地址。
+ *
+ * 此时已经没有办法向调用者报告错误，和 glibc 一样，
+ * 找不到符号时打印错误并终止进程。
+ *
+ * 返回: 目标函数地址
+ */
+void* linker_lazy_fixup(soinfo_t* si, size_t reloc_index) {
+    linker_rel_t* rela = &si->plt_rela[reloc_index];
+    uint32_t sym_idx = ELFW_R_SYM(rela->r_info);
+
+    reloc_ctx_t ctx;
+    reloc_ctx_init(&ctx, si);
+    stats_count_reloc(&ctx.stats, ARCH_R_JUMP_SLOT, 1);
+    void* sym_addr = resolve_symbol(&ctx, sym_idx);
+    stats_merge(&si->stats, &ctx.stats);
+
+    if (!sym_addr) {
+        const char* sym_name = si->strtab + si->symtab[sym_idx].st_name;
+        LOG_ERROR("[linker] %s: symbol lookup error: undefined symbol: %s\n",
+                  si->name, sym_name);
+        _exit(127);
+    }
+
+    /* 对齐的 8 字节写入是原子的，并发的首次调用最多重复解析一次 */
+    *(uint64_t*)((uint8_t*)si->load_bias + rela->r_offset) = (uint64_t)sym_addr;
+    return sym_addr;
+}
+
+#endif /* ARCH_HAS_LAZY_PLT */
+
+/**
+ * relocate_rela_range - 处理 .rela.dyn 中 [begin, end) 区间的条目
+ * @si: 共享库信息
+ * @begin: 起始下标
+ * @end: 结束下标（不含）
+ *
+ * 每个条目只写入自己的 r_offset，不同区间之间互不影响，
+ * 因此并行加载时大的 RELA 表可以切分给多个线程。
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+static int relocate_rela_range(soinfo_t* si, size_t begin, size_t end) {
+    if (!si->rela || begin >= end) return 0;
+
+    reloc_ctx_t ctx;
+    reloc_ctx_init(&ctx, si);
+    stats_span_t span;
+    span_begin(&span);
+    int result = 0;
+
+    /* 快速路径：DT_RELACOUNT 指明的 RELATIVE 前缀 */
+    size_t relative_end = si->relative_count;
+    if (relative_end > end) {
+        relative_end = end;
+    }
+    if (relative_end > begin) {
+        relocate_relative(si, si->rela + begin, relative_end - begin);
+        stats_count_reloc(&ctx.stats, ARCH_R_RELATIVE, relative_end - begin);
+        begin = relative_end;
+    }
+
+    /* 通用路径：剩余条目，零散的 RELATIVE 也不必进入 do_reloc */
+    for (size_t i = begin; i < end; i++) {
+        linker_rel_t* rela = &si->rela[i];
+        if (ELFW_R_TYPE(rela->r_info) == ARCH_R_RELATIVE) {
+            relocate_relative(si, rela, 1);
+            stats_count_reloc(&ctx.stats, ARCH_R_RELATIVE, 1);
+        } else if (do_reloc(&ctx, rela) < 0) {
+            result = -1;
+            break;
+        }
+    }
+
+    span_end(&span, &ctx.stats, LINKER_PHASE_RELOCATE);
+    stats_merge(&si->stats, &ctx.stats);
+    return result;
+}
+
+/**
+ * apply_remaining - relocate_remaining 的实现
+ * @ctx: 重定位上下文
+ * @flags: 加载标志
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+static int apply_remaining(reloc_ctx_t* ctx, int flags) {
+    soinfo_t* si = ctx->si;
+
+    /* 处理 RELR 重定位（只有相对重定位，没有符号）*/
+    if (si->relr) {
+        relocate_relr(ctx);
+    }
+
+    /* 处理 Android 打包重定位 */
+    if (si->android_rela && relocate_android_packed(ctx) < 0) {
+        return -1;
+    }
+
+    /* 处理 PLT 重定位（函数调用）*/
+#if ARCH_HAS_LAZY_PLT
+    if (si->plt_rela && (flags & LINKER_FLAG_LAZY) && !si->bind_now && si->plt_got) {
+        LOG("[linker] Lazy binding %zu PLT entries for %s\n", si->plt_rela_count, si->name);
+        return setup_lazy_plt(ctx);
+    }
+#else
+    (void)flags;
+#endif
+
+    if (si->plt_rela) {
+        for (size_t i = 0; i < si->plt_rela_count; i++) {
+            if (do_reloc(ctx, &si->plt_rela[i]) < 0) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * relocate_remaining - 处理 .rela.dyn 以外的所有重定位
+ * @si: 共享库信息
+ * @flags: 加载标志
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+static int relocate_remaining(soinfo_t* si, int flags) {
+    reloc_ctx_t ctx;
+    reloc_ctx_init(&ctx, si);
+    stats_span_t span;
+    span_begin(&span);
+
+    int result = apply_remaining(&ctx, flags);
+
+    span_end(&span, &ctx.stats, LINKER_PHASE_RELOCATE);
+    stats_merge(&si->stats, &ctx.stats);
+    return result;
+}
+
+/**
+ * linker_relocate - 执行所有重定位
+ * @si: 共享库信息
+ * @flags: 加载标志（LINKER_FLAG_LAZY 表示 PLT 延迟绑定）
+ *
+ * 处理以下重定位表：
+ *   1. RELA (.rela.dyn): 数据重定位，总是立即处理
+ *   2. RELR (.relr.dyn): 压缩的相对重定位
+ *   3. Android 打包重定位 (APS2)：解码后按 RELA 处理
+ *   4. PLT RELA (.rela.plt): 函数调用重定位
+ *
+ * 满足以下条件时 PLT 采用延迟绑定，否则立即绑定：
+ *   - 调用者请求了 LINKER_FLAG_LAZY
+ *   - 库本身没有要求 BIND_NOW（-z now）
+ *   - 存在 DT_PLTGOT（需要写入 GOT[1]/GOT[2]）
+ *   - 本架构有解析蹦床（ARCH_HAS_LAZY_PLT）
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+int linker_relocate(soinfo_t* si, int flags) {
+    /* 处理 RELA 重定位（数据引用）*/
+    if (relocate_rela_range(si, 0, si->rela_count) < 0) {
+        return -1;
+    }
+
+    return relocate_remaining(si, flags);
+}
+
+/**
+ * relocate_from_cache - 用重定位缓存完成 si 的重定位
+ * @si: 共享库信息
+ * @cache_dir: 缓存目录
+ *
+ * 符号重定位由缓存写回，RELATIVE 和 RELR 不需要符号查找，照常处理。
+ *
+ * 返回: 使用了缓存返回 0；没有可用的缓存返回 -1（si 未被修改）
+ */
+static int relocate_from_cache(soinfo_t* si, const char* cache_dir) {
+    reloc_ctx_t ctx;
+    reloc_ctx_init(&ctx, si);
+    stats_span_t span;
+    span_begin(&span);
+
+    if (reloc_cache_apply(si, g_linker.soinfo_list, cache_dir, &ctx.stats) < 0) {
+        return -1;
+    }
+
+    size_t prefix = si->relative_count < si->rela_count ? si->relative_count : si->rela_count;
+    if (prefix > 0) {
+        relocate_relative(si, si->rela, prefix);
+        stats_count_reloc(&ctx.stats, ARCH_R_RELATIVE, prefix);
+    }
+    for (size_t i = prefix; i < si->rela_count; i++) {
+        if (ELFW_R_TYPE(si->rela[i].r_info) == ARCH_R_RELATIVE) {
+            relocate_relative(si, &si->rela[i], 1);
+            stats_count_reloc(&ctx.stats, ARCH_R_RELATIVE, 1);
+        }
+    }
+    if (si->relr) {
+        relocate_relr(&ctx);
+    }
+
+    span_end(&span, &ctx.stats, LINKER_PHASE_RELOCATE);
+    stats_merge(&si->stats, &ctx.stats);
+    return 0;
+}
+
+/**
+ * protect_relro - 重定位完成后把 PT_GNU_RELRO 区域设为只读
+ * @si: 共享库信息
+ * @flags: 加载标志
+ * @cache_dir: 重定位缓存目录（NULL 表示不共享 RELRO 页）
+ *
+ * RELRO 只在加载时被重定位写入，之后设为只读可以防止 GOT 被篡改。
+ * 立即绑定且指定了缓存目录时，进一步把与快照相同的页换成映射自
+ * 快照文件的只读页，多个进程共享同一份物理内存。
+ *
+ * mprotect 失败不影响库的使用（只是失去保护），因此只打印警告。
+ */
+static void protect_relro(soinfo_t* si, int flags, const char* cache_dir) {
+    if (!si->relro_start) return;
+
+    if (mprotect(si->relro_start, si->relro_size, PROT_READ) < 0) {
+        LOG_WARN("[linker] mprotect RELRO failed for %s\n", si->name);
+        return;
+    }
+
+    if (cache_dir && !(flags & LINKER_FLAG_LAZY)) {
+        uint64_t shared = reloc_cache_share_relro(si, cache_dir);
+        __atomic_fetch_add(&si->stats.relro_shared_bytes, shared, __ATOMIC_RELAXED);
+    }
+}
+
+/* =============================================================================
+ * 库加载与卸载
+ * =============================================================================
+ */
+
+/**
+ * soinfo_alloc - 为即将加载的库分配 soinfo
+ * @path: 共享库文件路径
+ * @st: 文件的 stat 信息（用于去重索引）
+ *
+ * 只填写名字和 inode，可以先放入索引，映射稍后由 map_library 完成。
+ * soinfo 来自对象池，必须用 soinfo_free 释放。
+ *
+ * 返回: 成功返回 soinfo 指针，失败返回 NULL
+ */
+static soinfo_t* soinfo_alloc(const char* path, const struct stat* st) {
+    soinfo_t* si = (soinfo_t*)pool_alloc(&g_soinfo_pool);
+    if (!si) {
+        linker_set_error("Out of memory");
+        return NULL;
+    }
+
+    /* 名字按实际长度保存在库自己的 arena 中 */
+    arena_init(&si->arena, SOINFO_ARENA_CHUNK);
+    si->name = arena_strdup(&si->arena, path);
+    if (!si->name) {
+        pool_free(&g_soinfo_pool, si);
+        linker_set_error("Out of memory");
+        return NULL;
+    }
+    si->st_dev = st->st_dev;
+    si->st_ino = st->st_ino;
+    si->st_size = st->st_size;
+    si->st_mtim = st->st_mtim;
+    return si;
+}
+
+/**
+ * soinfo_free - 释放 soinfo 及其 arena 中的所有数据
+ * @si: 共享库信息（映射和依赖已经释放，或者从未建立）
+ */
+static void soinfo_free(soinfo_t* si) {
+    arena_release(&si->arena);
+    pool_free(&g_soinfo_pool, si);
+}
+
+/**
+ * locate_phdr - 为没有 PT_PHDR 的库确定程序头表在内存中的位置
+ * @si: 共享库信息（段已映射）
+ * @ehdr: ELF 头
+ * @phdrs: 从文件读取的程序头表
+ *
+ * 程序头表通常位于第一个 PT_LOAD 段覆盖的文件范围内，这时直接
+ * 指向映射后的内存；否则复制一份，随 soinfo 一起释放。
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+static int locate_phdr(soinfo_t* si, const ElfW(Ehdr)* ehdr, const ElfW(Phdr)* phdrs) {
+    size_t size = si->phnum * sizeof(ElfW(Phdr));
+
+    for (size_t i = 0; i < si->phnum; i++) {
+        const ElfW(Phdr)* ph = &phdrs[i];
+        if (ph->p_type != PT_LOAD) continue;
+        if (ehdr->e_phoff >= ph->p_offset &&
+            ehdr->e_phoff + size <= ph->p_offset + ph->p_filesz) {
+            si->phdr = (ElfW(Phdr)*)((uint8_t*)si->load_bias + ph->p_vaddr +
+                                     (ehdr->e_phoff - ph->p_offset));
+            return 0;
+        }
+    }
+
+    si->phdr_copy = (ElfW(Phdr)*)arena_alloc(&si->arena, size);
+    if (!si->phdr_copy) {
+        linker_set_error("Out of memory");
+        return -1;
+    }
+    memcpy(si->phdr_copy, phdrs, size);
+    si->phdr = si->phdr_copy;
+    return 0;
+}
+
+/**
+ * map_library - 把单个共享库映射到内存
+ * @si: soinfo_alloc 分配的共享库信息
+ * @lib_fd: 从这个 fd 的 si->file_offset 处加载；-1 表示打开 si->name
+ * @flags: 加载标志（LINKER_FLAG_HUGE_TEXT / LINKER_FLAG_PREFAULT 影响映射方式）
+ * @cache_dir: 重定位缓存目录（NULL 表示不使用），有 RELRO 快照时优先使用快照的加载地址
+ *
+ * 完成单个库的加载（不处理依赖，也不做重定位）：
+ *
+ *   1. 打开文件，用一次 pread 读取 ELF 头和程序头表
+ *   2. 计算需要的内存大小
+ *   3. 预留地址空间 (PROT_NONE)
+ *   4. 映射每个 PT_LOAD 段
+ *   5. 处理 BSS 段
+ *   6. 解析动态段
+ *
+ * 整个过程只打开一次文件，段直接从这个 fd 映射。不映射整个文件，
+ * 节头表、调试信息这些加载用不到的页不会被读入。
+ *
+ * 只访问 si 自己的状态，并行加载时可以在工作线程中调用。
+ * 重定位要等所有依赖都映射完成后，由 linker_load 统一进行。
+ *
+ * 返回: 成功返回 0；失败返回 -1，已建立的映射会被撤销（si 由调用者释放）
+ */
+static int map_library(soinfo_t* si, int lib_fd, int flags, const char* cache_dir) {
+    const char* path = si->name;
+    elf_header_t hdr;
+    linker_stats_t stats = {0};
+    stats_span_t span;
+
+    LOG("[linker] Loading: %s\n", path);
+
+    /* ============ 步骤 1: 打开文件并读取 ELF 头 ============ */
+    span_begin(&span);
+    int fd = lib_fd >= 0 ? lib_fd : open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        linker_set_error("Failed to open: %s", path);
+        return -1;
+    }
+    if (elf_read_header(fd, si->file_offset, &hdr) < 0) {
+        linker_set_error("Invalid ELF file: %s", path);
+        if (fd != lib_fd) close(fd);
+        return -1;
+    }
+    span_next(&span, &stats, LINKER_PHASE_OPEN);
+
+    /* ============ 步骤 2: 记录程序头 ============ */
+    ElfW(Phdr)* phdrs = hdr.phdr;
+    si->phnum = hdr.ehdr->e_phnum;
+
+    /* ============ 步骤 3: 计算加载大小 ============ */
+    size_t load_size = calculate_load_size(phdrs, si->phnum);
+    if (load_size == 0) {
+        linker_set_error("No loadable segments");
+        goto error;
+    }
+    si->size = load_size;
+
+    /* ============ 步骤 4: 找到最小虚拟地址 ============ */
+    ElfW(Addr) min_vaddr = (ElfW(Addr))-1;
+    for (size_t i = 0; i < si->phnum; i++) {
+        if (phdrs[i].p_type == PT_LOAD && phdrs[i].p_vaddr < min_vaddr) {
+            min_vaddr = phdrs[i].p_vaddr;
+        }
     }
     min_vaddr = PAGE_START(min_vaddr);
 
+    /* 第一个可执行段（大页对齐的目标）*/
+    const ElfW(Phdr)* text = NULL;
+    for (size_t i = 0; i < si->phnum && !text; i++) {
+        if (phdrs[i].p_type == PT_LOAD && (phdrs[i].p_flags & PF_X)) {
+            text = &phdrs[i];
+        }
+    }
+
     /* ============ 步骤 5: 预留地址空间 ============ */
     /*
      * 使用 MAP_ANONYMOUS 预留一块连续的虚拟地址空间
@@ -883,165 +3263,1024 @@ soinfo_t* linker_load(const char* path) {
      * 这种两步映射的好处：
      * 1. 确保所有段在连续的地址空间内
      * 2. 可以精确控制每个段的权限
+     *
+     * 有 RELRO 快照时先尝试快照记录的地址：加载地址相同，重定位后的
+     * RELRO 页才可能与快照相同、从而在进程间共享。地址被占用时照常随机选择。
+     *
+     * LINKER_FLAG_HUGE_TEXT 时让代码段的起始地址按 2MB 对齐，
+     * 代码段中完整的 2MB 区域随后可以换成大页。
      */
-    si->base = mmap(NULL, load_size, PROT_NONE,
-                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    void* hint = cache_dir ? reloc_cache_relro_base(si, cache_dir) : NULL;
+    si->base = MAP_FAILED;
+    if (hint) {
+        si->base = mmap(hint, load_size, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    }
+    if (si->base == MAP_FAILED && (flags & LINKER_FLAG_HUGE_TEXT) && text) {
+        si->base = reserve_aligned(load_size, HUGE_PAGE_SIZE, PAGE_START(text->p_vaddr) - min_vaddr);
+    }
+    if (si->base == MAP_FAILED) {
+        si->base = mmap(NULL, load_size, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
     if (si->base == MAP_FAILED) {
         linker_set_error("mmap failed");
         goto error;
     }
 
-    /*
-     * 计算加载偏移 (load_bias)
-     *
-     * load_bias = 实际加载地址 - ELF 中指定的虚拟地址
-     *
-     * 例如：
-     *   ELF 中 min_vaddr = 0x0
-     *   实际加载到 si->base = 0x7f0000000000
-     *   则 load_bias = 0x7f0000000000 - 0x0 = 0x7f0000000000
-     *
-     * 后续所有地址计算都需要加上这个偏移
-     */
-    si->load_bias = (void*)((uint8_t*)si->base - min_vaddr);
+    /*
+     * 计算加载偏移 (load_bias)
+     *
+     * load_bias = 实际加载地址 - ELF 中指定的虚拟地址
+     *
+     * 例如：
+     *   ELF 中 min_vaddr = 0x0
+     *   实际加载到 si->base = 0x7f0000000000
+     *   则 load_bias = 0x7f0000000000 - 0x0 = 0x7f0000000000
+     *
+     * 后续所有地址计算都需要加上这个偏移
+     */
+    si->load_bias = (void*)((uint8_t*)si->base - min_vaddr);
+
+    LOG("[linker] Base address: %p, load_bias: %p\n", si->base, si->load_bias);
+    span_next(&span, &stats, LINKER_PHASE_RESERVE);
+
+    /* ============ 步骤 6: 映射每个 PT_LOAD 段 ============ */
+    for (size_t i = 0; i < si->phnum; i++) {
+        ElfW(Phdr)* phdr = &phdrs[i];
+        if (phdr->p_type != PT_LOAD) continue;
+
+        /*
+         * 计算映射参数
+         *
+         * 段在内存中的布局：
+         *
+         *   seg_page_start    seg_start                seg_file_end  seg_end
+         *         │              │                          │           │
+         *         ▼              ▼                          ▼           ▼
+         *   ┌─────┬──────────────┬──────────────────────────┬───────────┐
+         *   │     │  文件内容    │        文件内容          │   BSS    │
+         *   │ pad │  (filesz)    │                          │  (zero)   │
+         *   └─────┴──────────────┴──────────────────────────┴───────────┘
+         *         ◄──────────────────── memsz ────────────────────────────►
+         *
+         * p_filesz: 文件中的大小
+         * p_memsz: 内存中的大小（可能大于 filesz，多出的是 BSS）
+         */
+        ElfW(Addr) seg_start = (ElfW(Addr))si->load_bias + phdr->p_vaddr;
+        ElfW(Addr) seg_end = seg_start + phdr->p_memsz;
+        ElfW(Addr) seg_page_start = PAGE_START(seg_start);
+        ElfW(Addr) seg_page_end = PAGE_END(seg_end);
+        ElfW(Addr) seg_file_end = seg_start + phdr->p_filesz;
+
+        ElfW(Off) file_start = (ElfW(Off))si->file_offset + phdr->p_offset;
+        ElfW(Off) file_page_start = PAGE_START(file_start);
+
+        /*
+         * 映射文件内容
+         *
+         * LINKER_FLAG_PREFAULT: 只读段用 MAP_POPULATE 立即建立页表；
+         * 可写段 MAP_POPULATE 会触发写时复制，把整个段变成私有脏页，
+         * 因此只用 MADV_WILLNEED 预读到页缓存。
+         */
+        bool writable = (phdr->p_flags & PF_W) != 0;
+        int map_flags = MAP_PRIVATE | MAP_FIXED;
+        if ((flags & LINKER_FLAG_PREFAULT) && !writable) {
+            map_flags |= MAP_POPULATE;
+        }
+        void* seg_addr = mmap((void*)seg_page_start,
+                              seg_file_end - seg_page_start,
+                              elf_to_mmap_prot(phdr->p_flags),
+                              map_flags,
+                              fd, file_page_start);
+        if (seg_addr == MAP_FAILED) {
+            linker_set_error("Failed to mmap segment");
+            goto error;
+        }
+        stats.bytes_mapped += seg_file_end - seg_page_start;
+        if ((flags & LINKER_FLAG_PREFAULT) && writable) {
+            madvise(seg_addr, seg_file_end - seg_page_start, MADV_WILLNEED);
+        }
+        if ((flags & LINKER_FLAG_HUGE_TEXT) && phdr == text) {
+            stats.huge_text_bytes += remap_huge(seg_page_start, seg_file_end,
+                                                elf_to_mmap_prot(phdr->p_flags));
+        }
+
+        /*
+         * 处理 BSS 段
+         *
+         * 如果 memsz > filesz，说明有 BSS 段（未初始化的全局变量）
+         * BSS 段需要被清零
+         */
+        if (phdr->p_memsz > phdr->p_filesz) {
+            /* 清零 BSS 部分 */
+            ElfW(Addr) bss_start = seg_file_end;
+            ElfW(Addr) bss_page_start = PAGE_END(bss_start);
+
+            /* 清零文件末尾到页边界的部分 */
+            if (bss_start < bss_page_start) {
+                memset((void*)bss_start, 0, bss_page_start - bss_start);
+            }
+
+            /* 如果 BSS 跨越多个页，需要分配匿名内存 */
+            if (seg_page_end > bss_page_start) {
+                void* bss_addr = mmap((void*)bss_page_start,
+                                      seg_page_end - bss_page_start,
+                                      elf_to_mmap_prot(phdr->p_flags),
+                                      MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS,
+                                      -1, 0);
+                if (bss_addr == MAP_FAILED) {
+                    linker_set_error("Failed to mmap BSS");
+                    goto error;
+                }
+                stats.bytes_mapped += seg_page_end - bss_page_start;
+            }
+        }
+
+        LOG("[linker] Loaded segment: vaddr=0x%lx, memsz=0x%lx, flags=%c%c%c\n",
+               (unsigned long)phdr->p_vaddr,
+               (unsigned long)phdr->p_memsz,
+               (phdr->p_flags & PF_R) ? 'R' : '-',
+               (phdr->p_flags & PF_W) ? 'W' : '-',
+               (phdr->p_flags & PF_X) ? 'X' : '-');
+    }
+
+    if (fd != lib_fd) close(fd);
+    fd = -1;
+    span_next(&span, &stats, LINKER_PHASE_MAP);
+
+    /* ============ 步骤 7: 查找并保存重要段的地址 ============ */
+    for (size_t i = 0; i < si->phnum; i++) {
+        if (phdrs[i].p_type == PT_PHDR) {
+            /* 程序头表在内存中的地址 */
+            si->phdr = (ElfW(Phdr)*)((uint8_t*)si->load_bias + phdrs[i].p_vaddr);
+        } else if (phdrs[i].p_type == PT_DYNAMIC) {
+            /* 动态段在内存中的地址 */
+            si->dynamic = (ElfW(Dyn)*)((uint8_t*)si->load_bias + phdrs[i].p_vaddr);
+        } else if (phdrs[i].p_type == PT_GNU_RELRO) {
+            /*
+             * 重定位完成后变为只读的区域（.got、.data.rel.ro 等）
+             * 末尾向下对齐：不完整的最后一页与可写数据共享，不能设为只读
+             */
+            ElfW(Addr) start = (ElfW(Addr))si->load_bias + phdrs[i].p_vaddr;
+            ElfW(Addr) page_start = PAGE_START(start);
+            ElfW(Addr) page_end = PAGE_START(start + phdrs[i].p_memsz);
+            if (page_end > page_start) {
+                si->relro_start = (void*)page_start;
+                si->relro_size = page_end - page_start;
+            }
+        } else if (phdrs[i].p_type == PT_TLS) {
+            /* TLS 初始化镜像，模块 ID 在重定位之前由 linker_tls_register 分配 */
+            si->has_tls = true;
+            si->tls_image = (uint8_t*)si->load_bias + phdrs[i].p_vaddr;
+            si->tls_filesz = phdrs[i].p_filesz;
+            si->tls_memsz = phdrs[i].p_memsz;
+            si->tls_align = phdrs[i].p_align;
+        }
+    }
+
+    /* 没有 PT_PHDR 时，在映射的段里找程序头表，找不到就保留一份副本 */
+    if (!si->phdr && locate_phdr(si, hdr.ehdr, phdrs) < 0) {
+        goto error;
+    }
+
+    /* ============ 步骤 8: 解析动态段 ============ */
+    if (parse_dynamic(si) < 0) {
+        goto error;
+    }
+
+    elf_header_release(&hdr);
+    span_end(&span, &stats, LINKER_PHASE_DYNAMIC);
+    stats_merge(&si->stats, &stats);
+    return 0;
+
+error:
+    if (fd >= 0 && fd != lib_fd) close(fd);
+    if (si->base && si->base != MAP_FAILED) {
+        munmap(si->base, si->size);
+    }
+    si->base = NULL;
+    si->phdr_copy = NULL;
+    si->phdr = NULL;
+    elf_header_release(&hdr);
+    return -1;
+}
+
+/* =============================================================================
+ * 已加载库索引
+ * =============================================================================
+ *
+ * 两张链式哈希表，都挂在 soinfo 内嵌的链指针上，不需要额外分配：
+ *   - name_index:  打开时使用的路径 -> soinfo（重复 dlopen 同一路径时 O(1) 命中）
+ *   - inode_index: (st_dev, st_ino) -> soinfo（不同路径指向同一文件时去重）
+ *
+ * 从 fd 加载的库还要比较 file_offset：同一个打包文件里可以有多个库。
+ */
+
+static uint32_t inode_hash(dev_t dev, ino_t ino) {
+    uint64_t h = (uint64_t)ino * 0x9e3779b97f4a7c15ULL ^ (uint64_t)dev;
+    return (uint32_t)(h >> 32) ^ (uint32_t)h;
+}
+
+static soinfo_t* index_find_by_name(const char* path) {
+    uint32_t bucket = gnu_hash(path) & (LINKER_INDEX_BUCKETS - 1);
+    for (soinfo_t* si = g_linker.name_index[bucket]; si; si = si->name_hash_next) {
+        if (strcmp(si->name, path) == 0) return si;
+    }
+    return NULL;
+}
+
+static soinfo_t* index_find_by_inode(dev_t dev, ino_t ino, off_t offset) {
+    uint32_t bucket = inode_hash(dev, ino) & (LINKER_INDEX_BUCKETS - 1);
+    for (soinfo_t* si = g_linker.inode_index[bucket]; si; si = si->inode_hash_next) {
+        if (si->st_dev == dev && si->st_ino == ino && si->file_offset == offset) return si;
+    }
+    return NULL;
+}
+
+static void index_insert(soinfo_t* si) {
+    uint32_t nb = gnu_hash(si->name) & (LINKER_INDEX_BUCKETS - 1);
+    si->name_hash_next = g_linker.name_index[nb];
+    g_linker.name_index[nb] = si;
+
+    uint32_t ib = inode_hash(si->st_dev, si->st_ino) & (LINKER_INDEX_BUCKETS - 1);
+    si->inode_hash_next = g_linker.inode_index[ib];
+    g_linker.inode_index[ib] = si;
+}
+
+static void index_remove(soinfo_t* si) {
+    soinfo_t** p = &g_linker.name_index[gnu_hash(si->name) & (LINKER_INDEX_BUCKETS - 1)];
+    while (*p && *p != si) p = &(*p)->name_hash_next;
+    if (*p) *p = si->name_hash_next;
+
+    p = &g_linker.inode_index[inode_hash(si->st_dev, si->st_ino) & (LINKER_INDEX_BUCKETS - 1)];
+    while (*p && *p != si) p = &(*p)->inode_hash_next;
+    if (*p) *p = si->inode_hash_next;
+}
+
+/**
+ * find_loaded - 查找已经加载的库
+ * @path: 路径
+ * @st: 输出该路径的 stat 信息（路径存在时）
+ *
+ * 先按路径查找（不需要系统调用），未命中再 stat 后按 inode 查找。
+ *
+ * 返回: 已加载的 soinfo；未加载返回 NULL。
+ *       *found 表示 stat 是否成功（文件是否存在）
+ */
+static soinfo_t* find_loaded(const char* path, struct stat* st, bool* found) {
+    soinfo_t* si = index_find_by_name(path);
+    if (si) {
+        *found = true;
+        return si;
+    }
+
+    *found = (stat(path, st) == 0);
+    if (!*found) return NULL;
+    return index_find_by_inode(st->st_dev, st->st_ino, 0);
+}
+
+/**
+ * find_loaded_fd - 按 fd 查找已经加载的库
+ * @fd: 文件描述符
+ * @offset: ELF 在文件中的偏移
+ * @st: 输出 fd 的 stat 信息
+ *
+ * 返回: 已加载的 soinfo；未加载返回 NULL。*found 表示 fstat 是否成功
+ */
+static soinfo_t* find_loaded_fd(int fd, off_t offset, struct stat* st, bool* found) {
+    *found = (fstat(fd, st) == 0);
+    if (!*found) return NULL;
+    return index_find_by_inode(st->st_dev, st->st_ino, offset);
+}
+
+/**
+ * fd_name - 为从 fd 加载的库生成名字
+ * @fd: 文件描述符
+ * @offset: ELF 在文件中的偏移
+ * @buf: 输出缓冲区
+ * @size: 缓冲区大小
+ *
+ * 取 /proc/self/fd 指向的路径，偏移非 0 时加上 "!0x偏移"（类似 Android
+ * 从 APK 加载时的 "base.apk!/lib/..."）。名字只用于日志和 $ORIGIN。
+ */
+static void fd_name(int fd, off_t offset, char* buf, size_t size) {
+    char link[64];
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+
+    ssize_t n = readlink(link, buf, size - 1);
+    if (n <= 0) {
+        n = snprintf(buf, size, "fd:%d", fd);
+        if (n < 0 || (size_t)n >= size) n = 0;
+    }
+    buf[n] = '\0';
+
+    if (offset != 0 && (size_t)n < size) {
+        snprintf(buf + n, size - n, "!0x%llx", (unsigned long long)offset);
+    }
+}
+
+/* =============================================================================
+ * 依赖库加载 (DT_NEEDED)
+ * =============================================================================
+ *
+ * 依赖按广度优先的顺序处理，并以同样的顺序加入已加载库链表，
+ * 因此全局符号搜索顺序与加载顺序一致（先根库，再逐层依赖）：
+ *
+ *   libA ──► libB ──► libD          加载 / 搜索顺序:
+ *     └────► libC ──► libD            libA, libB, libC, libD
+ *
+ * 依赖名的查找顺序：
+ *   1. 名字中含 '/'：直接作为路径
+ *   2. DT_RUNPATH / DT_RPATH（支持 $ORIGIN）
+ *   3. 环境变量 MINI_LD_LIBRARY_PATH（冒号分隔）
+ *   4. 以上都找不到：当作系统库，委托给系统的 dlopen（例如 libc.so.6）
+ *
+ * 系统库以 RTLD_GLOBAL 打开，使其符号对 dlsym(RTLD_DEFAULT) 可见。
+ */
+
+/**
+ * search_dirs - 在冒号分隔的目录列表中查找库文件
+ * @dirs: 目录列表
+ * @origin: $ORIGIN 的值（父库所在目录）
+ * @name: 库名
+ * @out: 输出找到的路径
+ * @out_size: 输出缓冲区大小
+ *
+ * 返回: 找到返回 0，否则返回 -1
+ */
+static int search_dirs(const char* dirs, const char* origin, const char* name,
+                       char* out, size_t out_size) {
+    const char* p = dirs;
+    while (p && *p) {
+        const char* end = strchr(p, ':');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+
+        char dir[PATH_MAX];
+        if (len >= 7 && strncmp(p, "$ORIGIN", 7) == 0) {
+            snprintf(dir, sizeof(dir), "%s%.*s", origin, (int)(len - 7), p + 7);
+        } else if (len >= 9 && strncmp(p, "${ORIGIN}", 9) == 0) {
+            snprintf(dir, sizeof(dir), "%s%.*s", origin, (int)(len - 9), p + 9);
+        } else {
+            snprintf(dir, sizeof(dir), "%.*s", (int)len, p);
+        }
+
+        if (dir[0] != '\0') {
+            int n = snprintf(out, out_size, "%s/%s", dir, name);
+            if (n > 0 && (size_t)n < out_size && access(out, R_OK) == 0) return 0;
+        }
+
+        p = end ? end + 1 : NULL;
+    }
+    return -1;
+}
+
+/**
+ * find_library_path - 确定依赖库的路径
+ * @parent: 声明依赖的库
+ * @name: DT_NEEDED 中的库名
+ * @out: 输出路径
+ * @out_size: 输出缓冲区大小
+ *
+ * 返回: 找到返回 0；找不到（应视为系统库）返回 -1
+ */
+static int find_library_path(soinfo_t* parent, const char* name, char* out, size_t out_size) {
+    if (strchr(name, '/')) {
+        snprintf(out, out_size, "%s", name);
+        return 0;
+    }
+
+    /* $ORIGIN = 父库所在目录 */
+    char origin[PATH_MAX];
+    const char* slash = strrchr(parent->name, '/');
+    if (slash) {
+        snprintf(origin, sizeof(origin), "%.*s", (int)(slash - parent->name), parent->name);
+    } else {
+        snprintf(origin, sizeof(origin), ".");
+    }
+
+    if (parent->runpath && search_dirs(parent->runpath, origin, name, out, out_size) == 0) {
+        return 0;
+    }
+
+    const char* env = getenv("MINI_LD_LIBRARY_PATH");
+    if (env && search_dirs(env, origin, name, out, out_size) == 0) {
+        return 0;
+    }
+
+    return -1;
+}
+
+/* 一次 linker_load 中新加载的库（广度优先顺序）*/
+typedef struct {
+    soinfo_t** items;
+    size_t count;
+    size_t capacity;
+} load_batch_t;
+
+static int batch_push(load_batch_t* batch, soinfo_t* si) {
+    if (batch->count == batch->capacity) {
+        size_t capacity = batch->capacity ? batch->capacity * 2 : 8;
+        soinfo_t** items = (soinfo_t**)realloc(batch->items, capacity * sizeof(*items));
+        if (!items) return -1;
+        batch->items = items;
+        batch->capacity = capacity;
+    }
+    batch->items[batch->count++] = si;
+    return 0;
+}
+
+/**
+ * append_to_list - 把库追加到已加载库链表末尾
+ *
+ * 追加而不是插入头部：全局符号搜索按加载顺序进行。
+ * 读者可能正在无锁遍历链表，指针用 rcu_assign_pointer 发布。
+ */
+static void append_to_list(soinfo_t* si) {
+    soinfo_t* tail = g_linker.soinfo_tail;
+    si->next = NULL;
+    si->prev = tail;
+    if (tail) {
+        rcu_assign_pointer(tail->next, si);
+    } else {
+        rcu_assign_pointer(g_linker.soinfo_list, si);
+    }
+    g_linker.soinfo_tail = si;
+    __atomic_store_n(&g_linker.adds, g_linker.adds + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * remove_from_list - 从已加载库链表中摘除（不在链表中时什么也不做）
+ *
+ * si->next 保持不变，正停在 si 上的读者仍然可以继续遍历；
+ * 调用者必须等待宽限期之后才能释放 si。
+ */
+static void remove_from_list(soinfo_t* si) {
+    if (!si->prev && g_linker.soinfo_list != si) {
+        return;
+    }
 
-    LOG("[linker] Base address: %p, load_bias: %p\n", si->base, si->load_bias);
+    if (si->prev) {
+        rcu_assign_pointer(si->prev->next, si->next);
+    } else {
+        rcu_assign_pointer(g_linker.soinfo_list, si->next);
+    }
+    if (si->next) {
+        si->next->prev = si->prev;
+    } else {
+        g_linker.soinfo_tail = si->prev;
+    }
+    si->prev = NULL;
+    __atomic_store_n(&g_linker.subs, g_linker.subs + 1, __ATOMIC_RELEASE);
+}
 
-    /* ============ 步骤 6: 打开文件用于 mmap ============ */
-    fd = open(path, O_RDONLY);
-    if (fd < 0) {
-        linker_set_error("Failed to open file for mmap");
-        goto error;
+/**
+ * load_system_library - 把依赖委托给系统动态链接器
+ * @si: 声明依赖的库
+ * @name: 依赖库名
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+static int load_system_library(soinfo_t* si, const char* name) {
+    /* 进程里还没有这个库时，新库的符号可能改变之前的负缓存 */
+    void* handle = dlopen(name, RTLD_NOW | RTLD_GLOBAL | RTLD_NOLOAD);
+    if (!handle) {
+        handle = dlopen(name, RTLD_NOW | RTLD_GLOBAL);
+        if (!handle) {
+            linker_set_error("Cannot load library \"%s\" needed by \"%s\": %s",
+                             name, si->name, dlerror());
+            return -1;
+        }
+        linker_flush_symbol_cache();
     }
 
-    /* ============ 步骤 7: 映射每个 PT_LOAD 段 ============ */
-    for (size_t i = 0; i < elf.ehdr->e_phnum; i++) {
-        Elf64_Phdr* phdr = &elf.phdr[i];
-        if (phdr->p_type != PT_LOAD) continue;
+    si->system_needed[si->system_needed_count++] = handle;
+    return 0;
+}
 
-        /*
-         * 计算映射参数
-         *
-         * 段在内存中的布局：
-         *
-         *   seg_page_start    seg_start                seg_file_end  seg_end
-         *         │              │                          │           │
-         *         ▼              ▼                          ▼           ▼
-         *   ┌─────┬──────────────┬──────────────────────────┬───────────┐
-         *   │     │  文件内容    │        文件内容          │   BSS    │
-         *   │ pad │  (filesz)    │                          │  (zero)   │
-         *   └─────┴──────────────┴──────────────────────────┴───────────┘
-         *         ◄──────────────────── memsz ────────────────────────────►
-         *
-         * p_filesz: 文件中的大小
-         * p_memsz: 内存中的大小（可能大于 filesz，多出的是 BSS）
-         */
-        Elf64_Addr seg_start = (Elf64_Addr)si->load_bias + phdr->p_vaddr;
-        Elf64_Addr seg_end = seg_start + phdr->p_memsz;
-        Elf64_Addr seg_page_start = PAGE_START(seg_start);
-        Elf64_Addr seg_page_end = PAGE_END(seg_end);
-        Elf64_Addr seg_file_end = seg_start + phdr->p_filesz;
+/**
+ * load_needed - 处理一个库的全部 DT_NEEDED 条目
+ * @si: 库（已经映射）
+ * @batch: 本次加载的库列表，新发现的依赖追加到末尾（尚未映射）
+ *
+ * 已经加载（或者在本批次中已映射）的依赖只增加引用计数。
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+static int load_needed(soinfo_t* si, load_batch_t* batch) {
+    size_t count = 0;
+    for (ElfW(Dyn)* d = si->dynamic; d->d_tag != DT_NULL; d++) {
+        if (d->d_tag == DT_NEEDED) count++;
+    }
+    if (count == 0) return 0;
 
-        Elf64_Off file_start = phdr->p_offset;
-        Elf64_Off file_page_start = PAGE_START(file_start);
+    si->needed = (soinfo_t**)arena_alloc(&si->arena, count * sizeof(soinfo_t*));
+    si->system_needed = (void**)arena_alloc(&si->arena, count * sizeof(void*));
+    if (!si->needed || !si->system_needed) {
+        linker_set_error("Out of memory");
+        return -1;
+    }
 
-        /* 映射文件内容 */
-        void* seg_addr = mmap((void*)seg_page_start,
-                              seg_file_end - seg_page_start,
-                              elf_to_mmap_prot(phdr->p_flags),
-                              MAP_PRIVATE | MAP_FIXED,
-                              fd, file_page_start);
-        if (seg_addr == MAP_FAILED) {
-            linker_set_error("Failed to mmap segment");
-            goto error;
-        }
+    for (ElfW(Dyn)* d = si->dynamic; d->d_tag != DT_NULL; d++) {
+        if (d->d_tag != DT_NEEDED) continue;
+        const char* name = si->strtab + d->d_un.d_val;
 
-        /*
-         * 处理 BSS 段
-         *
-         * 如果 memsz > filesz，说明有 BSS 段（未初始化的全局变量）
-         * BSS 段需要被清零
-         */
-        if (phdr->p_memsz > phdr->p_filesz) {
-            /* 清零 BSS 部分 */
-            Elf64_Addr bss_start = seg_file_end;
-            Elf64_Addr bss_page_start = PAGE_END(bss_start);
+        char path[PATH_MAX];
+        if (find_library_path(si, name, path, sizeof(path)) < 0) {
+            if (load_system_library(si, name) < 0) return -1;
+            continue;
+        }
 
-            /* 清零文件末尾到页边界的部分 */
-            if (bss_start < bss_page_start) {
-                memset((void*)bss_start, 0, bss_page_start - bss_start);
+        struct stat st;
+        bool exists;
+        soinfo_t* dep = find_loaded(path, &st, &exists);
+        if (!dep) {
+            if (!exists) {
+                linker_set_error("Cannot find library \"%s\" needed by \"%s\"", name, si->name);
+                return -1;
+            }
+            /* 只分配，映射由 linker_load 按层统一进行 */
+            dep = soinfo_alloc(path, &st);
+            if (!dep) return -1;
+            if (batch_push(batch, dep) < 0) {
+                soinfo_free(dep);
+                linker_set_error("Out of memory");
+                return -1;
             }
+            /* 先入索引，同一批次里后续的重复依赖可以直接命中 */
+            index_insert(dep);
+        }
 
-            /* 如果 BSS 跨越多个页，需要分配匿名内存 */
-            if (seg_page_end > bss_page_start) {
-                void* bss_addr = mmap((void*)bss_page_start,
-                                      seg_page_end - bss_page_start,
-                                      elf_to_mmap_prot(phdr->p_flags),
-                                      MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS,
-                                      -1, 0);
-                if (bss_addr == MAP_FAILED) {
-                    linker_set_error("Failed to mmap BSS");
-                    goto error;
+        dep->ref_count++;
+        si->needed[si->needed_count++] = dep;
+    }
+
+    return 0;
+}
+
+/**
+ * release_library - 释放一个库持有的资源（不调用析构函数）
+ * @si: 共享库信息（已经从链表和索引中移除）
+ *
+ * 依赖库的引用在这里被释放，可能因此级联卸载。
+ */
+static void slots_release(soinfo_t* si);
+
+static void release_library(soinfo_t* si) {
+    linker_tls_unregister(si);
+    slots_release(si);
+    if (si->base) {
+        munmap(si->base, si->size);
+    }
+
+    for (size_t i = 0; i < si->needed_count; i++) {
+        linker_unload(si->needed[i]);
+    }
+    for (size_t i = 0; i < si->system_needed_count; i++) {
+        dlclose(si->system_needed[i]);
+    }
+
+    free(si->flat_symtab);
+    free(si->addr_symtab);
+    soinfo_free(si);
+}
+
+/**
+ * rollback_batch - 加载失败时撤销本批次的所有库
+ * @batch: 本次新加载的库
+ *
+ * 本批次的库都还没有运行构造函数，直接释放即可。
+ * 本批次之外的依赖只会被减少引用计数。
+ */
+static void rollback_batch(load_batch_t* batch) {
+    /* 先断开批次内部的依赖边，避免 release_library 重复释放 */
+    for (size_t i = 0; i < batch->count; i++) {
+        soinfo_t* si = batch->items[i];
+        size_t kept = 0;
+        for (size_t j = 0; j < si->needed_count; j++) {
+            bool in_batch = false;
+            for (size_t k = 0; k < batch->count; k++) {
+                if (batch->items[k] == si->needed[j]) {
+                    in_batch = true;
+                    break;
                 }
             }
+            if (!in_batch) si->needed[kept++] = si->needed[j];
         }
+        si->needed_count = kept;
+    }
 
-        LOG("[linker] Loaded segment: vaddr=0x%lx, memsz=0x%lx, flags=%c%c%c\n",
-               (unsigned long)phdr->p_vaddr,
-               (unsigned long)phdr->p_memsz,
-               (phdr->p_flags & PF_R) ? 'R' : '-',
-               (phdr->p_flags & PF_W) ? 'W' : '-',
-               (phdr->p_flags & PF_X) ? 'X' : '-');
+    for (size_t i = 0; i < batch->count; i++) {
+        remove_from_list(batch->items[i]);
+        index_remove(batch->items[i]);
     }
+    scope_rebuild();
+    linker_flush_symbol_cache();
 
-    close(fd);
-    fd = -1;
+    /* 已经发布到链表的库可能正被读者访问 */
+    rcu_reclaim();
 
-    /* ============ 步骤 8: 查找并保存重要段的地址 ============ */
-    for (size_t i = 0; i < elf.ehdr->e_phnum; i++) {
-        if (elf.phdr[i].p_type == PT_PHDR) {
-            /* 程序头表在内存中的地址 */
-            si->phdr = (Elf64_Phdr*)((uint8_t*)si->load_bias + elf.phdr[i].p_vaddr);
-        } else if (elf.phdr[i].p_type == PT_DYNAMIC) {
-            /* 动态段在内存中的地址 */
-            si->dynamic = (Elf64_Dyn*)((uint8_t*)si->load_bias + elf.phdr[i].p_vaddr);
+    for (size_t i = batch->count; i > 0; i--) {
+        release_library(batch->items[i - 1]);
+    }
+}
+
+/* =============================================================================
+ * 并行加载
+ * =============================================================================
+ *
+ * 启动时一次要加载上百个库，映射和重定位都可以分给线程池：
+ *
+ *   映射：   广度优先的同一层新发现的库互不依赖。名字解析、去重、
+ *            索引维护仍在调用线程中串行完成，只把 map_library 并行化。
+ *
+ *   重定位： 重定位只写入库自己的内存；对依赖库只读取符号表和 load_bias
+ *            （映射完成后不再变化），也不会执行依赖库的代码。
+ *            所以同一批次的所有库可以同时重定位，不必等依赖库先完成。
+ *            超过 RELOC_CHUNK 条的 .rela.dyn 再切分成多个任务。
+ *
+ * 任务按工作量从大到小提交，避免最大的库最后才开始。
+ * 没有线程池（threads <= 1）时退化为原来的串行流程。
+ */
+
+#define RELOC_CHUNK 4096
+
+/*
+ * 错误信息是线程局部的：工作线程的错误先保存在任务里，
+ * 等待结束后由调用线程重新设置。
+ */
+typedef struct {
+    soinfo_t* si;
+    int flags;
+    const char* cache_dir;
+    int result;
+    char error[LINKER_ERROR_MAX];
+} map_task_t;
+
+typedef struct {
+    soinfo_t* si;
+    int flags;
+    size_t begin;           /* .rela.dyn 区间 [begin, end) */
+    size_t end;
+    bool remaining;         /* 同时负责 RELR / APS2 / PLT */
+    size_t cost;            /* 估计的条目数，用于排序 */
+    int result;
+    char error[LINKER_ERROR_MAX];
+} reloc_task_t;
+
+static void save_task_error(char* buf) {
+    const char* err = linker_get_error();
+    snprintf(buf, LINKER_ERROR_MAX, "%s", err ? err : "unknown error");
+}
+
+static void map_task_run(void* arg) {
+    map_task_t* task = (map_task_t*)arg;
+    task->result = map_library(task->si, -1, task->flags, task->cache_dir);
+    if (task->result < 0) save_task_error(task->error);
+}
+
+static void reloc_task_run(void* arg) {
+    reloc_task_t* task = (reloc_task_t*)arg;
+    task->result = relocate_rela_range(task->si, task->begin, task->end);
+    if (task->result == 0 && task->remaining) {
+        task->result = relocate_remaining(task->si, task->flags);
+    }
+    if (task->result < 0) save_task_error(task->error);
+}
+
+static int reloc_task_cmp(const void* a, const void* b) {
+    const reloc_task_t* ta = (const reloc_task_t*)a;
+    const reloc_task_t* tb = (const reloc_task_t*)b;
+    return (ta->cost < tb->cost) - (ta->cost > tb->cost);
+}
+
+/**
+ * map_batch_range - 映射本批次中 [from, to) 区间的库
+ * @batch: 本次加载的库
+ * @from: 起始下标
+ * @to: 结束下标（不含）
+ * @pool: 线程池，NULL 表示串行
+ * @flags: 加载标志
+ * @cache_dir: 重定位缓存目录，NULL 表示不使用
+ *
+ * 返回: 全部成功返回 0，任何一个失败返回 -1
+ */
+static int map_batch_range(load_batch_t* batch, size_t from, size_t to, thread_pool_t* pool,
+                           int flags, const char* cache_dir) {
+    size_t count = to - from;
+    map_task_t* tasks = pool && count > 1 ? (map_task_t*)calloc(count, sizeof(map_task_t)) : NULL;
+
+    if (!tasks) {
+        for (size_t i = from; i < to; i++) {
+            if (map_library(batch->items[i], -1, flags, cache_dir) < 0) return -1;
         }
+        return 0;
     }
 
-    /* 如果没有 PT_PHDR，使用计算的地址 */
-    if (!si->phdr) {
-        si->phdr = (Elf64_Phdr*)((uint8_t*)si->load_bias + elf.ehdr->e_phoff);
+    for (size_t i = 0; i < count; i++) {
+        tasks[i].si = batch->items[from + i];
+        tasks[i].flags = flags;
+        tasks[i].cache_dir = cache_dir;
+        if (thread_pool_submit(pool, map_task_run, &tasks[i]) < 0) {
+            map_task_run(&tasks[i]);
+        }
     }
+    thread_pool_wait(pool);
 
-    /* ============ 步骤 9: 解析动态段 ============ */
-    if (parse_dynamic(si) < 0) {
-        goto error;
+    int result = 0;
+    for (size_t i = 0; i < count && result == 0; i++) {
+        if (tasks[i].result < 0) {
+            linker_set_error("%s", tasks[i].error);
+            result = -1;
+        }
     }
+    free(tasks);
+    return result;
+}
 
-    /* ============ 步骤 10: 执行重定位 ============ */
-    if (linker_relocate(si) < 0) {
-        goto error;
+/**
+ * relocate_uncached - 对本批次中没有命中重定位缓存的库执行完整的重定位
+ * @batch: 本次加载的库
+ * @flags: 加载标志
+ * @pool: 线程池，NULL 表示串行
+ * @cached: cached[i] 为 true 的库已经由缓存完成重定位（可以为 NULL）
+ *
+ * 返回: 全部成功返回 0，任何一个失败返回 -1
+ */
+static int relocate_uncached(load_batch_t* batch, int flags, thread_pool_t* pool, const bool* cached) {
+    size_t task_count = 0;
+    reloc_task_t* tasks = NULL;
+
+    if (pool) {
+        for (size_t i = 0; i < batch->count; i++) {
+            if (cached && cached[i]) continue;
+            size_t rela_count = batch->items[i]->rela_count;
+            task_count += rela_count > RELOC_CHUNK ? (rela_count + RELOC_CHUNK - 1) / RELOC_CHUNK : 1;
+        }
+        tasks = task_count ? (reloc_task_t*)calloc(task_count, sizeof(reloc_task_t)) : NULL;
+    }
+
+    /* 串行：依赖先于使用者 */
+    if (!tasks) {
+        for (size_t i = batch->count; i > 0; i--) {
+            if (cached && cached[i - 1]) continue;
+            if (linker_relocate(batch->items[i - 1], flags) < 0) return -1;
+        }
+        return 0;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < batch->count; i++) {
+        if (cached && cached[i]) continue;
+        soinfo_t* si = batch->items[i];
+        size_t begin = 0;
+        do {
+            size_t end = si->rela_count - begin > RELOC_CHUNK ? begin + RELOC_CHUNK : si->rela_count;
+            reloc_task_t* task = &tasks[n++];
+            task->si = si;
+            task->flags = flags;
+            task->begin = begin;
+            task->end = end;
+            task->remaining = (begin == 0);
+            task->cost = end - begin;
+            if (task->remaining) {
+                task->cost += si->relr_count + si->plt_rela_count + si->android_rela_size / 2;
+            }
+            begin = end;
+        } while (begin < si->rela_count);
+    }
+
+    qsort(tasks, n, sizeof(reloc_task_t), reloc_task_cmp);
+    for (size_t i = 0; i < n; i++) {
+        if (thread_pool_submit(pool, reloc_task_run, &tasks[i]) < 0) {
+            reloc_task_run(&tasks[i]);
+        }
+    }
+    thread_pool_wait(pool);
+
+    int result = 0;
+    for (size_t i = 0; i < n && result == 0; i++) {
+        if (tasks[i].result < 0) {
+            linker_set_error("%s", tasks[i].error);
+            result = -1;
+        }
+    }
+    free(tasks);
+    return result;
+}
+
+/**
+ * relocate_batch - 重定位本批次的所有库
+ * @batch: 本次加载的库
+ * @flags: 加载标志
+ * @pool: 线程池，NULL 表示串行
+ * @cache_dir: 重定位缓存目录，NULL 表示不使用缓存
+ *
+ * 使用缓存时，先让每个库尝试从缓存写回符号重定位，其余的库照常
+ * 重定位，全部成功后再为它们写入缓存，供之后的进程使用。
+ * 缓存只记录立即绑定的结果，延迟绑定时不使用。
+ *
+ * 返回: 全部成功返回 0，任何一个失败返回 -1
+ */
+static int relocate_batch(load_batch_t* batch, int flags, thread_pool_t* pool, const char* cache_dir) {
+    bool* cached = NULL;
+    if (cache_dir && !(flags & LINKER_FLAG_LAZY)) {
+        cached = (bool*)calloc(batch->count, sizeof(bool));
+    }
+    if (cached) {
+        for (size_t i = 0; i < batch->count; i++) {
+            cached[i] = relocate_from_cache(batch->items[i], cache_dir) == 0;
+        }
+    }
+
+    int result = relocate_uncached(batch, flags, pool, cached);
+
+    if (result == 0 && cached) {
+        for (size_t i = 0; i < batch->count; i++) {
+            if (!cached[i]) {
+                reloc_cache_store(batch->items[i], g_linker.soinfo_list, cache_dir);
+            }
+        }
+    }
+    free(cached);
+    return result;
+}
+
+static soinfo_t* load_locked(const char* path, int flags, const linker_load_opts_t* opts);
+
+/**
+ * linker_load - 加载共享库
+ * @path: 共享库文件路径
+ * @flags: 加载标志（LINKER_FLAG_*）
+ *
+ * 等价于 linker_load_ex(path, flags, NULL)，在调用线程中串行加载。
+ *
+ * 返回: 成功返回 soinfo 指针，失败返回 NULL
+ */
+soinfo_t* linker_load(const char* path, int flags) {
+    return linker_load_ex(path, flags, NULL);
+}
+
+/**
+ * linker_load_ex - 加载共享库
+ * @path: 共享库文件路径（opts->use_fd 时只作为名字，可以为 NULL）
+ * @flags: 加载标志（LINKER_FLAG_*）
+ * @opts: 附加选项，可以为 NULL
+ *
+ * 这是链接器的核心函数，完整的加载流程如下：
+ *
+ *   1. 已经加载过（路径或 inode 相同；fd 加载时比较 inode 和偏移）：
+ *      增加引用计数后直接返回（opts->fresh 时总是重新加载根库）
+ *   2. 映射根库（map_library）
+ *   3. 广度优先地映射所有 DT_NEEDED 依赖（每层并行映射）
+ *   4. 按加载顺序追加到已加载库链表
+ *   5. 执行重定位（串行时依赖先于使用者，并行时同时进行）
+ *
+ * 任何一步失败，本次新加载的库全部撤销。
+ * 整个过程持有写者锁，与其他加载、卸载串行。
+ *
+ * 返回: 成功返回 soinfo 指针，失败返回 NULL
+ */
+soinfo_t* linker_load_ex(const char* path, int flags, const linker_load_opts_t* opts) {
+    linker_lock();
+    soinfo_t* si = load_locked(path, flags, opts);
+    linker_unlock();
+    return si;
+}
+
+/**
+ * load_locked - linker_load_ex 的实现（持有写者锁）
+ */
+static soinfo_t* load_locked(const char* path, int flags, const linker_load_opts_t* opts) {
+    struct stat st;
+    bool exists;
+    bool use_fd = opts && opts->use_fd;
+    bool fresh = opts && opts->fresh;
+    const char* cache_dir = opts ? opts->reloc_cache_dir : NULL;
+    char name[PATH_MAX];
+
+    if (use_fd && (opts->offset < 0 || PAGE_OFFSET(opts->offset) != 0)) {
+        linker_set_error("Offset not page-aligned: 0x%llx", (unsigned long long)opts->offset);
+        return NULL;
+    }
+
+    /* ============ 步骤 1: 查找已加载的库 ============ */
+    soinfo_t* si;
+    if (fresh) {
+        /* 热替换：新版本与旧版本同时存在，新版本插在索引链的前面 */
+        si = NULL;
+        exists = (use_fd ? fstat(opts->fd, &st) : stat(path, &st)) == 0;
+    } else {
+        si = use_fd ? find_loaded_fd(opts->fd, opts->offset, &st, &exists)
+                    : find_loaded(path, &st, &exists);
+    }
+    if (si) {
+        si->ref_count++;
+        LOG("[linker] Already loaded: %s (ref_count=%d)\n", si->name, si->ref_count);
+        return si;
+    }
+    if (!exists) {
+        if (use_fd) {
+            linker_set_error("Invalid fd: %d", opts->fd);
+        } else {
+            linker_set_error("Failed to open: %s", path);
+        }
+        return NULL;
+    }
+    if (use_fd && !path) {
+        fd_name(opts->fd, opts->offset, name, sizeof(name));
+        path = name;
     }
 
-    /* ============ 步骤 11: 添加到已加载库列表 ============ */
+    /* ============ 步骤 2: 映射根库 ============ */
+    uint64_t start_ns = now_ns();
+    si = soinfo_alloc(path, &st);
+    if (!si) {
+        return NULL;
+    }
+    if (use_fd) {
+        si->file_offset = opts->offset;
+    }
+    if (map_library(si, use_fd ? opts->fd : -1, flags, cache_dir) < 0) {
+        soinfo_free(si);
+        return NULL;
+    }
     si->ref_count = 1;
-    si->next = g_linker.soinfo_list;
-    g_linker.soinfo_list = si;
+    index_insert(si);
+
+    load_batch_t batch = {0};
+    if (batch_push(&batch, si) < 0) {
+        index_remove(si);
+        release_library(si);
+        linker_set_error("Out of memory");
+        return NULL;
+    }
+
+    /* 创建失败时串行加载 */
+    thread_pool_t* pool = NULL;
+    if (opts && opts->threads > 1) {
+        pool = thread_pool_create(opts->threads);
+    }
+
+    /* ============ 步骤 3: 广度优先加载依赖 ============ */
+    /*
+     * batch 在循环中增长。走到 mapped 时，上一层发现的库
+     * （[mapped, count) 区间）一起映射，然后才能读取它们的 DT_NEEDED。
+     */
+    size_t mapped = batch.count;
+    for (size_t i = 0; i < batch.count; i++) {
+        if (i == mapped) {
+            if (map_batch_range(&batch, mapped, batch.count, pool, flags, cache_dir) < 0) {
+                goto error;
+            }
+            mapped = batch.count;
+        }
+        if (load_needed(batch.items[i], &batch) < 0) {
+            goto error;
+        }
+    }
+
+    /* ============ 步骤 4: 加入已加载库链表 ============ */
+    for (size_t i = 0; i < batch.count; i++) {
+        if (flags & LINKER_FLAG_FLAT_SYMTAB) {
+            flat_symtab_get(batch.items[i]);
+        }
+        append_to_list(batch.items[i]);
+    }
+    scope_rebuild();
+    /* TLS 模块 ID 和静态 TLS 偏移要在重定位之前确定 */
+    for (size_t i = 0; i < batch.count; i++) {
+        if (linker_tls_register(batch.items[i]) < 0) {
+            goto error;
+        }
+    }
+    for (size_t i = 0; i < batch.count; i++) {
+        symcache_invalidate_for(batch.items[i]);
+    }
+
+    /* ============ 步骤 5: 执行重定位 ============ */
+    if (relocate_batch(&batch, flags, pool, cache_dir) < 0) {
+        goto error;
+    }
+
+    /* ============ 步骤 6: RELRO 设为只读 ============ */
+    for (size_t i = 0; i < batch.count; i++) {
+        protect_relro(batch.items[i], flags, cache_dir);
+    }
 
-    elf_close(&elf);
+    LOG("[linker] Successfully loaded: %s (%zu new libraries)\n", path, batch.count);
+    si->stats.total_ns = now_ns() - start_ns;
+    thread_pool_destroy(pool);
+    free(batch.items);
 
-    LOG("[linker] Successfully loaded: %s\n", path);
+    /* 释放加载过程中被替换掉的符号缓存表 */
+    rcu_reclaim();
     return si;
 
 error:
-    if (fd >= 0) close(fd);
-    if (si) {
-        if (si->base && si->base != MAP_FAILED) {
-            munmap(si->base, si->size);
-        }
-        free(si);
-    }
-    elf_close(&elf);
+    thread_pool_destroy(pool);
+    rollback_batch(&batch);
+    free(batch.items);
     return NULL;
 }
 
@@ -1053,33 +4292,213 @@ error:
  *   1. 减少引用计数
  *   2. 如果引用计数为 0：
  *      a. 调用析构函数
- *      b. 从链表中移除
+ *      b. 从链表和索引中移除，并清空全局符号缓存
  *      c. 解除内存映射
- *      d. 释放 soinfo 结构
+ *      d. 释放对依赖库的引用（可能级联卸载）
+ *      e. 释放 soinfo 结构
+ *
+ * 注意：循环依赖的库引用计数永远不会归零，不会被卸载。
  */
 void linker_unload(soinfo_t* si) {
     if (!si) return;
 
+    linker_lock();
+
     si->ref_count--;
-    if (si->ref_count > 0) return;
+    if (si->ref_count > 0) {
+        linker_unlock();
+        return;
+    }
 
-    /* 调用析构函数 */
+    /* 调用析构函数（先于依赖库的析构函数）*/
     linker_call_destructors(si);
 
-    /* 从链表中移除 */
-    soinfo_t** p = &g_linker.soinfo_list;
-    while (*p && *p != si) {
-        p = &(*p)->next;
+    /* 从链表、查找范围和索引中移除 */
+    remove_from_list(si);
+    index_remove(si);
+    scope_rebuild();
+
+    /* 缓存中可能有指向该库的地址 */
+    linker_flush_symbol_cache();
+
+    /* 等待仍在访问该库的读者退出，再释放内存和依赖 */
+    rcu_reclaim();
+    release_library(si);
+
+    linker_unlock();
+}
+
+/* =============================================================================
+ * 稳定符号槽和热替换
+ * =============================================================================
+ *
+ * dlsym 返回的地址在 dlclose + dlopen 之后全部失效。热替换改为让调用者
+ * 保存槽的地址，经由槽间接调用：
+ *
+ *   调用者:  fn = load_acquire(slot->addr); fn(...)
+ *
+ *   linker_reload:   加载新版本 ─► 解析所有槽 ─► 移出旧版本 ─► 切换槽
+ *                                    │ 有符号缺失：卸载新版本，槽不变
+ *   调用者（dlfcn）: 宽限期（rcu_synchronize）─► linker_unload(旧版本)
+ *
+ * 槽按 (库, 符号名) 去重，放在一个链表中，只有写者访问链表；
+ * 读者只读 slot->addr。库被卸载时它的槽一同释放。
+ */
+
+/**
+ * linker_get_slot - 获取库中符号的稳定槽
+ * @si: 共享库信息
+ * @name: 符号名
+ *
+ * 返回: 槽，符号不存在或内存不足返回 NULL
+ */
+linker_slot_t* linker_get_slot(soinfo_t* si, const char* name) {
+    linker_lock();
+
+    linker_slot_t* slot = g_linker.slots;
+    while (slot && !(slot->owner == si && strcmp(slot->name, name) == 0)) {
+        slot = slot->next;
     }
-    if (*p) {
-        *p = si->next;
+
+    if (!slot) {
+        symbol_name_t sn;
+        symbol_name_init(&sn, name);
+        void* addr = linker_find_symbol_indexed(si, &sn);
+        if (!addr) {
+            linker_unlock();
+            linker_set_error("Symbol not found in %s: %s", si->name, name);
+            return NULL;
+        }
+        if (sn.per_thread) {
+            /* 槽由所有线程共用，放不下每个线程各自的地址 */
+            linker_unlock();
+            linker_set_error("TLS symbol cannot be used through a stable slot: %s", name);
+            return NULL;
+        }
+
+        size_t len = strlen(name);
+        slot = (linker_slot_t*)malloc(sizeof(linker_slot_t) + len + 1);
+        if (!slot) {
+            linker_unlock();
+            linker_set_error("Out of memory");
+            return NULL;
+        }
+        slot->addr = addr;
+        slot->owner = si;
+        memcpy(slot->name, name, len + 1);
+        slot->next = g_linker.slots;
+        g_linker.slots = slot;
     }
 
-    /* 释放内存 */
-    if (si->base) {
-        munmap(si->base, si->size);
+    linker_unlock();
+    return slot;
+}
+
+/**
+ * slots_release - 释放库的所有槽（持有写者锁）
+ * @si: 正在卸载的库
+ */
+static void slots_release(soinfo_t* si) {
+    linker_slot_t** p = &g_linker.slots;
+    while (*p) {
+        linker_slot_t* slot = *p;
+        if (slot->owner == si) {
+            *p = slot->next;
+            free(slot);
+        } else {
+            p = &slot->next;
+        }
+    }
+}
+
+/**
+ * linker_reload - 热替换共享库
+ * @si: 当前版本
+ * @path: 新版本的路径，NULL 表示使用当前版本的路径（文件已被替换）
+ * @flags: 新版本的加载标志（LINKER_FLAG_*）
+ * @retired: 输出被替换下来的旧版本
+ *
+ * 新版本的依赖按普通规则查找，已经加载的依赖直接共享，不会重新加载。
+ * 作为其他库依赖的库不能替换：使用者的重定位已经指向旧版本。
+ *
+ * 切换之后旧版本不在全局查找范围和索引中，引用计数只剩 1，
+ * 只等调用者在宽限期之后卸载（运行析构函数并解除映射）。
+ *
+ * 返回: 新版本，失败返回 NULL（旧版本和所有槽保持不变）
+ */
+soinfo_t* linker_reload(soinfo_t* si, const char* path, int flags, soinfo_t** retired) {
+    linker_lock();
+
+    for (soinfo_t* user = g_linker.soinfo_list; user; user = user->next) {
+        for (size_t i = 0; i < user->needed_count; i++) {
+            if (user->needed[i] == si) {
+                linker_set_error("Cannot reload %s: needed by %s", si->name, user->name);
+                linker_unlock();
+                return NULL;
+            }
+        }
     }
-    free(si);
+
+    linker_load_opts_t opts = { .threads = 1, .fresh = true };
+    soinfo_t* fresh = load_locked(path ? path : si->name, flags, &opts);
+    if (!fresh) {
+        linker_unlock();
+        return NULL;
+    }
+
+    /* 先解析所有槽，全部找到才切换（构造函数还没有运行，失败时直接卸载）*/
+    size_t count = 0;
+    for (linker_slot_t* slot = g_linker.slots; slot; slot = slot->next) {
+        if (slot->owner == si) count++;
+    }
+    void** addrs = (void**)malloc((count ? count : 1) * sizeof(void*));
+    if (!addrs) {
+        linker_set_error("Out of memory");
+        goto fail;
+    }
+    size_t n = 0;
+    for (linker_slot_t* slot = g_linker.slots; slot; slot = slot->next) {
+        if (slot->owner != si) continue;
+        symbol_name_t sn;
+        symbol_name_init(&sn, slot->name);
+        addrs[n] = linker_find_symbol_indexed(fresh, &sn);
+        if (!addrs[n]) {
+            linker_set_error("Cannot reload %s: symbol %s not found in %s", si->name, slot->name, fresh->name);
+            goto fail;
+        }
+        n++;
+    }
+
+    linker_call_constructors(fresh);
+
+    /* 旧版本退出全局查找，之后按名字打开、全局查找得到的都是新版本 */
+    remove_from_list(si);
+    index_remove(si);
+    scope_rebuild();
+    linker_flush_symbol_cache();
+
+    n = 0;
+    for (linker_slot_t* slot = g_linker.slots; slot; slot = slot->next) {
+        if (slot->owner != si) continue;
+        __atomic_store_n(&slot->addr, addrs[n++], __ATOMIC_RELEASE);
+        slot->owner = fresh;
+    }
+    free(addrs);
+
+    /* 旧句柄的所有引用转给新版本 */
+    fresh->ref_count = si->ref_count;
+    si->ref_count = 1;
+
+    LOG("[linker] Reloaded %s -> %s (%zu slots switched)\n", si->name, fresh->name, count);
+    linker_unlock();
+    *retired = si;
+    return fresh;
+
+fail:
+    free(addrs);
+    linker_unload(fresh);
+    linker_unlock();
+    return NULL;
 }
 
 /* =============================================================================
@@ -1104,11 +4523,355 @@ static int is_valid_func_ptr(void* ptr) {
     return 1;
 }
 
+/* =============================================================================
+ * 构造函数调度
+ * =============================================================================
+ *
+ * 从根库出发收集所有尚未初始化的库，按 DT_NEEDED 建立依赖图：
+ * 依赖库的构造函数必须先于使用它的库执行。调度用 Kahn 算法：
+ * 未完成依赖数（入度）降为 0 的库就绪，执行完后把使用它的库的入度减一。
+ *
+ *   串行（threads <= 1）：就绪的库在调用线程中依次执行
+ *   并行：就绪的库作为任务提交给线程池，互不依赖的子树同时初始化
+ *
+ * 同时就绪的库按优先级执行：优先级是从该库到根库的最长依赖链长度（关键路径），
+ * 链越长越先开始，长链不会排在一堆叶子库后面。
+ *
+ * 整个调度期间调用线程持有写者锁，工作线程中的构造函数不能调用
+ * mini_dlopen / mini_dlclose（会等待这把锁），因此并行初始化需要调用者明确要求。
+ *
+ * 循环依赖中的库入度永远降不到 0，Kahn 结束后按 DFS 后序补上（与递归的顺序相同）。
+ */
+
+typedef struct init_graph init_graph_t;
+
+typedef struct {
+    soinfo_t* si;
+    init_graph_t* graph;
+    size_t pending;             /* 尚未完成的依赖数（并行时由图锁保护）*/
+    size_t users_begin;         /* graph->users[users_begin, users_end) 是依赖本库的节点 */
+    size_t users_end;
+    size_t priority;            /* 到根库的最长依赖链长度 */
+    uint64_t ready_ns;          /* 依赖全部完成的时刻 */
+    bool done;
+} init_node_t;
+
+struct init_graph {
+    init_node_t* nodes;         /* DFS 后序：依赖在前，根库最后 */
+    size_t count;
+    size_t* users;              /* 邻接表，每个节点的部分按优先级从高到低排列 */
+    size_t* order;              /* 串行执行时的就绪队列 */
+    thread_pool_t* pool;        /* NULL 表示串行 */
+    pthread_mutex_t lock;
+};
+
+/* 每次调度递增，soinfo 的 init_mark 等于它时 init_node 有效 */
+static uint32_t g_init_mark = 0;
+
+/**
+ * run_init_funcs - 执行一个库自己的 DT_INIT 和 DT_INIT_ARRAY
+ * @si: 共享库信息
+ * @ready_ns: 依赖全部完成的时刻（0 表示不统计等待时间）
+ *
+ * 只统计本库自己的初始化函数，依赖库的时间计入依赖库。
+ */
+static void run_init_funcs(soinfo_t* si, uint64_t ready_ns) {
+    linker_stats_t stats = {0};
+    stats_span_t span;
+    span_begin(&span);
+    if (ready_ns) {
+        stats.init_wait_ns = span.start_ns - ready_ns;
+    }
+
+    /* 调用 DT_INIT */
+    if (is_valid_func_ptr((void*)si->init_func)) {
+        LOG("[linker] Calling DT_INIT for %s\n", si->name);
+        si->init_func();
+        stats.init_funcs++;
+    }
+
+    /* 调用 DT_INIT_ARRAY */
+    if (si->init_array && si->init_array_count > 0) {
+        LOG("[linker] Calling DT_INIT_ARRAY (%zu entries) for %s\n",
+               si->init_array_count, si->name);
+        for (size_t i = 0; i < si->init_array_count; i++) {
+            if (is_valid_func_ptr((void*)si->init_array[i])) {
+                LOG("[linker] Calling init_array[%zu] at %p\n", i, (void*)si->init_array[i]);
+                si->init_array[i]();
+                stats.init_funcs++;
+            }
+        }
+    }
+
+    span_end(&span, &stats, LINKER_PHASE_INIT);
+    stats_merge(&si->stats, &stats);
+
+    /* 推迟初始化的库此后不再需要在 dlsym 时检查 */
+    __atomic_store_n(&si->init_deferred, false, __ATOMIC_RELEASE);
+}
+
+/**
+ * init_collect - DFS 收集 si 及其尚未初始化的依赖（持有写者锁）
+ * @si: 当前库
+ * @nodes: 输出数组（按后序追加）
+ * @count: 已收集的个数
+ * @capacity: 数组容量
+ * @edges: 累计边数
+ *
+ * 返回: 成功返回 0，内存不足返回 -1
+ */
+static int init_collect(soinfo_t* si, init_node_t** nodes, size_t* count, size_t* capacity,
+                        size_t* edges) {
+    si->init_mark = g_init_mark;
+    si->init_node = SIZE_MAX;       /* 正在访问：遇到它说明有环 */
+    si->init_called = true;         /* 先标记，防止重复调度（析构时据此判断）*/
+
+    for (size_t i = 0; i < si->needed_count; i++) {
+        soinfo_t* dep = si->needed[i];
+        if (!dep) continue;
+        if (dep->init_mark != g_init_mark) {
+            if (dep->init_called) continue;
+            if (init_collect(dep, nodes, count, capacity, edges) < 0) return -1;
+        }
+        *edges += 1;
+    }
+
+    if (*count == *capacity) {
+        size_t grown = *capacity ? *capacity * 2 : 16;
+        init_node_t* p = (init_node_t*)realloc(*nodes, grown * sizeof(init_node_t));
+        if (!p) return -1;
+        *nodes = p;
+        *capacity = grown;
+    }
+    si->init_node = *count;
+    (*nodes)[(*count)++] = (init_node_t){ .si = si };
+    return 0;
+}
+
+/* 根据当前标记找到依赖所在的节点，不在图中（已初始化或成环）返回 NULL */
+static init_node_t* init_node_of(init_graph_t* g, const soinfo_t* dep) {
+    if (!dep || dep->init_mark != g_init_mark || dep->init_node >= g->count) return NULL;
+    return &g->nodes[dep->init_node];
+}
+
+/* 按优先级从高到低排序节点下标 */
+static init_graph_t* g_sort_graph;
+static int init_cmp_priority(const void* a, const void* b) {
+    size_t pa = g_sort_graph->nodes[*(const size_t*)a].priority;
+    size_t pb = g_sort_graph->nodes[*(const size_t*)b].priority;
+    return pa < pb ? 1 : pa > pb ? -1 : 0;
+}
+
+/**
+ * init_graph_build - 建立反向邻接表并计算入度和优先级
+ * @g: 图（nodes 已按后序收集）
+ * @edges: init_collect 统计的边数（上界）
+ *
+ * 返回: 成功返回 0，内存不足返回 -1
+ */
+static int init_graph_build(init_graph_t* g, size_t edges) {
+    g->users = (size_t*)malloc((edges ? edges : 1) * sizeof(size_t));
+    g->order = (size_t*)malloc(g->count * sizeof(size_t));
+    if (!g->users || !g->order) return -1;
+
+    /* 第一遍：每个节点有多少使用者（边 dep <- user） */
+    size_t* fill = g->order;
+    memset(fill, 0, g->count * sizeof(size_t));
+    for (size_t u = 0; u < g->count; u++) {
+        soinfo_t* si = g->nodes[u].si;
+        for (size_t i = 0; i < si->needed_count; i++) {
+            init_node_t* dep = init_node_of(g, si->needed[i]);
+            if (dep && dep != &g->nodes[u]) {
+                fill[dep - g->nodes]++;
+                g->nodes[u].pending++;
+            }
+        }
+    }
+    size_t offset = 0;
+    for (size_t v = 0; v < g->count; v++) {
+        g->nodes[v].users_begin = g->nodes[v].users_end = offset;
+        offset += fill[v];
+    }
+    for (size_t u = 0; u < g->count; u++) {
+        soinfo_t* si = g->nodes[u].si;
+        for (size_t i = 0; i < si->needed_count; i++) {
+            init_node_t* dep = init_node_of(g, si->needed[i]);
+            if (dep && dep != &g->nodes[u]) {
+                g->users[dep->users_end++] = u;
+            }
+        }
+    }
+
+    /* 后序中使用者总在依赖之后（环除外），倒序遍历即可得到到根库的最长链 */
+    for (size_t v = g->count; v > 0; v--) {
+        init_node_t* n = &g->nodes[v - 1];
+        for (size_t k = n->users_begin; k < n->users_end; k++) {
+            size_t p = g->nodes[g->users[k]].priority + 1;
+            if (p > n->priority) n->priority = p;
+        }
+    }
+
+    g_sort_graph = g;
+    for (size_t v = 0; v < g->count; v++) {
+        init_node_t* n = &g->nodes[v];
+        qsort(&g->users[n->users_begin], n->users_end - n->users_begin, sizeof(size_t),
+              init_cmp_priority);
+    }
+    return 0;
+}
+
+static void init_task_run(void* arg);
+
+/* 节点就绪：并行时提交给线程池（失败则就地执行），串行时放入就绪队列 */
+static void init_ready(init_graph_t* g, init_node_t* n, size_t* queue_tail) {
+    n->ready_ns = now_ns();
+    if (g->pool) {
+        if (thread_pool_submit(g->pool, init_task_run, n) < 0) {
+            init_task_run(n);
+        }
+    } else {
+        g->order[(*queue_tail)++] = (size_t)(n - g->nodes);
+    }
+}
+
+/* 提交一批就绪节点（不能持有 g->lock） */
+static void init_submit(init_graph_t* g, const size_t* ready, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        init_ready(g, &g->nodes[ready[i]], NULL);
+    }
+}
+
+/**
+ * init_complete - 节点执行完毕，释放依赖它的节点
+ * @g: 图
+ * @n: 完成的节点
+ * @queue_tail: 串行就绪队列的尾部（并行时不使用）
+ */
+static void init_complete(init_graph_t* g, init_node_t* n, size_t* queue_tail) {
+    size_t ready[16];
+    size_t ready_count = 0;
+
+    if (g->pool) pthread_mutex_lock(&g->lock);
+    n->done = true;
+    for (size_t k = n->users_begin; k < n->users_end; k++) {
+        init_node_t* user = &g->nodes[g->users[k]];
+        if (--user->pending != 0) continue;
+        if (!g->pool) {
+            init_ready(g, user, queue_tail);
+            continue;
+        }
+        ready[ready_count++] = g->users[k];
+        if (ready_count == sizeof(ready) / sizeof(ready[0])) {
+            /*
+             * 提交失败时 init_ready 会就地执行，又要获取 g->lock，
+             * 所以总是先解锁；顺序仍然按优先级
+             */
+            pthread_mutex_unlock(&g->lock);
+            init_submit(g, ready, ready_count);
+            ready_count = 0;
+            pthread_mutex_lock(&g->lock);
+        }
+    }
+    if (g->pool) pthread_mutex_unlock(&g->lock);
+
+    /* 锁外提交，完成的任务越早开始执行下一个越好 */
+    init_submit(g, ready, ready_count);
+}
+
+static void init_task_run(void* arg) {
+    init_node_t* n = (init_node_t*)arg;
+    run_init_funcs(n->si, n->ready_ns);
+    init_complete(n->graph, n, NULL);
+}
+
+/**
+ * init_schedule - 按依赖图执行构造函数（持有写者锁）
+ * @root: 根库（init_called 为假）
+ * @threads: 并行线程数（<= 1 表示在调用线程中串行执行）
+ *
+ * 返回: 成功返回 0；内存不足返回 -1（此时没有执行任何构造函数，init_called 已复原）
+ */
+static int init_schedule(soinfo_t* root, int threads) {
+    init_graph_t g = {0};
+    size_t capacity = 0, edges = 0;
+    int result = -1;
+
+    g_init_mark++;
+    if (init_collect(root, &g.nodes, &g.count, &capacity, &edges) < 0) {
+        goto out;
+    }
+    for (size_t v = 0; v < g.count; v++) {
+        g.nodes[v].graph = &g;
+    }
+    if (init_graph_build(&g, edges) < 0) {
+        goto out;
+    }
+
+    /* 初始就绪的节点按优先级排序 */
+    size_t ready_count = 0;
+    size_t* initial = (size_t*)malloc(g.count * sizeof(size_t));
+    if (!initial) goto out;
+    for (size_t v = 0; v < g.count; v++) {
+        if (g.nodes[v].pending == 0) initial[ready_count++] = v;
+    }
+    g_sort_graph = &g;
+    qsort(initial, ready_count, sizeof(size_t), init_cmp_priority);
+
+    if (threads > 1 && g.count > 1) {
+        g.pool = thread_pool_create(threads < (int)g.count ? threads : (int)g.count);
+    }
+
+    if (g.pool) {
+        pthread_mutex_init(&g.lock, NULL);
+        for (size_t i = 0; i < ready_count; i++) {
+            init_ready(&g, &g.nodes[initial[i]], NULL);
+        }
+        thread_pool_wait(g.pool);
+        thread_pool_destroy(g.pool);
+        pthread_mutex_destroy(&g.lock);
+        g.pool = NULL;
+    } else {
+        size_t head = 0, tail = 0;
+        for (size_t i = 0; i < ready_count; i++) {
+            init_ready(&g, &g.nodes[initial[i]], &tail);
+        }
+        while (head < tail) {
+            init_node_t* n = &g.nodes[g.order[head++]];
+            run_init_funcs(n->si, n->ready_ns);
+            init_complete(&g, n, &tail);
+        }
+    }
+    free(initial);
+
+    /* 环中的库：按后序（依赖在前）补上 */
+    for (size_t v = 0; v < g.count; v++) {
+        if (!g.nodes[v].done) {
+            LOG("[linker] Circular dependency: initializing %s out of order\n", g.nodes[v].si->name);
+            run_init_funcs(g.nodes[v].si, 0);
+            g.nodes[v].done = true;
+        }
+    }
+    result = 0;
+
+out:
+    if (result < 0) {
+        for (size_t v = 0; v < g.count; v++) {
+            g.nodes[v].si->init_called = false;
+        }
+        root->init_called = false;
+    }
+    free(g.order);
+    free(g.users);
+    free(g.nodes);
+    return result;
+}
+
 /**
  * linker_call_constructors - 调用构造函数
  * @si: 共享库信息
  *
  * 构造函数的调用顺序：
+ *   0. 所有依赖库的构造函数（按依赖图的拓扑序，每个库只调用一次）
  *   1. DT_INIT（单个初始化函数，旧式）
  *   2. DT_INIT_ARRAY（初始化函数数组，按顺序调用）
  *
@@ -1122,25 +4885,66 @@ static int is_valid_func_ptr(void* ptr) {
  *   }
  */
 void linker_call_constructors(soinfo_t* si) {
+    linker_call_constructors_ex(si, 1);
+}
+
+/**
+ * linker_call_constructors_ex - 调用构造函数，互不依赖的库可以并行
+ * @si: 共享库信息
+ * @threads: 并行线程数（<= 1 表示在调用线程中串行执行）
+ *
+ * 调度图建不起来（内存不足）时退回到逐库递归的串行顺序。
+ */
+void linker_call_constructors_ex(soinfo_t* si, int threads) {
     if (!si) return;
 
-    /* 调用 DT_INIT */
-    if (is_valid_func_ptr((void*)si->init_func)) {
-        LOG("[linker] Calling DT_INIT for %s\n", si->name);
-        si->init_func();
+    linker_lock();
+    if (si->init_called) {
+        linker_unlock();
+        return;
     }
 
-    /* 调用 DT_INIT_ARRAY */
-    if (si->init_array && si->init_array_count > 0) {
-        LOG("[linker] Calling DT_INIT_ARRAY (%zu entries) for %s\n",
-               si->init_array_count, si->name);
-        for (size_t i = 0; i < si->init_array_count; i++) {
-            if (is_valid_func_ptr((void*)si->init_array[i])) {
-                LOG("[linker] Calling init_array[%zu] at %p\n", i, (void*)si->init_array[i]);
-                si->init_array[i]();
-            }
+    if (init_schedule(si, threads) < 0) {
+        /* 先标记，防止循环依赖导致无限递归 */
+        si->init_called = true;
+        for (size_t i = 0; i < si->needed_count; i++) {
+            linker_call_constructors(si->needed[i]);
+        }
+        run_init_funcs(si, 0);
+    }
+    linker_unlock();
+}
+
+/**
+ * linker_defer_constructors - 把构造函数推迟到第一次经由句柄查找符号时
+ * @si: 共享库信息
+ *
+ * 根库和它尚未初始化的依赖都标记为推迟：经由其中任何一个句柄的 dlsym
+ * 都会先按依赖顺序执行这棵子树的构造函数（见 linker_run_deferred_constructors）。
+ */
+void linker_defer_constructors(soinfo_t* si) {
+    if (!si) return;
+
+    linker_lock();
+    if (!si->init_called && !si->init_deferred) {
+        __atomic_store_n(&si->init_deferred, true, __ATOMIC_RELEASE);
+        for (size_t i = 0; i < si->needed_count; i++) {
+            linker_defer_constructors(si->needed[i]);
         }
     }
+    linker_unlock();
+}
+
+/**
+ * linker_run_deferred_constructors - 执行推迟的构造函数（如果还没有执行）
+ * @si: 共享库信息
+ *
+ * 快速路径只是一次原子读，已经初始化的库不加锁。
+ */
+void linker_run_deferred_constructors(soinfo_t* si) {
+    if (si && __atomic_load_n(&si->init_deferred, __ATOMIC_ACQUIRE)) {
+        linker_call_constructors(si);
+    }
 }
 
 /**
@@ -1163,6 +4967,13 @@ void linker_call_constructors(soinfo_t* si) {
 void linker_call_destructors(soinfo_t* si) {
     if (!si) return;
 
+    linker_lock();
+    if (!si->init_called) {
+        linker_unlock();
+        return;
+    }
+    si->init_called = false;
+
     /* 调用 DT_FINI_ARRAY（逆序）*/
     if (si->fini_array && si->fini_array_count > 0) {
         LOG("[linker] Calling DT_FINI_ARRAY (%zu entries) for %s\n",
@@ -1180,6 +4991,8 @@ void linker_call_destructors(soinfo_t* si) {
         LOG("[linker] Calling DT_FINI for %s\n", si->name);
         si->fini_func();
     }
+
+    linker_unlock();
 }
 
 /* =============================================================================
@@ -1202,15 +5015,157 @@ void soinfo_print(soinfo_t* si) {
     printf("Load bias: %p\n", si->load_bias);
     printf("Phdr: %p (%zu entries)\n", (void*)si->phdr, si->phnum);
     printf("Dynamic: %p\n", (void*)si->dynamic);
+    printf("RELRO: %p (0x%zx bytes)\n", si->relro_start, si->relro_size);
     printf("Symtab: %p\n", (void*)si->symtab);
     printf("Strtab: %p (size: %zu)\n", si->strtab, si->strtab_size);
     printf("Hash: %p\n", (void*)si->hash);
     printf("GNU hash: %p\n", (void*)si->gnu_hash);
-    printf("Rela: %p (%zu entries)\n", (void*)si->rela, si->rela_count);
+    printf("Versions: %zu defined, %zu needed files\n", si->verdef_count, si->verneed_count);
+    printf("Rela: %p (%zu entries, %zu relative)\n", (void*)si->rela, si->rela_count, si->relative_count);
+    printf("Relr: %p (%zu entries)\n", (void*)si->relr, si->relr_count);
+    printf("Android packed rela: %p (%zu bytes)\n", (void*)si->android_rela, si->android_rela_size);
     printf("PLT Rela: %p (%zu entries)\n", (void*)si->plt_rela, si->plt_rela_count);
+    printf("PLT GOT: %p (%s binding)\n", (void*)si->plt_got, si->lazy_bound ? "lazy" : "immediate");
     printf("Init: %p\n", (void*)si->init_func);
     printf("Fini: %p\n", (void*)si->fini_func);
     printf("Init array: %p (%zu entries)\n", (void*)si->init_array, si->init_array_count);
     printf("Fini array: %p (%zu entries)\n", (void*)si->fini_array, si->fini_array_count);
+    printf("Soname: %s\n", si->soname ? si->soname : "(none)");
+    printf("Runpath: %s\n", si->runpath ? si->runpath : "(none)");
+    printf("Needed: %zu loaded, %zu system\n", si->needed_count, si->system_needed_count);
+    for (size_t i = 0; i < si->needed_count; i++) {
+        printf("  -> %s\n", si->needed[i]->name);
+    }
     printf("Ref count: %d\n", si->ref_count);
 }
+
+/* =============================================================================
+ * 加载统计输出
+ * =============================================================================
+ */
+
+/**
+ * linker_get_stats - 读取共享库的加载统计快照
+ * @si: 共享库信息
+ * @out: 输出缓冲区
+ *
+ * 计数器可能正被延迟绑定的调用者累加，这里逐个原子读取，
+ * 每个计数器本身是一致的，计数器之间不保证是同一时刻的值。
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+int linker_get_stats(soinfo_t* si, linker_stats_t* out) {
+    if (!si || !out) {
+        linker_set_error("Invalid argument");
+        return -1;
+    }
+
+    const uint64_t* src = (const uint64_t*)&si->stats;
+    uint64_t* dst = (uint64_t*)out;
+    for (size_t i = 0; i < sizeof(linker_stats_t) / sizeof(uint64_t); i++) {
+        dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+/* 统计槽位对应的常见重定位类型名，其余输出为 type_N（N 为槽位）*/
+#define RELOC_NAME(type) case ARCH_RELOC_STAT_INDEX(type): return #type
+static const char* reloc_type_name(uint32_t slot) {
+    switch (slot) {
+#if defined(__x86_64__)
+        RELOC_NAME(R_X86_64_64);
+        RELOC_NAME(R_X86_64_PC32);
+        RELOC_NAME(R_X86_64_COPY);
+        RELOC_NAME(R_X86_64_GLOB_DAT);
+        RELOC_NAME(R_X86_64_JUMP_SLOT);
+        RELOC_NAME(R_X86_64_RELATIVE);
+        RELOC_NAME(R_X86_64_DTPMOD64);
+        RELOC_NAME(R_X86_64_DTPOFF64);
+        RELOC_NAME(R_X86_64_TPOFF64);
+        RELOC_NAME(R_X86_64_IRELATIVE);
+#elif defined(__aarch64__)
+        RELOC_NAME(R_AARCH64_ABS64);
+        RELOC_NAME(R_AARCH64_COPY);
+        RELOC_NAME(R_AARCH64_GLOB_DAT);
+        RELOC_NAME(R_AARCH64_JUMP_SLOT);
+        RELOC_NAME(R_AARCH64_RELATIVE);
+        RELOC_NAME(R_AARCH64_TLS_DTPMOD);
+        RELOC_NAME(R_AARCH64_TLS_DTPREL);
+        RELOC_NAME(R_AARCH64_TLS_TPREL);
+        RELOC_NAME(R_AARCH64_TLSDESC);
+#elif defined(__arm__)
+        RELOC_NAME(R_ARM_ABS32);
+        RELOC_NAME(R_ARM_TLS_DTPMOD32);
+        RELOC_NAME(R_ARM_TLS_DTPOFF32);
+        RELOC_NAME(R_ARM_TLS_TPOFF32);
+        RELOC_NAME(R_ARM_COPY);
+        RELOC_NAME(R_ARM_GLOB_DAT);
+        RELOC_NAME(R_ARM_JUMP_SLOT);
+        RELOC_NAME(R_ARM_RELATIVE);
+#endif
+        default: return NULL;
+    }
+}
+#undef RELOC_NAME
+
+/* 输出一个库的统计，一行一个 JSON 对象 */
+static void dump_one(soinfo_t* si, FILE* out) {
+    linker_stats_t st;
+    linker_get_stats(si, &st);
+
+    fprintf(out, "{\"name\":\"%s\",\"base\":\"%p\",\"total_ns\":%llu,\"phases_ns\":{",
+            si->name, si->base, (unsigned long long)st.total_ns);
+    for (int p = 0; p < LINKER_PHASE_COUNT; p++) {
+        fprintf(out, "%s\"%s\":%llu", p ? "," : "",
+                linker_phase_name((linker_phase_t)p), (unsigned long long)st.phase_ns[p]);
+    }
+
+    fputs("},\"relocs\":{", out);
+    bool first = true;
+    for (uint32_t t = 0; t < LINKER_STATS_RELOC_TYPES; t++) {
+        if (!st.relocs[t]) continue;
+        const char* name = reloc_type_name(t);
+        if (name) {
+            fprintf(out, "%s\"%s\":%llu", first ? "" : ",", name, (unsigned long long)st.relocs[t]);
+        } else {
+            fprintf(out, "%s\"type_%u\":%llu", first ? "" : ",", t, (unsigned long long)st.relocs[t]);
+        }
+        first = false;
+    }
+
+    fputs("},\"lookups\":{", out);
+    for (int k = 0; k < LINKER_LOOKUP_COUNT; k++) {
+        fprintf(out, "%s\"%s\":%llu", k ? "," : "",
+                linker_lookup_kind_name((linker_lookup_kind_t)k), (unsigned long long)st.lookups[k]);
+    }
+
+    fprintf(out, "},\"lookup_cache_hits\":%llu,\"bytes_mapped\":%llu,\"relro_shared_bytes\":%llu,"
+                 "\"huge_text_bytes\":%llu,\"minor_faults\":%llu,\"major_faults\":%llu,"
+                 "\"init_funcs\":%llu,\"init_wait_ns\":%llu}\n",
+            (unsigned long long)st.lookup_cache_hits, (unsigned long long)st.bytes_mapped,
+            (unsigned long long)st.relro_shared_bytes, (unsigned long long)st.huge_text_bytes,
+            (unsigned long long)st.minor_faults, (unsigned long long)st.major_faults,
+            (unsigned long long)st.init_funcs, (unsigned long long)st.init_wait_ns);
+}
+
+/**
+ * linker_dump_stats - 以 JSON Lines 格式输出加载统计
+ * @si: 共享库信息（NULL 表示所有已加载库）
+ * @out: 输出流
+ *
+ * 每个库输出一行 JSON，方便用 jq 等工具直接处理。
+ */
+void linker_dump_stats(soinfo_t* si, FILE* out) {
+    if (!out) return;
+
+    linker_lock();
+    if (si) {
+        dump_one(si, out);
+    } else {
+        for (soinfo_t* it = g_linker.soinfo_list; it != NULL; it = it->next) {
+            dump_one(it, out);
+        }
+    }
+    linker_unlock();
+    fflush(out);
+}
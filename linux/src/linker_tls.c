@@ -0,0 +1,413 @@
+/**
+ * =============================================================================
+ * linker_tls.c - 线程局部存储
+ * =============================================================================
+ *
+ * x86_64 使用 TLS variant II：线程指针（%fs:0）指向 TCB，静态 TLS 块
+ * 位于线程指针之前（负偏移）。
+ *
+ *            静态 TLS（glibc 分配，包含本文件的 t_static_tls）
+ *   ... [ 可执行文件 | ... | t_static_tls: [模块 A][模块 B] ··· ] [TCB]
+ *                                                                 ^ %fs:0
+ *
+ * AArch64 / ARM 使用 variant I（块在线程指针之后），但这里只记录
+ * "块地址 - 线程指针"，同样的计算在两种变体下都成立。
+ *
+ *   动态 TLS：每个线程一个 DTV
+ *     t_dtv ─► { generation, size, entries[模块 ID] = { block, generation } }
+ *                                                       │
+ *                                  静态区中的块，或者 aligned_alloc 的块
+ *
+ * 静态块的初始化：新线程的 t_static_tls 由 glibc 从可执行文件的 TLS 镜像复制，
+ * 所以 t_static_tls 放在 .tdata 中，模块注册时把 .tdata 写进这份镜像，
+ * 之后创建的线程在执行任何代码之前就已经有初始值。区首的 stamp 记录线程
+ * 创建时镜像的版本：模块的 image_stamp 不超过它，说明块已经初始化，不再复制，
+ * 否则不会覆盖 initial-exec 代码已经写入的值。注册时已经存在的线程没办法
+ * 提前初始化（glibc 靠内部线程表），只能在第一次经过 __tls_get_addr 时复制一次。
+ *
+ * 模块表只在持有 g_tls_lock 时访问。__tls_get_addr 的快速路径不加锁：
+ * DTV 属于当前线程，只需要确认 g_tls_generation 没有变化
+ * （每次注销模块都会递增它，DTV 中的块可能已经失效）。
+ *
+ * =============================================================================
+ */
+
+#define _GNU_SOURCE
+#include "linker_tls.h"
+#include "log.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+typedef struct {
+    soinfo_t* si;               /* NULL 表示空闲 */
+    uint64_t generation;        /* 每次注销递增，DTV 中记录的值不同说明块已失效 */
+    bool is_static;
+    ptrdiff_t tp_offset;        /* 静态块相对线程指针的偏移 */
+    uint64_t image_stamp;       /* .tdata 写入 TLS 镜像时的版本，0 表示没有写入 */
+} tls_module_t;
+
+typedef struct {
+    void* block;                /* 本线程的 TLS 块，NULL 表示尚未分配 */
+    uint64_t generation;        /* 分配时模块的 generation */
+    bool owned;                 /* 是否由 aligned_alloc 分配（静态块不需要释放）*/
+} tls_dtv_entry_t;
+
+typedef struct {
+    uint64_t generation;        /* 上次校验时的 g_tls_generation */
+    size_t size;                /* entries 的个数 */
+    tls_dtv_entry_t entries[];
+} tls_dtv_t;
+
+/*
+ * 静态 TLS 区：initial-exec 保证它在初始 TLS 中，偏移对所有线程相同。
+ * 放进 .tdata（而不是 .tbss）才有一份可以修改的初始化镜像。
+ * 前 STATIC_TLS_ALIGN 字节存放线程创建时镜像的 stamp，不分配给模块。
+ */
+static __thread _Alignas(64) uint8_t t_static_tls[LINKER_TLS_STATIC_SIZE]
+    __attribute__((section(".tdata"), tls_model("initial-exec")));
+#define STATIC_TLS_ALIGN 64
+#define STATIC_TLS_STAMP(base) (*(uint64_t*)(base))
+
+static __thread tls_dtv_t* t_dtv = NULL;
+
+static pthread_mutex_t g_tls_lock = PTHREAD_MUTEX_INITIALIZER;
+static tls_module_t* g_modules = NULL;     /* 下标即模块 ID，0 不使用 */
+static size_t g_module_capacity = 0;
+static size_t g_static_used = STATIC_TLS_ALIGN;
+static uint64_t g_tls_generation = 0;
+
+/* t_static_tls 在 TLS 镜像中的位置，以及镜像所在的 RELRO 范围（持有 g_tls_lock）*/
+static uint8_t* g_static_image = NULL;
+static uintptr_t g_relro_start = 0, g_relro_end = 0;
+static int g_static_image_state = 0;       /* 0 未查找，1 可用，-1 不可用 */
+static uint64_t g_static_image_stamp = 0;
+
+static pthread_key_t g_dtv_key;
+static pthread_once_t g_dtv_key_once = PTHREAD_ONCE_INIT;
+
+static inline uint8_t* thread_pointer(void) {
+    return (uint8_t*)__builtin_thread_pointer();
+}
+
+/**
+ * dtv_destroy - 线程退出时释放 DTV 和它分配的 TLS 块
+ */
+static void dtv_destroy(void* arg) {
+    tls_dtv_t* dtv = (tls_dtv_t*)arg;
+    for (size_t i = 0; i < dtv->size; i++) {
+        if (dtv->entries[i].owned) free(dtv->entries[i].block);
+    }
+    free(dtv);
+    t_dtv = NULL;
+}
+
+static void dtv_key_create(void) {
+    pthread_key_create(&g_dtv_key, dtv_destroy);
+}
+
+/**
+ * dtv_get - 获取当前线程的 DTV，保证能容纳模块 ID（持有 g_tls_lock）
+ * @module: 模块 ID
+ *
+ * 返回: DTV，内存不足返回 NULL
+ */
+static tls_dtv_t* dtv_get(size_t module) {
+    tls_dtv_t* dtv = t_dtv;
+    if (dtv && module < dtv->size) return dtv;
+
+    size_t old_size = dtv ? dtv->size : 0;
+    size_t size = old_size ? old_size : 16;
+    while (size <= module) size *= 2;
+
+    tls_dtv_t* grown = (tls_dtv_t*)realloc(dtv, sizeof(tls_dtv_t) + size * sizeof(tls_dtv_entry_t));
+    if (!grown) return NULL;
+    memset(&grown->entries[old_size], 0, (size - old_size) * sizeof(tls_dtv_entry_t));
+    if (!dtv) grown->generation = g_tls_generation;
+    grown->size = size;
+
+    pthread_once(&g_dtv_key_once, dtv_key_create);
+    pthread_setspecific(g_dtv_key, grown);
+    t_dtv = grown;
+    return grown;
+}
+
+/**
+ * dtv_revalidate - 丢弃已注销模块的块（持有 g_tls_lock）
+ * @dtv: 当前线程的 DTV
+ */
+static void dtv_revalidate(tls_dtv_t* dtv) {
+    for (size_t i = 0; i < dtv->size; i++) {
+        tls_dtv_entry_t* e = &dtv->entries[i];
+        if (!e->block) continue;
+        if (i < g_module_capacity && g_modules[i].si && g_modules[i].generation == e->generation) {
+            continue;
+        }
+        if (e->owned) free(e->block);
+        memset(e, 0, sizeof(*e));
+    }
+    dtv->generation = g_tls_generation;
+}
+
+/**
+ * static_image_find - dl_iterate_phdr 回调：找到包含 t_static_tls 的 TLS 段
+ */
+static int static_image_find(struct dl_phdr_info* info, size_t size, void* data) {
+    (void)size;
+    (void)data;
+    const ElfW(Phdr)* tls = NULL;
+    const ElfW(Phdr)* relro = NULL;
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        if (info->dlpi_phdr[i].p_type == PT_TLS) tls = &info->dlpi_phdr[i];
+        if (info->dlpi_phdr[i].p_type == PT_GNU_RELRO) relro = &info->dlpi_phdr[i];
+    }
+    uint8_t* block = (uint8_t*)info->dlpi_tls_data;
+    if (!tls || !block || t_static_tls < block || t_static_tls >= block + tls->p_memsz) return 0;
+
+    /* 必须整个落在 .tdata 中，否则镜像里没有这部分 */
+    size_t offset = (size_t)(t_static_tls - block);
+    if (offset + LINKER_TLS_STATIC_SIZE > tls->p_filesz) return -1;
+
+    g_static_image = (uint8_t*)(info->dlpi_addr + tls->p_vaddr) + offset;
+    if (relro) {
+        g_relro_start = info->dlpi_addr + relro->p_vaddr;
+        g_relro_end = g_relro_start + relro->p_memsz;
+    }
+    return 1;
+}
+
+/**
+ * static_image_write - 把模块的 .tdata 写进 TLS 镜像（持有 g_tls_lock）
+ * @offset: 模块在 t_static_tls 中的偏移
+ * @si:     共享库信息
+ *
+ * 镜像通常在 RELRO 中，写入期间临时改为可写。
+ *
+ * 返回: 写入后镜像的 stamp，镜像不可用返回 0
+ */
+static uint64_t static_image_write(size_t offset, const soinfo_t* si) {
+    if (g_static_image_state == 0) {
+        g_static_image_state = dl_iterate_phdr(static_image_find, NULL) == 1 ? 1 : -1;
+    }
+    if (g_static_image_state < 0) return 0;
+
+    uintptr_t start = (uintptr_t)g_static_image;
+    uintptr_t end = start + LINKER_TLS_STATIC_SIZE;
+    bool in_relro = start >= g_relro_start && end <= g_relro_end;
+    if (!in_relro && start < g_relro_end && end > g_relro_start) return 0;
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    void* page_start = (void*)(start & ~(page - 1));
+    size_t page_len = ((end + page - 1) & ~(page - 1)) - (uintptr_t)page_start;
+    if (in_relro && mprotect(page_start, page_len, PROT_READ | PROT_WRITE) != 0) {
+        g_static_image_state = -1;
+        return 0;
+    }
+
+    memcpy(g_static_image + offset, si->tls_image, si->tls_filesz);
+    uint64_t stamp = ++g_static_image_stamp;
+    __atomic_store_n(&STATIC_TLS_STAMP(g_static_image), stamp, __ATOMIC_RELEASE);
+
+    if (in_relro) mprotect(page_start, page_len, PROT_READ);
+    return stamp;
+}
+
+/**
+ * dtv_install - 为当前线程分配并初始化模块的 TLS 块（持有 g_tls_lock）
+ * @module: 模块 ID（已注册）
+ *
+ * 静态块在每个线程中只初始化一次：线程创建时镜像中已经有这个模块的
+ * .tdata 就不复制，否则只复制 .tdata。静态区不回收，没有用过的部分在
+ * 每个线程中都是零；再清零 .tbss 会抹掉 initial-exec 代码写入的值。
+ *
+ * 返回: TLS 块，内存不足返回 NULL
+ */
+static void* dtv_install(size_t module) {
+    tls_dtv_t* dtv = dtv_get(module);
+    if (!dtv) return NULL;
+
+    const tls_module_t* m = &g_modules[module];
+    const soinfo_t* si = m->si;
+    void* block;
+    bool owned = false;
+
+    if (m->is_static) {
+        block = thread_pointer() + m->tp_offset;
+        if (!m->image_stamp || m->image_stamp > STATIC_TLS_STAMP(t_static_tls)) {
+            memcpy(block, si->tls_image, si->tls_filesz);
+        }
+    } else {
+        size_t align = si->tls_align > sizeof(void*) ? si->tls_align : sizeof(void*);
+        size_t size = (si->tls_memsz + align - 1) & ~(align - 1);
+        block = aligned_alloc(align, size ? size : align);
+        if (!block) return NULL;
+        memcpy(block, si->tls_image, si->tls_filesz);
+        memset((uint8_t*)block + si->tls_filesz, 0, si->tls_memsz - si->tls_filesz);
+        owned = true;
+    }
+
+    dtv->entries[module].block = block;
+    dtv->entries[module].generation = m->generation;
+    dtv->entries[module].owned = owned;
+    return block;
+}
+
+/**
+ * linker_tls_register - 为库分配 TLS 模块 ID，需要时分配静态块
+ * @si: 共享库信息（has_tls 为真时才有 TLS 段）
+ *
+ * 静态区分配策略：
+ *   - DF_STATIC_TLS 的库必须分配成功，可以使用全部剩余空间
+ *   - 其他库只在分配后仍留有 LINKER_TLS_STATIC_RESERVE 字节时使用静态区
+ * 对齐要求超过 STATIC_TLS_ALIGN 的库只能使用动态块。
+ *
+ * 返回: 成功返回 0，失败返回 -1
+ */
+int linker_tls_register(soinfo_t* si) {
+    if (!si->has_tls) return 0;
+
+    pthread_mutex_lock(&g_tls_lock);
+
+    size_t module = 1;
+    while (module < g_module_capacity && g_modules[module].si) module++;
+    if (module >= g_module_capacity) {
+        size_t capacity = g_module_capacity ? g_module_capacity * 2 : 16;
+        tls_module_t* grown = (tls_module_t*)realloc(g_modules, capacity * sizeof(tls_module_t));
+        if (!grown) {
+            pthread_mutex_unlock(&g_tls_lock);
+            linker_set_error("Out of memory");
+            return -1;
+        }
+        memset(&grown[g_module_capacity], 0, (capacity - g_module_capacity) * sizeof(tls_module_t));
+        g_modules = grown;
+        g_module_capacity = capacity;
+    }
+
+    size_t align = si->tls_align ? si->tls_align : 1;
+    size_t offset = (g_static_used + align - 1) & ~(align - 1);
+    size_t limit = LINKER_TLS_STATIC_SIZE - (si->tls_static_required ? 0 : LINKER_TLS_STATIC_RESERVE);
+    bool fits = align <= STATIC_TLS_ALIGN && offset + si->tls_memsz <= limit;
+
+    if (si->tls_static_required && !fits) {
+        pthread_mutex_unlock(&g_tls_lock);
+        linker_set_error("Cannot allocate memory in static TLS block for %s (%zu bytes, %zu free)",
+                         si->name, si->tls_memsz,
+                         LINKER_TLS_STATIC_SIZE > g_static_used ? LINKER_TLS_STATIC_SIZE - g_static_used : 0);
+        return -1;
+    }
+
+    tls_module_t* m = &g_modules[module];
+    m->si = si;
+    m->is_static = fits;
+    m->tp_offset = 0;
+    m->image_stamp = 0;
+    if (fits) {
+        g_static_used = offset + si->tls_memsz;
+        m->tp_offset = (t_static_tls + offset) - thread_pointer();
+    }
+    si->tls_module = module;
+    si->tls_static = fits;
+    si->tls_tp_offset = m->tp_offset;
+
+    /*
+     * initial-exec 代码不经过 __tls_get_addr：加载线程的块现在就初始化，
+     * 之后创建的线程从镜像得到初始值
+     */
+    if (fits) {
+        dtv_install(module);
+        m->image_stamp = static_image_write(offset, si);
+        if (!m->image_stamp && si->tls_static_required && si->tls_filesz) {
+            LOG_WARN("[linker] %s uses initial-exec TLS with initialized data; other threads "
+                     "see it after their first dynamic TLS access\n", si->name);
+        }
+    }
+
+    pthread_mutex_unlock(&g_tls_lock);
+
+    LOG("[linker] TLS module %zu for %s: %zu bytes, align %zu, %s\n", module, si->name,
+        si->tls_memsz, align, fits ? "static" : "dynamic");
+    return 0;
+}
+
+/**
+ * linker_tls_unregister - 释放库的 TLS 模块 ID
+ * @si: 共享库信息
+ */
+void linker_tls_unregister(soinfo_t* si) {
+    if (!si->tls_module) return;
+
+    pthread_mutex_lock(&g_tls_lock);
+    tls_module_t* m = &g_modules[si->tls_module];
+    m->si = NULL;
+    m->generation++;
+    m->is_static = false;
+    __atomic_add_fetch(&g_tls_generation, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_tls_lock);
+
+    si->tls_module = 0;
+}
+
+/**
+ * tls_get_addr_slow - 当前线程还没有该模块的块，或者有模块被注销过
+ */
+static void* __attribute__((noinline)) tls_get_addr_slow(tls_index_t* ti) {
+    pthread_mutex_lock(&g_tls_lock);
+
+    if (t_dtv && t_dtv->generation != g_tls_generation) {
+        dtv_revalidate(t_dtv);
+    }
+
+    void* block = NULL;
+    if (ti->module < g_module_capacity && g_modules[ti->module].si) {
+        block = t_dtv && ti->module < t_dtv->size ? t_dtv->entries[ti->module].block : NULL;
+        if (!block) block = dtv_install(ti->module);
+    }
+
+    pthread_mutex_unlock(&g_tls_lock);
+
+    if (!block) {
+        LOG_ERROR("[linker] __tls_get_addr: cannot access TLS module %lu\n", ti->module);
+        abort();
+    }
+    return (uint8_t*)block + ti->offset;
+}
+
+/**
+ * linker_tls_get_addr - __tls_get_addr 的实现
+ * @ti: GOT 中的 {模块 ID, 偏移}
+ *
+ * 快速路径：DTV 已有该模块的块，且没有模块被注销过。
+ *
+ * 返回: 当前线程中变量的地址
+ */
+void* linker_tls_get_addr(tls_index_t* ti) {
+    tls_dtv_t* dtv = t_dtv;
+    if (__builtin_expect(dtv && ti->module < dtv->size && dtv->entries[ti->module].block &&
+                         dtv->generation == __atomic_load_n(&g_tls_generation, __ATOMIC_ACQUIRE), 1)) {
+        return (uint8_t*)dtv->entries[ti->module].block + ti->offset;
+    }
+    return tls_get_addr_slow(ti);
+}
+
+/**
+ * linker_tls_block - 调用线程中库的 TLS 块
+ * @si: 共享库信息
+ *
+ * 只读当前线程的 DTV，不加锁也不分配：可以在信号处理函数中调用。
+ * 静态块的地址在所有线程中都已确定，即使本线程还没有复制 .tdata。
+ *
+ * 返回: TLS 块，没有 TLS 段或本线程尚未分配时返回 NULL
+ */
+void* linker_tls_block(const soinfo_t* si) {
+    if (!si->has_tls || !si->tls_module) return NULL;
+    if (si->tls_static) return thread_pointer() + si->tls_tp_offset;
+
+    const tls_dtv_t* dtv = t_dtv;
+    if (dtv && si->tls_module < dtv->size &&
+        dtv->generation == __atomic_load_n(&g_tls_generation, __ATOMIC_ACQUIRE)) {
+        return dtv->entries[si->tls_module].block;
+    }
+    return NULL;
+}
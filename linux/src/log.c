@@ -1,12 +1,18 @@
+#define _GNU_SOURCE
 #include "log.h"
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include <pthread.h>
+#include <sys/types.h>
 #include <time.h>
 
-// 起始时间（用于计算相对时间）
-static struct timeval g_start_time = {0};
+// 起始时间（用于计算相对时间，纳秒）
+static uint64_t g_start_ns = 0;
 static int g_time_initialized = 0;
 static log_level_t g_log_level = LOG_LEVEL_DEBUG;
 
@@ -27,10 +33,50 @@ static const char* level_colors[] = {
 };
 static const char* color_reset = "\033[0m";
 
+// ============================================================================
+// 时间戳
+// ============================================================================
+
+// 粗粒度时钟：vDSO 直接读取内核每个 tick 更新的时间，没有系统调用
+static uint64_t coarse_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void ensure_start_time(void) {
+    if (!g_time_initialized) {
+        g_start_ns = coarse_now_ns();
+        g_time_initialized = 1;
+    }
+}
+
+// 每个线程缓存当前这一秒的 localtime 结果，每秒最多调用一次 localtime_r
+static __thread time_t t_cached_sec = (time_t)-1;
+static __thread struct tm t_cached_tm;
+
+// 格式: [时:分:秒.毫秒 +相对毫秒ms]
+static void format_timestamp(char* buf, size_t size, uint64_t ns) {
+    time_t sec = (time_t)(ns / 1000000000ULL);
+    if (sec != t_cached_sec) {
+        localtime_r(&sec, &t_cached_tm);
+        t_cached_sec = sec;
+    }
+    long elapsed_ms = (long)(((int64_t)(ns - g_start_ns)) / 1000000);
+    snprintf(buf, size, "[%02d:%02d:%02d.%03ld +%4ldms]",
+             t_cached_tm.tm_hour, t_cached_tm.tm_min, t_cached_tm.tm_sec,
+             (long)((ns / 1000000) % 1000), elapsed_ms);
+}
+
 // 初始化日志系统
 void log_init(void) {
-    gettimeofday(&g_start_time, NULL);
+    g_start_ns = coarse_now_ns();
     g_time_initialized = 1;
+
+    const char* async = getenv("MINI_LOG_ASYNC");
+    if (async && *async && strcmp(async, "0") != 0) {
+        log_start_async();
+    }
 }
 
 // 设置日志级别
@@ -40,24 +86,9 @@ void log_set_level(log_level_t level) {
 
 // 获取时间戳字符串
 const char* log_get_timestamp(void) {
-    static char buf[64];
-    struct timeval now;
-    gettimeofday(&now, NULL);
-
-    if (!g_time_initialized) {
-        g_start_time = now;
-        g_time_initialized = 1;
-    }
-
-    // 计算相对时间（毫秒）
-    long elapsed_ms = (now.tv_sec - g_start_time.tv_sec) * 1000 +
-                      (now.tv_usec - g_start_time.tv_usec) / 1000;
-
-    // 格式: [时:分:秒.毫秒 +相对毫秒ms]
-    struct tm* tm_info = localtime(&now.tv_sec);
-    snprintf(buf, sizeof(buf), "[%02d:%02d:%02d.%03ld +%4ldms]",
-             tm_info->tm_hour, tm_info->tm_min, tm_info->tm_sec,
-             (long)(now.tv_usec / 1000), elapsed_ms);
+    static __thread char buf[64];
+    ensure_start_time();
+    format_timestamp(buf, sizeof(buf), coarse_now_ns());
     return buf;
 }
 
@@ -67,27 +98,571 @@ static const char* get_filename(const char* path) {
     return name ? name + 1 : path;
 }
 
+static FILE* level_stream(log_level_t level) {
+    return (level >= LOG_LEVEL_WARN) ? stderr : stdout;
+}
+
+// 输出一行的前缀: [时间戳] [级别] [文件:行号]（调用者持有 out 的锁）
+static void write_prefix(FILE* out, log_level_t level, const char* file, int line, uint64_t ns) {
+    char ts[64];
+    format_timestamp(ts, sizeof(ts), ns);
+    fprintf(out, "%s %s%s%s [%s:%d] ",
+            ts, level_colors[level], level_names[level], color_reset,
+            get_filename(file), line);
+}
+
+// 同步输出：前缀和消息在同一次加锁内写出，多个线程的日志不会交错
+static void write_sync(log_level_t level, const char* file, int line, uint64_t ns,
+                       const char* fmt, va_list args) {
+    FILE* out = level_stream(level);
+    flockfile(out);
+    write_prefix(out, level, file, line, ns);
+    vfprintf(out, fmt, args);
+    funlockfile(out);
+}
+
+// ============================================================================
+// 格式串解析（异步模式：调用线程按它取出参数，后台线程按它重新格式化）
+// ============================================================================
+
+typedef enum {
+    LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_Z, LEN_J, LEN_T, LEN_BIG_L
+} fmt_len_t;
+
+typedef struct {
+    const char* start;      // '%'
+    const char* end;        // 转换字符之后
+    bool width_star;
+    bool prec_star;
+    int precision;          // -1 表示没有给出（或者由 * 给出）
+    fmt_len_t len;
+    char conv;
+} fmt_spec_t;
+
+// 解析 p（指向 '%'）开始的转换说明，不支持的转换（%n、%ls 等）返回 false
+static bool parse_spec(const char* p, fmt_spec_t* spec) {
+    spec->start = p++;
+    spec->width_star = spec->prec_star = false;
+    spec->precision = -1;
+    spec->len = LEN_NONE;
+
+    while (*p && strchr("-+ #0'", *p)) p++;
+    if (*p == '*') {
+        spec->width_star = true;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') p++;
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->prec_star = true;
+            p++;
+        } else {
+            spec->precision = 0;
+            while (*p >= '0' && *p <= '9') spec->precision = spec->precision * 10 + (*p++ - '0');
+        }
+    }
+
+    switch (*p) {
+    case 'h': p++; spec->len = (*p == 'h') ? (p++, LEN_HH) : LEN_H; break;
+    case 'l': p++; spec->len = (*p == 'l') ? (p++, LEN_LL) : LEN_L; break;
+    case 'z': p++; spec->len = LEN_Z; break;
+    case 'j': p++; spec->len = LEN_J; break;
+    case 't': p++; spec->len = LEN_T; break;
+    case 'L': p++; spec->len = LEN_BIG_L; break;
+    default: break;
+    }
+
+    spec->conv = *p;
+    if (!*p || !strchr("diouxXcspfFeEgGaA%", *p)) return false;
+    if (spec->len == LEN_BIG_L && !strchr("fFeEgGaA", *p)) return false;
+    if (spec->len != LEN_NONE && strchr("csp", *p)) return false;
+    spec->end = p + 1;
+    return true;
+}
+
+// ============================================================================
+// 异步模式: 每个线程一个单生产者单消费者环形缓冲区
+// ============================================================================
+//
+//   调用线程                                 后台线程
+//   log_output_ex ─► [记录|记录|填充|···] ─► 按格式串取出参数，
+//                     ^tail        ^head      逐个转换说明调用 fprintf
+//
+//   记录 = log_record_t + 参数（整数/指针/浮点数各 8 字节，long double 16 字节，
+//          字符串是 4 字节长度 + 内容），整体按 8 字节对齐。
+//   缓冲区末尾放不下一条记录时，写一条 size 为 0 的填充记录，从头开始。
+//
+// head 只由所属线程写，tail 只由后台线程写（持有 g_drain_lock 的线程即后台线程
+// 或 log_flush 的调用者），两者都是单调递增的字节数。
+
+#define LOG_RING_SIZE   (64 * 1024)     // 每个线程的缓冲区大小（2 的幂）
+#define LOG_RECORD_MAX  2048            // 单条记录的上限，超出时同步输出
+#define LOG_STRING_MAX  512             // 字符串参数最多复制的字节数，更长时同步输出
+#define LOG_NULL_STRING UINT32_MAX      // 字符串参数为 NULL
+
+#define ALIGN8(x) (((x) + 7) & ~(size_t)7)
+
+typedef struct {
+    uint32_t size;          // 记录的字节数，0 表示填充到缓冲区末尾
+    int32_t line;
+    uint32_t level;
+    uint32_t reserved;
+    const char* file;
+    const char* fmt;        // 格式串必须是字符串常量（LOG_* 宏总是如此）
+    uint64_t ns;
+} log_record_t;
+
+typedef struct log_ring {
+    _Alignas(64) uint64_t head;     // 已写入的字节数（生产者）
+    _Alignas(64) uint64_t tail;     // 已消费的字节数（后台线程）
+    _Alignas(64) bool closed;       // 所属线程已退出，消费完后释放
+    struct log_ring* next;
+    _Alignas(64) uint8_t data[LOG_RING_SIZE];
+} log_ring_t;
+
+static int g_async = 0;                         // 是否处于异步模式
+static int g_drain_running = 0;
+static pthread_t g_drain_thread;
+static pthread_mutex_t g_state_lock = PTHREAD_MUTEX_INITIALIZER;    // 启动/停止
+static pthread_mutex_t g_drain_lock = PTHREAD_MUTEX_INITIALIZER;    // 消费者
+static pthread_mutex_t g_rings_lock = PTHREAD_MUTEX_INITIALIZER;    // 缓冲区链表
+static log_ring_t* g_rings = NULL;
+static pthread_key_t g_ring_key;
+static pthread_once_t g_ring_key_once = PTHREAD_ONCE_INIT;
+
+static __thread log_ring_t* t_ring = NULL;
+
+// 线程退出：缓冲区交给后台线程，清空后释放
+static void ring_release(void* arg) {
+    log_ring_t* ring = (log_ring_t*)arg;
+    t_ring = NULL;
+    __atomic_store_n(&ring->closed, true, __ATOMIC_RELEASE);
+}
+
+static void ring_key_create(void) {
+    pthread_key_create(&g_ring_key, ring_release);
+}
+
+static log_ring_t* ring_get(void) {
+    if (t_ring) return t_ring;
+
+    log_ring_t* ring = (log_ring_t*)aligned_alloc(64, sizeof(log_ring_t));
+    if (!ring) return NULL;
+    memset(ring, 0, offsetof(log_ring_t, data));
+
+    pthread_once(&g_ring_key_once, ring_key_create);
+    pthread_setspecific(g_ring_key, ring);
+
+    pthread_mutex_lock(&g_rings_lock);
+    ring->next = g_rings;
+    g_rings = ring;
+    pthread_mutex_unlock(&g_rings_lock);
+
+    t_ring = ring;
+    return ring;
+}
+
+// 向记录追加一个参数，空间不足返回 false
+static bool put_arg(uint8_t* buf, size_t* off, size_t cap, const void* data, size_t size) {
+    if (*off + size > cap) return false;
+    memcpy(buf + *off, data, size);
+    *off = ALIGN8(*off + size);
+    return true;
+}
+
+/*
+ * encode_args - 按格式串取出参数写入 buf
+ *
+ * 返回: 参数占用的字节数（8 字节对齐），不支持的格式或空间不足返回 (size_t)-1
+ */
+static size_t encode_args(uint8_t* buf, size_t cap, const char* fmt, va_list ap) {
+    size_t off = 0;
+    fmt_spec_t spec;
+
+    for (const char* p = fmt; (p = strchr(p, '%')) != NULL; p = spec.end) {
+        if (!parse_spec(p, &spec)) return (size_t)-1;
+        if (spec.conv == '%') continue;
+
+        if (spec.width_star) {
+            int64_t width = va_arg(ap, int);
+            if (!put_arg(buf, &off, cap, &width, sizeof(width))) return (size_t)-1;
+        }
+        int precision = spec.precision;
+        if (spec.prec_star) {
+            precision = va_arg(ap, int);
+            int64_t v = precision;
+            if (!put_arg(buf, &off, cap, &v, sizeof(v))) return (size_t)-1;
+        }
+
+        bool ok;
+        switch (spec.conv) {
+        case 'd': case 'i': {
+            int64_t v;
+            switch (spec.len) {
+            case LEN_L:  v = va_arg(ap, long); break;
+            case LEN_LL: v = va_arg(ap, long long); break;
+            case LEN_Z:  v = va_arg(ap, ssize_t); break;
+            case LEN_J:  v = va_arg(ap, intmax_t); break;
+            case LEN_T:  v = va_arg(ap, ptrdiff_t); break;
+            default:     v = va_arg(ap, int); break;
+            }
+            ok = put_arg(buf, &off, cap, &v, sizeof(v));
+            break;
+        }
+        case 'o': case 'u': case 'x': case 'X': {
+            uint64_t v;
+            switch (spec.len) {
+            case LEN_L:  v = va_arg(ap, unsigned long); break;
+            case LEN_LL: v = va_arg(ap, unsigned long long); break;
+            case LEN_Z:  v = va_arg(ap, size_t); break;
+            case LEN_J:  v = va_arg(ap, uintmax_t); break;
+            case LEN_T:  v = (uint64_t)va_arg(ap, ptrdiff_t); break;
+            default:     v = va_arg(ap, unsigned int); break;
+            }
+            ok = put_arg(buf, &off, cap, &v, sizeof(v));
+            break;
+        }
+        case 'c': {
+            int64_t v = va_arg(ap, int);
+            ok = put_arg(buf, &off, cap, &v, sizeof(v));
+            break;
+        }
+        case 'p': {
+            void* v = va_arg(ap, void*);
+            ok = put_arg(buf, &off, cap, &v, sizeof(v));
+            break;
+        }
+        case 's': {
+            // 带精度的 %.*s 可能没有结尾的 '\0'，最多只读 precision 个字节；
+            // 超过 LOG_STRING_MAX 不截断，整条日志改为同步输出
+            const char* s = va_arg(ap, const char*);
+            size_t limit = precision >= 0 && precision <= LOG_STRING_MAX ? (size_t)precision : LOG_STRING_MAX + 1;
+            size_t slen = s ? strnlen(s, limit) : 0;
+            if (slen > LOG_STRING_MAX) return (size_t)-1;
+            uint32_t len = s ? (uint32_t)slen : LOG_NULL_STRING;
+            ok = put_arg(buf, &off, cap, &len, sizeof(len)) &&
+                 (!s || put_arg(buf, &off, cap, s, len));
+            break;
+        }
+        default:
+            if (spec.len == LEN_BIG_L) {
+                long double v = va_arg(ap, long double);
+                ok = put_arg(buf, &off, cap, &v, sizeof(v));
+            } else {
+                double v = va_arg(ap, double);
+                ok = put_arg(buf, &off, cap, &v, sizeof(v));
+            }
+            break;
+        }
+        if (!ok) return (size_t)-1;
+    }
+    return off;
+}
+
+/*
+ * enqueue - 把一条日志写入调用线程的缓冲区
+ *
+ * 返回: 成功返回 0；缓冲区已满、记录过大或格式不支持返回 -1（由调用者同步输出）
+ */
+static int enqueue(log_level_t level, const char* file, int line, uint64_t ns,
+                   const char* fmt, va_list args) {
+    _Alignas(16) uint8_t stage[LOG_RECORD_MAX];
+
+    va_list copy;
+    va_copy(copy, args);
+    size_t arg_size = encode_args(stage + sizeof(log_record_t),
+                                  sizeof(stage) - sizeof(log_record_t), fmt, copy);
+    va_end(copy);
+    if (arg_size == (size_t)-1) return -1;
+
+    log_record_t* rec = (log_record_t*)stage;
+    rec->size = (uint32_t)(sizeof(log_record_t) + arg_size);
+    rec->line = line;
+    rec->level = level;
+    rec->reserved = 0;
+    rec->file = file;
+    rec->fmt = fmt;
+    rec->ns = ns;
+
+    log_ring_t* ring = ring_get();
+    if (!ring) return -1;
+
+    uint64_t head = ring->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    size_t pos = head & (LOG_RING_SIZE - 1);
+    size_t pad = pos + rec->size > LOG_RING_SIZE ? LOG_RING_SIZE - pos : 0;
+    if (head + pad + rec->size - tail > LOG_RING_SIZE) return -1;
+
+    if (pad) {
+        ((log_record_t*)&ring->data[pos])->size = 0;
+        head += pad;
+        pos = 0;
+    }
+    memcpy(&ring->data[pos], stage, rec->size);
+    __atomic_store_n(&ring->head, head + rec->size, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// 取出一个参数（与 put_arg 对应）
+static const uint8_t* get_arg(const uint8_t* p, void* out, size_t size) {
+    memcpy(out, p, size);
+    return p + ALIGN8(size);
+}
+
+/*
+ * print_record - 按格式串重新格式化一条记录（后台线程）
+ *
+ * 逐个转换说明调用 fprintf：把说明中的 * 换成记录下来的数值，
+ * 再按长度修饰符传入相同类型的参数。
+ */
+static void print_record(const log_record_t* rec) {
+    FILE* out = level_stream((log_level_t)rec->level);
+    const uint8_t* args = (const uint8_t*)(rec + 1);
+    const char* p = rec->fmt;
+    fmt_spec_t spec;
+
+    flockfile(out);
+    write_prefix(out, (log_level_t)rec->level, rec->file, rec->line, rec->ns);
+
+    while (*p) {
+        const char* pct = strchr(p, '%');
+        if (!pct) {
+            fputs(p, out);
+            break;
+        }
+        fwrite(p, 1, pct - p, out);
+        parse_spec(pct, &spec);     // 写入时已经检查过
+        p = spec.end;
+        if (spec.conv == '%') {
+            putc('%', out);
+            continue;
+        }
+
+        // 重建转换说明，* 替换为实际数值
+        char spec_buf[64];
+        size_t n = 0;
+        for (const char* s = spec.start; s < spec.end && n < sizeof(spec_buf) - 16; s++) {
+            if (*s == '*') {
+                int64_t v;
+                args = get_arg(args, &v, sizeof(v));
+                n += snprintf(spec_buf + n, sizeof(spec_buf) - n, "%d", (int)v);
+            } else {
+                spec_buf[n++] = *s;
+            }
+        }
+        spec_buf[n] = '\0';
+
+        switch (spec.conv) {
+        case 'd': case 'i': {
+            int64_t v;
+            args = get_arg(args, &v, sizeof(v));
+            switch (spec.len) {
+            case LEN_L:  fprintf(out, spec_buf, (long)v); break;
+            case LEN_LL: fprintf(out, spec_buf, (long long)v); break;
+            case LEN_Z:  fprintf(out, spec_buf, (ssize_t)v); break;
+            case LEN_J:  fprintf(out, spec_buf, (intmax_t)v); break;
+            case LEN_T:  fprintf(out, spec_buf, (ptrdiff_t)v); break;
+            default:     fprintf(out, spec_buf, (int)v); break;
+            }
+            break;
+        }
+        case 'o': case 'u': case 'x': case 'X': {
+            uint64_t v;
+            args = get_arg(args, &v, sizeof(v));
+            switch (spec.len) {
+            case LEN_L:  fprintf(out, spec_buf, (unsigned long)v); break;
+            case LEN_LL: fprintf(out, spec_buf, (unsigned long long)v); break;
+            case LEN_Z:  fprintf(out, spec_buf, (size_t)v); break;
+            case LEN_J:  fprintf(out, spec_buf, (uintmax_t)v); break;
+            case LEN_T:  fprintf(out, spec_buf, (ptrdiff_t)v); break;
+            default:     fprintf(out, spec_buf, (unsigned int)v); break;
+            }
+            break;
+        }
+        case 'c': {
+            int64_t v;
+            args = get_arg(args, &v, sizeof(v));
+            fprintf(out, spec_buf, (int)v);
+            break;
+        }
+        case 'p': {
+            void* v;
+            args = get_arg(args, &v, sizeof(v));
+            fprintf(out, spec_buf, v);
+            break;
+        }
+        case 's': {
+            uint32_t len;
+            args = get_arg(args, &len, sizeof(len));
+            char str[LOG_STRING_MAX + 1];
+            if (len == LOG_NULL_STRING) {
+                strcpy(str, "(null)");
+            } else {
+                memcpy(str, args, len);
+                str[len] = '\0';
+                args += ALIGN8(len);
+            }
+            fprintf(out, spec_buf, str);
+            break;
+        }
+        default:
+            if (spec.len == LEN_BIG_L) {
+                long double v;
+                args = get_arg(args, &v, sizeof(v));
+                fprintf(out, spec_buf, v);
+            } else {
+                double v;
+                args = get_arg(args, &v, sizeof(v));
+                fprintf(out, spec_buf, v);
+            }
+            break;
+        }
+    }
+
+    funlockfile(out);
+}
+
+/*
+ * drain_all - 输出所有缓冲区中的日志，释放已经退出且已清空的线程的缓冲区
+ *
+ * 调用者持有 g_drain_lock。返回: 输出的记录数
+ */
+static size_t drain_all(void) {
+    size_t count = 0;
+
+    pthread_mutex_lock(&g_rings_lock);
+    log_ring_t** link = &g_rings;
+    while (*link) {
+        log_ring_t* ring = *link;
+        bool closed = __atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE);
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = ring->tail;
+
+        while (tail != head) {
+            size_t pos = tail & (LOG_RING_SIZE - 1);
+            const log_record_t* rec = (const log_record_t*)&ring->data[pos];
+            if (rec->size == 0) {
+                tail += LOG_RING_SIZE - pos;
+            } else {
+                print_record(rec);
+                tail += rec->size;
+                count++;
+            }
+            __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+        }
+
+        if (closed) {
+            *link = ring->next;
+            free(ring);
+        } else {
+            link = &ring->next;
+        }
+    }
+    pthread_mutex_unlock(&g_rings_lock);
+
+    return count;
+}
+
+static void* drain_main(void* arg) {
+    (void)arg;
+    const struct timespec idle = { 0, 1000000 };    // 没有日志时休眠 1ms
+
+    while (__atomic_load_n(&g_drain_running, __ATOMIC_ACQUIRE)) {
+        pthread_mutex_lock(&g_drain_lock);
+        size_t count = drain_all();
+        pthread_mutex_unlock(&g_drain_lock);
+
+        if (count) {
+            fflush(stdout);
+            fflush(stderr);
+        } else {
+            nanosleep(&idle, NULL);
+        }
+    }
+    return NULL;
+}
+
+// 启用异步模式
+int log_start_async(void) {
+    static bool atexit_registered = false;
+
+    pthread_mutex_lock(&g_state_lock);
+    if (g_async) {
+        pthread_mutex_unlock(&g_state_lock);
+        return 0;
+    }
+
+    __atomic_store_n(&g_drain_running, 1, __ATOMIC_RELEASE);
+    if (pthread_create(&g_drain_thread, NULL, drain_main, NULL) != 0) {
+        g_drain_running = 0;
+        pthread_mutex_unlock(&g_state_lock);
+        return -1;
+    }
+    __atomic_store_n(&g_async, 1, __ATOMIC_RELEASE);
+
+    // 进程正常退出时输出剩余的日志
+    if (!atexit_registered) {
+        atexit(log_stop_async);
+        atexit_registered = true;
+    }
+    pthread_mutex_unlock(&g_state_lock);
+    return 0;
+}
+
+// 等待已写入的日志输出完毕（在调用线程中消费）
+void log_flush(void) {
+    pthread_mutex_lock(&g_drain_lock);
+    drain_all();
+    pthread_mutex_unlock(&g_drain_lock);
+    fflush(stdout);
+    fflush(stderr);
+}
+
+// 停止异步模式
+void log_stop_async(void) {
+    pthread_mutex_lock(&g_state_lock);
+    if (!g_async) {
+        pthread_mutex_unlock(&g_state_lock);
+        return;
+    }
+
+    __atomic_store_n(&g_async, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_drain_running, 0, __ATOMIC_RELEASE);
+    pthread_join(g_drain_thread, NULL);
+    pthread_mutex_unlock(&g_state_lock);
+
+    // 停止前已经写入缓冲区的日志
+    log_flush();
+}
+
+// ============================================================================
+// 日志输出
+// ============================================================================
+
 // 带文件名和行号的日志输出函数
 void log_output_ex(log_level_t level, const char* file, int line, const char* fmt, ...) {
     if (level < g_log_level) {
         return;
     }
 
-    FILE* out = (level >= LOG_LEVEL_WARN) ? stderr : stdout;
-    const char* filename = get_filename(file);
+    ensure_start_time();
+    uint64_t ns = coarse_now_ns();
 
-    // 输出格式: [时间戳] [级别] [文件:行号] 消息
-    fprintf(out, "%s %s%s%s [%s:%d] ",
-            log_get_timestamp(),
-            level_colors[level],
-            level_names[level],
-            color_reset,
-            filename,
-            line);
-
-    // 输出消息
     va_list args;
     va_start(args, fmt);
-    vfprintf(out, fmt, args);
+
+    if (__atomic_load_n(&g_async, __ATOMIC_ACQUIRE)) {
+        // ERROR 可能紧跟着 abort，不能停留在缓冲区中
+        if (level < LOG_LEVEL_ERROR && enqueue(level, file, line, ns, fmt, args) == 0) {
+            va_end(args);
+            return;
+        }
+        // 同步输出之前先清空缓冲区，保持同一线程内的顺序
+        log_flush();
+    }
+
+    write_sync(level, file, line, ns, fmt, args);
     va_end(args);
 }
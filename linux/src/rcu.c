@@ -0,0 +1,164 @@
+/**
+ * =============================================================================
+ * rcu.c - 用户态 RCU
+ * =============================================================================
+ *
+ * mini_dlsym 是高频路径，写者（dlopen/dlclose）却很少出现。
+ * 这里每个读者线程有一个私有计数器，读侧只写自己的缓存行：
+ *
+ *   rcu_read_lock:   ctr++（变为奇数，表示在临界区中）+ 全屏障
+ *   rcu_read_unlock: ctr++（变为偶数）
+ *
+ * 写者的 rcu_synchronize 遍历所有读者：计数器为奇数的读者，
+ * 等到它的计数器发生变化（说明那次临界区已经结束）。
+ * 之后才开始的临界区一定能看到写者在同步之前发布的新数据。
+ *
+ *   读者 A:  ──[lock ····· unlock]──────[lock ··· unlock]──
+ *   写者:        发布 ─► synchronize ═══════╗ ─► 释放旧数据
+ *                          等待 A 的第一次临界区
+ *
+ * 读者记录在线程第一次进入临界区时注册，线程退出时标记为空闲，
+ * 供之后的线程复用，因此注册表只增长到同时存在的最大线程数。
+ *
+ * =============================================================================
+ */
+
+#define _GNU_SOURCE
+#include "rcu.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef struct rcu_reader {
+    unsigned long ctr;              /* 奇数表示在读侧临界区中 */
+    bool in_use;                    /* 是否属于某个存活的线程 */
+    struct rcu_reader* next;
+} __attribute__((aligned(64))) rcu_reader_t;
+
+static rcu_reader_t* g_readers = NULL;
+static pthread_mutex_t g_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t g_reader_key;
+static pthread_once_t g_key_once = PTHREAD_ONCE_INIT;
+
+static __thread rcu_reader_t* t_reader = NULL;
+static __thread unsigned int t_nesting = 0;
+
+/* 推迟释放的内存 */
+static void** g_deferred = NULL;
+static size_t g_deferred_count = 0;
+static size_t g_deferred_capacity = 0;
+static pthread_mutex_t g_deferred_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * reader_release - 线程退出时归还读者记录
+ */
+static void reader_release(void* arg) {
+    rcu_reader_t* r = (rcu_reader_t*)arg;
+    pthread_mutex_lock(&g_registry_lock);
+    r->in_use = false;
+    pthread_mutex_unlock(&g_registry_lock);
+}
+
+static void make_key(void) {
+    pthread_key_create(&g_reader_key, reader_release);
+}
+
+/**
+ * reader_register - 为当前线程分配读者记录
+ *
+ * 内存不足时返回 NULL，调用者无法进入临界区，这里直接终止。
+ */
+static rcu_reader_t* reader_register(void) {
+    pthread_once(&g_key_once, make_key);
+
+    pthread_mutex_lock(&g_registry_lock);
+    rcu_reader_t* r = g_readers;
+    while (r && r->in_use) {
+        r = r->next;
+    }
+    if (!r) {
+        if (posix_memalign((void**)&r, 64, sizeof(rcu_reader_t)) != 0) {
+            pthread_mutex_unlock(&g_registry_lock);
+            abort();
+        }
+        r->ctr = 0;
+        r->next = g_readers;
+        g_readers = r;
+    }
+    r->in_use = true;
+    pthread_mutex_unlock(&g_registry_lock);
+
+    pthread_setspecific(g_reader_key, r);
+    t_reader = r;
+    return r;
+}
+
+void rcu_read_lock(void) {
+    if (t_nesting++ > 0) return;
+
+    rcu_reader_t* r = t_reader ? t_reader : reader_register();
+    __atomic_store_n(&r->ctr, r->ctr + 1, __ATOMIC_RELAXED);
+    /* 让写者先看到 ctr 变为奇数，再读取共享指针 */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void rcu_read_unlock(void) {
+    if (--t_nesting > 0) return;
+
+    rcu_reader_t* r = t_reader;
+    __atomic_store_n(&r->ctr, r->ctr + 1, __ATOMIC_RELEASE);
+}
+
+void rcu_synchronize(void) {
+    /* 之前发布的指针先于下面对计数器的读取 */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    pthread_mutex_lock(&g_registry_lock);
+    for (rcu_reader_t* r = g_readers; r; r = r->next) {
+        unsigned long ctr = __atomic_load_n(&r->ctr, __ATOMIC_ACQUIRE);
+        if (!(ctr & 1)) continue;
+        while (__atomic_load_n(&r->ctr, __ATOMIC_ACQUIRE) == ctr) {
+            sched_yield();
+        }
+    }
+    pthread_mutex_unlock(&g_registry_lock);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void rcu_defer_free(void* ptr) {
+    if (!ptr) return;
+
+    pthread_mutex_lock(&g_deferred_lock);
+    if (g_deferred_count == g_deferred_capacity) {
+        size_t capacity = g_deferred_capacity ? g_deferred_capacity * 2 : 64;
+        void** items = (void**)realloc(g_deferred, capacity * sizeof(void*));
+        if (!items) {
+            /* 宁可泄漏也不能提前释放仍可能被读者访问的内存 */
+            pthread_mutex_unlock(&g_deferred_lock);
+            return;
+        }
+        g_deferred = items;
+        g_deferred_capacity = capacity;
+    }
+    g_deferred[g_deferred_count++] = ptr;
+    pthread_mutex_unlock(&g_deferred_lock);
+}
+
+void rcu_reclaim(void) {
+    pthread_mutex_lock(&g_deferred_lock);
+    void** items = g_deferred;
+    size_t count = g_deferred_count;
+    g_deferred = NULL;
+    g_deferred_count = 0;
+    g_deferred_capacity = 0;
+    pthread_mutex_unlock(&g_deferred_lock);
+
+    rcu_synchronize();
+
+    for (size_t i = 0; i < count; i++) {
+        free(items[i]);
+    }
+    free(items);
+}
@@ -0,0 +1,587 @@
+/**
+ * =============================================================================
+ * reloc_cache.c - 跨进程的符号重定位缓存
+ * =============================================================================
+ *
+ * 同一批库在每个工作进程里的重定位结果几乎完全相同，唯一的差别是
+ * 各个库的加载地址。把符号重定位的结果记成"相对提供者的差值"，
+ * 换一个进程只要用新的加载偏移加回去即可：
+ *
+ *   记录:  *slot = S + A        ──► (provider = libB, delta = S + A - bias(libB))
+ *   写回:  *slot = bias'(libB) + delta
+ *
+ * 缓存文件（每个库一个，<dir>/<dev>-<ino>-<offset>.rcache）：
+ *
+ *   ┌──────────────┬─────────────────┬──────────────┬───────────────────┐
+ *   │ rc_header_t  │ rc_ident_t[]    │ rc_provider_t│ rc_entry_t[]      │
+ *   │ 自身文件身份 │ 搜索范围中的库  │ 系统库身份   │ 每个符号重定位    │
+ *   └──────────────┴─────────────────┴──────────────┴───────────────────┘
+ *
+ * 搜索范围（已加载库链表，按顺序）决定了每个名字解析到哪个库，
+ * 因此必须与记录时完全一致；系统库按文件身份校验后，用 dlinfo 取得
+ * 它在本进程中的加载偏移。
+ *
+ * 缓存写入临时文件后 rename，读者不会看到写了一半的文件。
+ *
+ * RELRO 快照（<dir>/<dev>-<ino>-<offset>.relro）则是重定位后的 RELRO 页本身：
+ *
+ *   ┌────────────────────┬────────────────────────────────────┐
+ *   │ rc_relro_header_t  │ RELRO 页（从第二页开始，按页对齐） │
+ *   │ （填充到一整页）   │                                    │
+ *   └────────────────────┴────────────────────────────────────┘
+ *
+ * 同一地址加载的进程中，与快照相同的页直接 mmap 快照文件（只读、私有），
+ * 这些页不会被写入，始终是页缓存中的同一份物理内存。
+ *
+ * =============================================================================
+ */
+
+#define _GNU_SOURCE
+#include "reloc_cache.h"
+#include "log.h"
+#include <dlfcn.h>
+#include <link.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RC_MAGIC    0x43524c4d      /* "MLRC" */
+#define RC_VERSION  1
+#define RC_ABSOLUTE UINT32_MAX      /* 没有提供者：delta 就是最终值（未定义的弱符号）*/
+#define RC_SYSTEM   UINT32_MAX      /* rc_provider_t.scope_index：系统库 */
+#define RC_PATH_MAX 256
+#define RC_RELRO_MAGIC 0x52524c4d   /* "MLRR" */
+#define RC_PAGE_SIZE 4096
+
+/* 文件身份：内容变化时 mtime/大小必然变化 */
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t offset;
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+} rc_ident_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    rc_ident_t self;
+    uint64_t rela_count;
+    uint64_t plt_rela_count;
+    uint32_t scope_count;
+    uint32_t provider_count;
+    uint64_t entry_count;
+} rc_header_t;
+
+typedef struct {
+    uint32_t scope_index;           /* 在搜索范围中的下标，RC_SYSTEM 表示系统库 */
+    uint32_t reserved;
+    rc_ident_t ident;               /* 系统库的文件身份 */
+    char path[RC_PATH_MAX];         /* 系统库在 link_map 中的名字（主程序为空串）*/
+} rc_provider_t;
+
+typedef struct {
+    uint64_t offset;                /* r_offset */
+    uint32_t provider;              /* 提供者下标，RC_ABSOLUTE 表示没有 */
+    uint32_t type;                  /* 重定位类型（用于校验和统计）*/
+    int64_t delta;                  /* 最终值 - 提供者的加载偏移 */
+} rc_entry_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    rc_ident_t self;
+    uint64_t base;                  /* 写入快照时的加载地址 */
+    uint64_t relro_offset;          /* RELRO 相对 base 的偏移 */
+    uint64_t relro_size;
+} rc_relro_header_t;
+
+/* ============ 辅助函数 ============ */
+
+static void ident_of_soinfo(const soinfo_t* si, rc_ident_t* id) {
+    memset(id, 0, sizeof(*id));
+    id->dev = (uint64_t)si->st_dev;
+    id->ino = (uint64_t)si->st_ino;
+    id->offset = (uint64_t)si->file_offset;
+    id->size = (uint64_t)si->st_size;
+    id->mtime_sec = (int64_t)si->st_mtim.tv_sec;
+    id->mtime_nsec = (int64_t)si->st_mtim.tv_nsec;
+}
+
+/* 系统库的文件身份（主程序的名字为空串）*/
+static int ident_of_path(const char* path, rc_ident_t* id) {
+    struct stat st;
+    if (stat(path[0] ? path : "/proc/self/exe", &st) < 0) return -1;
+
+    memset(id, 0, sizeof(*id));
+    id->dev = (uint64_t)st.st_dev;
+    id->ino = (uint64_t)st.st_ino;
+    id->size = (uint64_t)st.st_size;
+    id->mtime_sec = (int64_t)st.st_mtim.tv_sec;
+    id->mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+    return 0;
+}
+
+static int cache_file(const soinfo_t* si, const char* dir, const char* ext, char* out, size_t size) {
+    int n = snprintf(out, size, "%s/%016llx-%016llx-%llx.%s", dir,
+                     (unsigned long long)si->st_dev, (unsigned long long)si->st_ino,
+                     (unsigned long long)si->file_offset, ext);
+    return (n < 0 || (size_t)n >= size) ? -1 : 0;
+}
+
+static int cache_path(const soinfo_t* si, const char* dir, char* out, size_t size) {
+    return cache_file(si, dir, "rcache", out, size);
+}
+
+static bool is_symbolic(uint32_t type) {
+    return type == ARCH_R_ABS || type == ARCH_R_GLOB_DAT || type == ARCH_R_JUMP_SLOT;
+}
+
+/* 第 i 个重定位条目：先 .rela.dyn，再 .rela.plt */
+static const linker_rel_t* nth_rela(const soinfo_t* si, size_t i) {
+    return i < si->rela_count ? &si->rela[i] : &si->plt_rela[i - si->rela_count];
+}
+
+/**
+ * count_entries - 统计需要缓存的符号重定位个数
+ *
+ * 返回: 个数；库中有缓存无法表达的重定位时返回 -1
+ */
+static long count_entries(const soinfo_t* si) {
+    if (si->android_rela) return -1;
+#if !ARCH_USE_RELA
+    /* REL 的加数在重定位后已被覆盖，无法从结果还原符号地址 */
+    return -1;
+#endif
+
+    long n = 0;
+    size_t total = si->rela_count + si->plt_rela_count;
+    for (size_t i = 0; i < total; i++) {
+        uint32_t type = ELFW_R_TYPE(nth_rela(si, i)->r_info);
+        if (type == ARCH_R_NONE || type == ARCH_R_RELATIVE) continue;
+        if (!is_symbolic(type) || ELFW_R_SYM(nth_rela(si, i)->r_info) == 0) return -1;
+        n++;
+    }
+    return n;
+}
+
+/* 系统库在本进程中的加载偏移（库必须已经加载）*/
+static int system_bias(const char* path, uintptr_t* bias) {
+    void* handle = dlopen(path[0] ? path : NULL, RTLD_NOLOAD | RTLD_LAZY);
+    if (!handle) return -1;
+
+    struct link_map* lm = NULL;
+    int result = dlinfo(handle, RTLD_DI_LINKMAP, &lm) == 0 && lm ? 0 : -1;
+    if (result == 0) {
+        *bias = (uintptr_t)lm->l_addr;
+    }
+    dlclose(handle);
+    return result;
+}
+
+static size_t scope_collect(soinfo_t* scope, soinfo_t*** out) {
+    size_t n = 0;
+    for (soinfo_t* it = scope; it; it = it->next) n++;
+
+    *out = (soinfo_t**)malloc((n ? n : 1) * sizeof(soinfo_t*));
+    if (!*out) return 0;
+
+    size_t i = 0;
+    for (soinfo_t* it = scope; it; it = it->next) (*out)[i++] = it;
+    return n;
+}
+
+/* ============ 读取 ============ */
+
+/* 把整个缓存文件读入内存 */
+static uint8_t* read_file(const char* path, size_t* size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    uint8_t* data = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = (uint8_t*)malloc(st.st_size);
+        if (data && pread(fd, data, st.st_size, 0) != st.st_size) {
+            free(data);
+            data = NULL;
+        }
+        *size = (size_t)st.st_size;
+    }
+    close(fd);
+    return data;
+}
+
+int reloc_cache_apply(soinfo_t* si, soinfo_t* scope, const char* dir, linker_stats_t* stats) {
+    char path[PATH_MAX];
+    if (!dir || cache_path(si, dir, path, sizeof(path)) < 0) return -1;
+    if (count_entries(si) < 0) return -1;
+
+    size_t size = 0;
+    uint8_t* data = read_file(path, &size);
+    if (!data) return -1;
+
+    int result = -1;
+    soinfo_t** items = NULL;
+    uintptr_t* bases = NULL;
+    rc_header_t* hdr = (rc_header_t*)data;
+    rc_ident_t self;
+    ident_of_soinfo(si, &self);
+
+    /* ============ 步骤 1: 校验文件头和自身身份 ============ */
+    if (size < sizeof(*hdr) || hdr->magic != RC_MAGIC || hdr->version != RC_VERSION ||
+        memcmp(&hdr->self, &self, sizeof(self)) != 0 ||
+        hdr->rela_count != si->rela_count || hdr->plt_rela_count != si->plt_rela_count) {
+        goto out;
+    }
+    /* 计数来自文件，逐个和剩余大小比较，乘法不会溢出 */
+    size_t rest = size - sizeof(*hdr);
+    if (hdr->scope_count > rest / sizeof(rc_ident_t)) goto out;
+    rest -= hdr->scope_count * sizeof(rc_ident_t);
+    if (hdr->provider_count > rest / sizeof(rc_provider_t)) goto out;
+    rest -= hdr->provider_count * sizeof(rc_provider_t);
+    if (hdr->entry_count > rest / sizeof(rc_entry_t)) goto out;
+    if (rest != hdr->entry_count * sizeof(rc_entry_t)) goto out;
+
+    const rc_ident_t* scope_ids = (const rc_ident_t*)(hdr + 1);
+    const rc_provider_t* providers = (const rc_provider_t*)(scope_ids + hdr->scope_count);
+    const rc_entry_t* entries = (const rc_entry_t*)(providers + hdr->provider_count);
+
+    /* ============ 步骤 2: 校验搜索范围 ============ */
+    size_t scope_count = scope_collect(scope, &items);
+    if (!items || scope_count != hdr->scope_count) goto out;
+    for (size_t i = 0; i < scope_count; i++) {
+        rc_ident_t id;
+        ident_of_soinfo(items[i], &id);
+        if (memcmp(&id, &scope_ids[i], sizeof(id)) != 0) goto out;
+    }
+
+    /* ============ 步骤 3: 求出每个提供者在本进程中的加载偏移 ============ */
+    bases = (uintptr_t*)malloc((hdr->provider_count ? hdr->provider_count : 1) * sizeof(uintptr_t));
+    if (!bases) goto out;
+    for (uint32_t i = 0; i < hdr->provider_count; i++) {
+        const rc_provider_t* p = &providers[i];
+        if (p->scope_index != RC_SYSTEM) {
+            if (p->scope_index >= scope_count) goto out;
+            bases[i] = (uintptr_t)items[p->scope_index]->load_bias;
+            continue;
+        }
+
+        rc_ident_t id;
+        if (memchr(p->path, '\0', sizeof(p->path)) == NULL ||
+            ident_of_path(p->path, &id) < 0 || memcmp(&id, &p->ident, sizeof(id)) != 0 ||
+            system_bias(p->path, &bases[i]) < 0) {
+            goto out;
+        }
+    }
+
+    /* ============ 步骤 4: 校验条目与重定位表一一对应 ============ */
+    size_t total = si->rela_count + si->plt_rela_count;
+    size_t e = 0;
+    for (size_t i = 0; i < total; i++) {
+        const linker_rel_t* rela = nth_rela(si, i);
+        uint32_t type = ELFW_R_TYPE(rela->r_info);
+        if (type == ARCH_R_NONE || type == ARCH_R_RELATIVE) continue;
+        if (e >= hdr->entry_count || entries[e].offset != rela->r_offset || entries[e].type != type ||
+            (entries[e].provider != RC_ABSOLUTE && entries[e].provider >= hdr->provider_count)) {
+            goto out;
+        }
+        e++;
+    }
+    if (e != hdr->entry_count) goto out;
+
+    /* ============ 步骤 5: 写回 ============ */
+    uint8_t* bias = (uint8_t*)si->load_bias;
+    for (size_t i = 0; i < hdr->entry_count; i++) {
+        const rc_entry_t* ent = &entries[i];
+        uintptr_t base = ent->provider == RC_ABSOLUTE ? 0 : bases[ent->provider];
+        *(ElfW(Addr)*)(bias + ent->offset) = (ElfW(Addr))(base + ent->delta);
+        uint32_t slot = ARCH_RELOC_STAT_INDEX(ent->type);
+        stats->relocs[slot < LINKER_STATS_RELOC_TYPES ? slot : LINKER_STATS_RELOC_TYPES - 1]++;
+    }
+
+    LOG("[linker] Applied %llu cached symbol relocations for %s\n",
+        (unsigned long long)hdr->entry_count, si->name);
+    result = 0;
+
+out:
+    free(bases);
+    free(items);
+    free(data);
+    return result;
+}
+
+/* ============ 写入 ============ */
+
+/* 找到或添加系统库提供者 */
+static int add_system_provider(rc_provider_t** providers, uint32_t* count, const char* name) {
+    for (uint32_t i = 0; i < *count; i++) {
+        if ((*providers)[i].scope_index == RC_SYSTEM && strcmp((*providers)[i].path, name) == 0) {
+            return (int)i;
+        }
+    }
+    if (strlen(name) >= RC_PATH_MAX) return -1;
+
+    rc_provider_t* grown = (rc_provider_t*)realloc(*providers, (*count + 1) * sizeof(rc_provider_t));
+    if (!grown) return -1;
+    *providers = grown;
+
+    rc_provider_t* p = &grown[*count];
+    memset(p, 0, sizeof(*p));
+    p->scope_index = RC_SYSTEM;
+    strcpy(p->path, name);
+    if (ident_of_path(name, &p->ident) < 0) return -1;
+    return (int)(*count)++;
+}
+
+/* 找到或添加搜索范围中的提供者 */
+static int add_scope_provider(rc_provider_t** providers, uint32_t* count, uint32_t scope_index) {
+    for (uint32_t i = 0; i < *count; i++) {
+        if ((*providers)[i].scope_index == scope_index) return (int)i;
+    }
+
+    rc_provider_t* grown = (rc_provider_t*)realloc(*providers, (*count + 1) * sizeof(rc_provider_t));
+    if (!grown) return -1;
+    *providers = grown;
+
+    memset(&grown[*count], 0, sizeof(rc_provider_t));
+    grown[*count].scope_index = scope_index;
+    return (int)(*count)++;
+}
+
+static int write_all(int fd, const void* buf, size_t size) {
+    const uint8_t* p = (const uint8_t*)buf;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n <= 0) return -1;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+int reloc_cache_store(soinfo_t* si, soinfo_t* scope, const char* dir) {
+    char path[PATH_MAX];
+    char tmp[PATH_MAX + 32];
+    if (!dir || cache_path(si, dir, path, sizeof(path)) < 0) return -1;
+
+    long count = count_entries(si);
+    if (count < 0) return -1;
+
+    int result = -1;
+    soinfo_t** items = NULL;
+    rc_provider_t* providers = NULL;
+    uint32_t provider_count = 0;
+    rc_ident_t* scope_ids = NULL;
+    rc_entry_t* entries = (rc_entry_t*)malloc((count ? count : 1) * sizeof(rc_entry_t));
+    size_t scope_count = scope_collect(scope, &items);
+    if (!entries || !items) goto out;
+
+    scope_ids = (rc_ident_t*)malloc((scope_count ? scope_count : 1) * sizeof(rc_ident_t));
+    if (!scope_ids) goto out;
+    for (size_t i = 0; i < scope_count; i++) {
+        ident_of_soinfo(items[i], &scope_ids[i]);
+    }
+
+    /* ============ 步骤 1: 把每个符号重定位的结果归到提供者 ============ */
+    uint8_t* bias = (uint8_t*)si->load_bias;
+    size_t total = si->rela_count + si->plt_rela_count;
+    size_t e = 0;
+    for (size_t i = 0; i < total; i++) {
+        const linker_rel_t* rela = nth_rela(si, i);
+        uint32_t type = ELFW_R_TYPE(rela->r_info);
+        if (type == ARCH_R_NONE || type == ARCH_R_RELATIVE) continue;
+
+        ElfW(Addr) value = *(ElfW(Addr)*)(bias + rela->r_offset);
+        /* 按符号地址（而不是 S + A）归类，加数可能指到提供者之外 */
+#if ARCH_USE_RELA
+        uintptr_t sym = (uintptr_t)(type == ARCH_R_ABS || ARCH_GOT_USES_ADDEND ? value - rela->r_addend : value);
+#else
+        uintptr_t sym = (uintptr_t)value;   /* 不会到达：count_entries 拒绝了 REL */
+#endif
+        rc_entry_t* ent = &entries[e++];
+        ent->offset = rela->r_offset;
+        ent->type = type;
+        ent->provider = RC_ABSOLUTE;
+        ent->delta = (int64_t)value;
+        if (sym == 0) continue;
+
+        int provider = -1;
+        uintptr_t base = 0;
+        for (size_t k = 0; k < scope_count; k++) {
+            uintptr_t start = (uintptr_t)items[k]->base;
+            if (sym >= start && sym < start + items[k]->size) {
+                provider = add_scope_provider(&providers, &provider_count, (uint32_t)k);
+                base = (uintptr_t)items[k]->load_bias;
+                break;
+            }
+        }
+
+        if (provider < 0) {
+            Dl_info info;
+            struct link_map* lm = NULL;
+            if (!dladdr1((void*)sym, &info, (void**)&lm, RTLD_DL_LINKMAP) || !lm) goto out;
+            provider = add_system_provider(&providers, &provider_count, lm->l_name);
+            base = (uintptr_t)lm->l_addr;
+        }
+        if (provider < 0) goto out;
+
+        ent->provider = (uint32_t)provider;
+        ent->delta = (int64_t)(value - base);
+    }
+
+    /* ============ 步骤 2: 写入临时文件后原子替换 ============ */
+    rc_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = RC_MAGIC;
+    hdr.version = RC_VERSION;
+    ident_of_soinfo(si, &hdr.self);
+    hdr.rela_count = si->rela_count;
+    hdr.plt_rela_count = si->plt_rela_count;
+    hdr.scope_count = (uint32_t)scope_count;
+    hdr.provider_count = provider_count;
+    hdr.entry_count = (uint64_t)count;
+
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) goto out;
+
+    int written = write_all(fd, &hdr, sizeof(hdr)) == 0 &&
+                  write_all(fd, scope_ids, scope_count * sizeof(rc_ident_t)) == 0 &&
+                  write_all(fd, providers, provider_count * sizeof(rc_provider_t)) == 0 &&
+                  write_all(fd, entries, (size_t)count * sizeof(rc_entry_t)) == 0;
+    close(fd);
+    if (!written || rename(tmp, path) < 0) {
+        unlink(tmp);
+        goto out;
+    }
+
+    LOG("[linker] Stored %ld symbol relocations for %s in %s\n", count, si->name, path);
+    result = 0;
+
+out:
+    free(entries);
+    free(scope_ids);
+    free(providers);
+    free(items);
+    return result;
+}
+
+/* ============ RELRO 快照 ============ */
+
+static int relro_read_header(int fd, const soinfo_t* si, rc_relro_header_t* hdr) {
+    rc_ident_t self;
+    ident_of_soinfo(si, &self);
+    if (pread(fd, hdr, sizeof(*hdr), 0) != (ssize_t)sizeof(*hdr)) return -1;
+    if (hdr->magic != RC_RELRO_MAGIC || hdr->version != RC_VERSION) return -1;
+    return memcmp(&hdr->self, &self, sizeof(self)) == 0 ? 0 : -1;
+}
+
+void* reloc_cache_relro_base(const soinfo_t* si, const char* dir) {
+    char path[PATH_MAX];
+    if (cache_file(si, dir, "relro", path, sizeof(path)) < 0) return NULL;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    rc_relro_header_t hdr;
+    void* base = relro_read_header(fd, si, &hdr) == 0 ? (void*)(uintptr_t)hdr.base : NULL;
+    close(fd);
+    return base;
+}
+
+/* 写入快照：一页文件头，之后是 RELRO 页 */
+static void relro_write(const soinfo_t* si, const char* path) {
+    char tmp[PATH_MAX + 32];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+
+    uint8_t page[RC_PAGE_SIZE];
+    memset(page, 0, sizeof(page));
+    rc_relro_header_t* hdr = (rc_relro_header_t*)page;
+    hdr->magic = RC_RELRO_MAGIC;
+    hdr->version = RC_VERSION;
+    ident_of_soinfo(si, &hdr->self);
+    hdr->base = (uint64_t)(uintptr_t)si->base;
+    hdr->relro_offset = (uint64_t)((uint8_t*)si->relro_start - (uint8_t*)si->base);
+    hdr->relro_size = si->relro_size;
+
+    int written = write_all(fd, page, sizeof(page)) == 0 &&
+                  write_all(fd, si->relro_start, si->relro_size) == 0;
+    close(fd);
+    if (!written || rename(tmp, path) < 0) {
+        unlink(tmp);
+        return;
+    }
+    LOG("[linker] Stored RELRO snapshot for %s (0x%zx bytes at %p)\n",
+        si->name, si->relro_size, si->base);
+}
+
+uint64_t reloc_cache_share_relro(soinfo_t* si, const char* dir) {
+    char path[PATH_MAX];
+    if (!si->relro_start || cache_file(si, dir, "relro", path, sizeof(path)) < 0) return 0;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    rc_relro_header_t hdr;
+    if (fd < 0 || relro_read_header(fd, si, &hdr) < 0) {
+        /* 没有快照，或者库文件已经变化：（重新）写入 */
+        if (fd >= 0) close(fd);
+        relro_write(si, path);
+        return 0;
+    }
+
+    /* 加载地址不同时内容必然不同；保留原来的快照，不与其他进程来回覆盖 */
+    struct stat st;
+    uint64_t offset = (uint64_t)((uint8_t*)si->relro_start - (uint8_t*)si->base);
+    if (hdr.base != (uint64_t)(uintptr_t)si->base || hdr.relro_offset != offset ||
+        hdr.relro_size != si->relro_size || fstat(fd, &st) < 0 ||
+        (uint64_t)st.st_size < RC_PAGE_SIZE + si->relro_size) {
+        close(fd);
+        return 0;
+    }
+
+    uint8_t* snap = (uint8_t*)mmap(NULL, si->relro_size, PROT_READ, MAP_PRIVATE, fd, RC_PAGE_SIZE);
+    if (snap == MAP_FAILED) {
+        close(fd);
+        return 0;
+    }
+
+    /* 逐页比较，连续相同的页一次替换 */
+    uint8_t* relro = (uint8_t*)si->relro_start;
+    uint64_t shared = 0;
+    size_t page = 0;
+    size_t pages = si->relro_size / RC_PAGE_SIZE;
+    while (page < pages) {
+        if (memcmp(relro + page * RC_PAGE_SIZE, snap + page * RC_PAGE_SIZE, RC_PAGE_SIZE) != 0) {
+            page++;
+            continue;
+        }
+        size_t run = page + 1;
+        while (run < pages &&
+               memcmp(relro + run * RC_PAGE_SIZE, snap + run * RC_PAGE_SIZE, RC_PAGE_SIZE) == 0) {
+            run++;
+        }
+
+        size_t len = (run - page) * RC_PAGE_SIZE;
+        void* addr = mmap(relro + page * RC_PAGE_SIZE, len, PROT_READ, MAP_PRIVATE | MAP_FIXED,
+                          fd, RC_PAGE_SIZE + page * RC_PAGE_SIZE);
+        if (addr != MAP_FAILED) {
+            shared += len;
+        }
+        page = run;
+    }
+
+    munmap(snap, si->relro_size);
+    close(fd);
+    LOG("[linker] Shared %llu of %zu RELRO bytes for %s\n",
+        (unsigned long long)shared, si->relro_size, si->name);
+    return shared;
+}
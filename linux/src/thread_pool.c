@@ -0,0 +1,183 @@
+/**
+ * =============================================================================
+ * thread_pool.c - 固定大小线程池
+ * =============================================================================
+ *
+ * 链接器的并行加载只需要最简单的调度模型：
+ *   - 提交一批互不依赖的任务
+ *   - 等待这批任务全部完成
+ *
+ * 因此这里只有一个加锁的 FIFO 队列，没有任务窃取和优先级。
+ * 等待的线程不会空闲：它和工作线程一起从队列中取任务执行，
+ * 所以 threads = N 时只会创建 N - 1 个工作线程。
+ *
+ * =============================================================================
+ */
+
+#define _GNU_SOURCE
+#include "thread_pool.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct {
+    thread_pool_fn fn;
+    void* arg;
+} task_t;
+
+struct thread_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t  work_cond;      /* 有新任务或需要退出 */
+    pthread_cond_t  done_cond;      /* 所有任务完成 */
+
+    task_t* tasks;                  /* 环形队列 */
+    size_t  capacity;
+    size_t  head;
+    size_t  count;
+
+    size_t  running;                /* 正在执行的任务数 */
+    bool    shutdown;
+
+    pthread_t* workers;
+    int        worker_count;
+};
+
+/**
+ * pop_task - 从队列头部取出一个任务（调用者持有锁）
+ */
+static bool pop_task(thread_pool_t* pool, task_t* task) {
+    if (pool->count == 0) return false;
+    *task = pool->tasks[pool->head];
+    pool->head = (pool->head + 1) % pool->capacity;
+    pool->count--;
+    pool->running++;
+    return true;
+}
+
+/**
+ * run_task - 在锁外执行任务，完成后更新计数（调用者持有锁）
+ */
+static void run_task(thread_pool_t* pool, task_t* task) {
+    pthread_mutex_unlock(&pool->lock);
+    task->fn(task->arg);
+    pthread_mutex_lock(&pool->lock);
+
+    pool->running--;
+    if (pool->count == 0 && pool->running == 0) {
+        pthread_cond_broadcast(&pool->done_cond);
+    }
+}
+
+static void* worker_main(void* arg) {
+    thread_pool_t* pool = (thread_pool_t*)arg;
+    task_t task;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->count == 0 && !pool->shutdown) {
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        }
+        if (pool->count == 0 && pool->shutdown) break;
+
+        pop_task(pool, &task);
+        run_task(pool, &task);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+int thread_pool_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+thread_pool_t* thread_pool_create(int threads) {
+    if (threads < 1) threads = 1;
+
+    thread_pool_t* pool = (thread_pool_t*)calloc(1, sizeof(thread_pool_t));
+    if (!pool) return NULL;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    pool->workers = (pthread_t*)calloc((size_t)threads, sizeof(pthread_t));
+    if (!pool->workers) {
+        thread_pool_destroy(pool);
+        return NULL;
+    }
+
+    /* 调用 thread_pool_wait 的线程也会执行任务 */
+    for (int i = 0; i < threads - 1; i++) {
+        if (pthread_create(&pool->workers[i], NULL, worker_main, pool) != 0) {
+            break;
+        }
+        pool->worker_count++;
+    }
+
+    return pool;
+}
+
+int thread_pool_submit(thread_pool_t* pool, thread_pool_fn fn, void* arg) {
+    pthread_mutex_lock(&pool->lock);
+
+    if (pool->count == pool->capacity) {
+        size_t capacity = pool->capacity ? pool->capacity * 2 : 64;
+        task_t* tasks = (task_t*)malloc(capacity * sizeof(task_t));
+        if (!tasks) {
+            pthread_mutex_unlock(&pool->lock);
+            return -1;
+        }
+        /* 展开环形队列 */
+        for (size_t i = 0; i < pool->count; i++) {
+            tasks[i] = pool->tasks[(pool->head + i) % pool->capacity];
+        }
+        free(pool->tasks);
+        pool->tasks = tasks;
+        pool->capacity = capacity;
+        pool->head = 0;
+    }
+
+    pool->tasks[(pool->head + pool->count) % pool->capacity] = (task_t){fn, arg};
+    pool->count++;
+
+    pthread_cond_signal(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void thread_pool_wait(thread_pool_t* pool) {
+    task_t task;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pop_task(pool, &task)) {
+        run_task(pool, &task);
+    }
+    while (pool->count != 0 || pool->running != 0) {
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_destroy(thread_pool_t* pool) {
+    if (!pool) return;
+
+    thread_pool_wait(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->worker_count; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool->tasks);
+    free(pool);
+}
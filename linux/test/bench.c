@@ -0,0 +1,536 @@
+/**
+ * bench.c - Mini Linker 性能基准
+ *
+ * 生成合成库并测量：
+ *   - dlopen / dlclose 延迟（mini_dlopen 与系统 dlopen 对比）
+ *   - dlsym 吞吐（命中 / 未命中；平铺符号表、GNU hash、SysV hash、线性搜索）
+ *     GNU hash 库上平铺符号表的未命中比 hash 表慢时，基准以失败退出
+ *
+ * 每组参数 (符号数 S, 重定位数 R, 依赖深度 D) 生成一组库：
+ *
+ *   root_gnu.so / root_sysv.so / root_linear.so   S 个导出符号 sym_i，
+ *        │                                        R 个指向 ext_i 的指针（符号重定位）
+ *        └─► dep1.so ─► dep2.so ─► ... ─► depD.so    最深的一层定义 ext_0 .. ext_{R-1}
+ *
+ * root_linear.so 是 root_sysv.so 去掉 DT_HASH 后的副本，只有 mini linker
+ * 能加载（走线性搜索）。D 为 0 时 ext_i 定义在根库自己中。
+ *
+ * 结果以 JSON Lines 输出，每个测量一行，便于逐个提交比较、设置回归阈值。
+ *
+ * 用法: mini_bench [-s 1000,10000] [-r 1000] [-d 1,4] [-n 次数] [-t 毫秒]
+ *                  [-o 输出文件] [-l 标签] [-k]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+#include <limits.h>
+#include <dlfcn.h>
+#include <elf.h>
+#include "mini_dlfcn.h"
+#include "linker.h"
+#include "log.h"
+
+#define MAX_PARAMS 16
+#define NAME_COUNT 4096         // 每次测量轮流查找的名字个数（2 的幂）
+#define NAME_LEN 32
+#define LOOKUP_BATCH 64         // 每查找这么多次读一次时钟
+#define FLAT_MISS_TOLERANCE 1.2 // 平铺表未命中相对 GNU hash 未命中允许的误差
+
+// 命令行参数
+typedef struct {
+    size_t symbols[MAX_PARAMS];
+    size_t symbol_count;
+    size_t relocs[MAX_PARAMS];
+    size_t reloc_count;
+    size_t depths[MAX_PARAMS];
+    size_t depth_count;
+    size_t runs;                // dlopen/dlclose 的重复次数
+    uint64_t budget_ns;         // 每项 dlsym 测量的时长
+    const char* label;          // 写入每条记录（例如提交号）
+    bool keep;                  // 保留生成的库
+} bench_opts_t;
+
+// 一组库的参数
+typedef struct {
+    size_t symbols;
+    size_t relocs;
+    size_t depth;
+} bench_config_t;
+
+static FILE* g_out;
+static const char* g_label = "";
+static char g_names_hit[NAME_COUNT][NAME_LEN];
+static char g_names_miss[NAME_COUNT][NAME_LEN];
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* =============================================================================
+ * 生成合成库
+ * =============================================================================
+ */
+
+static int run_cmd(const char* cmd) {
+    int ret = system(cmd);
+    if (ret != 0) {
+        LOG_ERROR("Command failed (%d): %s\n", ret, cmd);
+        return -1;
+    }
+    return 0;
+}
+
+// 在 dir 下拼接文件名（超出缓冲区时截断，生成的目录名很短，不会发生）
+static void make_path(char* out, const char* dir, const char* fmt, ...) {
+    int n = snprintf(out, PATH_MAX, "%s/", dir);
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(out + n, n < PATH_MAX ? PATH_MAX - n : 0, fmt, ap);
+    va_end(ap);
+}
+
+static const char* compiler(void) {
+    const char* cc = getenv("CC");
+    return cc && *cc ? cc : "cc";
+}
+
+/**
+ * write_dep - 生成第 level 层依赖的源码并编译
+ * @dir: 输出目录
+ * @cfg: 参数
+ * @level: 层数（1..depth，depth 层是叶子）
+ */
+static int write_dep(const char* dir, const bench_config_t* cfg, size_t level) {
+    char path[PATH_MAX];
+    make_path(path, dir, "dep%zu.c", level);
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        LOG_ERROR("Cannot create %s\n", path);
+        return -1;
+    }
+    fprintf(f, "int dep%zu_marker = %zu;\n", level, level);
+    if (level == cfg->depth) {
+        for (size_t i = 0; i < cfg->relocs; i++) {
+            fprintf(f, "int ext_%zu = %zu;\n", i, i);
+        }
+    }
+    fclose(f);
+
+    char cmd[PATH_MAX * 3];
+    int n = snprintf(cmd, sizeof(cmd), "%s -shared -fPIC -o %s/dep%zu.so %s",
+                     compiler(), dir, level, path);
+    if (level < cfg->depth) {
+        snprintf(cmd + n, sizeof(cmd) - n, " -L%s -Wl,--no-as-needed -l:dep%zu.so -Wl,-rpath,'$ORIGIN'", dir, level + 1);
+    }
+    return run_cmd(cmd);
+}
+
+/**
+ * write_root - 生成根库的源码并按指定的 hash 风格编译
+ */
+static int write_root(const char* dir, const bench_config_t* cfg) {
+    char path[PATH_MAX];
+    make_path(path, dir, "root.c");
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        LOG_ERROR("Cannot create %s\n", path);
+        return -1;
+    }
+    for (size_t i = 0; i < cfg->symbols; i++) {
+        fprintf(f, "int sym_%zu = %zu;\n", i, i);
+    }
+    for (size_t i = 0; i < cfg->relocs; i++) {
+        // 没有依赖时定义在根库自己中（仍然是可被抢占的符号重定位）
+        fprintf(f, cfg->depth ? "extern int ext_%zu;\n" : "int ext_%zu = 0;\n", i);
+    }
+    if (cfg->relocs) {
+        fprintf(f, "int* refs[] = {\n");
+        for (size_t i = 0; i < cfg->relocs; i++) {
+            fprintf(f, "    &ext_%zu,\n", i);
+        }
+        fprintf(f, "};\n");
+    }
+    fclose(f);
+
+    static const char* const styles[] = { "gnu", "sysv" };
+    for (size_t i = 0; i < 2; i++) {
+        char cmd[PATH_MAX * 3];
+        int n = snprintf(cmd, sizeof(cmd), "%s -shared -fPIC -Wl,--hash-style=%s -o %s/root_%s.so %s",
+                         compiler(), styles[i], dir, styles[i], path);
+        if (cfg->depth) {
+            snprintf(cmd + n, sizeof(cmd) - n, " -L%s -Wl,--no-as-needed -l:dep1.so -Wl,-rpath,'$ORIGIN'", dir);
+        }
+        if (run_cmd(cmd) < 0) return -1;
+    }
+    return 0;
+}
+
+/**
+ * write_linear - 复制 root_sysv.so 并把 DT_HASH 改为 DT_DEBUG
+ *
+ * 没有任何 hash 表的库系统 ld.so 拒绝加载，mini linker 则退回到线性搜索。
+ */
+static int write_linear(const char* dir) {
+    char src[PATH_MAX], dst[PATH_MAX];
+    make_path(src, dir, "root_sysv.so");
+    make_path(dst, dir, "root_linear.so");
+
+    FILE* f = fopen(src, "rb");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* buf = (uint8_t*)malloc(size);
+    if (!buf || fread(buf, 1, size, f) != (size_t)size) {
+        fclose(f);
+        free(buf);
+        return -1;
+    }
+    fclose(f);
+
+    int patched = 0;
+    ElfW(Ehdr)* ehdr = (ElfW(Ehdr)*)buf;
+    ElfW(Phdr)* phdr = (ElfW(Phdr)*)(buf + ehdr->e_phoff);
+    for (size_t i = 0; i < ehdr->e_phnum; i++) {
+        if (phdr[i].p_type != PT_DYNAMIC) continue;
+        ElfW(Dyn)* dyn = (ElfW(Dyn)*)(buf + phdr[i].p_offset);
+        for (; dyn->d_tag != DT_NULL; dyn++) {
+            if (dyn->d_tag == DT_HASH || dyn->d_tag == DT_GNU_HASH) {
+                dyn->d_tag = DT_DEBUG;
+                dyn->d_un.d_val = 0;
+                patched++;
+            }
+        }
+    }
+
+    f = fopen(dst, "wb");
+    int ok = f && patched && fwrite(buf, 1, size, f) == (size_t)size;
+    if (f) fclose(f);
+    free(buf);
+    if (!ok) {
+        LOG_ERROR("Cannot create %s\n", dst);
+        return -1;
+    }
+    return 0;
+}
+
+static int generate(const char* dir, const bench_config_t* cfg) {
+    char cmd[PATH_MAX + 16];
+    snprintf(cmd, sizeof(cmd), "mkdir -p %s", dir);
+    if (run_cmd(cmd) < 0) return -1;
+
+    // 从叶子开始编译，上一层链接下一层
+    for (size_t level = cfg->depth; level >= 1; level--) {
+        if (write_dep(dir, cfg, level) < 0) return -1;
+    }
+    if (write_root(dir, cfg) < 0) return -1;
+    return write_linear(dir);
+}
+
+/* =============================================================================
+ * 测量
+ * =============================================================================
+ */
+
+static void print_config(const bench_config_t* cfg, const char* bench, const char* impl, const char* hash) {
+    fprintf(g_out, "{\"label\":\"%s\",\"bench\":\"%s\",\"impl\":\"%s\",\"hash\":\"%s\","
+            "\"symbols\":%zu,\"relocs\":%zu,\"depth\":%zu,",
+            g_label, bench, impl, hash, cfg->symbols, cfg->relocs, cfg->depth);
+}
+
+static void print_samples(const bench_config_t* cfg, const char* bench, const char* impl,
+                          const char* hash, uint64_t* samples, size_t runs) {
+    qsort(samples, runs, sizeof(uint64_t), cmp_u64);
+    uint64_t total = 0;
+    for (size_t i = 0; i < runs; i++) total += samples[i];
+
+    print_config(cfg, bench, impl, hash);
+    fprintf(g_out, "\"runs\":%zu,\"min_ns\":%llu,\"median_ns\":%llu,\"mean_ns\":%llu}\n",
+            runs, (unsigned long long)samples[0], (unsigned long long)samples[runs / 2],
+            (unsigned long long)(total / runs));
+}
+
+/**
+ * bench_open_close - 测量 dlopen 和 dlclose 的延迟
+ * @system: 使用系统 dlopen
+ *
+ * 先做一次不计时的加载，文件进入页缓存，之后每次都是完整的加载和卸载。
+ */
+static int bench_open_close(const bench_config_t* cfg, const char* path, const char* hash,
+                            bool system, size_t runs) {
+    uint64_t* open_ns = (uint64_t*)calloc(runs, sizeof(uint64_t));
+    uint64_t* close_ns = (uint64_t*)calloc(runs, sizeof(uint64_t));
+    if (!open_ns || !close_ns) {
+        free(open_ns);
+        free(close_ns);
+        return -1;
+    }
+
+    int ret = 0;
+    for (size_t i = 0; i <= runs; i++) {
+        uint64_t t0 = now_ns();
+        void* handle = system ? dlopen(path, RTLD_NOW | RTLD_LOCAL) : mini_dlopen(path, MINI_RTLD_NOW);
+        uint64_t t1 = now_ns();
+        if (!handle) {
+            LOG_ERROR("Failed to load %s: %s\n", path, system ? dlerror() : mini_dlerror());
+            ret = -1;
+            break;
+        }
+        if (system) {
+            dlclose(handle);
+        } else {
+            mini_dlclose(handle);
+        }
+        uint64_t t2 = now_ns();
+        if (i > 0) {
+            open_ns[i - 1] = t1 - t0;
+            close_ns[i - 1] = t2 - t1;
+        }
+    }
+
+    if (ret == 0) {
+        const char* impl = system ? "system" : "mini";
+        print_samples(cfg, "dlopen", impl, hash, open_ns, runs);
+        print_samples(cfg, "dlclose", impl, hash, close_ns, runs);
+    }
+    free(open_ns);
+    free(close_ns);
+    return ret;
+}
+
+typedef void* (*lookup_fn)(void* handle, const char* name);
+
+static void* lookup_mini(void* handle, const char* name) {
+    return mini_dlsym(handle, name);
+}
+
+// 只查平铺符号表（第一次调用时构建），不含 mini_dlsym 记录错误信息的开销
+static void* lookup_flat(void* handle, const char* name) {
+    symbol_name_t sn;
+    symbol_name_init(&sn, name);
+    return linker_find_symbol_indexed((soinfo_t*)handle, &sn);
+}
+
+// 直接走 hash 表（或线性搜索），不使用平铺符号表
+static void* lookup_hash(void* handle, const char* name) {
+    return linker_find_symbol((soinfo_t*)handle, name);
+}
+
+static void* lookup_system(void* handle, const char* name) {
+    return dlsym(handle, name);
+}
+
+/**
+ * bench_lookup - 在时间预算内反复查找，输出每次查找的平均耗时
+ * @method: 查找方式（flat / gnu / sysv / linear / dlsym / system）
+ * @ns_per_op: 输出命中、未命中各自的平均耗时（可以为 NULL）
+ */
+static void bench_lookup(const bench_config_t* cfg, const char* impl, const char* hash,
+                         const char* method, lookup_fn fn, void* handle, uint64_t budget_ns,
+                         double ns_per_op[2]) {
+    static const char* const kinds[] = { "hit", "miss" };
+    for (size_t k = 0; k < 2; k++) {
+        char (*names)[NAME_LEN] = k == 0 ? g_names_hit : g_names_miss;
+        uintptr_t sink = 0;
+        uint64_t ops = 0;
+        uint64_t start = now_ns(), elapsed;
+        do {
+            for (size_t i = 0; i < LOOKUP_BATCH; i++) {
+                sink ^= (uintptr_t)fn(handle, names[(ops + i) & (NAME_COUNT - 1)]);
+            }
+            ops += LOOKUP_BATCH;
+            elapsed = now_ns() - start;
+        } while (elapsed < budget_ns);
+        __asm__ volatile("" : : "r"(sink));
+
+        print_config(cfg, "dlsym", impl, hash);
+        fprintf(g_out, "\"method\":\"%s\",\"lookup\":\"%s\",\"ops\":%llu,\"ns_per_op\":%.1f}\n",
+                method, kinds[k], (unsigned long long)ops, (double)elapsed / (double)ops);
+        if (ns_per_op) ns_per_op[k] = (double)elapsed / (double)ops;
+    }
+}
+
+static void init_names(size_t symbols) {
+    uint32_t x = 12345;
+    for (size_t i = 0; i < NAME_COUNT; i++) {
+        x = x * 1103515245u + 12345u;       // 打乱顺序，避免只访问相邻的符号
+        snprintf(g_names_hit[i], NAME_LEN, "sym_%zu", (size_t)(x >> 8) % symbols);
+        snprintf(g_names_miss[i], NAME_LEN, "nosym_%zu", i);
+    }
+}
+
+/**
+ * bench_config - 测量一组库
+ */
+static int bench_config(const char* dir, const bench_config_t* cfg, const bench_opts_t* opts) {
+    static const char* const hashes[] = { "gnu", "sysv", "linear" };
+    init_names(cfg->symbols);
+
+    for (size_t h = 0; h < 3; h++) {
+        char path[PATH_MAX];
+        make_path(path, dir, "root_%s.so", hashes[h]);
+        bool has_system = h < 2;
+
+        if (bench_open_close(cfg, path, hashes[h], false, opts->runs) < 0) return -1;
+        if (has_system && bench_open_close(cfg, path, hashes[h], true, opts->runs) < 0) return -1;
+
+        void* handle = mini_dlopen(path, MINI_RTLD_NOW);
+        if (!handle || !lookup_hash(handle, g_names_hit[0])) {
+            LOG_ERROR("Lookup check failed for %s\n", path);
+            if (handle) mini_dlclose(handle);
+            return -1;
+        }
+        // hash 表必须先测：第一次按句柄查找时会构建平铺符号表
+        // dlsym 是完整的 mini_dlsym（平铺符号表 + 未命中时格式化错误信息）
+        double hash_ns[2], flat_ns[2];
+        bench_lookup(cfg, "mini", hashes[h], hashes[h], lookup_hash, handle, opts->budget_ns, hash_ns);
+        bench_lookup(cfg, "mini", hashes[h], "flat", lookup_flat, handle, opts->budget_ns, flat_ns);
+        bench_lookup(cfg, "mini", hashes[h], "dlsym", lookup_mini, handle, opts->budget_ns, NULL);
+        mini_dlclose(handle);
+
+        // 平铺符号表取代了 hash 表：未命中不能比 GNU hash 的 bloom filter 慢（留出测量误差）
+        if (h == 0 && flat_ns[1] > hash_ns[1] * FLAT_MISS_TOLERANCE + 2.0) {
+            LOG_ERROR("flat miss %.1f ns/op is slower than gnu miss %.1f ns/op (symbols=%zu)\n",
+                      flat_ns[1], hash_ns[1], cfg->symbols);
+            return -1;
+        }
+
+        if (has_system) {
+            void* sys = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+            if (!sys) {
+                LOG_ERROR("Failed to load %s: %s\n", path, dlerror());
+                return -1;
+            }
+            bench_lookup(cfg, "system", hashes[h], hashes[h], lookup_system, sys, opts->budget_ns, NULL);
+            dlclose(sys);
+        }
+    }
+    return 0;
+}
+
+/* =============================================================================
+ * 命令行
+ * =============================================================================
+ */
+
+static size_t parse_list(const char* arg, size_t* out) {
+    size_t n = 0;
+    char* end;
+    while (*arg && n < MAX_PARAMS) {
+        out[n++] = strtoul(arg, &end, 10);
+        arg = *end == ',' ? end + 1 : end;
+        if (end == arg && *arg) break;
+    }
+    return n;
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [options]\n", prog);
+    fprintf(stderr, "  -s LIST   symbol counts (default 1000,10000,100000)\n");
+    fprintf(stderr, "  -r LIST   relocation counts (default 1000)\n");
+    fprintf(stderr, "  -d LIST   DT_NEEDED depths (default 1,4)\n");
+    fprintf(stderr, "  -n RUNS   dlopen/dlclose repetitions (default 20)\n");
+    fprintf(stderr, "  -t MS     time budget per dlsym measurement (default 50)\n");
+    fprintf(stderr, "  -o FILE   write JSON Lines to FILE (default stdout)\n");
+    fprintf(stderr, "  -l LABEL  label added to every record (e.g. commit id)\n");
+    fprintf(stderr, "  -k        keep generated libraries\n");
+}
+
+int main(int argc, char* argv[]) {
+    bench_opts_t opts = {
+        .symbols = { 1000, 10000, 100000 }, .symbol_count = 3,
+        .relocs = { 1000 }, .reloc_count = 1,
+        .depths = { 1, 4 }, .depth_count = 2,
+        .runs = 20,
+        .budget_ns = 50 * 1000000ULL,
+        .label = "",
+    };
+    const char* out_path = NULL;
+
+    int c;
+    while ((c = getopt(argc, argv, "s:r:d:n:t:o:l:kh")) != -1) {
+        switch (c) {
+        case 's': opts.symbol_count = parse_list(optarg, opts.symbols); break;
+        case 'r': opts.reloc_count = parse_list(optarg, opts.relocs); break;
+        case 'd': opts.depth_count = parse_list(optarg, opts.depths); break;
+        case 'n': opts.runs = strtoul(optarg, NULL, 10); break;
+        case 't': opts.budget_ns = strtoull(optarg, NULL, 10) * 1000000ULL; break;
+        case 'o': out_path = optarg; break;
+        case 'l': opts.label = optarg; break;
+        case 'k': opts.keep = true; break;
+        default:
+            print_usage(argv[0]);
+            return c == 'h' ? 0 : 1;
+        }
+    }
+    if (!opts.symbol_count || !opts.reloc_count || !opts.depth_count || !opts.runs) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    for (size_t i = 0; i < opts.symbol_count; i++) {
+        if (opts.symbols[i] == 0) {
+            fprintf(stderr, "Symbol counts must be positive\n");
+            return 1;
+        }
+    }
+
+    // 链接器的 INFO 日志会淹没结果，只保留警告和错误（输出到 stderr）
+    log_init();
+    log_set_level(LOG_LEVEL_WARN);
+    linker_init();
+
+    g_out = out_path ? fopen(out_path, "w") : stdout;
+    if (!g_out) {
+        LOG_ERROR("Cannot open %s\n", out_path);
+        return 1;
+    }
+    g_label = opts.label;
+
+    char workdir[] = "/tmp/mini_bench.XXXXXX";
+    if (!mkdtemp(workdir)) {
+        LOG_ERROR("mkdtemp failed\n");
+        return 1;
+    }
+
+    int ret = 0;
+    for (size_t s = 0; s < opts.symbol_count && ret == 0; s++) {
+        for (size_t r = 0; r < opts.reloc_count && ret == 0; r++) {
+            for (size_t d = 0; d < opts.depth_count && ret == 0; d++) {
+                bench_config_t cfg = { opts.symbols[s], opts.relocs[r], opts.depths[d] };
+                char dir[PATH_MAX];
+                snprintf(dir, sizeof(dir), "%s/s%zu_r%zu_d%zu", workdir, cfg.symbols, cfg.relocs, cfg.depth);
+
+                fprintf(stderr, "bench: symbols=%zu relocs=%zu depth=%zu\n", cfg.symbols, cfg.relocs, cfg.depth);
+                if (generate(dir, &cfg) < 0 || bench_config(dir, &cfg, &opts) < 0) {
+                    ret = 1;
+                }
+                fflush(g_out);
+            }
+        }
+    }
+
+    if (opts.keep) {
+        fprintf(stderr, "bench: libraries kept in %s\n", workdir);
+    } else {
+        char cmd[PATH_MAX];
+        snprintf(cmd, sizeof(cmd), "rm -rf %s", workdir);
+        if (system(cmd) != 0) {
+            LOG_WARN("Failed to remove %s\n", workdir);
+        }
+    }
+    if (out_path) fclose(g_out);
+    return ret;
+}
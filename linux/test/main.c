@@ -4,9 +4,14 @@
  * 使用自定义的 mini_dlopen/mini_dlsym 加载共享库
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <link.h>
 #include "mini_dlfcn.h"
 #include "linker.h"
 #include "elf_parser.h"
@@ -18,6 +23,113 @@ typedef int (*multiply_func)(int, int);
 typedef const char* (*get_message_func)(void);
 typedef void (*print_hello_func)(const char*);
 typedef int (*factorial_func)(int);
+typedef int (*int_func)(void);
+
+// 断言: 不成立时输出错误并计入 failures（只在 main 中使用，失败时进程返回 1）
+#define EXPECT(cond, ...) do { if (!(cond)) { LOG_ERROR(__VA_ARGS__); failures++; } } while (0)
+
+// 并发测试: 查找线程与加载/卸载线程同时运行
+static volatile int g_stop_lookups = 0;
+static int g_lookups_started = 0;
+
+typedef struct {
+    void* factorial;        // 主线程持有 test_lib.so 时得到的地址
+    volatile long lookups;
+    long errors;
+} lookup_test_t;
+
+static void* lookup_thread(void* arg) {
+    lookup_test_t* t = (lookup_test_t*)arg;
+    __atomic_add_fetch(&g_lookups_started, 1, __ATOMIC_RELEASE);
+    while (!g_stop_lookups) {
+        // test_lib.so 一直被持有，插件随时可能被卸载（结果为 NULL 或有效地址都可以）
+        if (mini_dlsym(MINI_RTLD_DEFAULT, "factorial") != t->factorial) t->errors++;
+        if (mini_dlsym(MINI_RTLD_DEFAULT, "no_such_symbol")) t->errors++;
+        mini_dlsym(MINI_RTLD_DEFAULT, "plugin_calls");
+        t->lookups += 3;
+    }
+    return NULL;
+}
+
+// 地址反查测试: 遍历到的库
+static int phdr_callback(struct dl_phdr_info* info, size_t size, void* data) {
+    (void)size;
+    int loads = 0;
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        if (info->dlpi_phdr[i].p_type == PT_LOAD) loads++;
+    }
+    LOG_INFO("phdr: %s at %p, %d PT_LOAD, TLS module %zu\n", info->dlpi_name,
+             (void*)info->dlpi_addr, loads, info->dlpi_tls_modid);
+    (*(int*)data)++;
+    return 0;
+}
+
+// TLS 测试: 新线程中的线程局部变量从初始值开始
+typedef struct {
+    int_func funcs[3];      // tls_increment, tls_ie_increment, tls_dep_value
+    int results[3];
+    void* dep_handle;       // test_dep.so，dlsym("dep_tls_value") 应返回本线程的变量
+    int* dep_var;
+    int dep_ok;
+    void* handle;           // test_lib.so
+    int_func ie_increment;  // tls_ie_value_increment，变量初始值为 40
+    int ie_value;
+    int ie_ok;
+} tls_test_t;
+
+// dlsym 得到的 TLS 变量地址与代码访问的是同一个变量（tls_dep_value 返回后加一）
+static int check_dep_tls(tls_test_t* t) {
+    t->dep_var = (int*)mini_dlsym(t->dep_handle, "dep_tls_value");
+    if (!t->dep_var) return 0;
+    int before = *t->dep_var;
+    return t->funcs[2]() == before && *t->dep_var == before + 1;
+}
+
+// 先经由 initial-exec 写入，再经由 __tls_get_addr（dlsym）读取，两边必须一致
+static int check_ie_tls(tls_test_t* t) {
+    t->ie_value = t->ie_increment();
+    int* var = (int*)mini_dlsym(t->handle, "tls_ie_value");
+    return var && *var == t->ie_value;
+}
+
+static void* tls_thread(void* arg) {
+    tls_test_t* t = (tls_test_t*)arg;
+    t->ie_ok = check_ie_tls(t) && t->ie_value == 41;
+    for (int i = 0; i < 3; i++) {
+        t->results[i] = t->funcs[i]();
+    }
+    t->dep_ok = check_dep_tls(t);
+    return NULL;
+}
+
+// 热替换测试: 调用线程经由稳定槽持续调用，替换前后都不能崩溃
+typedef struct {
+    void** slot;            // plugin_version 的槽
+    volatile int stop;
+    volatile long calls[3]; // 按返回的版本号计数
+} reload_test_t;
+
+static void* slot_call_thread(void* arg) {
+    reload_test_t* t = (reload_test_t*)arg;
+    while (!t->stop) {
+        mini_dlslot_enter();
+        int version = ((int_func)mini_dlslot_get(t->slot))();
+        mini_dlslot_exit();
+        t->calls[version >= 1 && version <= 2 ? version : 0]++;
+    }
+    return NULL;
+}
+
+// 异步日志测试: 两个线程同时写日志，参数在调用返回后立即失效
+static void* async_log_thread(void* arg) {
+    for (int i = 0; i < 3; i++) {
+        char word[16];
+        snprintf(word, sizeof(word), "msg-%d", i);
+        LOG_INFO("async log from thread %ld: %s %.*s %zu %5.2f\n",
+                 (long)(intptr_t)arg, word, 3, "abcdef", (size_t)i, i * 1.5);
+    }
+    return NULL;
+}
 
 void print_usage(const char* prog) {
     printf("Usage: %s <shared_library.so>\n", prog);
@@ -27,6 +139,7 @@ void print_usage(const char* prog) {
 
 int main(int argc, char* argv[]) {
     const char* lib_path;
+    int failures = 0;
 
     // 初始化日志系统
     log_init();
@@ -75,8 +188,10 @@ int main(int argc, char* argv[]) {
     if (add) {
         int result = add(10, 20);
         LOG_INFO("add(10, 20) = %d\n", result);
+        EXPECT(result == 30, "add(10, 20) should be 30\n");
     } else {
         LOG_ERROR("Failed to find 'add': %s\n", mini_dlerror());
+        failures++;
     }
 
     // 测试 multiply
@@ -85,8 +200,10 @@ int main(int argc, char* argv[]) {
     if (multiply) {
         int result = multiply(6, 7);
         LOG_INFO("multiply(6, 7) = %d\n", result);
+        EXPECT(result == 42, "multiply(6, 7) should be 42\n");
     } else {
         LOG_ERROR("Failed to find 'multiply': %s\n", mini_dlerror());
+        failures++;
     }
 
     // 测试 get_message
@@ -95,8 +212,11 @@ int main(int argc, char* argv[]) {
     if (get_message) {
         const char* msg = get_message();
         LOG_INFO("get_message() = \"%s\"\n", msg);
+        // g_message 由 RELATIVE 重定位（test_lib_relr.so 中是 DT_RELR）填写
+        EXPECT(msg && strcmp(msg, "Hello from mini linker!") == 0, "get_message() returned the wrong string\n");
     } else {
         LOG_ERROR("Failed to find 'get_message': %s\n", mini_dlerror());
+        failures++;
     }
 
     // 测试 print_hello
@@ -107,6 +227,7 @@ int main(int argc, char* argv[]) {
         print_hello("Mini Linker");
     } else {
         LOG_ERROR("Failed to find 'print_hello': %s\n", mini_dlerror());
+        failures++;
     }
 
     // 测试 factorial
@@ -115,8 +236,10 @@ int main(int argc, char* argv[]) {
     if (factorial) {
         LOG_INFO("factorial(5) = %d\n", factorial(5));
         LOG_INFO("factorial(10) = %d\n", factorial(10));
+        EXPECT(factorial(5) == 120 && factorial(10) == 3628800, "factorial returned wrong values\n");
     } else {
         LOG_ERROR("Failed to find 'factorial': %s\n", mini_dlerror());
+        failures++;
     }
 
     // 测试全局变量
@@ -124,12 +247,132 @@ int main(int argc, char* argv[]) {
     int* counter = (int*)mini_dlsym(handle, "global_counter");
     if (counter) {
         LOG_INFO("global_counter = %d\n", *counter);
+        EXPECT(*counter == 42, "global_counter should start at 42\n");
         *counter = 100;
         LOG_INFO("global_counter (after modification) = %d\n", *counter);
     } else {
         LOG_ERROR("Failed to find 'global_counter': %s\n", mini_dlerror());
+        failures++;
+    }
+
+    // 测试批量查找: 一次解析多个符号
+    LOG_INFO("Looking up symbols in batch: add, multiply, factorial, undefined_symbol\n");
+    const char* batch_names[] = { "add", "multiply", "factorial", "undefined_symbol" };
+    void* batch_addrs[4];
+    size_t batch_found = mini_dlsym_many(handle, batch_names, batch_addrs, 4);
+    bool batch_match = batch_addrs[0] == (void*)add && batch_addrs[1] == (void*)multiply &&
+                       batch_addrs[2] == (void*)factorial && !batch_addrs[3];
+    LOG_INFO("mini_dlsym_many found %zu/4 (matches dlsym: %s)\n", batch_found, batch_match ? "yes" : "no");
+    EXPECT(batch_found == 3 && batch_match, "mini_dlsym_many does not match mini_dlsym\n");
+    mini_dlerror();
+
+    // 测试依赖库: scaled_add 调用 test_dep.so 中的 dep_scale
+    LOG_INFO("Looking up symbol: scaled_add\n");
+    add_func scaled_add = (add_func)mini_dlsym(handle, "scaled_add");
+    if (scaled_add) {
+        LOG_INFO("scaled_add(2, 3) = %d\n", scaled_add(2, 3));
+        EXPECT(scaled_add(2, 3) == 50, "scaled_add(2, 3) should be 50\n");
+    } else {
+        LOG_ERROR("Failed to find 'scaled_add': %s\n", mini_dlerror());
+        failures++;
+    }
+
+    // 测试地址反查: 函数内部的地址还原为 (库, 符号)，主程序中的地址不属于任何库
+    LOG_INFO("--- Testing address lookup ---\n");
+    mini_dl_info_t dl_info;
+    const char* lib_name = ((soinfo_t*)handle)->name;
+    if (factorial && mini_dladdr((const char*)factorial + 4, &dl_info)) {
+        LOG_INFO("factorial+4: %s, %s+%#lx\n", dl_info.dli_fname,
+                 dl_info.dli_sname ? dl_info.dli_sname : "?",
+                 (unsigned long)((const char*)factorial + 4 - (const char*)dl_info.dli_saddr));
+        EXPECT(strcmp(dl_info.dli_fname, lib_name) == 0 && dl_info.dli_sname &&
+               strcmp(dl_info.dli_sname, "factorial") == 0 && dl_info.dli_saddr == (void*)factorial &&
+               dl_info.dli_fbase == ((soinfo_t*)handle)->load_bias,
+               "mini_dladdr(factorial+4) should be %s, factorial at %p\n", lib_name, (void*)factorial);
+    } else {
+        LOG_ERROR("mini_dladdr failed: %s\n", mini_dlerror());
+        failures++;
+    }
+    if (scaled_add && mini_dladdr((void*)scaled_add, &dl_info)) {
+        LOG_INFO("scaled_add: %s, %s\n", dl_info.dli_fname, dl_info.dli_sname ? dl_info.dli_sname : "?");
+        EXPECT(dl_info.dli_sname && strcmp(dl_info.dli_sname, "scaled_add") == 0 &&
+               dl_info.dli_saddr == (void*)scaled_add, "mini_dladdr(scaled_add) returned the wrong symbol\n");
+    } else {
+        LOG_ERROR("mini_dladdr(scaled_add) failed: %s\n", mini_dlerror());
+        failures++;
+    }
+    EXPECT(!mini_dladdr((void*)main, &dl_info), "main should not be in a mini-loaded library\n");
+    mini_dlerror();
+    int phdr_count = 0;
+    mini_dl_iterate_phdr(phdr_callback, &phdr_count);
+    LOG_INFO("dl_iterate_phdr visited %d libraries\n", phdr_count);
+    // 至少有 test_lib 和它的依赖 test_dep
+    EXPECT(phdr_count >= 2, "dl_iterate_phdr visited %d libraries, expected at least 2\n", phdr_count);
+
+    // 测试符号版本: test_lib 按 .gnu.version_r 绑定 dep_version@@DEP_2
+    LOG_INFO("--- Testing symbol versioning ---\n");
+    int_func call_dep_version = (int_func)mini_dlsym(handle, "call_dep_version");
+    int_func dep_v1 = (int_func)mini_dlvsym(MINI_RTLD_DEFAULT, "dep_version", "DEP_1");
+    int_func dep_default = (int_func)mini_dlsym(MINI_RTLD_DEFAULT, "dep_version");
+    int version_results[3] = {
+        call_dep_version ? call_dep_version() : -1, dep_v1 ? dep_v1() : -1, dep_default ? dep_default() : -1,
+    };
+    LOG_INFO("call_dep_version() = %d, dep_version@DEP_1 = %d, dep_version = %d\n",
+             version_results[0], version_results[1], version_results[2]);
+    EXPECT(version_results[0] == 2 && version_results[1] == 1 && version_results[2] == 2,
+           "expected call_dep_version() = 2, dep_version@DEP_1 = 1, dep_version = 2\n");
+    EXPECT(!mini_dlvsym(MINI_RTLD_DEFAULT, "dep_version", "DEP_3"), "dep_version@DEP_3 should not exist\n");
+    mini_dlerror();
+
+    // 测试 TLS: 动态模型、initial-exec 和跨模块引用（主线程先修改，新线程应看到初始值）
+    LOG_INFO("--- Testing thread-local storage ---\n");
+    tls_test_t tls = { .funcs = {
+        (int_func)mini_dlsym(handle, "tls_increment"),
+        (int_func)mini_dlsym(handle, "tls_ie_increment"),
+        (int_func)mini_dlsym(handle, "tls_dep_value"),
+    }, .handle = handle, .ie_increment = (int_func)mini_dlsym(handle, "tls_ie_value_increment") };
+    if (tls.funcs[0] && tls.funcs[1] && tls.funcs[2] && tls.ie_increment) {
+        int main_results[3];
+        for (int i = 0; i < 3; i++) {
+            tls.funcs[i]();
+            main_results[i] = tls.funcs[i]();
+        }
+        soinfo_t* dep = ((soinfo_t*)handle)->needed_count ? ((soinfo_t*)handle)->needed[0] : NULL;
+        tls.dep_handle = dep ? mini_dlopen(dep->name, MINI_RTLD_NOW) : NULL;
+        int main_dep_ok = tls.dep_handle && check_dep_tls(&tls);
+        int* main_dep_var = tls.dep_var;
+        tls.ie_increment();
+        int main_ie_ok = check_ie_tls(&tls) && tls.ie_value == 42;
+
+        pthread_t tls_tid;
+        pthread_create(&tls_tid, NULL, tls_thread, &tls);
+        pthread_join(tls_tid, NULL);
+        LOG_INFO("main thread: %d %d %d, new thread: %d %d %d\n",
+                 main_results[0], main_results[1], main_results[2],
+                 tls.results[0], tls.results[1], tls.results[2]);
+        if (main_dep_ok && tls.dep_ok && main_dep_var != tls.dep_var) {
+            LOG_INFO("dlsym(dep_tls_value) matches tls_dep_value() on both threads\n");
+        } else {
+            LOG_ERROR("dlsym(dep_tls_value) does not return the thread's variable\n");
+            failures++;
+        }
+        if (main_ie_ok && tls.ie_ok) {
+            LOG_INFO("initial-exec tls_ie_value starts at 40 and survives dynamic access on both threads\n");
+        } else {
+            LOG_ERROR("initial-exec tls_ie_value is wrong: new thread got %d\n", tls.ie_value);
+            failures++;
+        }
+        mini_dlclose(tls.dep_handle);
+    } else {
+        LOG_ERROR("Failed to find TLS test functions: %s\n", mini_dlerror());
     }
 
+    // 重复打开同一个库应返回同一个句柄
+    void* again = mini_dlopen(lib_path, MINI_RTLD_NOW);
+    LOG_INFO("Reopen returns same handle: %s (ref_count=%d)\n",
+             again == handle ? "yes" : "no", ((soinfo_t*)handle)->ref_count);
+    mini_dlclose(again);
+
     // 测试未定义符号
     LOG_INFO("Looking up undefined symbol (expect error)\n");
     void* undefined = mini_dlsym(handle, "undefined_symbol");
@@ -140,6 +383,338 @@ int main(int argc, char* argv[]) {
     LOG_INFO("--- Unloading library ---\n");
     mini_dlclose(handle);
 
+    // 测试延迟绑定: PLT 条目在第一次调用时才解析
+    LOG_INFO("--- Testing lazy binding ---\n");
+    handle = mini_dlopen(lib_path, MINI_RTLD_LAZY);
+    if (!handle) {
+        LOG_ERROR("Failed to load library (lazy): %s\n", mini_dlerror());
+        return 1;
+    }
+    LOG_INFO("PLT binding: %s\n", ((soinfo_t*)handle)->lazy_bound ? "lazy" : "immediate");
+    EXPECT(((soinfo_t*)handle)->lazy_bound, "MINI_RTLD_LAZY did not defer PLT binding\n");
+
+    print_hello = (print_hello_func)mini_dlsym(handle, "print_hello");
+    if (print_hello) {
+        // printf 经由 PLT 蹦床解析，第二次调用直接走 GOT
+        print_hello("lazy binding (1st call)");
+        print_hello("lazy binding (2nd call)");
+    } else {
+        LOG_ERROR("Failed to find 'print_hello': %s\n", mini_dlerror());
+        failures++;
+    }
+
+    // 构造函数已经调用过 printf；dep_scale 只有 scaled_add 使用，第一次调用时才解析（计入查找统计）
+    add_func lazy_scaled = (add_func)mini_dlsym(handle, "scaled_add");
+    if (lazy_scaled) {
+        linker_stats_t lazy_stats[3];
+        int lazy_results[2];
+        mini_dlstats(handle, &lazy_stats[0]);
+        lazy_results[0] = lazy_scaled(1, 1);
+        mini_dlstats(handle, &lazy_stats[1]);
+        lazy_results[1] = lazy_scaled(1, 1);
+        mini_dlstats(handle, &lazy_stats[2]);
+        uint64_t lazy_lookups[3] = {0};
+        for (int i = 0; i < 3; i++) {
+            for (int k = 0; k < LINKER_LOOKUP_COUNT; k++) lazy_lookups[i] += lazy_stats[i].lookups[k];
+        }
+        EXPECT(lazy_results[0] == 20 && lazy_results[1] == 20, "lazy scaled_add(1, 1) = %d, %d\n",
+               lazy_results[0], lazy_results[1]);
+        EXPECT(lazy_lookups[1] == lazy_lookups[0] + 1 && lazy_lookups[2] == lazy_lookups[1],
+               "lazy binding lookups: %llu -> %llu -> %llu (expected one, on the first call)\n",
+               (unsigned long long)lazy_lookups[0], (unsigned long long)lazy_lookups[1],
+               (unsigned long long)lazy_lookups[2]);
+    } else {
+        LOG_ERROR("Failed to find 'scaled_add' (lazy): %s\n", mini_dlerror());
+        failures++;
+    }
+    mini_dlclose(handle);
+
+    // 测试并行加载: 依赖库的映射和重定位交给线程池
+    LOG_INFO("--- Testing parallel load ---\n");
+    mini_dlextinfo_t extinfo = { .flags = MINI_DLEXT_THREADS, .threads = 4 };
+    handle = mini_dlopen_ex(lib_path, MINI_RTLD_NOW, &extinfo);
+    if (!handle) {
+        LOG_ERROR("Failed to load library (parallel): %s\n", mini_dlerror());
+        return 1;
+    }
+    add_func scaled = (add_func)mini_dlsym(handle, "scaled_add");
+    if (scaled) {
+        LOG_INFO("scaled_add(4, 5) = %d\n", scaled(4, 5));
+        EXPECT(scaled(4, 5) == 90, "scaled_add(4, 5) should be 90 after a parallel load\n");
+    } else {
+        LOG_ERROR("Failed to find 'scaled_add': %s\n", mini_dlerror());
+        failures++;
+    }
+
+    // 测试加载统计
+    LOG_INFO("--- Testing load statistics ---\n");
+    linker_stats_t stats;
+    if (mini_dlstats(handle, &stats) == 0) {
+        LOG_INFO("total: %llu ns, relocate: %llu ns, mapped: %llu bytes\n",
+                 (unsigned long long)stats.total_ns,
+                 (unsigned long long)stats.phase_ns[LINKER_PHASE_RELOCATE],
+                 (unsigned long long)stats.bytes_mapped);
+    } else {
+        LOG_ERROR("Failed to get stats: %s\n", mini_dlerror());
+    }
+    mini_dlstats_dump(MINI_RTLD_DEFAULT, stdout);
+    mini_dlclose(handle);
+
+    // 测试从 fd 和内存加载
+    LOG_INFO("--- Testing fd and memory load ---\n");
+    FILE* lib_file = fopen(lib_path, "rb");
+    if (lib_file) {
+        handle = mini_dlopen_fd(fileno(lib_file), 0);
+        if (handle) {
+            add_func fd_add = (add_func)mini_dlsym(handle, "add");
+            LOG_INFO("fd load: add(2, 3) = %d\n", fd_add ? fd_add(2, 3) : -1);
+            EXPECT(fd_add && fd_add(2, 3) == 5, "fd load: add(2, 3) should be 5\n");
+            mini_dlclose(handle);
+        } else {
+            LOG_ERROR("Failed to load library from fd: %s\n", mini_dlerror());
+            failures++;
+        }
+
+        // 内存中的镜像没有所在目录，依赖通过 MINI_LD_LIBRARY_PATH 查找
+        char lib_dir[256];
+        const char* slash = strrchr(lib_path, '/');
+        snprintf(lib_dir, sizeof(lib_dir), "%.*s", slash ? (int)(slash - lib_path) : 1,
+                 slash ? lib_path : ".");
+        setenv("MINI_LD_LIBRARY_PATH", lib_dir, 1);
+
+        fseek(lib_file, 0, SEEK_END);
+        long image_size = ftell(lib_file);
+        rewind(lib_file);
+        void* image = malloc(image_size);
+        if (image && fread(image, 1, image_size, lib_file) == (size_t)image_size) {
+            handle = mini_dlopen_mem(image, image_size);
+            if (handle) {
+                add_func mem_scaled = (add_func)mini_dlsym(handle, "scaled_add");
+                LOG_INFO("memory load: scaled_add(1, 2) = %d\n", mem_scaled ? mem_scaled(1, 2) : -1);
+                EXPECT(mem_scaled && mem_scaled(1, 2) == 30, "memory load: scaled_add(1, 2) should be 30\n");
+                mini_dlclose(handle);
+            } else {
+                LOG_ERROR("Failed to load library from memory: %s\n", mini_dlerror());
+                failures++;
+            }
+        }
+        free(image);
+        unsetenv("MINI_LD_LIBRARY_PATH");
+        fclose(lib_file);
+    }
+
+    // 测试重定位缓存: 第一次加载写入缓存，第二次加载直接写回
+    LOG_INFO("--- Testing relocation cache ---\n");
+    char cache_dir[] = "/tmp/mini_linker_rcache.XXXXXX";
+    if (mkdtemp(cache_dir)) {
+        mini_dlextinfo_t cache_info = { .flags = MINI_DLEXT_RELOC_CACHE, .reloc_cache_dir = cache_dir };
+        for (int i = 0; i < 2; i++) {
+            handle = mini_dlopen_ex(lib_path, MINI_RTLD_NOW, &cache_info);
+            if (!handle) {
+                LOG_ERROR("Failed to load library (reloc cache): %s\n", mini_dlerror());
+                failures++;
+                break;
+            }
+            // 缓存命中时符号重定位直接写回，不做任何符号查找。test_lib 有 TLS 重定位，
+            // 缓存无法表达，每次都正常重定位；检查它的依赖 test_dep
+            soinfo_t* cached_dep = ((soinfo_t*)handle)->needed_count ? ((soinfo_t*)handle)->needed[0] : NULL;
+            linker_stats_t cache_stats;
+            uint64_t cache_lookups = 0;
+            if (cached_dep && mini_dlstats(cached_dep, &cache_stats) == 0) {
+                for (int k = 0; k < LINKER_LOOKUP_COUNT; k++) cache_lookups += cache_stats.lookups[k];
+            }
+            add_func cached_scaled = (add_func)mini_dlsym(handle, "scaled_add");
+            LOG_INFO("pass %d: scaled_add(2, 2) = %d, %llu symbol lookups in test_dep\n", i,
+                     cached_scaled ? cached_scaled(2, 2) : -1, (unsigned long long)cache_lookups);
+            EXPECT(cached_scaled && cached_scaled(2, 2) == 40, "pass %d: scaled_add(2, 2) should be 40\n", i);
+            EXPECT(i == 0 ? cache_lookups > 0 : cache_lookups == 0,
+                   "pass %d: %llu symbol lookups, relocation cache %s\n", i,
+                   (unsigned long long)cache_lookups, i == 0 ? "was not written" : "was not used");
+            mini_dlclose(handle);
+        }
+
+        // 清理缓存目录
+        char cmd[64];
+        snprintf(cmd, sizeof(cmd), "rm -rf %s", cache_dir);
+        if (system(cmd) != 0) {
+            LOG_WARN("Failed to remove %s\n", cache_dir);
+        }
+    }
+
+    // 测试大页和预取（测试库的代码段不足 2MB，只验证加载路径）
+    LOG_INFO("--- Testing huge text and prefault ---\n");
+    handle = mini_dlopen(lib_path, MINI_RTLD_NOW | MINI_RTLD_HUGETEXT | MINI_RTLD_PREFAULT);
+    if (handle) {
+        add_func huge_add = (add_func)mini_dlsym(handle, "add");
+        LOG_INFO("add(4, 5) = %d\n", huge_add ? huge_add(4, 5) : -1);
+        EXPECT(huge_add && huge_add(4, 5) == 9, "add(4, 5) should be 9 with huge text and prefault\n");
+        if (mini_dlstats(handle, &stats) == 0) {
+            LOG_INFO("huge text: %llu bytes\n", (unsigned long long)stats.huge_text_bytes);
+            // 不足 2MB 的代码段不能换成大页，必须保持原来的映射
+            EXPECT(stats.huge_text_bytes == 0, "text smaller than 2MB was remapped to huge pages\n");
+        } else {
+            LOG_ERROR("Failed to get stats (huge text): %s\n", mini_dlerror());
+            failures++;
+        }
+        mini_dlclose(handle);
+    } else {
+        LOG_ERROR("Failed to load library (huge text): %s\n", mini_dlerror());
+        failures++;
+    }
+
+    // 测试推迟初始化和并行初始化: 构造函数在第一次 dlsym 时才执行（依赖库先于自身）
+    LOG_INFO("--- Testing deferred and parallel init ---\n");
+    handle = mini_dlopen(lib_path, MINI_RTLD_NOW | MINI_RTLD_DEFERRED_INIT);
+    if (handle) {
+        LOG_INFO("loaded, constructors pending\n");
+        uint64_t pending_inits = mini_dlstats(handle, &stats) == 0 ? stats.init_funcs : (uint64_t)-1;
+        add_func deferred_add = (add_func)mini_dlsym(handle, "add");
+        LOG_INFO("add(6, 7) = %d\n", deferred_add ? deferred_add(6, 7) : -1);
+        uint64_t deferred_inits = mini_dlstats(handle, &stats) == 0 ? stats.init_funcs : 0;
+        int_func saw_dep = (int_func)mini_dlsym(handle, "init_saw_dep");
+        EXPECT(pending_inits == 0 && deferred_inits > 0,
+               "deferred init: %llu constructor(s) before dlsym, %llu after\n",
+               (unsigned long long)pending_inits, (unsigned long long)deferred_inits);
+        EXPECT(saw_dep && saw_dep(), "deferred init: test_lib was initialized before test_dep\n");
+        mini_dlclose(handle);
+    } else {
+        LOG_ERROR("Failed to load library (deferred init): %s\n", mini_dlerror());
+        failures++;
+    }
+    mini_dlextinfo_t init_info = { .flags = MINI_DLEXT_THREADS | MINI_DLEXT_PARALLEL_INIT, .threads = 4 };
+    handle = mini_dlopen_ex(lib_path, MINI_RTLD_NOW, &init_info);
+    if (handle) {
+        if (mini_dlstats(handle, &stats) == 0) {
+            LOG_INFO("init: %llu functions, %llu ns\n", (unsigned long long)stats.init_funcs,
+                     (unsigned long long)stats.phase_ns[LINKER_PHASE_INIT]);
+            EXPECT(stats.init_funcs > 0, "parallel init ran no constructors\n");
+        }
+        int_func saw_dep = (int_func)mini_dlsym(handle, "init_saw_dep");
+        EXPECT(saw_dep && saw_dep(), "parallel init: test_lib was initialized before test_dep\n");
+        mini_dlclose(handle);
+    } else {
+        LOG_ERROR("Failed to load library (parallel init): %s\n", mini_dlerror());
+        failures++;
+    }
+
+    // 测试热替换: 调用线程经由槽持续调用，主线程把插件从 v1 换成 v2
+    LOG_INFO("--- Testing live reload ---\n");
+    handle = mini_dlopen("lib/test_plugin_v1.so", MINI_RTLD_NOW);
+    reload_test_t reload = { .slot = handle ? mini_dlsym_stable(handle, "plugin_version") : NULL };
+    if (reload.slot) {
+        pthread_t caller;
+        pthread_create(&caller, NULL, slot_call_thread, &reload);
+        while (reload.calls[1] == 0) sched_yield();
+        void* reloaded = mini_dlreload(handle, "lib/test_plugin_v2.so", MINI_RTLD_NOW);
+        if (reloaded) {
+            handle = reloaded;
+            while (reload.calls[2] == 0) sched_yield();
+        } else {
+            LOG_ERROR("Failed to reload plugin: %s\n", mini_dlerror());
+            failures++;
+        }
+        reload.stop = 1;
+        pthread_join(caller, NULL);
+        int slot_version = ((int_func)mini_dlslot_get(reload.slot))();
+        LOG_INFO("slot now returns %d (calls v1=%ld, v2=%ld, bad=%ld)\n",
+                 slot_version, reload.calls[1], reload.calls[2], reload.calls[0]);
+        EXPECT(slot_version == 2 && reload.calls[0] == 0,
+               "live reload: slot returns %d, %ld call(s) saw a bad version\n", slot_version, reload.calls[0]);
+        mini_dlclose(handle);
+    } else {
+        LOG_ERROR("Failed to load plugin: %s\n", mini_dlerror());
+        failures++;
+    }
+
+    // 测试异步日志（已经由 MINI_LOG_ASYNC 启用时保持启用）
+    LOG_INFO("--- Testing async logging ---\n");
+    bool async_was_on = getenv("MINI_LOG_ASYNC") && strcmp(getenv("MINI_LOG_ASYNC"), "0") != 0;
+    if (log_start_async() == 0) {
+        pthread_t log_threads[2];
+        for (long i = 0; i < 2; i++) {
+            pthread_create(&log_threads[i], NULL, async_log_thread, (void*)(intptr_t)i);
+        }
+        for (int i = 0; i < 2; i++) {
+            pthread_join(log_threads[i], NULL);
+        }
+        log_flush();
+
+        // 超过 LOG_STRING_MAX 的字符串参数应完整输出（临时把 stdout 重定向到文件）
+        char long_msg[601];
+        memset(long_msg, 'x', sizeof(long_msg) - 1);
+        long_msg[sizeof(long_msg) - 1] = '\0';
+        FILE* capture = tmpfile();
+        int saved_stdout = capture ? dup(STDOUT_FILENO) : -1;
+        if (saved_stdout >= 0) {
+            fflush(stdout);
+            dup2(fileno(capture), STDOUT_FILENO);
+            LOG_INFO("long message: %s\n", long_msg);
+            log_flush();
+            dup2(saved_stdout, STDOUT_FILENO);
+            close(saved_stdout);
+
+            char captured[2048] = {0};
+            rewind(capture);
+            size_t n = fread(captured, 1, sizeof(captured) - 1, capture);
+            captured[n] = '\0';
+            if (strstr(captured, long_msg)) {
+                LOG_INFO("long string argument printed in full (%zu bytes)\n", strlen(long_msg));
+            } else {
+                LOG_ERROR("long string argument was truncated in async mode\n");
+                failures++;
+            }
+        }
+        if (capture) fclose(capture);
+        if (!async_was_on) {
+            log_stop_async();
+        }
+    } else {
+        LOG_ERROR("Failed to start async logging\n");
+    }
+
+    // 测试线程安全: 4 个线程持续查找符号，主线程反复加载和卸载插件
+    LOG_INFO("--- Testing concurrent lookups ---\n");
+    void* pinned = mini_dlopen(lib_path, MINI_RTLD_NOW);
+    lookup_test_t lookups[4] = {{0}};
+    pthread_t readers[4];
+    for (int i = 0; i < 4; i++) {
+        lookups[i].factorial = pinned ? mini_dlsym(pinned, "factorial") : NULL;
+        pthread_create(&readers[i], NULL, lookup_thread, &lookups[i]);
+    }
+    while (__atomic_load_n(&g_lookups_started, __ATOMIC_ACQUIRE) < 4) sched_yield();
+    int cycles = 0;
+    for (; cycles < 100; cycles++) {
+        handle = mini_dlopen("lib/test_plugin_v1.so", MINI_RTLD_NOW);
+        if (!handle) {
+            LOG_ERROR("Failed to load library (concurrent): %s\n", mini_dlerror());
+            failures++;
+            break;
+        }
+        mini_dlclose(handle);
+    }
+    // 每个线程都至少完成一轮查找后再停止
+    for (int i = 0; i < 4; i++) {
+        while (lookups[i].lookups == 0) sched_yield();
+    }
+    g_stop_lookups = 1;
+    long total_lookups = 0, lookup_errors = 0;
+    for (int i = 0; i < 4; i++) {
+        pthread_join(readers[i], NULL);
+        total_lookups += lookups[i].lookups;
+        lookup_errors += lookups[i].errors;
+    }
+    mini_dlclose(pinned);
+    LOG_INFO("Concurrent lookups completed: %ld across %d load/unload cycles\n", total_lookups, cycles);
+    if (!pinned || !lookups[0].factorial || total_lookups == 0 || lookup_errors) {
+        LOG_ERROR("Concurrent lookups returned %ld wrong result(s)\n", lookup_errors);
+        failures++;
+    }
+
+    if (failures) {
+        LOG_ERROR("%d check(s) failed\n", failures);
+        return 1;
+    }
+
     LOG_INFO("===========================================\n");
     LOG_INFO("  Test completed successfully!\n");
     LOG_INFO("===========================================\n");
@@ -0,0 +1,45 @@
+/**
+ * test_dep.c - 测试依赖库（被 test_lib.so 通过 DT_NEEDED 引用）
+ *
+ * 编译命令:
+ *   gcc -shared -fPIC -Wl,-soname,test_dep.so -Wl,--version-script,test/test_dep.map \
+ *       -o lib/test_dep.so test/test_dep.c
+ */
+
+#include <stdio.h>
+
+// 构造函数执行后置 1，test_lib 的构造函数据此检查初始化顺序
+int dep_init_done = 0;
+
+// 构造函数 - 应当先于 test_lib 的构造函数调用
+__attribute__((constructor))
+static void test_dep_init(void) {
+    dep_init_done = 1;
+    printf("[test_dep] Constructor called\n");
+}
+
+// 析构函数 - 应当晚于 test_lib 的析构函数调用
+__attribute__((destructor))
+static void test_dep_fini(void) {
+    printf("[test_dep] Destructor called\n");
+}
+
+// 导出函数: 乘以固定系数
+int dep_scale(int x) {
+    return x * 10;
+}
+
+// 带版本的导出函数（版本节点见 test_dep.map）
+// dep_version@DEP_1 是旧版本，只能按版本名引用；新链接的库绑定默认版本 DEP_2
+__attribute__((symver("dep_version@DEP_1")))
+int dep_version_1(void) {
+    return 1;
+}
+
+__attribute__((symver("dep_version@@DEP_2")))
+int dep_version_2(void) {
+    return 2;
+}
+
+// 线程局部变量（被 test_lib 跨模块引用：DTPMOD64 / DTPOFF64）
+__thread int dep_tls_value = 7;
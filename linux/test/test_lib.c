@@ -7,14 +7,22 @@
 
 #include <stdio.h>
 
+// 来自依赖库 test_dep.so
+extern int dep_scale(int x);
+extern int dep_version(void);
+extern __thread int dep_tls_value;
+extern int dep_init_done;
+
 // 全局变量
 static int g_init_count = 0;
+static int g_dep_ready_at_init = 0;     // 构造函数执行时依赖库是否已经初始化
 static const char* g_message = "Hello from mini linker!";
 
 // 构造函数 - 库加载时调用
 __attribute__((constructor))
 static void test_lib_init(void) {
     g_init_count++;
+    g_dep_ready_at_init = dep_init_done;
     printf("[test_lib] Constructor called (count=%d)\n", g_init_count);
 }
 
@@ -50,5 +58,44 @@ int factorial(int n) {
     return n * factorial(n - 1);
 }
 
+// 导出函数: 调用依赖库中的函数
+int scaled_add(int a, int b) {
+    return dep_scale(a + b);
+}
+
+// 导出函数: 调用依赖库中带版本的函数（链接时绑定 dep_version@@DEP_2）
+int call_dep_version(void) {
+    return dep_version();
+}
+
+// 线程局部变量: 动态模型经由 __tls_get_addr 访问，initial-exec 模型直接用 %fs 偏移访问
+static __thread int tls_counter = 5;
+static __thread int tls_ie_counter __attribute__((tls_model("initial-exec")));
+__thread int tls_ie_value __attribute__((tls_model("initial-exec"))) = 40;
+
+// 导出函数: 每个线程各自计数
+int tls_increment(void) {
+    return ++tls_counter;
+}
+
+int tls_ie_increment(void) {
+    return ++tls_ie_counter;
+}
+
+// 导出函数: 带初始值的 initial-exec 变量
+int tls_ie_value_increment(void) {
+    return ++tls_ie_value;
+}
+
+// 导出函数: 读取依赖库的线程局部变量
+int tls_dep_value(void) {
+    return dep_tls_value++;
+}
+
+// 导出函数: 构造函数执行时依赖库的构造函数是否已经执行
+int init_saw_dep(void) {
+    return g_dep_ready_at_init;
+}
+
 // 导出全局变量
 int global_counter = 42;
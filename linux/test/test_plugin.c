@@ -0,0 +1,16 @@
+// 热替换测试插件：同一份源码以不同的 PLUGIN_VERSION 编译成两个版本
+
+#ifndef PLUGIN_VERSION
+#define PLUGIN_VERSION 1
+#endif
+
+static int calls = 0;
+
+int plugin_version(void) {
+    return PLUGIN_VERSION;
+}
+
+// 每个版本各自计数：替换后从 1 重新开始
+int plugin_calls(void) {
+    return ++calls;
+}